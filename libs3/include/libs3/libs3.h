@@ -142,6 +142,12 @@ extern "C" {
  **/
 #define S3_MAX_KEY_SIZE                   1024
 
+/**
+ * S3_MAX_DELETE_OBJECTS_COUNT is the maximum number of keys that can be
+ * deleted with one S3_delete_objects request.
+ **/
+#define S3_MAX_DELETE_OBJECTS_COUNT       1000
+
 /**
  * S3_MAX_METADATA_SIZE is the maximum number of bytes allowed for
  * x-amz-meta header names and values in any request passed to Amazon S3
@@ -1308,6 +1314,29 @@ typedef S3Status(S3ListPartsResponseCallback)(int isTruncated,
  **/
 typedef S3Status(S3MultipartCommitResponseCallback)(const char* location, const char* etag, void* callbackData);
 
+/**
+ * This callback is made once for each key result returned by a
+ * delete_objects request.  In quiet mode only the keys that could not be
+ * deleted are reported.
+ *
+ * @param key is the key the result is for
+ * @param deleted is nonzero if the key was deleted (or did not exist)
+ * @param errorCode is the S3 error code if the key could not be deleted,
+ *        NULL otherwise
+ * @param errorMessage is the S3 error message if the key could not be
+ *        deleted, NULL otherwise
+ * @param callbackData is the callback data as specified when the request
+ *        was issued.
+ * @return S3StatusOK to continue processing the request, anything else to
+ *         immediately abort the request with a status which will be
+ *         passed to the S3ResponseCompleteCallback for this request.
+ **/
+typedef S3Status(S3DeleteObjectsResultCallback)(const char* key,
+                                                int deleted,
+                                                const char* errorCode,
+                                                const char* errorMessage,
+                                                void* callbackData);
+
 /**
  * Mechanism for S3 application to customize each CURL easy request
  * associated with the given S3 request context.
@@ -1474,6 +1503,23 @@ typedef struct S3MultipartCommitHandler
 	S3MultipartCommitResponseCallback* responseXmlCallback;
 } S3MultipartCommitHandler;
 
+/**
+ * An S3DeleteObjectsHandler defines the callbacks which are made for
+ * delete_objects requests.
+ **/
+typedef struct S3DeleteObjectsHandler
+{
+	/**
+	 * responseHandler provides the properties and complete callback
+	 **/
+	S3ResponseHandler responseHandler;
+
+	/**
+	 * The resultCallback is called for each key result in the response.
+	 **/
+	S3DeleteObjectsResultCallback* resultCallback;
+} S3DeleteObjectsHandler;
+
 typedef struct S3RestoreObjectHandler
 {
 	/**
@@ -2255,6 +2301,31 @@ void S3_copy_object_range(const S3BucketContext* bucketContext,
                           const S3ResponseHandler* handler,
                           void* callbackData);
 
+/**
+ * Like S3_copy_object_range, but the copy only succeeds if the eTag of the
+ * source object is sourceIfMatchETag (sent as x-amz-copy-source-if-match).
+ * Otherwise it completes with S3StatusErrorPreconditionFailed.  The eTag
+ * must be in the S3 form, which typically includes double-quotes.  If
+ * sourceIfMatchETag is NULL there is no condition.
+ **/
+void S3_copy_object_range_if_match(const S3BucketContext* bucketContext,
+                                   const char* key,
+                                   const char* destinationBucket,
+                                   const char* destinationKey,
+                                   const int partNo,
+                                   const char* uploadId,
+                                   const unsigned long startOffset,
+                                   const unsigned long count,
+                                   const char* sourceIfMatchETag,
+                                   const S3PutProperties* putProperties,
+                                   int64_t* lastModifiedReturn,
+                                   int eTagReturnSize,
+                                   char* eTagReturn,
+                                   S3RequestContext* requestContext,
+                                   int timeoutMs,
+                                   const S3ResponseHandler* handler,
+                                   void* callbackData);
+
 /**
  * Gets an object from S3.  The contents of the object are returned in the
  * handler's getObjectDataCallback.
@@ -2358,6 +2429,73 @@ void S3_delete_object(const S3BucketContext* bucketContext,
                       const S3ResponseHandler* handler,
                       void* callbackData);
 
+/**
+ * Returns nonzero if the key can be sent in a S3_delete_objects request.  The
+ * request is an XML 1.0 document, which cannot contain control characters
+ * other than tab, line feed and carriage return.  Objects with other keys
+ * must be deleted with S3_delete_object.
+ *
+ * @param key is the key to check
+ * @return nonzero if the key can be sent, 0 otherwise
+ **/
+int S3_is_valid_delete_objects_key(const char* key);
+
+/**
+ * Writes the XML document a S3_delete_objects request for the keys sends.
+ * The request does not need it, the document is generated as it is sent.
+ *
+ * @param keysCount is the number of keys
+ * @param keys are the keys, which must be accepted by
+ *        S3_is_valid_delete_objects_key
+ * @param quiet is nonzero to ask for the keys that could not be deleted only
+ * @param buffer receives the document and a terminating nul, cut short if it
+ *        does not fit
+ * @param bufferSize is the size of buffer
+ * @return the length of the whole document, or -1 if a key is not valid or
+ *         memory could not be allocated
+ **/
+int S3_generate_delete_objects_document(int keysCount,
+                                        const char* const* keys,
+                                        int quiet,
+                                        char* buffer,
+                                        int bufferSize);
+
+/**
+ * Deletes up to S3_MAX_DELETE_OBJECTS_COUNT objects from a bucket with a
+ * single multi-object delete (POST ?delete) request.
+ *
+ * The XML request document is generated as it is sent and the per-key
+ * results are parsed as they are received, so memory use does not depend
+ * on the number of keys.  The completion status is S3StatusOK if the
+ * request itself succeeded, even if some keys could not be deleted; those
+ * are reported through the resultCallback.
+ *
+ * @param bucketContext gives the bucket and associated parameters for this
+ *        request
+ * @param keysCount is the number of keys, 1 to S3_MAX_DELETE_OBJECTS_COUNT
+ * @param keys are the keys of the objects to delete.  The keys must remain
+ *        valid until the request completes.  If any key is not accepted by
+ *        S3_is_valid_delete_objects_key the request is not sent and completes
+ *        with S3StatusNotSupported (or S3StatusKeyTooLong).
+ * @param quiet if nonzero, only keys that could not be deleted are reported
+ * @param requestContext if non-NULL, gives the S3RequestContext to add this
+ *        request to, and does not perform the request immediately.  If NULL,
+ *        performs the request immediately and synchronously.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @param handler gives the callbacks to call as the request is processed and
+ *        completed
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks for this request
+ **/
+void S3_delete_objects(const S3BucketContext* bucketContext,
+                       int keysCount,
+                       const char* const* keys,
+                       int quiet,
+                       S3RequestContext* requestContext,
+                       int timeoutMs,
+                       const S3DeleteObjectsHandler* handler,
+                       void* callbackData);
+
 /** **************************************************************************
  * Access Control List Functions
  ************************************************************************** **/
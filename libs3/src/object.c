@@ -36,6 +36,11 @@
 #include <strings.h>
 #include "libs3/libs3.h"
 #include "libs3/request.h"
+#include "libs3/simplexml.h"
+
+#ifndef __APPLE__
+#  include <openssl/evp.h>
+#endif
 
 // put object ----------------------------------------------------------------
 
@@ -215,6 +220,46 @@ void S3_copy_object_range(const S3BucketContext* bucketContext,
                           const S3ResponseHandler* handler,
                           void* callbackData)
 {
+	S3_copy_object_range_if_match(bucketContext,
+	                              key,
+	                              destinationBucket,
+	                              destinationKey,
+	                              partNo,
+	                              uploadId,
+	                              startOffset,
+	                              count,
+	                              NULL, // No source condition
+	                              putProperties,
+	                              lastModifiedReturn,
+	                              eTagReturnSize,
+	                              eTagReturn,
+	                              requestContext,
+	                              timeoutMs,
+	                              handler,
+	                              callbackData);
+}
+
+void S3_copy_object_range_if_match(const S3BucketContext* bucketContext,
+                                   const char* key,
+                                   const char* destinationBucket,
+                                   const char* destinationKey,
+                                   const int partNo,
+                                   const char* uploadId,
+                                   const unsigned long startOffset,
+                                   const unsigned long count,
+                                   const char* sourceIfMatchETag,
+                                   const S3PutProperties* putProperties,
+                                   int64_t* lastModifiedReturn,
+                                   int eTagReturnSize,
+                                   char* eTagReturn,
+                                   S3RequestContext* requestContext,
+                                   int timeoutMs,
+                                   const S3ResponseHandler* handler,
+                                   void* callbackData)
+{
+	// The headers are composed before request_perform returns
+	S3GetConditions sourceConditions = {-1, -1, sourceIfMatchETag, NULL};
+
 	// Create the callback data
 	CopyObjectData* data = (CopyObjectData*) malloc(sizeof(CopyObjectData));
 	if (!data) {
@@ -262,7 +307,7 @@ void S3_copy_object_range(const S3BucketContext* bucketContext,
 		0,                                                                  // subResource
 		bucketContext->bucketName,                                          // copySourceBucketName
 		key,                                                                // copySourceKey
-		0,                                                                  // getConditions
+		sourceIfMatchETag ? &sourceConditions : 0,                          // getConditions
 		startOffset,                                                        // startByte
 		count,                                                              // byteCount
 		putProperties,                                                      // putProperties
@@ -419,6 +464,404 @@ void S3_delete_object(const S3BucketContext* bucketContext,
 	request_perform(&params, requestContext);
 }
 
+// delete objects -------------------------------------------------------------
+
+// Every character of a key may be escaped as an XML entity of up to 6 bytes
+#define DELETE_OBJECTS_MAX_PIECE_SIZE (sizeof("<Object><Key></Key></Object>") + 6 * S3_MAX_KEY_SIZE)
+
+typedef struct DeleteObjectsData
+{
+	SimpleXml simpleXml;
+
+	const S3DeleteObjectsHandler* handler;
+	void* callbackData;
+
+	// The request document is generated one piece (the header, one Object
+	// element or the footer) at a time as it is sent.
+	int keysCount;
+	const char* const* keys;
+	int quiet;
+	int nextPiece;
+	char piece[DELETE_OBJECTS_MAX_PIECE_SIZE];
+	int pieceLen;
+	int pieceOffset;
+
+	string_buffer(key, S3_MAX_KEY_SIZE);
+	string_buffer(errorCode, 256);
+	string_buffer(errorMessage, 1024);
+} DeleteObjectsData;
+
+int S3_is_valid_delete_objects_key(const char* key)
+{
+	const char* c;
+
+	if (strlen(key) > S3_MAX_KEY_SIZE) {
+		return 0;
+	}
+
+	// XML 1.0 has no representation, not even a character reference, for
+	// the other control characters
+	for (c = key; *c; c++) {
+		if ((unsigned char) *c < 0x20 && *c != '\t' && *c != '\n' && *c != '\r') {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// Escapes [src] for use as XML character data into [dest], which must have
+// room for 6 times the length of [src] plus one.  [src] must be a valid key
+// (see S3_is_valid_delete_objects_key).  Returns the length written.
+static int xml_escape(char* dest, const char* src)
+{
+	char* d = dest;
+
+	for (; *src; src++) {
+		switch (*src) {
+			case '&':
+				d += sprintf(d, "&amp;");
+				break;
+			case '<':
+				d += sprintf(d, "&lt;");
+				break;
+			case '>':
+				d += sprintf(d, "&gt;");
+				break;
+			case '"':
+				d += sprintf(d, "&quot;");
+				break;
+			case '\'':
+				d += sprintf(d, "&apos;");
+				break;
+			default:
+				// tab, line feed and carriage return, which would be
+				// normalized by the parser if written as they are
+				if ((unsigned char) *src < 0x20) {
+					d += sprintf(d, "&#%d;", (unsigned char) *src);
+				}
+				else {
+					*d++ = *src;
+				}
+				break;
+		}
+	}
+
+	*d = 0;
+	return d - dest;
+}
+
+static void delete_objects_reset_document(DeleteObjectsData* doData)
+{
+	doData->nextPiece = -1;
+	doData->pieceLen = 0;
+	doData->pieceOffset = 0;
+}
+
+// Generates the next piece of the request document.  Returns 0 when the
+// document is complete.
+static int delete_objects_next_piece(DeleteObjectsData* doData)
+{
+	int len = 0;
+
+	if (doData->nextPiece < 0) {
+		len = sprintf(doData->piece,
+		              "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Delete><Quiet>%s</Quiet>",
+		              doData->quiet ? "true" : "false");
+	}
+	else if (doData->nextPiece < doData->keysCount) {
+		len = sprintf(doData->piece, "<Object><Key>");
+		len += xml_escape(doData->piece + len, doData->keys[doData->nextPiece]);
+		len += sprintf(doData->piece + len, "</Key></Object>");
+	}
+	else if (doData->nextPiece == doData->keysCount) {
+		len = sprintf(doData->piece, "</Delete>");
+	}
+	else {
+		return 0;
+	}
+
+	doData->nextPiece++;
+	doData->pieceLen = len;
+	doData->pieceOffset = 0;
+	return 1;
+}
+
+int S3_generate_delete_objects_document(int keysCount,
+                                        const char* const* keys,
+                                        int quiet,
+                                        char* buffer,
+                                        int bufferSize)
+{
+	int i;
+	for (i = 0; i < keysCount; i++) {
+		if (!S3_is_valid_delete_objects_key(keys[i])) {
+			return -1;
+		}
+	}
+
+	DeleteObjectsData* doData = (DeleteObjectsData*) malloc(sizeof(DeleteObjectsData));
+	if (!doData) {
+		return -1;
+	}
+
+	doData->keysCount = keysCount;
+	doData->keys = keys;
+	doData->quiet = quiet;
+	delete_objects_reset_document(doData);
+
+	int length = 0;
+	while (delete_objects_next_piece(doData)) {
+		if (length < bufferSize - 1) {
+			int toCopy = doData->pieceLen;
+			if (toCopy > bufferSize - 1 - length) {
+				toCopy = bufferSize - 1 - length;
+			}
+			memcpy(buffer + length, doData->piece, toCopy);
+		}
+		length += doData->pieceLen;
+	}
+
+	if (bufferSize > 0) {
+		buffer[length < bufferSize ? length : bufferSize - 1] = 0;
+	}
+
+	free(doData);
+	return length;
+}
+
+static int deleteObjectsDataCallback(int bufferSize, char* buffer, void* callbackData)
+{
+	DeleteObjectsData* doData = (DeleteObjectsData*) callbackData;
+	int written = 0;
+
+	while (written < bufferSize) {
+		if (doData->pieceOffset == doData->pieceLen && !delete_objects_next_piece(doData)) {
+			break;
+		}
+
+		int toCopy = doData->pieceLen - doData->pieceOffset;
+		if (toCopy > bufferSize - written) {
+			toCopy = bufferSize - written;
+		}
+
+		memcpy(buffer + written, doData->piece + doData->pieceOffset, toCopy);
+		doData->pieceOffset += toCopy;
+		written += toCopy;
+	}
+
+	return written;
+}
+
+static S3Status deleteObjectsXmlCallback(const char* elementPath, const char* data, int dataLen, void* callbackData)
+{
+	DeleteObjectsData* doData = (DeleteObjectsData*) callbackData;
+
+	int fit;
+
+	if (data) {
+		if (!strcmp(elementPath, "DeleteResult/Deleted/Key") || !strcmp(elementPath, "DeleteResult/Error/Key")) {
+			string_buffer_append(doData->key, data, dataLen, fit);
+		}
+		else if (!strcmp(elementPath, "DeleteResult/Error/Code")) {
+			string_buffer_append(doData->errorCode, data, dataLen, fit);
+		}
+		else if (!strcmp(elementPath, "DeleteResult/Error/Message")) {
+			string_buffer_append(doData->errorMessage, data, dataLen, fit);
+		}
+	}
+	else {
+		int deleted = !strcmp(elementPath, "DeleteResult/Deleted");
+		if (deleted || !strcmp(elementPath, "DeleteResult/Error")) {
+			S3Status status = S3StatusOK;
+			if (doData->handler->resultCallback) {
+				status = (*(doData->handler->resultCallback))(doData->key,
+				                                              deleted,
+				                                              deleted ? 0 : doData->errorCode,
+				                                              deleted ? 0 : doData->errorMessage,
+				                                              doData->callbackData);
+			}
+			string_buffer_initialize(doData->key);
+			string_buffer_initialize(doData->errorCode);
+			string_buffer_initialize(doData->errorMessage);
+			return status;
+		}
+	}
+
+	(void) fit;
+
+	return S3StatusOK;
+}
+
+static S3Status deleteObjectsPropertiesCallback(const S3ResponseProperties* responseProperties, void* callbackData)
+{
+	DeleteObjectsData* doData = (DeleteObjectsData*) callbackData;
+
+	if (doData->handler->responseHandler.propertiesCallback) {
+		return (*(doData->handler->responseHandler.propertiesCallback))(responseProperties, doData->callbackData);
+	}
+	return S3StatusOK;
+}
+
+static S3Status deleteObjectsResponseCallback(int bufferSize, const char* buffer, void* callbackData)
+{
+	DeleteObjectsData* doData = (DeleteObjectsData*) callbackData;
+	return simplexml_add(&(doData->simpleXml), buffer, bufferSize);
+}
+
+static void deleteObjectsCompleteCallback(S3Status requestStatus,
+                                          const S3ErrorDetails* s3ErrorDetails,
+                                          void* callbackData)
+{
+	DeleteObjectsData* doData = (DeleteObjectsData*) callbackData;
+
+	if (doData->handler->responseHandler.completeCallback) {
+		(*(doData->handler->responseHandler.completeCallback))(requestStatus, s3ErrorDetails, doData->callbackData);
+	}
+
+	simplexml_deinitialize(&(doData->simpleXml));
+	free(doData);
+}
+
+void S3_delete_objects(const S3BucketContext* bucketContext,
+                       int keysCount,
+                       const char* const* keys,
+                       int quiet,
+                       S3RequestContext* requestContext,
+                       int timeoutMs,
+                       const S3DeleteObjectsHandler* handler,
+                       void* callbackData)
+{
+#ifdef __APPLE__
+	/* This request requires calculating MD5 sum.
+	 * MD5 sum requires OpenSSL library, which is not used on Apple.
+	 */
+	(void) bucketContext;
+	(void) keysCount;
+	(void) keys;
+	(void) quiet;
+	(void) requestContext;
+	(void) timeoutMs;
+	(*(handler->responseHandler.completeCallback))(S3StatusNotSupported, 0, callbackData);
+	return;
+#else
+	if (keysCount < 1 || keysCount > S3_MAX_DELETE_OBJECTS_COUNT) {
+		(*(handler->responseHandler.completeCallback))(S3StatusInternalError, 0, callbackData);
+		return;
+	}
+
+	int i;
+	for (i = 0; i < keysCount; i++) {
+		if (strlen(keys[i]) > S3_MAX_KEY_SIZE) {
+			(*(handler->responseHandler.completeCallback))(S3StatusKeyTooLong, 0, callbackData);
+			return;
+		}
+		if (!S3_is_valid_delete_objects_key(keys[i])) {
+			(*(handler->responseHandler.completeCallback))(S3StatusNotSupported, 0, callbackData);
+			return;
+		}
+	}
+
+	DeleteObjectsData* doData = (DeleteObjectsData*) malloc(sizeof(DeleteObjectsData));
+	if (!doData) {
+		(*(handler->responseHandler.completeCallback))(S3StatusOutOfMemory, 0, callbackData);
+		return;
+	}
+
+	simplexml_initialize(&(doData->simpleXml), &deleteObjectsXmlCallback, doData);
+
+	doData->handler = handler;
+	doData->callbackData = callbackData;
+	doData->keysCount = keysCount;
+	doData->keys = keys;
+	doData->quiet = quiet;
+	string_buffer_initialize(doData->key);
+	string_buffer_initialize(doData->errorCode);
+	string_buffer_initialize(doData->errorMessage);
+
+	// The Content-MD5 header is required for this request.  Generate the
+	// document once to compute it and its length, it is generated again as
+	// it is sent.
+	unsigned char md5[EVP_MAX_MD_SIZE];
+	unsigned int md5Len = 0;
+	char md5Base64[64];
+	int64_t contentLength = 0;
+
+	EVP_MD_CTX* mdContext = EVP_MD_CTX_new();
+	if (!mdContext) {
+		free(doData);
+		(*(handler->responseHandler.completeCallback))(S3StatusOutOfMemory, 0, callbackData);
+		return;
+	}
+	EVP_DigestInit_ex(mdContext, EVP_md5(), 0);
+
+	delete_objects_reset_document(doData);
+	while (delete_objects_next_piece(doData)) {
+		EVP_DigestUpdate(mdContext, doData->piece, doData->pieceLen);
+		contentLength += doData->pieceLen;
+	}
+
+	EVP_DigestFinal_ex(mdContext, md5, &md5Len);
+	EVP_MD_CTX_free(mdContext);
+	EVP_EncodeBlock((unsigned char*) md5Base64, md5, md5Len);
+
+	delete_objects_reset_document(doData);
+
+	S3PutProperties properties = {
+		"application/xml", // contentType
+		md5Base64,         // md5
+		0,                 // cacheControl
+		0,                 // contentDispositionFilename
+		0,                 // contentEncoding
+		-1,                // expires
+		0,                 // cannedAcl
+		0,                 // metaDataCount
+		0,                 // metaData
+		0,                 // useServerSideEncryption
+		0,                 // xAmzStorageClass
+		0,                 // xAmzChecksumAlgorithm
+		0,                 // xAmzChecksumType
+		0,                 // xAmzTrailer
+		-1                 // xAmzDecodedContentLength (-1 = unknown)
+	};
+
+	// Set up the RequestParams
+	RequestParams params = {
+		HttpRequestTypePOST,              // httpRequestType
+		{bucketContext->hostName,         // hostName
+	     bucketContext->bucketName,       // bucketName
+	     bucketContext->protocol,         // protocol
+	     bucketContext->uriStyle,         // uriStyle
+	     bucketContext->accessKeyId,      // accessKeyId
+	     bucketContext->secretAccessKey,  // secretAccessKey
+	     bucketContext->securityToken,    // securityToken
+	     bucketContext->authRegion,       // authRegion
+	     bucketContext->stsDate},         // stsDate
+		0,                                // key
+		0,                                // queryParams
+		"delete",                         // subResource
+		0,                                // copySourceBucketName
+		0,                                // copySourceKey
+		0,                                // getConditions
+		0,                                // startByte
+		0,                                // byteCount
+		&properties,                      // putProperties
+		&deleteObjectsPropertiesCallback, // propertiesCallback
+		&deleteObjectsDataCallback,       // toS3Callback
+		contentLength,                    // toS3CallbackTotalSize
+		&deleteObjectsResponseCallback,   // fromS3Callback
+		&deleteObjectsCompleteCallback,   // completeCallback
+		doData,                           // callbackData
+		timeoutMs,                        // timeoutMs
+		0,                                // xAmzObjectAttributes
+		0                                 // chunkedState
+	};
+
+	// Perform the request
+	request_perform(&params, requestContext);
+#endif
+}
+
 // restore object --------------------------------------------------------------
 
 typedef struct RestoreObjectData
@@ -436,6 +436,10 @@ static S3Status compose_amz_headers(const RequestParams* params,
 			snprintf(bucketKey, sizeof(bucketKey), "/%s/%s", params->copySourceBucketName, params->copySourceKey);
 			append_amz_header(values, 0, "x-amz-copy-source", bucketKey);
 		}
+		// The copy fails with PreconditionFailed if the source has another eTag
+		if (params->getConditions && params->getConditions->ifMatchETag && params->getConditions->ifMatchETag[0]) {
+			append_amz_header(values, 0, "x-amz-copy-source-if-match", params->getConditions->ifMatchETag);
+		}
 		// If byteCount != 0 then we're just copying a range, add header
 		if (params->byteCount > 0) {
 			char byteRange[S3_MAX_METADATA_SIZE];
@@ -647,8 +651,13 @@ static S3Status compose_standard_headers(const RequestParams* params, RequestCom
 		values->ifUnmodifiedSinceHeader[0] = 0;
 	}
 
-	// If-Match header
-	do_get_header("If-Match: %s", ifMatchETag, ifMatchHeader, S3StatusBadIfMatchETag, S3StatusIfMatchETagTooLong);
+	// If-Match header, a copy sends the eTag as x-amz-copy-source-if-match instead
+	if (params->httpRequestType == HttpRequestTypeCOPY) {
+		values->ifMatchHeader[0] = 0;
+	}
+	else {
+		do_get_header("If-Match: %s", ifMatchETag, ifMatchHeader, S3StatusBadIfMatchETag, S3StatusIfMatchETagTooLong);
+	}
 
 	// If-None-Match header
 	do_get_header("If-None-Match: %s",
@@ -11,6 +11,9 @@
 #include <irods/dataObjOpr.hpp>
 #include <irods/irods_hierarchy_parser.hpp>
 
+#include <map>
+#include <string>
+
 namespace irods_s3 {
 
     // =-=-=-=-=-=-=-
@@ -54,6 +57,14 @@ namespace irods_s3 {
     // interface for POSIX Stat
     irods::error s3_file_stat_operation( irods::plugin_context& _ctx, struct stat* _statbuf );
 
+    // =-=-=-=-=-=-=-
+    // stat of the object in S3, retrying while it is not found if requested,
+    // which also returns the user metadata of the object
+    irods::error s3_file_stat_operation_with_flag_for_retry_on_not_found( irods::plugin_context& _ctx,
+                                    struct stat* _statbuf,
+                                    bool retry_on_not_found,
+                                    std::map<std::string, std::string>* _meta_data = nullptr );
+
     // =-=-=-=-=-=-=-
     // interface for POSIX Fstat
     irods::error s3FileFstatPlugin(  irods::plugin_context& _ctx, struct stat* _statbuf );
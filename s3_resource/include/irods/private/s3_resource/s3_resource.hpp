@@ -13,6 +13,14 @@
 #include <irods/irods_file_object.hpp>
 #include <irods/rcConnect.h>
 #include "libs3/libs3.h"
+#include "irods/private/s3_transport/retry_policy.hpp"
+#include "irods/private/s3_transport/bulk_delete.hpp"
+#include "irods/private/s3_transport/compression.hpp"
+#include "irods/private/s3_transport/pack_store.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
+
+#include <map>
+#include <memory>
 
 #define S3_AUTH_FILE "s3Auth"
 #define ARCHIVE_NAMING_POLICY_KW    "ARCHIVE_NAMING_POLICY"
@@ -24,7 +32,6 @@ typedef enum { S3_PUTFILE, S3_COPYOBJECT } s3_putcopy;
 
 extern const std::string  s3_default_hostname;
 extern const std::string  s3_default_hostname_vector;
-extern const std::string  s3_hostname_index;
 extern const std::string  host_mode;
 extern const std::string  s3_auth_file;
 extern const std::string  s3_key_id;
@@ -48,6 +55,7 @@ extern const std::string  s3_circular_buffer_timeout_seconds; // timeout for rea
 extern const std::string  s3_uri_request_style;        //  either "path" or "virtual_hosted" - default "path"
 extern const std::string  s3_number_of_threads;        //  to save number of threads
 extern const std::size_t  S3_DEFAULT_RETRY_WAIT_SECONDS;
+extern const std::size_t  S3_DEFAULT_RETRY_WAIT_MILLISECONDS;
 extern const std::size_t  S3_DEFAULT_MAX_RETRY_WAIT_SECONDS;
 extern const std::size_t  S3_DEFAULT_RETRY_COUNT;
 extern const int          S3_DEFAULT_CIRCULAR_BUFFER_SIZE;
@@ -55,8 +63,12 @@ extern const unsigned int S3_DEFAULT_CIRCULAR_BUFFER_TIMEOUT_SECONDS;
 extern const unsigned int S3_DEFAULT_NON_DATA_TRANSFER_TIMEOUT_SECONDS;
 
 std::string s3GetHostname(irods::plugin_property_map& _prop_map);
+std::string s3GetCurrentHostname(irods::plugin_property_map& _prop_map);
 std::int64_t s3GetMPUChunksize(irods::plugin_property_map& _prop_map);
 ssize_t s3GetMPUThreads(irods::plugin_property_map& _prop_map);
+std::int64_t s3GetMPUCopyThreshold(irods::plugin_property_map& _prop_map);
+std::int64_t s3GetMPUCopyChunksize(irods::plugin_property_map& _prop_map, std::int64_t _object_size);
+ssize_t s3GetMPUCopyThreads(irods::plugin_property_map& _prop_map);
 bool s3GetEnableMultiPartUpload (irods::plugin_property_map& _prop_map);
 S3UriStyle s3_get_uri_request_style(irods::plugin_property_map& _prop_map);
 std::string get_region_name(irods::plugin_property_map& _prop_map);
@@ -64,14 +76,117 @@ bool s3GetServerEncrypt (irods::plugin_property_map& _prop_map);
 std::string get_cache_directory(irods::plugin_property_map& _prop_map);
 
 std::size_t get_retry_wait_time_sec(irods::plugin_property_map& _prop_map);
+std::size_t get_retry_wait_time_ms(irods::plugin_property_map& _prop_map);
 std::size_t get_max_retry_wait_time_sec(irods::plugin_property_map& _prop_map);
 std::size_t get_retry_count(irods::plugin_property_map& _prop_map);
+unsigned int get_retry_budget_tokens(irods::plugin_property_map& _prop_map);
+irods::experimental::io::s3_transport::retry_policy make_retry_policy(
+        irods::plugin_property_map& _prop_map,
+        irods::experimental::io::s3_transport::retry_policy::retryable_predicate _is_retryable = S3_status_is_retryable);
 unsigned int get_non_data_transfer_timeout_seconds(irods::plugin_property_map& _prop_map);
 unsigned int s3_get_restoration_days(irods::plugin_property_map& _prop_map);
 std::string s3_get_restoration_tier(irods::plugin_property_map& _prop_map);
 std::string s3_get_storage_class_from_configuration(irods::plugin_property_map& _prop_map);
 bool s3_direct_checksum_read_enabled(irods::plugin_property_map& _prop_map);
 bool s3_trailing_checksum_on_upload_enabled(irods::plugin_property_map& _prop_map);
+bool s3_adaptive_concurrency_enabled(irods::plugin_property_map& _prop_map);
+unsigned int get_adaptive_concurrency_max_in_flight(irods::plugin_property_map& _prop_map);
+bool s3_hedged_reads_enabled(irods::plugin_property_map& _prop_map);
+double get_hedged_reads_percentile(irods::plugin_property_map& _prop_map);
+double get_hedged_reads_max_percent(irods::plugin_property_map& _prop_map);
+std::uint64_t get_rate_limit(irods::plugin_property_map& _prop_map, const std::string& _keyword);
+unsigned int get_listing_shards(irods::plugin_property_map& _prop_map);
+bool s3_bulk_delete_enabled(irods::plugin_property_map& _prop_map);
+unsigned int get_bulk_delete_batch_size(irods::plugin_property_map& _prop_map);
+unsigned int get_bulk_delete_max_delay_ms(irods::plugin_property_map& _prop_map);
+bool s3_deferred_delete_enabled(irods::plugin_property_map& _prop_map);
+unsigned int get_deferred_delete_threads(irods::plugin_property_map& _prop_map);
+bool s3_server_side_replication_enabled(irods::plugin_property_map& _prop_map);
+bool s3_resumable_uploads_enabled(irods::plugin_property_map& _prop_map);
+std::int64_t get_stale_upload_age_seconds(irods::plugin_property_map& _prop_map);
+bool s3_partial_overwrite_enabled(irods::plugin_property_map& _prop_map);
+bool s3_server_side_append_enabled(irods::plugin_property_map& _prop_map);
+bool s3_pack_small_objects_enabled(irods::plugin_property_map& _prop_map);
+std::int64_t get_pack_member_maximum_size(irods::plugin_property_map& _prop_map);
+std::int64_t get_pack_size_mb(irods::plugin_property_map& _prop_map);
+std::int64_t get_pack_maximum_age_seconds(irods::plugin_property_map& _prop_map);
+unsigned int get_pack_compaction_percent(irods::plugin_property_map& _prop_map);
+bool s3_compression_enabled(irods::plugin_property_map& _prop_map);
+int get_compression_level(irods::plugin_property_map& _prop_map);
+bool s3_content_addressed_naming_enabled(irods::plugin_property_map& _prop_map);
+std::int64_t get_memory_staging_size_mb(irods::plugin_property_map& _prop_map);
+std::string get_memory_staging_directory(irods::plugin_property_map& _prop_map);
+void cancel_pending_delete(
+        irods::plugin_property_map& _prop_map,
+        const std::string& _bucket,
+        const std::string& _key);
+std::vector<irods::experimental::io::s3_transport::delete_failure> flush_pending_deletes(
+        irods::plugin_property_map& _prop_map,
+        bool _all = false);
+
+// The settings of a resource that operations use most, parsed and validated once
+// from the property map when the resource starts so that operations do not look
+// up and convert the same properties again.  Shared read-only by all threads.
+struct s3_resource_settings
+{
+    std::string  resource_name;
+    bool         cacheless_mode;
+    bool         attached_mode;
+    std::string  access_key_id;
+    std::string  secret_access_key;
+    bool         credentials_read;      // false before the auth file is read
+    S3Protocol   protocol;
+    std::string  protocol_str;
+    S3STSDate    sts_date;
+    S3UriStyle   uri_style;
+    std::string  region_name;
+    std::string  cache_directory;
+    bool         multipart_enabled;
+    std::int64_t mpu_chunk_size;
+    ssize_t      mpu_threads;
+    std::int64_t max_upload_size_mb;
+    unsigned int circular_buffer_size;
+    unsigned int circular_buffer_timeout_seconds;
+    bool         server_encrypt;
+    std::string  storage_class;
+    unsigned int restoration_days;
+    std::string  restoration_tier;
+    std::size_t  retry_count;
+    std::size_t  retry_wait_time_ms;
+    std::size_t  max_retry_wait_time_sec;
+    unsigned int non_data_transfer_timeout_seconds;
+    bool         trailing_checksum_on_upload;
+    bool         resumable_uploads;
+    std::int64_t stale_upload_age_seconds;
+    bool         partial_overwrite;
+    bool         server_side_append;
+    std::int64_t memory_staging_size_mb;
+    std::string  memory_staging_directory;
+};
+
+s3_resource_settings make_resource_settings(irods::plugin_property_map& _prop_map);
+
+// Stores the settings parsed from the current properties in the property map.
+void update_resource_settings(irods::plugin_property_map& _prop_map);
+
+// Returns the settings published when the resource started, without taking a lock.
+// They are built now if the resource has not started, and published only once the
+// auth file was read.
+std::shared_ptr<const s3_resource_settings> get_resource_settings(irods::plugin_property_map& _prop_map);
+
+// Returns an error if the credentials of the resource were not read.
+irods::error check_credentials(const s3_resource_settings& _settings);
+
+// Returns a bucket context for _bucket_name with the endpoint settings and credentials
+// of the resource.  The strings of the bucket context are owned by _settings and
+// _bucket_name.  The host name is left to the caller.
+S3BucketContext make_bucket_context(const s3_resource_settings& _settings, const std::string& _bucket_name);
+
+// Returns what the requests of the pack store of the resource are sent with.
+// The strings of the bucket context are owned by _settings.
+irods::experimental::io::s3_transport::pack_store::transfer_settings make_pack_transfer_settings(
+        irods::plugin_property_map& _prop_map,
+        const s3_resource_settings& _settings);
 
 void StoreAndLogStatus(S3Status status, const S3ErrorDetails *error,
         const char *function, const S3BucketContext *pCtx, S3Status *pStatus,
@@ -104,6 +219,9 @@ typedef struct callback_data
         , prop_map_ptr{nullptr}
         , x_amz_storage_class{}   // for glacier
         , x_amz_restore{}         // for glacier
+        , meta_data{}
+        , user_name{}
+        , limiter{nullptr}
     {}
     int fd;
     std::int64_t offset;       /* For multiple upload */
@@ -116,6 +234,9 @@ typedef struct callback_data
     irods::plugin_property_map *prop_map_ptr;
     std::string x_amz_storage_class;
     std::string x_amz_restore;
+    std::map<std::string, std::string> meta_data;
+    std::string user_name;    // for the per-user rate limits
+    irods::experimental::io::s3_transport::rate_limiter *limiter;  // looked up on the first chunk of the transfer
 } callback_data_t;
 
 typedef struct upload_manager
@@ -216,8 +337,31 @@ irods::error s3GetFile(
     rodsLong_t _fileSize,
     const std::string& _key_id,
     const std::string& _access_key,
+    irods::plugin_property_map& _prop_map,
+    const std::string& _user_name );
+
+/// @brief Downloads a compressed object into the cache file, decompressing its frames as they arrive
+irods::error s3GetCompressedFile(
+    const std::string& _filename,
+    const std::string& _s3ObjName,
+    const irods::experimental::io::s3_transport::compressed_object& _object,
+    const std::string& _key_id,
+    const std::string& _access_key,
     irods::plugin_property_map& _prop_map );
 
+/// @brief Uploads the cache file compressed, or as is if it does not get smaller
+irods::error s3PutCompressedFile(
+    const std::string& _filename,
+    const std::string& _s3ObjName,
+    rodsLong_t _fileSize,
+    const std::string& _key_id,
+    const std::string& _access_key,
+    irods::plugin_property_map& _prop_map,
+    const std::map<std::string, std::string>& _meta_data = {},
+    const std::string& _user_name = "");
+
+/// @brief Uploads a file, or copies an object in parts.  _user_name is the user whose
+///        rate limits apply to the bytes uploaded, it is empty for a copy.
 irods::error s3PutCopyFile(
     const s3_putcopy _mode,
     const std::string& _filename,
@@ -225,7 +369,9 @@ irods::error s3PutCopyFile(
     rodsLong_t _fileSize,
     const std::string& _key_id,
     const std::string& _access_key,
-    irods::plugin_property_map& _prop_map);
+    irods::plugin_property_map& _prop_map,
+    const std::map<std::string, std::string>& _meta_data = {},
+    const std::string& _user_name = "");
 
 /// @brief Function to copy the specified src file to the specified dest file
 irods::error s3CopyFile(
@@ -238,6 +384,19 @@ irods::error s3CopyFile(
     const S3STSDate _stsDate,
     const S3UriStyle _s3_uri_style);
 
+/// @brief Function to copy the specified src object of a known size to the specified dest object
+irods::error s3CopyObject(
+    irods::plugin_property_map& _prop_map,
+    const std::string& _src_file,
+    const std::string& _dest_file,
+    const std::int64_t _object_size,
+    const std::string& _key_id,
+    const std::string& _access_key,
+    const S3Protocol _proto,
+    const S3STSDate _stsDate,
+    const S3UriStyle _s3_uri_style,
+    const std::map<std::string, std::string>& _meta_data = {});
+
 // =-=-=-=-=-=-=-
 /// @brief Checks the basic operation parameters and updates the physical path in the file object
 irods::error s3CheckParams(irods::plugin_context& _ctx );
@@ -252,6 +411,22 @@ bool determine_unlink_for_repl_policy(
     const std::string& _logical_path,
     const std::string& _vault_path);
 
+/// @brief True if _key names an object by its contents
+bool is_content_addressed_key(const std::string& _key);
+
+/// @brief Sets _key to the key of an object with the contents of the file, named by their SHA-256
+irods::error get_content_addressed_key(
+    const std::string& _filename,
+    std::string&       _key);
+
+/// @brief True if no replica on an s3 resource other than the replica of _data_id on
+/// _resource_name refers to the object named by its contents at _physical_path
+bool determine_unlink_for_content_addressed_object(
+    rsComm_t*          _comm,
+    const std::string& _physical_path,
+    rodsLong_t         _data_id,
+    const std::string& _resource_name);
+
 // =-=-=-=-=-=-=-
 // redirect_get - code to determine redirection for get operation
 irods::error s3RedirectCreate(
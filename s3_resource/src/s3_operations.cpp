@@ -3,6 +3,15 @@
 #include "irods/private/s3_resource/s3_operations.hpp"
 #include "irods/private/s3_resource/s3_resource.hpp"
 #include "irods/private/s3_transport/s3_transport.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/bucket_lister.hpp"
+#include "irods/private/s3_transport/bulk_delete.hpp"
+#include "irods/private/s3_transport/compression.hpp"
+#include "irods/private/s3_transport/content_address.hpp"
+#include "irods/private/s3_transport/content_release_queue.hpp"
+#include "irods/private/s3_transport/delete_queue.hpp"
+#include "irods/private/s3_transport/pack_store.hpp"
+#include "irods/private/s3_transport/streaming_copy.hpp"
 #include "irods/private/s3_transport/managed_shared_memory_object.hpp"
 #include "irods/private/s3_resource/s3_plugin_logging_category.hpp"
 #include "irods/private/s3_resource/multipart_shared_data.hpp"
@@ -30,8 +39,12 @@
 #include <irods/voting.hpp>
 #include <irods/get_file_descriptor_info.h>
 #include <irods/rsModAVUMetadata.hpp>
+#include <irods/modDataObjMeta.h>
+#include <irods/rsModDataObjMeta.hpp>
+#include <irods/scoped_privileged_client.hpp>
 #include <irods/irods_at_scope_exit.hpp>
 #include <irods/checksum.h>
+#include <irods/rcMisc.h>
 
 // =-=-=-=-=-=-=-
 // boost includes
@@ -58,6 +71,11 @@
 #include <curl/curl.h>
 #include <fmt/format.h>
 #include <filesystem>
+#include <optional>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
 
 extern std::size_t g_retry_count;
 extern std::size_t g_retry_wait;
@@ -69,6 +87,16 @@ using idstream            = irods::experimental::io::idstream;
 using dstream             = irods::experimental::io::dstream;
 using s3_transport        = irods::experimental::io::s3_transport::s3_transport<char>;
 using s3_transport_config = irods::experimental::io::s3_transport::config;
+using endpoint_request    = irods::experimental::io::s3_transport::endpoint_request;
+using bucket_lister       = irods::experimental::io::s3_transport::bucket_lister;
+using bucket_list_entry   = irods::experimental::io::s3_transport::bucket_list_entry;
+using delete_batcher      = irods::experimental::io::s3_transport::delete_batcher;
+using delete_queue        = irods::experimental::io::s3_transport::delete_queue;
+using pack_store          = irods::experimental::io::s3_transport::pack_store;
+using content_release_queue = irods::experimental::io::s3_transport::content_release_queue;
+using irods::experimental::io::s3_transport::compressed_object_from_meta_data;
+
+namespace content_address = irods::experimental::io::s3_transport::content_address;
 
 namespace irods_s3 {
 
@@ -94,6 +122,22 @@ namespace irods_s3 {
         std::ios_base::openmode open_mode;
         std::shared_ptr<dstream> dstream_ptr;
         std::shared_ptr<s3_transport> s3_transport_ptr;
+
+        // set on first use if the replica is the source or destination of a server-side copy
+        std::optional<bool> server_side_copy;
+        std::string server_side_copy_key;
+        bool server_side_copy_source{false};
+        std::int64_t server_side_copy_size{0};
+        std::int64_t server_side_copy_offset{0};
+
+        // set if the replica is a member of a pack
+        std::optional<pack_store::member> pack_member;
+        std::int64_t pack_member_offset{0};
+        std::int64_t pack_member_size{0};
+        bool pack_member_created{false};
+
+        // the member the replica was moved from when it was opened to be overwritten
+        std::optional<pack_store::member> replaced_pack_member;
     }; // end per_thread_data
 
     class fd_to_data_map {
@@ -178,8 +222,18 @@ namespace irods_s3 {
             std::to_string(std::hash<std::string>{}(get_resource_name(ctx.prop_map()) + file_obj->logical_path()));
     }
 
-    irods::error s3_file_stat_operation_with_flag_for_retry_on_not_found(irods::plugin_context& _ctx,
-            struct stat* _statbuf, bool retry_on_not_found );
+    // Returns the pack member named by a physical path, or nothing if the path
+    // names an object of its own.
+    std::optional<pack_store::member> get_pack_member(const std::string& _physical_path,
+            irods::plugin_property_map& _prop_map)
+    {
+        std::string bucket_name;
+        std::string object_key;
+        if (!parseS3Path(_physical_path, bucket_name, object_key, _prop_map).ok()) {
+            return std::nullopt;
+        }
+        return pack_store::parse_key(object_key);
+    } // end get_pack_member
 
     // determines the data size and number of threads, stores them, and returns them
     auto get_number_of_threads_data_size_and_opr_type(irods::plugin_context& _ctx,
@@ -428,6 +482,11 @@ namespace irods_s3 {
         // if archive naming policy is decoupled
         // we use the object's reversed id as S3 key name prefix
         if (archive_naming_policy == DECOUPLED_NAMING) {
+            // a member of a pack keeps the physical path it was given when it was created
+            if (get_pack_member(object->physical_path(), _ctx.prop_map())) {
+                return;
+            }
+
             // extract object name and bucket name from physical path
             std::vector< std::string > tokens;
             irods::string_tokenize(object->physical_path(), "/", tokens);
@@ -564,12 +623,7 @@ namespace irods_s3 {
 
     bool is_cacheless_mode(irods::plugin_property_map& _prop_map) {
 
-        bool cacheless_mode = false;
-        bool attached_mode = true;
-
-        std::tie(cacheless_mode, attached_mode) = get_modes_from_properties(_prop_map);
-
-        return cacheless_mode;
+        return get_resource_settings(_prop_map)->cacheless_mode;
 
     }
 
@@ -595,10 +649,6 @@ namespace irods_s3 {
         int number_of_threads = 0;
         std::string bucket_name;
         std::string object_key;
-        std::string access_key;
-        std::string secret_access_key;
-        unsigned int circular_buffer_size = S3_DEFAULT_CIRCULAR_BUFFER_SIZE;
-        unsigned int circular_buffer_timeout_seconds = S3_DEFAULT_CIRCULAR_BUFFER_TIMEOUT_SECONDS;
 
         // create entry for fd if it doesn't exist
         if (!fd_data.exists(fd)) {
@@ -620,9 +670,12 @@ namespace irods_s3 {
         logger::debug("{}:{} ({}) [[{}]] [physical_path={}][bucket_name={}][fd={}]",
                 __FILE__, __LINE__, __FUNCTION__, thread_id, file_obj->physical_path().c_str(), bucket_name.c_str(), fd);
 
-        ret = s3GetAuthCredentials(_ctx.prop_map(), access_key, secret_access_key);
-        if(!ret.ok()) {
-            return std::make_tuple(PASS(ret), data.dstream_ptr, data.s3_transport_ptr);
+        // the settings were parsed when the resource started
+        const auto settings = get_resource_settings(_ctx.prop_map());
+        if (settings->access_key_id.empty() || settings->secret_access_key.empty()) {
+            return std::make_tuple(ERROR(S3_FILE_OPEN_ERR,
+                        fmt::format("[resource_name={}] Failed to get the S3 credentials.", settings->resource_name)),
+                    data.dstream_ptr, data.s3_transport_ptr);
         }
 
         ret = get_number_of_threads_data_size_and_opr_type(_ctx, number_of_threads, data_size, oprType);
@@ -634,66 +687,46 @@ namespace irods_s3 {
         logger::debug("{}:{} ({}) [[{}]] data_size set to {}", __FILE__, __LINE__, __FUNCTION__, thread_id, data_size);
         logger::debug("{}:{} ({}) [[{}]] number_of_threads={}", __FILE__, __LINE__, __FUNCTION__, thread_id, number_of_threads);
 
-        // read the size of the circular buffer from configuration
-        std::string circular_buffer_size_str;
-        ret = _ctx.prop_map().get<std::string>(s3_circular_buffer_size, circular_buffer_size_str);
-        if (ret.ok()) {
-            try {
-                circular_buffer_size = boost::lexical_cast<unsigned int>(circular_buffer_size_str);
-            } catch (const boost::bad_lexical_cast &) {}
-        }
-
-        // minimum circular buffer size is 2 * minimum_part_size
-        if (circular_buffer_size < 2) {
-            circular_buffer_size = 2;
-        }
-
-        // read the circular buffer timeout from configuration
-        std::string circular_buffer_timeout_seconds_str;
-        ret = _ctx.prop_map().get<std::string>(s3_circular_buffer_timeout_seconds, circular_buffer_timeout_seconds_str);
-        if (ret.ok()) {
-            try {
-                circular_buffer_timeout_seconds = boost::lexical_cast<unsigned int>(circular_buffer_timeout_seconds_str);
-            } catch (const boost::bad_lexical_cast &) {}
-        }
-
-        std::string s3_cache_dir_str = get_cache_directory(_ctx.prop_map());
-
-        std::string&& hostname = s3GetHostname(_ctx.prop_map());
+        std::string&& hostname = s3GetCurrentHostname(_ctx.prop_map());
         s3_transport_config s3_config;
         s3_config.hostname = hostname;
         s3_config.object_size = data_size;
-        s3_config.number_of_cache_transfer_threads = s3GetMPUThreads(_ctx.prop_map());      // number of threads created by s3_transport when writing/reading to/from cache
+        s3_config.number_of_cache_transfer_threads = settings->mpu_threads;                 // number of threads created by s3_transport when writing/reading to/from cache
         s3_config.number_of_client_transfer_threads = number_of_threads;                    // number of threads created by client
         s3_config.bytes_this_thread = data_size == s3_transport_config::UNKNOWN_OBJECT_SIZE // if number of threads is 0, cache is forced and bytes_this_thread is n/a
             || number_of_threads == 0 ? 0 : data_size / number_of_threads;
         s3_config.bucket_name = bucket_name;
-        s3_config.access_key = access_key;
-        s3_config.secret_access_key = secret_access_key;
+        s3_config.access_key = settings->access_key_id;
+        s3_config.secret_access_key = settings->secret_access_key;
         s3_config.shared_memory_timeout_in_seconds = 180;
-        s3_config.minimum_part_size = s3GetMPUChunksize(_ctx.prop_map());
-        s3_config.circular_buffer_size = circular_buffer_size * s3_config.minimum_part_size;
-        s3_config.circular_buffer_timeout_seconds = circular_buffer_timeout_seconds;
-        s3_config.s3_protocol_str = get_protocol_as_string(_ctx.prop_map());
-        s3_config.s3_uri_request_style = s3_get_uri_request_style(_ctx.prop_map()) == S3UriStyleVirtualHost ? "host" : "path";
-        s3_config.region_name = get_region_name(_ctx.prop_map());
+        s3_config.minimum_part_size = settings->mpu_chunk_size;
+        s3_config.circular_buffer_size = settings->circular_buffer_size * s3_config.minimum_part_size;
+        s3_config.circular_buffer_timeout_seconds = settings->circular_buffer_timeout_seconds;
+        s3_config.s3_protocol_str = settings->protocol_str;
+        s3_config.s3_uri_request_style = settings->uri_style == S3UriStyleVirtualHost ? "host" : "path";
+        s3_config.region_name = settings->region_name;
         s3_config.put_repl_flag = ( oprType == PUT_OPR || oprType == REPLICATE_DEST || oprType == COPY_DEST );
-        s3_config.server_encrypt_flag = s3GetServerEncrypt(_ctx.prop_map());
-        s3_config.cache_directory = s3_cache_dir_str;
-        s3_config.multipart_enabled = s3GetEnableMultiPartUpload (_ctx.prop_map());
-        s3_config.retry_count_limit = get_retry_count(_ctx.prop_map());
-        s3_config.retry_wait_seconds = get_retry_wait_time_sec(_ctx.prop_map());
-        s3_config.max_retry_wait_seconds = get_max_retry_wait_time_sec(_ctx.prop_map());
-        s3_config.resource_name = get_resource_name(_ctx.prop_map());
-        s3_config.restoration_days = s3_get_restoration_days(_ctx.prop_map());
-        s3_config.restoration_tier = s3_get_restoration_tier(_ctx.prop_map());
-        s3_config.max_single_part_upload_size = s3GetMaxUploadSizeMB(_ctx.prop_map()) * 1024 * 1024;
-        s3_config.non_data_transfer_timeout_seconds = get_non_data_transfer_timeout_seconds(_ctx.prop_map());
-        s3_config.s3_storage_class = s3_get_storage_class_from_configuration(_ctx.prop_map());
-        s3_config.trailing_checksum_on_upload_enabled = s3_trailing_checksum_on_upload_enabled(_ctx.prop_map());
-
-        auto sts_date_setting = s3GetSTSDate(_ctx.prop_map());
-        s3_config.s3_sts_date_str = sts_date_setting == S3STSAmzOnly ? "amz" : sts_date_setting == S3STSAmzAndDate ? "both" : "date";
+        s3_config.server_encrypt_flag = settings->server_encrypt;
+        s3_config.cache_directory = settings->cache_directory;
+        s3_config.multipart_enabled = settings->multipart_enabled;
+        s3_config.retry_count_limit = settings->retry_count;
+        s3_config.retry_wait_milliseconds = settings->retry_wait_time_ms;
+        s3_config.max_retry_wait_seconds = settings->max_retry_wait_time_sec;
+        s3_config.resource_name = settings->resource_name;
+        s3_config.user_name = _ctx.comm()->clientUser.userName;
+        s3_config.restoration_days = settings->restoration_days;
+        s3_config.restoration_tier = settings->restoration_tier;
+        s3_config.max_single_part_upload_size = settings->max_upload_size_mb * 1024 * 1024;
+        s3_config.non_data_transfer_timeout_seconds = settings->non_data_transfer_timeout_seconds;
+        s3_config.s3_storage_class = settings->storage_class;
+        s3_config.trailing_checksum_on_upload_enabled = settings->trailing_checksum_on_upload;
+        s3_config.resumable_uploads_enabled = settings->resumable_uploads;
+        s3_config.stale_upload_age_seconds = settings->stale_upload_age_seconds;
+        s3_config.partial_overwrite_enabled = settings->partial_overwrite;
+        s3_config.server_side_append_enabled = settings->server_side_append;
+        s3_config.memory_staging_budget = settings->memory_staging_size_mb * 1024 * 1024;
+        s3_config.memory_staging_directory = settings->memory_staging_directory;
+        s3_config.s3_sts_date_str = settings->sts_date == S3STSAmzOnly ? "amz" : settings->sts_date == S3STSAmzAndDate ? "both" : "date";
 
         logger::debug("{}:{} ({}) [[{}]] [put_repl_flag={}][object_size={}][multipart_enabled={}][minimum_part_size={}] ",
                 __FILE__, __LINE__, __FUNCTION__, thread_id, s3_config.put_repl_flag, s3_config.object_size,
@@ -710,22 +743,760 @@ namespace irods_s3 {
             data.open_mode = open_mode;
         }
 
-        data.s3_transport_ptr = std::make_shared<s3_transport>(s3_config);
-        data.dstream_ptr = std::make_shared<dstream>(*data.s3_transport_ptr, object_key, open_mode);
+        data.s3_transport_ptr = std::make_shared<s3_transport>(s3_config);
+        data.dstream_ptr = std::make_shared<dstream>(*data.s3_transport_ptr, object_key, open_mode);
+
+        irods::error return_error = SUCCESS();
+
+        if (!data.s3_transport_ptr || !data.dstream_ptr) {
+            return_error  = ERROR(S3_FILE_OPEN_ERR,
+                    fmt::format("[resource_name={}] null dstream or s3_transport encountered",
+                    get_resource_name(_ctx.prop_map())));
+        } else {
+            fd_data.set(fd, data);
+            return_error = data.s3_transport_ptr->get_error();
+        }
+
+        return std::make_tuple(return_error, data.dstream_ptr, data.s3_transport_ptr);
+    }
+
+    // Returns the L1desc entry of the replica, the last one if there are
+    // several, or -1 if the replica was redirected from another server.
+    int get_l1desc_index(irods::file_object_ptr _file_obj)
+    {
+        int index = -1;
+        bool found = false;
+        for (int i = 0; i < NUM_L1_DESC; ++i) {
+            if (L1desc[i].inuseFlag) {
+                if (L1desc[i].dataObjInp && L1desc[i].dataObjInfo &&
+                        L1desc[i].dataObjInp->objPath == _file_obj->logical_path()
+                        && L1desc[i].dataObjInfo->filePath == _file_obj->physical_path()) {
+                    found = true;
+                    index = i;
+                }
+            } else if (found) {
+                break;
+            }
+        }
+        return index;
+    } // end get_l1desc_index
+
+    // Replications and copies between two S3 resources of this server that use the
+    // same endpoint and credentials are performed by the provider with CopyObject.
+    // The server still moves the bytes from the source replica to the destination
+    // replica, so reads of the source return zeros without downloading anything
+    // and writes to the destination are discarded.  The entries are keyed by the
+    // destination resource and physical path.  The first descriptor of the source
+    // or destination to use an entry copies the object, the others wait for the
+    // result.  An entry is kept until both the source and the destination have
+    // been closed so that a descriptor resolving late does not copy again.
+    struct server_side_copy_entry {
+        std::once_flag copy_flag;
+        bool copied{false};             // read once copy_flag is done
+        int  references{0};             // guarded by server_side_copy_mutex
+        bool source_closed{false};      // guarded by server_side_copy_mutex
+        bool destination_closed{false}; // guarded by server_side_copy_mutex
+    };
+
+    // guards server_side_copies, it is never held while an object is copied
+    std::mutex server_side_copy_mutex;
+    std::map<std::string, std::shared_ptr<server_side_copy_entry>> server_side_copies;
+
+    // A replication or copy that can be done with a server-side copy.
+    struct server_side_copy_plan {
+        std::string key;
+        bool source{false};                             // the descriptor reads the source
+        std::string source_path;
+        std::string destination_path;
+        std::int64_t object_size{0};
+        irods::resource_ptr other_resource;             // keeps destination_prop_map alive
+        irods::plugin_property_map* destination_prop_map{nullptr};
+    };
+
+    // Returns true if the resources send requests to the same S3 endpoint with the
+    // same credentials so that one of them can copy the objects of the other.
+    bool same_endpoint_and_credentials(irods::plugin_property_map& _prop_map1,
+                                       irods::plugin_property_map& _prop_map2)
+    {
+        std::string hostname1, hostname2;
+        _prop_map1.get<std::string>(s3_default_hostname, hostname1);
+        _prop_map2.get<std::string>(s3_default_hostname, hostname2);
+
+        const auto settings1 = get_resource_settings(_prop_map1);
+        const auto settings2 = get_resource_settings(_prop_map2);
+
+        return hostname1 == hostname2
+            && !settings1->access_key_id.empty()
+            && settings1->access_key_id == settings2->access_key_id
+            && settings1->secret_access_key == settings2->secret_access_key
+            && settings1->region_name == settings2->region_name
+            && settings1->protocol_str == settings2->protocol_str;
+    }
+
+    // Returns true if the bytes moved through the descriptor are used for more
+    // than writing the destination, such as a checksum computed or verified
+    // while they are streamed.  Those bytes cannot be skipped.
+    bool stream_needs_the_bytes(const l1desc_t& _l1desc)
+    {
+        return _l1desc.chksumFlag != 0
+            || getValByKey(&_l1desc.dataObjInp->condInput, VERIFY_CHKSUM_KW)
+            || getValByKey(&_l1desc.dataObjInp->condInput, REG_CHKSUM_KW);
+    }
+
+    // Decides whether the descriptor is the source or destination of a
+    // replication or copy that can be done with a server-side copy.
+    std::optional<server_side_copy_plan> plan_server_side_copy(irods::plugin_context& _ctx,
+                                                               std::ios_base::openmode _open_mode)
+    {
+        if (!s3_server_side_replication_enabled(_ctx.prop_map()) || s3_copyobject_disabled(_ctx.prop_map())) {
+            return std::nullopt;
+        }
+
+        const int index = get_l1desc_index(boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco()));
+        if (index < 0) {
+            return std::nullopt;
+        }
+
+        // the destination entry refers to the source entry
+        const int oprType = L1desc[index].dataObjInp->oprType;
+        const bool writing = (_open_mode & std::ios_base::out) != 0;
+        int source_index = -1;
+        int destination_index = -1;
+        if ((oprType == REPLICATE_SRC || oprType == COPY_SRC) && !writing) {
+            source_index = index;
+            for (int i = 0; i < NUM_L1_DESC; ++i) {
+                if (L1desc[i].inuseFlag && L1desc[i].dataObjInp && L1desc[i].srcL1descInx == index &&
+                        (L1desc[i].dataObjInp->oprType == REPLICATE_DEST || L1desc[i].dataObjInp->oprType == COPY_DEST)) {
+                    destination_index = i;
+                    break;
+                }
+            }
+        } else if ((oprType == REPLICATE_DEST || oprType == COPY_DEST) && writing) {
+            source_index = L1desc[index].srcL1descInx;
+            destination_index = index;
+        }
+        if (source_index < 0 || source_index >= NUM_L1_DESC || destination_index < 0) {
+            return std::nullopt;
+        }
+
+        const auto& source = L1desc[source_index];
+        const auto& destination = L1desc[destination_index];
+        if (!source.inuseFlag || !source.dataObjInp || !source.dataObjInfo || source.remoteZoneHost ||
+                !destination.inuseFlag || !destination.dataObjInp || !destination.dataObjInfo || destination.remoteZoneHost) {
+            return std::nullopt;
+        }
+
+        if (stream_needs_the_bytes(source) || stream_needs_the_bytes(destination)) {
+            return std::nullopt;
+        }
+
+        const std::int64_t object_size = source.dataObjInfo->dataSize;
+        if (object_size <= 0) {
+            return std::nullopt;
+        }
+
+        // the other replica must be in a cacheless S3 resource of this server
+        server_side_copy_plan plan;
+        const rodsLong_t other_resource_id = index == source_index ? destination.dataObjInfo->rescId : source.dataObjInfo->rescId;
+        if (!resc_mgr.resolve(other_resource_id, plan.other_resource).ok()) {
+            return std::nullopt;
+        }
+
+        std::string type, other_type, location, other_location;
+        _ctx.prop_map().get<std::string>(irods::RESOURCE_TYPE, type);
+        _ctx.prop_map().get<std::string>(irods::RESOURCE_LOCATION, location);
+        plan.other_resource->get_property<std::string>(irods::RESOURCE_TYPE, other_type);
+        plan.other_resource->get_property<std::string>(irods::RESOURCE_LOCATION, other_location);
+
+        irods::plugin_property_map& other_prop_map = plan.other_resource->properties();
+        if (type != other_type || location != other_location || !is_cacheless_mode(other_prop_map) ||
+                !s3_server_side_replication_enabled(other_prop_map) || s3_copyobject_disabled(other_prop_map) ||
+                !same_endpoint_and_credentials(_ctx.prop_map(), other_prop_map)) {
+            return std::nullopt;
+        }
+
+        plan.destination_prop_map = index == destination_index ? &_ctx.prop_map() : &other_prop_map;
+
+        // the physical path of a decoupled destination is not known until it is written
+        std::string archive_naming_policy = CONSISTENT_NAMING;
+        plan.destination_prop_map->get<std::string>(ARCHIVE_NAMING_POLICY_KW, archive_naming_policy);
+        if (boost::iequals(archive_naming_policy, DECOUPLED_NAMING)) {
+            return std::nullopt;
+        }
+
+        plan.source_path = source.dataObjInfo->filePath;
+        plan.destination_path = destination.dataObjInfo->filePath;
+
+        // a member of a pack is not an object of its own
+        if (get_pack_member(plan.source_path, _ctx.prop_map()) ||
+                get_pack_member(plan.destination_path, *plan.destination_prop_map)) {
+            return std::nullopt;
+        }
+
+        plan.key = fmt::format("{}:{}", get_resource_name(*plan.destination_prop_map), plan.destination_path);
+        plan.source = index == source_index;
+        plan.object_size = object_size;
+        return plan;
+    } // end plan_server_side_copy
+
+    // Copies the object of the plan on the S3 provider.  Returns true if it was copied.
+    bool copy_on_provider(irods::plugin_context& _ctx, const server_side_copy_plan& _plan)
+    {
+        irods::plugin_property_map& destination_prop_map = *_plan.destination_prop_map;
+
+        std::string access_key;
+        std::string secret_access_key;
+        irods::error ret = s3GetAuthCredentials(destination_prop_map, access_key, secret_access_key);
+
+        std::string bucket_name;
+        std::string object_key;
+        if (ret.ok() && parseS3Path(_plan.destination_path, bucket_name, object_key, destination_prop_map).ok()) {
+            cancel_pending_delete(destination_prop_map, bucket_name, object_key);
+        }
+
+        if (ret.ok()) {
+            ret = s3CopyObject(destination_prop_map, _plan.source_path, _plan.destination_path, _plan.object_size,
+                    access_key, secret_access_key, s3GetProto(destination_prop_map),
+                    s3GetSTSDate(destination_prop_map), s3_get_uri_request_style(destination_prop_map));
+        }
+
+        if (ret.ok()) {
+            logger::debug("{}:{} ({}) [resource_name={}] copied {} to {} on the S3 provider",
+                    __FILE__, __LINE__, __FUNCTION__, get_resource_name(_ctx.prop_map()),
+                    _plan.source_path, _plan.destination_path);
+        } else {
+            logger::warn("{}:{} ({}) [resource_name={}] server-side copy of {} to {} failed, streaming the object instead - {}",
+                    __FILE__, __LINE__, __FUNCTION__, get_resource_name(_ctx.prop_map()),
+                    _plan.source_path, _plan.destination_path, ret.result());
+        }
+        return ret.ok();
+    } // end copy_on_provider
+
+    // Decides whether the descriptor of _data takes part in a server-side copy
+    // and performs the copy unless a descriptor of the source or destination
+    // already did.
+    void resolve_server_side_copy(irods::plugin_context& _ctx, per_thread_data& _data)
+    {
+        _data.server_side_copy = false;
+
+        const auto plan = plan_server_side_copy(_ctx, _data.open_mode);
+        if (!plan) {
+            return;
+        }
+
+        std::shared_ptr<server_side_copy_entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(server_side_copy_mutex);
+            auto& found = server_side_copies[plan->key];
+            if (!found) {
+                found = std::make_shared<server_side_copy_entry>();
+            }
+            entry = found;
+            ++entry->references;
+        }
+
+        std::call_once(entry->copy_flag, [&] { entry->copied = copy_on_provider(_ctx, *plan); });
+
+        _data.server_side_copy = entry->copied;
+        _data.server_side_copy_key = plan->key;
+        _data.server_side_copy_source = plan->source;
+        _data.server_side_copy_size = plan->object_size;
+    } // end resolve_server_side_copy
+
+    // Returns the data of the descriptor, deciding whether it takes part in a
+    // server-side copy if this is its first read, write, or seek.
+    per_thread_data get_data_for_server_side_copy(irods::plugin_context& _ctx)
+    {
+        irods::file_object_ptr file_obj = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+        const int fd = file_obj->file_descriptor();
+
+        if (!fd_data.exists(fd)) {
+            return per_thread_data{};
+        }
+
+        per_thread_data data = fd_data.get(fd);
+        if (!data.server_side_copy) {
+            resolve_server_side_copy(_ctx, data);
+            fd_data.set(fd, data);
+        }
+        return data;
+    } // end get_data_for_server_side_copy
+
+    // Ends the use of a server-side copy by a closed descriptor.  A descriptor
+    // that never read or wrote still closes its side of a copy which the other
+    // side resolved.
+    void release_server_side_copy(irods::plugin_context& _ctx, const per_thread_data& _data)
+    {
+        std::string key = _data.server_side_copy_key;
+        bool source = _data.server_side_copy_source;
+
+        if (!_data.server_side_copy) {
+            {
+                std::lock_guard<std::mutex> lock(server_side_copy_mutex);
+                if (server_side_copies.empty()) {
+                    return;
+                }
+            }
+            const auto plan = plan_server_side_copy(_ctx, _data.open_mode);
+            if (!plan) {
+                return;
+            }
+            key = plan->key;
+            source = plan->source;
+        } else if (key.empty()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(server_side_copy_mutex);
+        auto iter = server_side_copies.find(key);
+        if (iter == server_side_copies.end()) {
+            return;
+        }
+
+        auto& entry = *iter->second;
+        if (!_data.server_side_copy_key.empty()) {
+            --entry.references;
+        }
+        (source ? entry.source_closed : entry.destination_closed) = true;
+        if (entry.references <= 0 && entry.source_closed && entry.destination_closed) {
+            server_side_copies.erase(iter);
+        }
+    } // end release_server_side_copy
+
+    // Points the replica, and its L1desc entry so that the catalog is updated, to _physical_path.
+    void set_physical_path(irods::file_object_ptr _file_obj, int _index, const std::string& _physical_path)
+    {
+        _file_obj->physical_path(_physical_path);
+        strncpy(L1desc[_index].dataObjInfo->filePath, _physical_path.c_str(), MAX_NAME_LEN);
+        L1desc[_index].dataObjInfo->filePath[MAX_NAME_LEN - 1] = '\0';
+    } // end set_physical_path
+
+    // Reserves a pack member for the replica written through L1desc[_index] if
+    // the resource packs objects of its size.  Only puts, replications, and
+    // copies are packed as the size of the replica is known before it is
+    // written.  Objects larger than the single buffer size are transferred by
+    // several threads and are never packed.
+    std::optional<pack_store::member> reserve_pack_member(irods::plugin_context& _ctx,
+            int _index,
+            const std::string& _bucket_name)
+    {
+        auto& store = pack_store::for_resource(get_resource_name(_ctx.prop_map()));
+        if (!store.enabled()) {
+            return std::nullopt;
+        }
+
+        const auto& l1desc = L1desc[_index];
+        std::int64_t size = -1;
+        switch (l1desc.dataObjInp->oprType) {
+            case PUT_OPR:
+                size = l1desc.dataObjInp->dataSize;
+                break;
+            case REPLICATE_DEST:
+            case COPY_DEST:
+                if (l1desc.srcL1descInx > 0 && l1desc.srcL1descInx < NUM_L1_DESC &&
+                        L1desc[l1desc.srcL1descInx].inuseFlag && L1desc[l1desc.srcL1descInx].dataObjInfo) {
+                    size = L1desc[l1desc.srcL1descInx].dataObjInfo->dataSize;
+                } else {
+                    size = l1desc.dataObjInfo->dataSize;
+                }
+                break;
+            default:
+                return std::nullopt;
+        }
+
+        const std::int64_t single_buffer_size =
+            static_cast<std::int64_t>(irods::get_advanced_setting<const int>(irods::KW_CFG_MAX_SIZE_FOR_SINGLE_BUFFER)) * 1024 * 1024;
+        if (!store.accepts(size) || size > single_buffer_size) {
+            return std::nullopt;
+        }
+
+        return store.reserve(_bucket_name, size);
+    } // end reserve_pack_member
+
+    // Points the replicas of the resource that refer to _from to _to.
+    pack_store::relocation relocate_pack_member(irods::plugin_context& _ctx,
+            const std::string& _bucket_name,
+            const pack_store::member& _from,
+            const pack_store::member& _to)
+    {
+        const auto resource_name = get_resource_name(_ctx.prop_map());
+        const auto from_path = fmt::format("/{}/{}", _bucket_name, pack_store::key(_from));
+        const auto to_path = fmt::format("/{}/{}", _bucket_name, pack_store::key(_to));
+
+        rodsLong_t resource_id = 0;
+        if (const auto ret = _ctx.prop_map().get<rodsLong_t>(irods::RESOURCE_ID, resource_id); !ret.ok()) {
+            logger::error("{}:{} ({}) [resource_name={}] {}", __FILE__, __LINE__, __func__, resource_name, ret.result());
+            return pack_store::relocation::failed;
+        }
+
+        bool moved = false;
+        try {
+            // the replicas may belong to any user
+            irods::experimental::scoped_privileged_client privileged_client{*_ctx.comm()};
+
+            const auto query_string = fmt::format("SELECT DATA_ID, DATA_REPL_NUM, COLL_NAME, DATA_NAME, DATA_RESC_HIER "
+                    "WHERE DATA_PATH = '{}' AND DATA_RESC_ID = '{}'", from_path, resource_id);
+            for (const auto& row : irods::query<rsComm_t>{_ctx.comm(), query_string}) {
+                dataObjInfo_t data_obj_info{};
+                data_obj_info.dataId = boost::lexical_cast<rodsLong_t>(row[0]);
+                data_obj_info.replNum = boost::lexical_cast<int>(row[1]);
+                rstrcpy(data_obj_info.objPath, fmt::format("{}/{}", row[2], row[3]).c_str(), MAX_NAME_LEN);
+                rstrcpy(data_obj_info.rescHier, row[4].c_str(), MAX_NAME_LEN);
+                data_obj_info.rescId = resource_id;
+
+                keyValPair_t reg_param{};
+                const auto free_reg_param = irods::at_scope_exit{[&reg_param] { clearKeyVal(&reg_param); }};
+                addKeyVal(&reg_param, FILE_PATH_KW, to_path.c_str());
+                addKeyVal(&reg_param, ADMIN_KW, "");
+
+                modDataObjMeta_t mod_data_obj_meta_inp{};
+                mod_data_obj_meta_inp.dataObjInfo = &data_obj_info;
+                mod_data_obj_meta_inp.regParam = &reg_param;
+                if (const int status = rsModDataObjMeta(_ctx.comm(), &mod_data_obj_meta_inp); status < 0) {
+                    logger::error("{}:{} ({}) [resource_name={}] failed to move {} to {} - status={}",
+                            __FILE__, __LINE__, __func__, resource_name, data_obj_info.objPath, to_path, status);
+                    return pack_store::relocation::failed;
+                }
+                moved = true;
+            }
+        }
+        catch (const std::exception& e) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to move the replicas in {} - {}",
+                    __FILE__, __LINE__, __func__, resource_name, from_path, e.what());
+            return pack_store::relocation::failed;
+        }
+
+        return moved ? pack_store::relocation::moved : pack_store::relocation::orphaned;
+    } // end relocate_pack_member
+
+    // Records that a member was deleted.  Its pack is compacted later, by an
+    // agent writing members, once enough of its members are deleted.
+    void remove_pack_member(irods::plugin_context& _ctx, const pack_store::member& _member)
+    {
+        pack_store::for_resource(get_resource_name(_ctx.prop_map())).remove(_member);
+    } // end remove_pack_member
+
+    // Opens a replica stored as a member of a pack.  A member cannot be
+    // changed in place, so a replica opened to be overwritten is moved to a
+    // new member, or to an object of its own if it no longer fits in a pack,
+    // and the old member is deleted when the replica is closed.  _packed is
+    // set to false if the replica is no longer a member.
+    irods::error open_pack_member(irods::plugin_context& _ctx, const pack_store::member& _member, bool& _packed)
+    {
+        irods::file_object_ptr file_obj = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+        const auto resource_name = get_resource_name(_ctx.prop_map());
+        const int fd = file_obj->file_descriptor();
+        per_thread_data data = fd_data.get(fd);
+        _packed = true;
+
+        if ((data.open_mode & std::ios_base::out) == 0) {
+            data.pack_member = _member;
+            fd_data.set(fd, data);
+            return SUCCESS();
+        }
+
+        const int index = get_l1desc_index(file_obj);
+        if ((data.open_mode & std::ios_base::trunc) == 0 || index < 0) {
+            return ERROR(SYS_NOT_SUPPORTED,
+                    fmt::format("[resource_name={}] {} is a member of a pack and can only be overwritten "
+                        "entirely by an agent serving the client", resource_name, file_obj->physical_path()));
+        }
+
+        std::string bucket_name;
+        std::string object_key;
+        irods::error ret = parseS3Path(file_obj->physical_path(), bucket_name, object_key, _ctx.prop_map());
+        if (!ret.ok()) {
+            return PASS(ret);
+        }
+
+        if (auto member = reserve_pack_member(_ctx, index, bucket_name); member) {
+            set_physical_path(file_obj, index, fmt::format("/{}/{}", bucket_name, pack_store::key(*member)));
+            data.pack_member = member;
+            data.pack_member_created = true;
+        } else {
+            // the key the replica would have been given by decoupled naming
+            std::string data_id = std::to_string(L1desc[index].dataObjInfo->dataId);
+            std::reverse(data_id.begin(), data_id.end());
+            object_key = fmt::format("{}/{}", data_id, std::filesystem::path(file_obj->logical_path()).filename().string());
+            set_physical_path(file_obj, index, fmt::format("/{}/{}", bucket_name, object_key));
+            cancel_pending_delete(_ctx.prop_map(), bucket_name, object_key);
+            _packed = false;
+        }
+
+        logger::debug("{}:{} ({}) [resource_name={}] moving {} from {} to {}", __FILE__, __LINE__, __func__,
+                resource_name, file_obj->logical_path(), pack_store::key(_member), file_obj->physical_path());
+
+        data.replaced_pack_member = _member;
+        fd_data.set(fd, data);
+        return SUCCESS();
+    } // end open_pack_member
+
+    // Returns the data of the descriptor if the replica is a member of a pack.
+    std::optional<per_thread_data> get_data_for_pack_member(irods::plugin_context& _ctx)
+    {
+        irods::file_object_ptr file_obj = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+        const int fd = file_obj->file_descriptor();
+
+        if (!fd_data.exists(fd)) {
+            return std::nullopt;
+        }
+
+        per_thread_data data = fd_data.get(fd);
+        if (!data.pack_member) {
+            return std::nullopt;
+        }
+        return data;
+    } // end get_data_for_pack_member
+
+    irods::error read_pack_member(irods::plugin_context& _ctx, per_thread_data& _data, void* _buf, int _len)
+    {
+        irods::file_object_ptr file_obj = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+
+        std::string bucket_name;
+        std::string object_key;
+        irods::error result = parseS3Path(file_obj->physical_path(), bucket_name, object_key, _ctx.prop_map());
+        if (!result.ok()) {
+            return PASS(result);
+        }
+
+        const auto settings = get_resource_settings(_ctx.prop_map());
+        std::int64_t bytes_read = 0;
+        const S3Status status = pack_store::for_resource(settings->resource_name).read(
+                make_pack_transfer_settings(_ctx.prop_map(), *settings), bucket_name, *_data.pack_member,
+                _data.pack_member_offset, static_cast<char*>(_buf), _len, bytes_read);
+        if (status != S3StatusOK) {
+            return ERROR(S3_GET_ERROR, fmt::format("[resource_name={}] failed to read {} - {}",
+                        settings->resource_name, file_obj->physical_path(), S3_get_status_name(status)));
+        }
+
+        _data.pack_member_offset += bytes_read;
+        fd_data.set(file_obj->file_descriptor(), _data);
+        result.code(bytes_read);
+        return result;
+    } // end read_pack_member
+
+    irods::error write_pack_member(irods::plugin_context& _ctx, per_thread_data& _data, const void* _buf, int _len)
+    {
+        irods::file_object_ptr file_obj = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+        const auto resource_name = get_resource_name(_ctx.prop_map());
+        const auto& member = *_data.pack_member;
+
+        if (!_data.pack_member_created) {
+            return ERROR(SYS_NOT_SUPPORTED, fmt::format("[resource_name={}] {} was not opened for writing",
+                        resource_name, file_obj->physical_path()));
+        }
+
+        if (!pack_store::for_resource(resource_name).write(member, _data.pack_member_offset, static_cast<const char*>(_buf), _len)) {
+            return ERROR(S3_PUT_ERROR, fmt::format("[resource_name={}] failed to write {} bytes at offset {} of {}, "
+                        "which holds {} bytes", resource_name, _len, _data.pack_member_offset, file_obj->physical_path(), member.length));
+        }
+
+        _data.pack_member_offset += _len;
+        _data.pack_member_size = std::max(_data.pack_member_size, _data.pack_member_offset);
+        fd_data.set(file_obj->file_descriptor(), _data);
+
+        irods::error result = SUCCESS();
+        result.code(_len);
+        return result;
+    } // end write_pack_member
+
+    // Records a member that was written and deletes the member it replaces.  The
+    // packs that are ready are then uploaded and those queued are compacted.
+    irods::error close_pack_member(irods::plugin_context& _ctx, const per_thread_data& _data)
+    {
+        if (!_data.pack_member_created) {
+            return SUCCESS();
+        }
+
+        irods::file_object_ptr file_obj = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+        const auto resource_name = get_resource_name(_ctx.prop_map());
+        auto& store = pack_store::for_resource(resource_name);
+        const auto& member = *_data.pack_member;
+
+        if (_data.pack_member_size != member.length) {
+            store.remove(member);
+            return ERROR(SYS_COPY_LEN_ERR, fmt::format("[resource_name={}] {} bytes were written to {}, {} were expected",
+                        resource_name, _data.pack_member_size, file_obj->physical_path(), member.length));
+        }
+
+        // the bytes are only on the disk of this server until the pack is uploaded
+        if (!store.complete(member)) {
+            return ERROR(S3_PUT_ERROR, fmt::format("[resource_name={}] {} was uploaded without {}",
+                        resource_name, pack_store::pack_key(member.pack_id), file_obj->physical_path()));
+        }
+
+        if (_data.replaced_pack_member) {
+            remove_pack_member(_ctx, *_data.replaced_pack_member);
+        }
+
+        const auto settings = get_resource_settings(_ctx.prop_map());
+        const auto transfer_settings = make_pack_transfer_settings(_ctx.prop_map(), *settings);
+        store.seal_ready_packs(transfer_settings);
+        store.compact_ready_packs(transfer_settings,
+                [&_ctx](const std::string& _bucket_name, const pack_store::member& _from, const pack_store::member& _to) {
+                    return relocate_pack_member(_ctx, _bucket_name, _from, _to);
+                });
+        return SUCCESS();
+    } // end close_pack_member
+
+    // Deletes an object, or queues its deletion with deferred or bulk delete.
+    irods::error delete_s3_object(irods::plugin_context& _ctx,
+            const std::string& _bucket,
+            const std::string& _key,
+            const std::string& _physical_path)
+    {
+        const auto settings = get_resource_settings(_ctx.prop_map());
+        irods::error ret = check_credentials(*settings);
+        if(!ret.ok()) {
+            return PASS(ret);
+        }
+
+        const auto& resource_name = settings->resource_name;
+        const int timeout_ms = static_cast<int>(settings->non_data_transfer_timeout_seconds * 1000);
+
+        S3BucketContext bucketContext = make_bucket_context(*settings, _bucket);
+
+        // With deferred delete the key is written to the durable delete queue
+        // and deleted later by a drainer thread.  If the queue cannot be written
+        // the object is deleted now.
+        if (delete_queue::for_resource(resource_name).enabled() &&
+                delete_queue::for_resource(resource_name).enqueue(bucketContext, _key,
+                    make_retry_policy(_ctx.prop_map()), timeout_ms)) {
+            return SUCCESS();
+        }
+
+        // With bulk delete the key is queued and deleted with others from the
+        // same bucket by a multi-object delete.  Keys of earlier unlinks that
+        // could not be deleted are reported to the client of this unlink.
+        if (delete_batcher::for_resource(resource_name).enabled()) {
+            delete_batcher::for_resource(resource_name).add(bucketContext, _key,
+                    make_retry_policy(_ctx.prop_map()), timeout_ms);
+
+            irods::error result = SUCCESS();
+            for (const auto& failure : flush_pending_deletes(_ctx.prop_map())) {
+                auto msg = fmt::format("[resource_name={}]  - Error unlinking the S3 object: \"{}\" - \"{}\"",
+                        resource_name,
+                        failure.key,
+                        failure.code.empty() ? S3_get_status_name(failure.status) : failure.code);
+                addRErrorMsg(&_ctx.comm()->rError, 0, msg.c_str());
+                if (failure.key == _key) {
+                    result = ERROR(S3_FILE_UNLINK_ERR, msg);
+                }
+            }
+            return result;
+        }
+
+        callback_data_t data;
+        S3ResponseHandler responseHandler = { 0, &responseCompleteCallback };
+
+        data = {};
+        std::string&& hostname = s3GetHostname(_ctx.prop_map());
+        bucketContext.hostName = hostname.c_str();
+        data.pCtx = &bucketContext;
+        endpoint_request endpoint{resource_name, hostname};
+        S3_delete_object(
+            &bucketContext,
+            _key.c_str(), 0,
+            timeout_ms,
+            &responseHandler,
+            &data);
+        endpoint.finish(data.status);
+
+        if(data.status != S3StatusOK && data.status != S3StatusHttpErrorNotFound && data.status != S3StatusErrorNoSuchKey) {
+
+            auto msg = fmt::format("[resource_name={}]  - Error unlinking the S3 object: \"{}\"",
+                        resource_name,
+                        _physical_path);
+
+            if(data.status >= 0) {
+                msg += fmt::format(" - \"{}\"", S3_get_status_name((S3Status)data.status));
+            }
+            return ERROR(S3_FILE_UNLINK_ERR, msg);
+        }
+
+        return SUCCESS();
+    } // end delete_s3_object
+
+    // Deletes the objects named by their contents whose release is due, unless
+    // a replica was registered to them since they were released.
+    void delete_released_content_addressed_objects(irods::plugin_context& _ctx)
+    {
+        const auto resource_name = get_resource_name(_ctx.prop_map());
+        auto& queue = content_release_queue::for_resource(resource_name);
+
+        for (const auto& entry : queue.take_due()) {
+            const auto physical_path = fmt::format("/{}/{}", entry.bucket_name, entry.key);
+
+            // the replica that released the object is no longer registered, none is left out
+            try {
+                if (!determine_unlink_for_content_addressed_object(_ctx.comm(), physical_path, 0, resource_name)) {
+                    logger::debug("{}:{} ({}) [resource_name={}] {} is referred to again, not deleting it.",
+                            __FILE__, __LINE__, __FUNCTION__, resource_name, physical_path);
+                    continue;
+                }
+            }
+            catch (const irods::exception& _e) {
+                logger::error("{}:{} ({}) [resource_name={}] Failed to count the replicas referring to {}, "
+                        "trying again later: {}", __FILE__, __LINE__, __FUNCTION__, resource_name, physical_path, _e.what());
+                queue.add(entry.bucket_name, entry.key);
+                continue;
+            }
+
+            if (const auto ret = delete_s3_object(_ctx, entry.bucket_name, entry.key, physical_path); !ret.ok()) {
+                logger::error("{}:{} ({}) [resource_name={}] Failed to delete {} which no replica refers to anymore: {}",
+                        __FILE__, __LINE__, __FUNCTION__, resource_name, physical_path, ret.result());
+            }
+        }
+    } // end delete_released_content_addressed_objects
+
+    // Queues the object named by its contents at _physical_path, which no
+    // replica refers to anymore, to be deleted once a replica synchronized to
+    // it concurrently would have been registered.
+    irods::error release_content_addressed_key(irods::plugin_context& _ctx,
+            const std::string& _bucket,
+            const std::string& _key,
+            const std::string& _physical_path)
+    {
+        if (!content_release_queue::for_resource(get_resource_name(_ctx.prop_map())).add(_bucket, _key)) {
+            return ERROR(S3_FILE_UNLINK_ERR, fmt::format("[resource_name={}] Failed to queue the deletion of \"{}\".",
+                        get_resource_name(_ctx.prop_map()), _physical_path));
+        }
+        return SUCCESS();
+    } // end release_content_addressed_key
 
-        irods::error return_error = SUCCESS();
+    // Releases the object named by its contents that a replica referred to
+    // before it was synchronized with other contents, unless another replica
+    // still refers to it.
+    void release_content_addressed_object(irods::plugin_context& _ctx,
+            const std::string& _physical_path)
+    {
+        irods::file_object_ptr object = boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco());
+        const auto resource_name = get_resource_name(_ctx.prop_map());
 
-        if (!data.s3_transport_ptr || !data.dstream_ptr) {
-            return_error  = ERROR(S3_FILE_OPEN_ERR,
-                    fmt::format("[resource_name={}] null dstream or s3_transport encountered",
-                    get_resource_name(_ctx.prop_map())));
-        } else {
-            fd_data.set(fd, data);
-            return_error = data.s3_transport_ptr->get_error();
+        std::string bucket;
+        std::string key;
+        if (_physical_path == object->physical_path() ||
+                !parseS3Path(_physical_path, bucket, key, _ctx.prop_map()).ok() ||
+                !is_content_addressed_key(key)) {
+            return;
         }
 
-        return std::make_tuple(return_error, data.dstream_ptr, data.s3_transport_ptr);
-    }
+        try {
+            if (!determine_unlink_for_content_addressed_object(_ctx.comm(), _physical_path, object->id(), resource_name)) {
+                return;
+            }
+        }
+        catch (const irods::exception& _e) {
+            logger::error("{}:{} ({}) [resource_name={}] Failed to count the replicas referring to {}: {}",
+                    __FILE__, __LINE__, __FUNCTION__, resource_name, _physical_path, _e.what());
+            return;
+        }
+
+        if (const auto ret = release_content_addressed_key(_ctx, bucket, key, _physical_path); !ret.ok()) {
+            logger::error("{}:{} ({}) [resource_name={}] {} is left in the bucket: {}",
+                    __FILE__, __LINE__, __FUNCTION__, resource_name, _physical_path, ret.result());
+        }
+    } // end release_content_addressed_object
 
     // =-=-=-=-=-=-=-
     // interface for file registration
@@ -789,9 +1560,26 @@ namespace irods_s3 {
             // update the physical path
             update_physical_path_for_decoupled_naming(_ctx);
 
+            // do not let a pending unlink of a previous object delete the new one
+            std::string bucket_name;
+            std::string object_key;
+            if (parseS3Path(file_obj->physical_path(), bucket_name, object_key, _ctx.prop_map()).ok()) {
+                cancel_pending_delete(_ctx.prop_map(), bucket_name, object_key);
+            }
+
             int fd = fd_data.get_and_increment_fd_counter();
             per_thread_data data;
             data.open_mode = open_mode;
+
+            // a small object written by an agent serving the client is stored in a pack
+            if (const int index = get_l1desc_index(file_obj); index >= 0 && !bucket_name.empty()) {
+                if (auto member = reserve_pack_member(_ctx, index, bucket_name); member) {
+                    set_physical_path(file_obj, index, fmt::format("/{}/{}", bucket_name, pack_store::key(*member)));
+                    data.pack_member = member;
+                    data.pack_member_created = true;
+                }
+            }
+
             fd_data.set(fd, data);
             file_obj->file_descriptor(fd);
 
@@ -876,20 +1664,23 @@ namespace irods_s3 {
             fd_data.set(fd, data);
             file_obj->file_descriptor(fd);
 
+            // a member of a pack is read from its pack and moved when it is overwritten
+            if (const auto member = get_pack_member(file_obj->physical_path(), _ctx.prop_map()); member) {
+                bool packed = true;
+                result = open_pack_member(_ctx, *member, packed);
+                if (!result.ok() || packed) {
+                    return result;
+                }
+            }
+
             bool object_must_exist = operation_requires_that_object_exists(open_mode, oprType);
 
             if (object_must_exist) {
 
                 S3BucketContext bucket_context = {};
 
-                std::string hostname = s3GetHostname(_ctx.prop_map()).c_str();
-                std::string region_name = get_region_name(_ctx.prop_map());
-
-                std::string access_key, secret_access_key;
-                result = s3GetAuthCredentials(_ctx.prop_map(), access_key, secret_access_key);
-                if(!result.ok()) {
-                    return PASS(result);
-                }
+                std::string hostname = s3GetCurrentHostname(_ctx.prop_map());
+                const auto settings = get_resource_settings(_ctx.prop_map());
 
                 std::string bucket_name;
                 std::string object_key;
@@ -900,23 +1691,38 @@ namespace irods_s3 {
 
                 bucket_context.hostName         = hostname.c_str();
                 bucket_context.bucketName       = bucket_name.c_str();
-                bucket_context.authRegion       = region_name.c_str();
-                bucket_context.accessKeyId      = access_key.c_str();
-                bucket_context.secretAccessKey  = secret_access_key.c_str();
-                bucket_context.protocol         = s3GetProto(_ctx.prop_map());
-                bucket_context.stsDate          = s3GetSTSDate(_ctx.prop_map());
-                bucket_context.uriStyle         = s3_get_uri_request_style(_ctx.prop_map());
+                bucket_context.authRegion       = settings->region_name.c_str();
+                bucket_context.accessKeyId      = settings->access_key_id.c_str();
+                bucket_context.secretAccessKey  = settings->secret_access_key.c_str();
+                bucket_context.protocol         = settings->protocol;
+                bucket_context.stsDate          = settings->sts_date;
+                bucket_context.uriStyle         = settings->uri_style;
 
                 // determine if the object exists
                 object_s3_status object_status;
                 std::string storage_class;
                 std::int64_t object_size = 0;
-                result = get_object_s3_status(object_key, bucket_context, object_size, object_status, storage_class);
+                std::map<std::string, std::string> meta_data;
+                result = get_object_s3_status(object_key, bucket_context, object_size, object_status, storage_class,
+                        &meta_data);
                 if (!result.ok()) {
                     addRErrorMsg( &_ctx.comm()->rError, 0, result.result().c_str());
                     return PASS(result);
                 }
 
+                // A compressed object is only decompressed when it is staged to the cache in archive
+                // mode.  Streaming it would return the compressed bytes while stat reports the size
+                // before compression.
+                if (compressed_object_from_meta_data(meta_data)) {
+                    result = ERROR(SYS_NOT_SUPPORTED, fmt::format(
+                                "[resource_name={}] The S3 object \"{}\" is compressed and cannot be opened in "
+                                "cacheless mode.  Open it through a resource in archive mode.",
+                                get_resource_name(_ctx.prop_map()), file_obj->physical_path()));
+                    logger::error(result.result());
+                    addRErrorMsg( &_ctx.comm()->rError, 0, result.result().c_str());
+                    return result;
+                }
+
                 logger::debug("{}:{} ({}) object_status = {} storage_class = {}", __FILE__, __LINE__, __FUNCTION__,
                         object_status == object_s3_status::IN_S3 ? "IN_S3" :
                         object_status == object_s3_status::IN_GLACIER ? "IN_GLACIER" :
@@ -924,9 +1730,8 @@ namespace irods_s3 {
                         "DOES_NOT_EXIST",
                         storage_class);
 
-                unsigned int restoration_days = s3_get_restoration_days(_ctx.prop_map());
-                const std::string restoration_tier = s3_get_restoration_tier(_ctx.prop_map());
-                result = handle_glacier_status(object_key, bucket_context, restoration_days, restoration_tier, object_status, storage_class);
+                result = handle_glacier_status(object_key, bucket_context, settings->restoration_days,
+                        settings->restoration_tier, object_status, storage_class);
                 if (!result.ok()) {
                     addRErrorMsg( &_ctx.comm()->rError, 0, result.result().c_str());
                     return PASS(result);
@@ -956,6 +1761,21 @@ namespace irods_s3 {
 
             irods::error result = SUCCESS();
 
+            if (auto data = get_data_for_pack_member(_ctx); data) {
+                return read_pack_member(_ctx, *data, _buf, _len);
+            }
+
+            // the source of a server-side copy is not downloaded
+            if (per_thread_data data = get_data_for_server_side_copy(_ctx); data.server_side_copy.value_or(false)) {
+                const std::int64_t count = std::clamp<std::int64_t>(
+                        data.server_side_copy_size - data.server_side_copy_offset, 0, _len);
+                std::memset(_buf, 0, count);
+                data.server_side_copy_offset += count;
+                fd_data.set(boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco())->file_descriptor(), data);
+                result.code(count);
+                return result;
+            }
+
             std::shared_ptr<dstream> dstream_ptr;
             std::shared_ptr<s3_transport> s3_transport_ptr;
 
@@ -1005,6 +1825,18 @@ namespace irods_s3 {
 
             irods::error result = SUCCESS();
 
+            if (auto data = get_data_for_pack_member(_ctx); data) {
+                return write_pack_member(_ctx, *data, _buf, _len);
+            }
+
+            // the destination of a server-side copy has already been written
+            if (per_thread_data data = get_data_for_server_side_copy(_ctx); data.server_side_copy.value_or(false)) {
+                data.server_side_copy_offset += _len;
+                fd_data.set(boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco())->file_descriptor(), data);
+                result.code(_len);
+                return result;
+            }
+
             // make and read dstream_ptr
             std::shared_ptr<dstream> dstream_ptr;
             std::shared_ptr<s3_transport> s3_transport_ptr;
@@ -1107,6 +1939,18 @@ namespace irods_s3 {
 
             per_thread_data data = fd_data.get(fd);
 
+            if (data.pack_member) {
+                fd_data.remove(fd);
+                return close_pack_member(_ctx, data);
+            }
+
+            // nothing was transferred for the source or destination of a server-side copy
+            if (data.server_side_copy.value_or(false)) {
+                fd_data.remove(fd);
+                release_server_side_copy(_ctx, data);
+                return SUCCESS();
+            }
+
             // Need to get the oprType to check if this was a write type of operation.
             // If it was and no dstream_ptr was created, then that means there was never a
             // a call to write presumably because the object is zero bytes.  In that case
@@ -1130,6 +1974,7 @@ namespace irods_s3 {
             }
 
             fd_data.remove(fd);
+            release_server_side_copy(_ctx, data);
 
             dstream_ptr = data.dstream_ptr;
             s3_transport_ptr = data.s3_transport_ptr;
@@ -1184,6 +2029,11 @@ namespace irods_s3 {
 
             dstream_ptr.reset();  // make sure dstream is destructed first
 
+            // the replica was moved out of a pack when it was opened
+            if (result.ok() && data.replaced_pack_member) {
+                remove_pack_member(_ctx, *data.replaced_pack_member);
+            }
+
             return result;
 
         } else {
@@ -1255,52 +2105,34 @@ namespace irods_s3 {
             return PASS(ret);
         }
 
-        std::string key_id;
-        std::string access_key;
-        ret = s3GetAuthCredentials(_ctx.prop_map(), key_id, access_key);
-        if(!ret.ok()) {
-            return PASS(ret);
+        // a member of a pack is deleted with its pack once it is compacted
+        if (const auto member = pack_store::parse_key(key); member) {
+            remove_pack_member(_ctx, *member);
+            return SUCCESS();
         }
 
-
-        std::string region_name = get_region_name(_ctx.prop_map());
-
-        S3BucketContext bucketContext = {};
-        bucketContext.bucketName = bucket.c_str();
-        bucketContext.protocol = s3GetProto(_ctx.prop_map());
-        bucketContext.stsDate = s3GetSTSDate(_ctx.prop_map());
-        bucketContext.uriStyle = s3_get_uri_request_style(_ctx.prop_map());
-        bucketContext.accessKeyId = key_id.c_str();
-        bucketContext.secretAccessKey = access_key.c_str();
-        bucketContext.authRegion = region_name.c_str();
-
-        callback_data_t data;
-        S3ResponseHandler responseHandler = { 0, &responseCompleteCallback };
-
-        data = {};
-        std::string&& hostname = s3GetHostname(_ctx.prop_map());
-        bucketContext.hostName = hostname.c_str();
-        data.pCtx = &bucketContext;
-        S3_delete_object(
-            &bucketContext,
-            key.c_str(), 0,
-            get_non_data_transfer_timeout_seconds(_ctx.prop_map()) * 1000,    // timeout (ms)
-            &responseHandler,
-            &data);
-
-        if(data.status != S3StatusOK && data.status != S3StatusHttpErrorNotFound && data.status != S3StatusErrorNoSuchKey) {
-
-            auto msg = fmt::format("[resource_name={}]  - Error unlinking the S3 object: \"{}\"",
-                        get_resource_name(_ctx.prop_map()),
-                        file_obj->physical_path());
-
-            if(data.status >= 0) {
-                msg += fmt::format(" - \"{}\"", S3_get_status_name((S3Status)data.status));
+        // an object named by its contents is shared by the replicas with the
+        // same contents and released with the last of them
+        if (is_content_addressed_key(key)) {
+            try {
+                if (!determine_unlink_for_content_addressed_object(_ctx.comm(), file_obj->physical_path(),
+                            file_obj->id(), get_resource_name(_ctx.prop_map()))) {
+                    delete_released_content_addressed_objects(_ctx);
+                    return SUCCESS();
+                }
             }
-            return ERROR(S3_FILE_UNLINK_ERR, msg);
+            catch(const irods::exception& _e) {
+                return ERROR(
+                            _e.code(),
+                            _e.what());
+            }
+
+            ret = release_content_addressed_key(_ctx, bucket, key, file_obj->physical_path());
+            delete_released_content_addressed_objects(_ctx);
+            return ret;
         }
 
-        return SUCCESS();
+        return delete_s3_object(_ctx, bucket, key, file_obj->physical_path());
 
     } // s3_file_unlink_operation
 
@@ -1310,16 +2142,15 @@ namespace irods_s3 {
     irods::error s3_file_stat_operation_with_flag_for_retry_on_not_found(
         irods::plugin_context& _ctx,
         struct stat* _statbuf,
-        bool retry_on_not_found )
+        bool retry_on_not_found,
+        std::map<std::string, std::string>* _meta_data )
     {
         std::uint64_t thread_id = std::hash<std::thread::id>{}(std::this_thread::get_id());
         logger::debug("{}:{} ({}) [[{}]]", __FILE__, __LINE__, __FUNCTION__, thread_id);
 
-        std::size_t retry_count_limit = get_retry_count(_ctx.prop_map());
-        std::size_t retry_wait = get_retry_wait_time_sec(_ctx.prop_map());
-        std::size_t max_retry_wait = get_max_retry_wait_time_sec(_ctx.prop_map());
-
-        const auto resource_name = get_resource_name(_ctx.prop_map());
+        // the settings were parsed when the resource started
+        const auto settings = get_resource_settings(_ctx.prop_map());
+        const auto& resource_name = settings->resource_name;
 
         // =-=-=-=-=-=-=-
         // check incoming parameters
@@ -1344,8 +2175,6 @@ namespace irods_s3 {
 
         std::string bucket;
         std::string key;
-        std::string key_id;
-        std::string access_key;
 
         ret = parseS3Path(object->physical_path(), bucket, key, _ctx.prop_map());
         if (!ret.ok()) {
@@ -1358,6 +2187,16 @@ namespace irods_s3 {
             return ret;
         }
 
+        // the size of a member of a pack is part of its key
+        if (const auto member = pack_store::parse_key(key); member) {
+            _statbuf->st_mode = S_IFREG;
+            _statbuf->st_nlink = 1;
+            _statbuf->st_uid = getuid();
+            _statbuf->st_gid = getgid();
+            _statbuf->st_size = member->length;
+            return SUCCESS();
+        }
+
         ret = s3InitPerOperation( _ctx.prop_map() );
         if (!ret.ok()) {
             ret = PASSMSG(fmt::format(
@@ -1369,7 +2208,7 @@ namespace irods_s3 {
             return ret;
         }
 
-        ret = s3GetAuthCredentials(_ctx.prop_map(), key_id, access_key);
+        ret = check_credentials(*settings);
         if (!ret.ok()) {
             ret = PASSMSG(fmt::format(
                         "[resource_name={}] Failed to get the S3 credentials properties.",
@@ -1380,47 +2219,30 @@ namespace irods_s3 {
             return ret;
         }
 
-        std::string region_name = get_region_name(_ctx.prop_map());
-
         callback_data_t data;
-        S3BucketContext bucketContext{};
-
-        bucketContext.bucketName = bucket.c_str();
-        bucketContext.protocol = s3GetProto(_ctx.prop_map());
-        bucketContext.stsDate = s3GetSTSDate(_ctx.prop_map());
-        bucketContext.uriStyle = s3_get_uri_request_style(_ctx.prop_map());
-        bucketContext.accessKeyId = key_id.c_str();
-        bucketContext.secretAccessKey = access_key.c_str();
-        bucketContext.authRegion = region_name.c_str();
+        S3BucketContext bucketContext = make_bucket_context(*settings, bucket);
 
         S3ResponseHandler headObjectHandler = { &responsePropertiesCallback, &responseCompleteCallbackIgnoreLoggingNotFound};
-        std::size_t retry_cnt = 0;
+        auto retry = make_retry_policy(_ctx.prop_map(),
+                irods::experimental::io::s3_transport::S3_status_is_retryable);
+        std::size_t not_found_cnt = 0;
+        bool retry_not_found = false;
         do {
             std::string&& hostname = s3GetHostname(_ctx.prop_map());
             bucketContext.hostName = hostname.c_str();
             data.pCtx = &bucketContext;
 
+            endpoint_request endpoint{resource_name, hostname};
             S3_head_object(&bucketContext, key.c_str(), 0, 0, &headObjectHandler, &data);
+            endpoint.finish(data.status);
 
-            if ((retry_on_not_found && data.status != S3StatusOK) ||
-                    (data.status != S3StatusOK && data.status != S3StatusHttpErrorNotFound)) {
-
-
-                // On not found just sleep for a second and don't do exponential backoff
-                if (data.status == S3StatusHttpErrorNotFound) {
-                    s3_sleep( 1 );
-                } else {
-                    s3_sleep( retry_wait );
-                    retry_wait *= 2;
-                }
-                if (retry_wait > max_retry_wait) {
-                    retry_wait = max_retry_wait;
-                }
+            // On not found just sleep for a second and don't do exponential backoff
+            retry_not_found = retry_on_not_found && data.status == S3StatusHttpErrorNotFound &&
+                ++not_found_cnt < settings->retry_count;
+            if (retry_not_found) {
+                s3_sleep( 1 );
             }
-        } while ( data.status != S3StatusOK &&
-                ( irods::experimental::io::s3_transport::S3_status_is_retryable(data.status) ||
-                  ( retry_on_not_found && data.status == S3StatusHttpErrorNotFound ) ) &&
-                ++retry_cnt < retry_count_limit );
+        } while ( retry_not_found || retry.should_retry(data.status) );
 
         if (data.status == S3StatusOK) {
             _statbuf->st_mode = S_IFREG;
@@ -1430,6 +2252,14 @@ namespace irods_s3 {
             _statbuf->st_atime = _statbuf->st_mtime = _statbuf->st_ctime = savedProperties.lastModified;
             _statbuf->st_size = savedProperties.contentLength;
 
+            // a compressed object is reported with its size before compression
+            if (const auto compressed = compressed_object_from_meta_data(data.meta_data); compressed) {
+                _statbuf->st_size = compressed->logical_size;
+            }
+            if (_meta_data) {
+                *_meta_data = std::move(data.meta_data);
+            }
+
             return SUCCESS();
         }
 
@@ -1554,6 +2384,25 @@ namespace irods_s3 {
 
             irods::error result = SUCCESS();
 
+            if (auto data = get_data_for_pack_member(_ctx); data) {
+                const std::int64_t base =
+                    _whence == SEEK_SET ? 0 : (_whence == SEEK_END ? data->pack_member->length : data->pack_member_offset);
+                data->pack_member_offset = base + _offset;
+                fd_data.set(boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco())->file_descriptor(), *data);
+                result.code(data->pack_member_offset);
+                return result;
+            }
+
+            // nothing is transferred for the source or destination of a server-side copy
+            if (per_thread_data data = get_data_for_server_side_copy(_ctx); data.server_side_copy.value_or(false)) {
+                const std::int64_t base =
+                    _whence == SEEK_SET ? 0 : (_whence == SEEK_END ? data.server_side_copy_size : data.server_side_copy_offset);
+                data.server_side_copy_offset = base + _offset;
+                fd_data.set(boost::dynamic_pointer_cast<irods::file_object>(_ctx.fco())->file_descriptor(), data);
+                result.code(data.server_side_copy_offset);
+                return result;
+            }
+
             std::shared_ptr<dstream> dstream_ptr;
             std::shared_ptr<s3_transport> s3_transport_ptr;
 
@@ -1621,6 +2470,35 @@ namespace irods_s3 {
 
     } // s3_rmdir_operation
 
+    // Listings in progress for this thread, keyed by the prefix being listed.
+    // An entry is removed when its listing completes or on closedir.
+    thread_local std::map<std::string, std::unique_ptr<bucket_lister>> directory_listers;
+
+    // Returns the bucket and the key prefix listed by readdir for the collection in _ctx.
+    irods::error get_readdir_search_key( irods::plugin_context& _ctx, std::string& _bucket, std::string& _search_key ) {
+
+        irods::collection_object_ptr fco = boost::dynamic_pointer_cast< irods::collection_object >( _ctx.fco() );
+        if (!fco) {
+            return ERROR(SYS_INVALID_INPUT_PARAM,
+                    fmt::format("[resource_name={}] {} expects a collection object",
+                        get_resource_name(_ctx.prop_map()), __FUNCTION__));
+        }
+
+        std::string key;
+        irods::error ret = parseS3Path(fco->physical_path(), _bucket, key, _ctx.prop_map());
+        if(!ret.ok()) {
+            return PASS(ret);
+        }
+
+        // add a trailing slash if it is not there
+        _search_key = key;
+        if(!_search_key.empty() && '/' != _search_key.back()) {
+             _search_key += "/";
+        }
+
+        return SUCCESS();
+    } // get_readdir_search_key
+
     // =-=-=-=-=-=-=-
     // interface for POSIX opendir
     irods::error s3_opendir_operation( irods::plugin_context& _ctx ) {
@@ -1640,6 +2518,13 @@ namespace irods_s3 {
     irods::error s3_closedir_operation( irods::plugin_context& _ctx) {
 
         if (is_cacheless_mode(_ctx.prop_map())) {
+
+            // release the listing of this collection, if any
+            std::string bucket;
+            std::string search_key;
+            if (get_readdir_search_key(_ctx, bucket, search_key).ok()) {
+                directory_listers.erase(search_key);
+            }
             return SUCCESS();
         } else {
             return ERROR(SYS_NOT_SUPPORTED,
@@ -1658,115 +2543,33 @@ namespace irods_s3 {
 
             logger::debug("{}:{} ({}) [[{}]]", __FILE__, __LINE__, __FUNCTION__, std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
-            struct readdir_callback_data {
-
-                struct query_results {
-
-                    query_results()
-                        : is_truncated(true)
-                        , next_marker("")
-                        , status(S3StatusOK)
-                        , pCtx(nullptr)
-                    {}
-
-                    bool is_truncated;
-                    std::list<std::string> returned_objects;
-                    std::list<std::string> returned_collections;
-                    std::string next_marker;
-                    S3Status status;
-                    S3BucketContext *pCtx; /* To enable more detailed error messages */
-                };
-
-                std::map<std::string, query_results> result_map;
-                std::string query_string;
-            };
-
-            S3ListBucketHandler list_bucket_handler = {
-                {
-                    [] (const S3ResponseProperties *properties, void *callback_data) -> S3Status {
-                        return S3StatusOK;
-                    },
-                    [] (S3Status status, const S3ErrorDetails *error, void *callback_data) -> void {
-
-                        readdir_callback_data *data = static_cast<readdir_callback_data*>(callback_data);
-                        std::string query_string = data->query_string;
-
-                        readdir_callback_data::query_results &results = data->result_map[query_string];
-                        StoreAndLogStatus( status, error, __FUNCTION__, results.pCtx, &(results.status) );
-                    }
-                },
-                [] (int is_truncated, const char *next_marker, int contents_count,
-                        const S3ListBucketContent *contents, int common_prefixes_count,
-                        const char **common_prefixes, void *callback_data) -> S3Status {
-
-                    readdir_callback_data *data = static_cast<readdir_callback_data*>(callback_data);
-                    std::string query_string = data->query_string;
-                    readdir_callback_data::query_results &results = data->result_map[query_string];
-
-                    results.is_truncated = is_truncated;
-                    results.next_marker = (next_marker == nullptr ? "" : next_marker);
-                    for (int i = 0; i < contents_count; ++i) {
-                        results.returned_objects.push_back(contents[i].key);
-                    }
-
-                    for (int i = 0; i < common_prefixes_count; ++i) {
-                        // remove trailing slash
-                        std::string dir_name(common_prefixes[i]);
-                        if('/' == dir_name.back()) {
-                            dir_name.pop_back();
-                        }
-                        results.returned_collections.push_back(dir_name);
-                    }
-                    return S3StatusOK;
-                }
-            };
-
-            irods::error result = SUCCESS();
-
-
             // check incoming parameters
             irods::error ret = s3CheckParams( _ctx );
             if (!ret.ok()) {
                 return PASS(ret);
             }
 
-            irods::collection_object_ptr fco = boost::dynamic_pointer_cast< irods::collection_object >( _ctx.fco() );
-            std::string path = fco->physical_path();
-
             std::string bucket;
-            std::string key;
-            result = parseS3Path(path, bucket, key, _ctx.prop_map());
-            if(!result.ok()) {
-                return PASS(result);
-            }
-
-            thread_local readdir_callback_data cb_data{ {}, "" };
-
-            // add a trailing slash if it is not there
-            std::string search_key = key;
-            if('/' != search_key.back()) {
-                 search_key += "/";
+            std::string search_key;
+            ret = get_readdir_search_key(_ctx, bucket, search_key);
+            if (!ret.ok()) {
+                return PASS(ret);
             }
-            cb_data.query_string = search_key;
-
-            readdir_callback_data::query_results& data = cb_data.result_map[search_key];
-
-            // see if we need to get more data
-            if (data.returned_objects.size() == 0 && data.returned_collections.size() == 0 && data.is_truncated) {
 
-                std::size_t retry_count_limit = get_retry_count(_ctx.prop_map());
-                std::size_t retry_wait = get_retry_wait_time_sec(_ctx.prop_map());
-                std::size_t max_retry_wait = get_max_retry_wait_time_sec(_ctx.prop_map());
+            auto& lister = directory_listers[search_key];
+            if (!lister) {
 
-                result = s3InitPerOperation( _ctx.prop_map() );
-                if(!result.ok()) {
-                    return PASS(result);
+                ret = s3InitPerOperation( _ctx.prop_map() );
+                if(!ret.ok()) {
+                    directory_listers.erase(search_key);
+                    return PASS(ret);
                 }
 
                 std::string key_id, access_key;
-                result = s3GetAuthCredentials(_ctx.prop_map(), key_id, access_key);
-                if(!result.ok()) {
-                    return PASS(result);
+                ret = s3GetAuthCredentials(_ctx.prop_map(), key_id, access_key);
+                if(!ret.ok()) {
+                    directory_listers.erase(search_key);
+                    return PASS(ret);
                 }
 
                 std::string region_name = get_region_name(_ctx.prop_map());
@@ -1781,74 +2584,42 @@ namespace irods_s3 {
                 bucketContext.secretAccessKey = access_key.c_str();
                 bucketContext.authRegion = region_name.c_str();
 
-                std::size_t retry_cnt = 0;
-                do {
-
-                    std::string&& hostname = s3GetHostname(_ctx.prop_map());
-                    bucketContext.hostName = hostname.c_str();
-                    data.pCtx = &bucketContext;
-
-                    S3_list_bucket(&bucketContext,                                       // S3BucketContext
-                            search_key.c_str(),                                          // prefix
-                            data.next_marker == "" ? nullptr : data.next_marker.c_str(), // marker
-                            "/",                                                         // delimiter
-                            1024,                                                        // max number returned
-                            nullptr,                                                     // S3RequestContext
-                            0,                                                           // timeout
-                            &list_bucket_handler,                                        // S3ListBucketHandler
-                            &cb_data                                                     // void* callback data
-                            );
-
-                    if (data.status != S3StatusOK) {
-                        s3_sleep( retry_wait );
-                        retry_wait *= 2;
-                        if (retry_wait > max_retry_wait) {
-                            retry_wait = max_retry_wait;
-                        }
-                    }
+                lister = std::make_unique<bucket_lister>(get_resource_name(_ctx.prop_map()),
+                        bucketContext, search_key, "/",
+                        make_retry_policy(_ctx.prop_map(), irods::experimental::io::s3_transport::S3_status_is_retryable),
+                        bucket_lister::alphabet_boundaries(search_key, get_listing_shards(_ctx.prop_map())));
+            }
 
-                } while ( (data.status != S3StatusOK) &&
-                        irods::experimental::io::s3_transport::S3_status_is_retryable(data.status) &&
-                        (++retry_cnt < retry_count_limit ) );
+            std::optional<bucket_list_entry> entry;
+            S3Status status = lister->next(entry);
 
-                if (data.status != S3StatusOK) {
+            if (status != S3StatusOK) {
 
-                    auto msg = fmt::format("[resource_name={}] - Error in S3 listing:  \"{}\"",
-                                get_resource_name(_ctx.prop_map()),
-                                search_key.c_str());
+                directory_listers.erase(search_key);
 
-                    if(data.status >= 0) {
-                        msg += fmt::format(" - \"{}\"", S3_get_status_name((S3Status)data.status));
-                    }
+                auto msg = fmt::format("[resource_name={}] - Error in S3 listing:  \"{}\"",
+                            get_resource_name(_ctx.prop_map()),
+                            search_key.c_str());
 
-                    return ERROR(S3_FILE_STAT_ERR, msg);
+                if(status >= 0) {
+                    msg += fmt::format(" - \"{}\"", S3_get_status_name(status));
                 }
-            }
 
-            *_dirent_ptr = nullptr;
-            if (data.returned_objects.size() > 0) {
-
-                std::string current_key = data.returned_objects.front();
-                data.returned_objects.pop_front();
-                *_dirent_ptr = ( rodsDirent_t* ) malloc( sizeof( rodsDirent_t ) );
-                boost::filesystem::path p(current_key.c_str());
-                current_key = p.filename().string();
-                strcpy((*_dirent_ptr)->d_name, current_key.c_str());
-                return result;
+                return ERROR(S3_FILE_STAT_ERR, msg);
             }
 
-            if (data.returned_collections.size() > 0) {
-
-                std::string current_key = data.returned_collections.front();
-                data.returned_collections.pop_front();
-                *_dirent_ptr = ( rodsDirent_t* ) malloc( sizeof( rodsDirent_t ) );
-                boost::filesystem::path p(current_key.c_str());
-                current_key = p.filename().string();
-                strcpy((*_dirent_ptr)->d_name, current_key.c_str());
-                return result;
+            *_dirent_ptr = nullptr;
+            if (!entry) {
+                // listing complete, release the memory even if closedir is not called
+                directory_listers.erase(search_key);
+                return SUCCESS();
             }
 
-            return result;
+            *_dirent_ptr = ( rodsDirent_t* ) malloc( sizeof( rodsDirent_t ) );
+            boost::filesystem::path p(entry->key.c_str());
+            std::string current_key = p.filename().string();
+            strcpy((*_dirent_ptr)->d_name, current_key.c_str());
+            return SUCCESS();
 
         } else {
 
@@ -1867,10 +2638,10 @@ namespace irods_s3 {
         logger::debug("{}:{} ({}) [[{}]]", __FILE__, __LINE__, __FUNCTION__, std::hash<std::thread::id>{}(std::this_thread::get_id()));
 
         irods::error result = SUCCESS();
-        std::string access_key;
-        std::string secret_access_key;
 
-        const auto resource_name = get_resource_name(_ctx.prop_map());
+        // the settings were parsed when the resource started
+        const auto settings = get_resource_settings(_ctx.prop_map());
+        const auto& resource_name = settings->resource_name;
 
         // retrieve archive naming policy from resource plugin context
         std::string archive_naming_policy = CONSISTENT_NAMING; // default
@@ -1888,7 +2659,7 @@ namespace irods_s3 {
             return SUCCESS();
         }
 
-        ret = s3GetAuthCredentials(_ctx.prop_map(), access_key, secret_access_key);
+        ret = check_credentials(*settings);
         if (!ret.ok()) {
             // TODO: this is to maintain existing behavior but probably not necessary for error cases
             object->physical_path(_new_file_name);
@@ -1898,11 +2669,20 @@ namespace irods_s3 {
                         resource_name), ret);
         }
 
+        // do not let a pending unlink of a previous object delete the destination
+        {
+            std::string new_bucket_name;
+            std::string new_object_key;
+            if (parseS3Path(_new_file_name, new_bucket_name, new_object_key, _ctx.prop_map()).ok()) {
+                cancel_pending_delete(_ctx.prop_map(), new_bucket_name, new_object_key);
+            }
+        }
+
         if (!s3_copyobject_disabled(_ctx.prop_map())) {
             // copy the object to the new location
-            ret = s3CopyFile(_ctx, object->physical_path(), _new_file_name, access_key, secret_access_key,
-                    s3GetProto(_ctx.prop_map()), s3GetSTSDate(_ctx.prop_map()),
-                    s3_get_uri_request_style(_ctx.prop_map()));
+            ret = s3CopyFile(_ctx, object->physical_path(), _new_file_name,
+                    settings->access_key_id, settings->secret_access_key,
+                    settings->protocol, settings->sts_date, settings->uri_style);
             if (!ret.ok()) {
                 // TODO: this is to maintain existing behavior but probably not necessary for error cases
                 object->physical_path(_new_file_name);
@@ -1928,16 +2708,9 @@ namespace irods_s3 {
             return ret;
         }
 
-        // read the buffer size from rods environment
-        rodsLong_t buf_size = irods::get_advanced_setting<const int>(irods::KW_CFG_TRANS_BUFFER_SIZE_FOR_PARA_TRANS) * 1024 * 1024;
-        char* buf = ( char* )malloc( buf_size );
-
-        const irods::at_scope_exit free_buf { [buf]() {
-            free(buf);
-        }};
-
         struct stat statbuf;
-        ret = s3_file_stat_operation_with_flag_for_retry_on_not_found(_ctx, &statbuf, false);
+        std::map<std::string, std::string> meta_data;
+        ret = s3_file_stat_operation_with_flag_for_retry_on_not_found(_ctx, &statbuf, false, &meta_data);
         if (!ret.ok()) {
             // TODO: this is to maintain existing behavior but probably not necessary for error cases
             object->physical_path(_new_file_name);
@@ -1947,67 +2720,67 @@ namespace irods_s3 {
                         resource_name, object->physical_path()), ret);
         }
 
-        std::string bucket_name;
+        // a compressed object is copied as is along with the metadata describing it
+        std::int64_t object_size = statbuf.st_size;
+        std::map<std::string, std::string> compression_meta_data;
+        if (const auto compressed = compressed_object_from_meta_data(meta_data); compressed) {
+            object_size = compressed->compressed_size;
+            compression_meta_data = compressed->meta_data();
+        }
+        std::vector<S3NameValue> put_meta_data;
+        for (const auto& [name, value] : compression_meta_data) {
+            put_meta_data.push_back({name.c_str(), value.c_str()});
+        }
+
+        std::string src_bucket_name;
+        std::string dest_bucket_name;
         std::string src_object_key;
         std::string dest_object_key;
-        std::string&& hostname = s3GetHostname(_ctx.prop_map());
 
         // get source object_key
-        ret = parseS3Path(object->physical_path(), bucket_name, src_object_key, _ctx.prop_map());
+        ret = parseS3Path(object->physical_path(), src_bucket_name, src_object_key, _ctx.prop_map());
         if (!ret.ok()) {
             return ret;
         }
 
         // get destination object_key
-        ret = parseS3Path(_new_file_name, bucket_name, dest_object_key, _ctx.prop_map());
+        ret = parseS3Path(_new_file_name, dest_bucket_name, dest_object_key, _ctx.prop_map());
         if (!ret.ok()) {
             return ret;
         }
 
-        // read from source and write to destination
-        s3_transport_config src_s3_config;
-        src_s3_config.hostname = hostname;
-        src_s3_config.number_of_cache_transfer_threads = 1;
-        src_s3_config.number_of_client_transfer_threads = 1;
-        src_s3_config.bucket_name = bucket_name;
-        src_s3_config.access_key = access_key;
-        src_s3_config.secret_access_key = secret_access_key;
-        src_s3_config.shared_memory_timeout_in_seconds = 180;
-        src_s3_config.region_name = get_region_name(_ctx.prop_map());
-        src_s3_config.s3_protocol_str = s3GetProto(_ctx.prop_map());
-
-        s3_transport src_transport_object{src_s3_config};
-        idstream src_dstream_object{src_transport_object, src_object_key};
-
-        // get the source object size
-        off_t object_size = src_transport_object.get_existing_object_size();
-
-        s3_transport_config dest_s3_config;
-        dest_s3_config.hostname = hostname;
-        dest_s3_config.number_of_cache_transfer_threads = 1;
-        dest_s3_config.bucket_name = bucket_name;
-        dest_s3_config.access_key = access_key;
-        dest_s3_config.secret_access_key = secret_access_key;
-        dest_s3_config.shared_memory_timeout_in_seconds = 180;
-        dest_s3_config.region_name = get_region_name(_ctx.prop_map());
-        dest_s3_config.put_repl_flag = false;
-        dest_s3_config.object_size = object_size;
-        dest_s3_config.minimum_part_size = s3GetMPUChunksize(_ctx.prop_map());
-        dest_s3_config.circular_buffer_size = 2 * dest_s3_config.minimum_part_size;
-        dest_s3_config.s3_protocol_str = s3GetProto(_ctx.prop_map());
-
-        dest_s3_config.number_of_client_transfer_threads = 1;
-        s3_transport dest_transport_object{dest_s3_config};
-        odstream dest_dstream_object{dest_transport_object, dest_object_key};
-
-        // copy from src to dest
-        for (off_t offset = 0; offset < object_size; offset += buf_size) {
-            off_t read_write_size = (offset + buf_size) <= object_size ? buf_size : (object_size - offset);
-            src_dstream_object.read(buf, read_write_size);
-            dest_dstream_object.write(buf, read_write_size);
-        }
-        src_dstream_object.close();
-        dest_dstream_object.close();
+        const S3BucketContext src_bucket_context = make_bucket_context(*settings, src_bucket_name);
+        const S3BucketContext dest_bucket_context = make_bucket_context(*settings, dest_bucket_name);
+
+        S3PutProperties put_props = {};
+        put_props.expires = -1;
+        put_props.useServerSideEncryption = settings->server_encrypt;
+        put_props.xAmzStorageClass = settings->storage_class.c_str();
+        put_props.metaDataCount = static_cast<int>(put_meta_data.size());
+        put_props.metaData = put_meta_data.empty() ? nullptr : put_meta_data.data();
+
+        // read from source and write to destination, downloading and uploading
+        // several parts at a time
+        using irods::experimental::io::s3_transport::streaming_copy;
+        const S3Status status = streaming_copy(resource_name,
+                src_bucket_context, src_object_key,
+                dest_bucket_context, dest_object_key,
+                object_size,
+                s3GetMPUCopyChunksize(_ctx.prop_map(), object_size),
+                s3GetMPUCopyThreads(_ctx.prop_map()),
+                settings->multipart_enabled,
+                put_props,
+                make_retry_policy(_ctx.prop_map()),
+                static_cast<int>(settings->non_data_transfer_timeout_seconds * 1000));
+        if (status != S3StatusOK) {
+            auto msg = fmt::format("[resource_name={}] Failed to copy object from: \"{}\" to \"{}\" - \"{}\".",
+                    resource_name, object->physical_path(), _new_file_name, S3_get_status_name(status));
+
+            // TODO: this is to maintain existing behavior but probably not necessary for error cases
+            object->physical_path(_new_file_name);
+
+            return ERROR(S3_FILE_COPY_ERR, msg);
+        }
 
         // delete the original file
         result = s3_file_unlink_operation(_ctx);
@@ -2082,7 +2855,7 @@ namespace irods_s3 {
 
         S3BucketContext bucket_context = {};
 
-        std::string hostname = s3GetHostname(_ctx.prop_map()).c_str();
+        std::string hostname = s3GetCurrentHostname(_ctx.prop_map());
         std::string region_name = get_region_name(_ctx.prop_map());
 
         ret = s3GetAuthCredentials(_ctx.prop_map(), access_key, secret_access_key);
@@ -2111,7 +2884,8 @@ namespace irods_s3 {
         object_s3_status object_status;
         std::string storage_class;
         std::int64_t object_size = 0;
-        ret = get_object_s3_status(object_key, bucket_context, object_size, object_status, storage_class);
+        std::map<std::string, std::string> meta_data;
+        ret = get_object_s3_status(object_key, bucket_context, object_size, object_status, storage_class, &meta_data);
         if (!ret.ok()) {
             addRErrorMsg( &_ctx.comm()->rError, 0, ret.result().c_str());
             return PASS(ret);
@@ -2132,13 +2906,22 @@ namespace irods_s3 {
             return PASS(ret);
         }
 
+        // a compressed object is decompressed into the cache file
+        const auto compressed = compressed_object_from_meta_data(meta_data);
+        if (compressed) {
+            object_size = compressed->logical_size;
+        }
+
         if (object->size() > 0 && object->size() != static_cast<rodsLong_t>(object_size)) {
             return ERROR(SYS_COPY_LEN_ERR, fmt::format(
                         "[resource_name={}] Error for file: \"{}\" inp data size: {} does not match stat size: {}.",
                         resource_name, object->physical_path(), object->size(), object_size));
         }
 
-        ret = s3GetFile( _cache_file_name, object->physical_path(), object_size, access_key, secret_access_key, _ctx.prop_map());
+        ret = compressed
+            ? s3GetCompressedFile( _cache_file_name, object->physical_path(), *compressed, access_key, secret_access_key, _ctx.prop_map())
+            : s3GetFile( _cache_file_name, object->physical_path(), object_size, access_key, secret_access_key, _ctx.prop_map(),
+                _ctx.comm()->clientUser.userName);
         if (!ret.ok()) {
             return PASSMSG(fmt::format(
                         "[resource_name={}] Failed to copy the S3 object: \"{}\" to the cache: \"{}\".",
@@ -2223,9 +3006,50 @@ namespace irods_s3 {
         }
         boost::to_lower(archive_naming_policy);
 
+        // the object the replica referred to before it is synchronized
+        const std::string previous_physical_path = object->physical_path();
+        bool content_exists = false;
+        std::string content_digest;
+
         // if archive naming policy is decoupled
         // we use the object's reversed id as S3 key name prefix
-        if (archive_naming_policy == DECOUPLED_NAMING) {
+        if (archive_naming_policy == DECOUPLED_NAMING && s3_content_addressed_naming_enabled(_ctx.prop_map())) {
+            // the key is named by the hash of the contents and an object
+            // already holding them is shared rather than uploaded again
+            std::vector< std::string > tokens;
+            irods::string_tokenize(object->physical_path(), "/", tokens);
+            std::string bucket_name = tokens.front();
+
+            std::string content_key;
+            ret = get_content_addressed_key(_cache_file_name, content_key);
+            if (!ret.ok()) {
+                ret = PASSMSG(fmt::format(
+                            "[resource_name={}] Failed to hash the cache file: \"{}\".",
+                            resource_name, _cache_file_name), ret);
+
+                logger::error(ret.result());
+
+                return ret;
+            }
+
+            object->physical_path(fmt::format("/{}/{}", bucket_name, content_key));
+
+            // the digest the object was uploaded with is checked as well as its
+            // size, an object written under the key otherwise is uploaded again
+            content_digest = content_address::digest_of_key(content_key);
+            struct stat content_statbuf = {};
+            std::map<std::string, std::string> content_meta_data;
+            ret = s3_file_stat_operation_with_flag_for_retry_on_not_found(_ctx, &content_statbuf, false, &content_meta_data);
+            content_exists = ret.ok() && S_ISREG(content_statbuf.st_mode) &&
+                content_address::holds_contents(content_key, statbuf.st_size, content_statbuf.st_size, content_meta_data);
+            if (content_exists) {
+                // a delete of the object queued by the unlink of its last replica must not remove it now
+                cancel_pending_delete(_ctx.prop_map(), bucket_name, content_key);
+                logger::debug("{}:{} ({}) [resource_name={}] {} holds the contents of {}, not uploading it.",
+                        __FILE__, __LINE__, __FUNCTION__, resource_name, object->physical_path(), _cache_file_name);
+            }
+        }
+        else if (archive_naming_policy == DECOUPLED_NAMING) {
             // extract object name and bucket name from physical path
             std::vector< std::string > tokens;
             irods::string_tokenize(object->physical_path(), "/", tokens);
@@ -2243,7 +3067,24 @@ namespace irods_s3 {
             object->physical_path(s3_key_name);
         }
 
-        ret = s3PutCopyFile(S3_PUTFILE, _cache_file_name, object->physical_path(), statbuf.st_size, key_id, access_key, _ctx.prop_map());
+        if (content_exists) {
+            release_content_addressed_object(_ctx, previous_physical_path);
+            delete_released_content_addressed_objects(_ctx);
+            return SUCCESS();
+        }
+
+        // an object named by its contents records their digest
+        std::map<std::string, std::string> meta_data;
+        if (!content_digest.empty()) {
+            meta_data[content_address::DIGEST_META_DATA] = content_digest;
+        }
+
+        // the cache file is compressed first if the resource compresses objects
+        ret = s3_compression_enabled(_ctx.prop_map())
+            ? s3PutCompressedFile(_cache_file_name, object->physical_path(), statbuf.st_size, key_id, access_key, _ctx.prop_map(), meta_data,
+                    _ctx.comm()->clientUser.userName)
+            : s3PutCopyFile(S3_PUTFILE, _cache_file_name, object->physical_path(), statbuf.st_size, key_id, access_key, _ctx.prop_map(), meta_data,
+                    _ctx.comm()->clientUser.userName);
         if (!ret.ok()) {
             ret = PASSMSG(fmt::format(
                         "[resource_name={}] Failed to copy the cache file: \"{}\" to the S3 object: \"{}\".",
@@ -2254,6 +3095,11 @@ namespace irods_s3 {
             return ret;
         }
 
+        release_content_addressed_object(_ctx, previous_physical_path);
+        if (!content_digest.empty()) {
+            delete_released_content_addressed_objects(_ctx);
+        }
+
         return ret;
     } // s3_sync_to_arch_operation
 
@@ -2446,6 +3292,16 @@ namespace irods_s3 {
             return PASS(ret);
         }
 
+        // S3 keeps the checksum of the pack, not of its members
+        if (pack_store::parse_key(key)) {
+            return generic_checksum_not_available_error;
+        }
+
+        // S3 keeps the checksum of the compressed object, not of its contents
+        if (s3_compression_enabled(_ctx.prop_map()) && !is_cacheless_mode(_ctx.prop_map())) {
+            return generic_checksum_not_available_error;
+        }
+
         // get auth credentials
         std::string key_id;
         std::string access_key;
@@ -2464,7 +3320,7 @@ namespace irods_s3 {
         bucketContext.secretAccessKey = access_key.c_str();
         std::string region_name = get_region_name(_ctx.prop_map());
         bucketContext.authRegion = region_name.c_str();
-        std::string&& hostname = s3GetHostname(_ctx.prop_map());
+        std::string&& hostname = s3GetCurrentHostname(_ctx.prop_map());
         bucketContext.hostName = hostname.c_str();
 
         // set up callbacks for s3_get_object_attributes
@@ -3,6 +3,17 @@
 #include "irods/private/s3_resource/s3_resource.hpp"
 #include "irods/private/s3_resource/s3_operations.hpp"
 #include "irods/private/s3_resource/s3_plugin_logging_category.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/admission_controller.hpp"
+#include "irods/private/s3_transport/hedged_get.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
+#include "irods/private/s3_transport/bulk_delete.hpp"
+#include "irods/private/s3_transport/compression.hpp"
+#include "irods/private/s3_transport/content_address.hpp"
+#include "irods/private/s3_transport/content_release_queue.hpp"
+#include "irods/private/s3_transport/delete_queue.hpp"
+#include "irods/private/s3_transport/pack_store.hpp"
+#include "irods/private/s3_transport/library_lifecycle.hpp"
 #include "irods/private/s3_transport/logging_category.hpp"
 #include "irods/private/s3_transport/s3_transport.hpp"
 
@@ -44,6 +55,11 @@
 #include <tuple>
 #include <random>
 #include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 
 // =-=-=-=-=-=-=-
 // boost includes
@@ -58,6 +74,7 @@
 // =-=-=-=-=-=-=-
 // system includes
 #include <openssl/md5.h>
+#include <openssl/evp.h>
 #ifndef _WIN32
 #include <sys/file.h>
 #include <sys/param.h>
@@ -87,6 +104,7 @@
 #include <sys/stat.h>
 
 #include <chrono>
+#include <mutex>
 #include <thread>
 
 // =-=-=-=-=-=-=-
@@ -115,15 +133,26 @@ static const std::int64_t g_merr_idx{4}; // Which part of Multipart Finish XML t
 #endif
 
 using s3_logger = irods::experimental::log::logger<s3_plugin_logging_category>;
+using endpoint_balancer = irods::experimental::io::s3_transport::endpoint_balancer;
+using admission_controller = irods::experimental::io::s3_transport::admission_controller;
+using retry_budget = irods::experimental::io::s3_transport::retry_budget;
+using hedge_controller = irods::experimental::io::s3_transport::hedge_controller;
+using rate_limiter = irods::experimental::io::s3_transport::rate_limiter;
+using delete_batcher = irods::experimental::io::s3_transport::delete_batcher;
+using delete_queue = irods::experimental::io::s3_transport::delete_queue;
+using pack_store = irods::experimental::io::s3_transport::pack_store;
+using content_release_queue = irods::experimental::io::s3_transport::content_release_queue;
+using library_lifecycle = irods::experimental::io::s3_transport::library_lifecycle;
+using retry_policy = irods::experimental::io::s3_transport::retry_policy;
+using endpoint_request = irods::experimental::io::s3_transport::endpoint_request;
+using compressed_object = irods::experimental::io::s3_transport::compressed_object;
+using irods::experimental::io::s3_transport::compressed_object_from_meta_data;
 
 //////////////////////////////////////////////////////////////////////
 // s3 specific functionality
-static bool S3Initialized = false; // so we only initialize the s3 library once
-static boost::mutex g_hostnameIdxLock;
 
 const std::string  s3_default_hostname{"S3_DEFAULT_HOSTNAME"};
 const std::string  s3_default_hostname_vector{"S3_DEFAULT_HOSTNAME_VECTOR"};
-const std::string  s3_hostname_index{"S3_HOSTNAME_INDEX"};
 const std::string  host_mode{"HOST_MODE"};
 const std::string  s3_auth_file{"S3_AUTH_FILE"};
 const std::string  s3_key_id{"S3_ACCESS_KEY_ID"};
@@ -131,8 +160,10 @@ const std::string  s3_access_key{"S3_SECRET_ACCESS_KEY"};
 const std::string  s3_retry_count{"S3_RETRY_COUNT"};
 const std::string  s3_wait_time_seconds{"S3_WAIT_TIME_SECONDS"};
 const std::string  s3_wait_time_sec{"S3_WAIT_TIME_SEC"};                 // being deprecated
+const std::string  s3_wait_time_milliseconds{"S3_WAIT_TIME_MILLISECONDS"};
 const std::string  s3_max_wait_time_seconds{"S3_MAX_WAIT_TIME_SECONDS"};
 const std::string  s3_max_wait_time_sec{"S3_MAX_WAIT_TIME_SEC"};     // being deprecated
+const std::string  s3_retry_budget{"S3_RETRY_BUDGET"};
 const std::string  s3_proto{"S3_PROTO"};
 const std::string  s3_stsdate{"S3_STSDATE"};
 const std::string  s3_max_upload_size{"S3_MAX_UPLOAD_SIZE"};
@@ -140,6 +171,9 @@ const std::string  s3_max_upload_size_mb{"S3_MAX_UPLOAD_SIZE_MB"};
 const std::string  s3_enable_mpu{"S3_ENABLE_MPU"};
 const std::string  s3_mpu_chunk{"S3_MPU_CHUNK"};
 const std::string  s3_mpu_threads{"S3_MPU_THREADS"};
+const std::string  s3_mpu_copy_threshold_mb{"S3_MPU_COPY_THRESHOLD_MB"};
+const std::string  s3_mpu_copy_chunk{"S3_MPU_COPY_CHUNK"};
+const std::string  s3_mpu_copy_threads{"S3_MPU_COPY_THREADS"};
 const std::string  s3_enable_md5{"S3_ENABLE_MD5"};
 const std::string  s3_server_encrypt{"S3_SERVER_ENCRYPT"};
 const std::string  s3_region_name{"S3_REGIONNAME"};
@@ -155,17 +189,53 @@ const std::string  s3_enable_copyobject{"S3_ENABLE_COPYOBJECT"};       //  If se
 const std::string  s3_non_data_transfer_timeout_seconds{"S3_NON_DATA_TRANSFER_TIMEOUT_SECONDS"};
 const std::string  enable_direct_checksum_read("ENABLE_DIRECT_CHECKSUM_READ");
 const std::string  enable_trailing_checksum_on_upload("ENABLE_TRAILING_CHECKSUM_ON_UPLOAD");
+const std::string  s3_adaptive_concurrency{"S3_ADAPTIVE_CONCURRENCY"};
+const std::string  s3_adaptive_concurrency_max_in_flight{"S3_ADAPTIVE_CONCURRENCY_MAX_IN_FLIGHT"};
+const std::string  s3_hedged_reads{"S3_HEDGED_READS"};
+const std::string  s3_hedged_reads_percentile{"S3_HEDGED_READS_PERCENTILE"};
+const std::string  s3_hedged_reads_max_percent{"S3_HEDGED_READS_MAX_PERCENT"};
+const std::string  s3_max_bytes_per_second{"S3_MAX_BYTES_PER_SECOND"};                      // 0 is unlimited
+const std::string  s3_max_requests_per_second{"S3_MAX_REQUESTS_PER_SECOND"};                // 0 is unlimited
+const std::string  s3_max_bytes_per_second_per_user{"S3_MAX_BYTES_PER_SECOND_PER_USER"};    // 0 is unlimited
+const std::string  s3_max_requests_per_second_per_user{"S3_MAX_REQUESTS_PER_SECOND_PER_USER"};  // 0 is unlimited
+const std::string  s3_listing_shards{"S3_LISTING_SHARDS"};
+const std::string  s3_bulk_delete{"S3_BULK_DELETE"};                                        // 0 or 1 - default 0
+const std::string  s3_bulk_delete_batch_size{"S3_BULK_DELETE_BATCH_SIZE"};
+const std::string  s3_bulk_delete_max_delay_ms{"S3_BULK_DELETE_MAX_DELAY_MILLISECONDS"};
+const std::string  s3_deferred_delete{"S3_DEFERRED_DELETE"};                                // 0 or 1 - default 0
+const std::string  s3_deferred_delete_threads{"S3_DEFERRED_DELETE_THREADS"};
+const std::string  s3_server_side_replication{"S3_SERVER_SIDE_REPLICATION"};              // 0 or 1 - default 1
+const std::string  s3_resumable_uploads{"S3_RESUMABLE_UPLOADS"};                          // 0 or 1 - default 0
+const std::string  s3_stale_upload_age_seconds{"S3_STALE_UPLOAD_AGE_SECONDS"};
+const std::string  s3_partial_overwrite{"S3_PARTIAL_OVERWRITE"};                          // 0 or 1 - default 0
+const std::string  s3_server_side_append{"S3_SERVER_SIDE_APPEND"};                        // 0 or 1 - default 0
+const std::string  s3_pack_small_objects{"S3_PACK_SMALL_OBJECTS"};                        // 0 or 1 - default 0
+const std::string  s3_pack_member_maximum_size{"S3_PACK_MEMBER_MAXIMUM_SIZE"};
+const std::string  s3_pack_size_mb{"S3_PACK_SIZE_MB"};
+const std::string  s3_pack_maximum_age_seconds{"S3_PACK_MAXIMUM_AGE_SECONDS"};
+const std::string  s3_pack_compaction_percent{"S3_PACK_COMPACTION_PERCENT"};
+const std::string  s3_compression{"S3_COMPRESSION"};                                      // none or zstd - default none
+const std::string  s3_compression_level{"S3_COMPRESSION_LEVEL"};
+const std::string  s3_content_addressed_naming{"S3_CONTENT_ADDRESSED_NAMING"};            // 0 or 1 - default 0
+const std::string  s3_memory_staging_size_mb{"S3_MEMORY_STAGING_SIZE_MB"};                // 0 is disabled - default 0
+const std::string  s3_memory_staging_dir{"S3_MEMORY_STAGING_DIR"};
 
 const std::string  s3_number_of_threads{"S3_NUMBER_OF_THREADS"};        //  to save number of threads
 const std::size_t  S3_DEFAULT_RETRY_WAIT_SECONDS = 2;
+const std::size_t  S3_DEFAULT_RETRY_WAIT_MILLISECONDS = S3_DEFAULT_RETRY_WAIT_SECONDS * 1000;
 const std::size_t  S3_DEFAULT_MAX_RETRY_WAIT_SECONDS = 30;
 const std::size_t  S3_DEFAULT_RETRY_COUNT = 3;
+const unsigned int S3_DEFAULT_LISTING_SHARDS = 1;
+const unsigned int S3_MAXIMUM_LISTING_SHARDS = 64;
 const int          S3_DEFAULT_CIRCULAR_BUFFER_SIZE = 4;
 const unsigned int S3_DEFAULT_CIRCULAR_BUFFER_TIMEOUT_SECONDS = 180;
 const unsigned int S3_DEFAULT_NON_DATA_TRANSFER_TIMEOUT_SECONDS = 300;
 constexpr int64_t  LOWER_BOUND_MAX_UPLOAD_SIZE_MB = 5;
 constexpr int64_t  UPPER_BOUND_MAX_UPLOAD_SIZE_MB = 5 * 1024 * 1024;
 constexpr int64_t  DEFAULT_MAX_UPLOAD_SIZE_MB = 5 * 1024;
+constexpr int64_t  DEFAULT_MPU_COPY_THRESHOLD_MB = 256;
+constexpr int64_t  DEFAULT_MPU_COPY_CHUNK_MB = 64;
+constexpr int64_t  MAXIMUM_NUMBER_OF_PARTS = 10000;
 
 const std::string  S3_STORAGE_CLASS_KW{"S3_STORAGE_CLASS"};
 
@@ -284,24 +354,21 @@ static std::uint64_t usNow() {
     return us;
 }
 
-// Increment through all specified hostnames in the list, locking in the case
-// where we may be multithreaded
+// Pick the hostname for the next request from the hosts in S3_DEFAULT_HOSTNAME.
+// The endpoint balancer for the resource prefers the least loaded healthy host.
+// Requests against the host should be wrapped in an endpoint_request so that the
+// balancer learns the latency and failures of each host.
 std::string s3GetHostname(irods::plugin_property_map& _prop_map)
 {
-    std::vector<std::string> hostname_vector;
-    std::size_t hostname_index = 0;
-    g_hostnameIdxLock.lock();
-    _prop_map.get<std::vector<std::string> >(s3_default_hostname_vector, hostname_vector);
-    _prop_map.get<std::size_t>(s3_hostname_index, hostname_index);
-    if (hostname_vector.empty()) {
-        return {}; // Short-circuit default case
-    }
-
-    std::string ret = hostname_vector[hostname_index];
-    hostname_index = (hostname_index+ 1) % hostname_vector.size();
-    _prop_map.set<std::size_t>(s3_hostname_index, hostname_index);
-    g_hostnameIdxLock.unlock();
-    return ret;
+    return endpoint_balancer::for_resource(get_resource_name(_prop_map)).select_host();
+}
+
+// Pick the hostname for a request that is not wrapped in an endpoint_request, or for
+// a default that is replaced for each request.  Unlike s3GetHostname this never hands
+// out the probe of an ejected host, which would otherwise stay claimed until it times out.
+std::string s3GetCurrentHostname(irods::plugin_property_map& _prop_map)
+{
+    return endpoint_balancer::for_resource(get_resource_name(_prop_map)).current_host();
 }
 
 
@@ -379,6 +446,13 @@ S3Status responsePropertiesCallback(
        data->x_amz_restore = properties->xAmzRestore;
     }
 
+    // user metadata, e.g. describing the compression of the object
+    for (int i = 0; i < properties->metaDataCount; ++i) {
+        if (properties->metaData[i].name && properties->metaData[i].value) {
+            data->meta_data[properties->metaData[i].name] = properties->metaData[i].value;
+        }
+    }
+
     return S3StatusOK;
 }
 
@@ -389,13 +463,20 @@ static S3Status getObjectDataCallback(
 {
     callback_data_t *cb = (callback_data_t *)callbackData;
     irods::plugin_property_map *prop_map_ptr = cb ? cb->prop_map_ptr : nullptr;
-    std::string resource_name = prop_map_ptr != nullptr ? get_resource_name(*prop_map_ptr) : "";
 
     if (0 == bufferSize || !buffer || !callbackData) {
+        std::string resource_name = prop_map_ptr != nullptr ? get_resource_name(*prop_map_ptr) : "";
         auto msg = fmt::format("[resource_name={}] Invalid input parameter.", resource_name);
         s3_logger::error(ERROR(SYS_INVALID_INPUT_PARAM, msg).result());
     }
 
+    if (cb && prop_map_ptr) {
+        if (!cb->limiter) {
+            cb->limiter = &rate_limiter::for_resource(get_resource_name(*prop_map_ptr));
+        }
+        cb->limiter->acquire_transfer_bytes(bufferSize, cb->user_name);
+    }
+
     ssize_t wrote = pwrite(cb->fd, buffer, bufferSize, cb->offset);
     if (wrote>0) cb->offset += wrote;
 
@@ -430,6 +511,13 @@ static int putObjectDataCallback(
     data->contentLength -= ret;
     data->offset += ret;
 
+    if (ret > 0 && data->prop_map_ptr) {
+        if (!data->limiter) {
+            data->limiter = &rate_limiter::for_resource(get_resource_name(*data->prop_map_ptr));
+        }
+        data->limiter->acquire_transfer_bytes(ret, data->user_name);
+    }
+
 #ifdef ERROR_INJECT
     g_error_mutex.lock();
     g_rerr++;
@@ -598,9 +686,6 @@ irods::error s3Init (
     irods::plugin_property_map& _prop_map ) {
 
     std::vector<std::string> hostname_vector;
-    std::size_t hostname_index = 0;
-
-    g_hostnameIdxLock.lock();
 
     // First, parse the default hostname (if present) into a list of
     // hostnames separated on the definition line by commas (,)
@@ -618,25 +703,95 @@ irods::error s3Init (
         while (std::getline(ss, item, ',')) {
             hostname_vector.push_back(item);
         }
-        // Because each resource operation is a new instance, randomize the starting
-        // hostname offset so we don't always hit the first in the list between different
-        // operations.
-        srand(time(NULL));
-        hostname_index = rand() % hostname_vector.size();
+        // Because each agent starts with no statistics, shuffle the hosts so that
+        // agents starting at the same time don't all hit the first in the list.
+        std::shuffle(hostname_vector.begin(), hostname_vector.end(), std::default_random_engine{std::random_device{}()});
     }
 
     _prop_map.set<std::vector<std::string> >(s3_default_hostname_vector, hostname_vector);
-    _prop_map.set<std::size_t>(s3_hostname_index, hostname_index);
 
-    g_hostnameIdxLock.unlock();
+    std::string resource_name = get_resource_name(_prop_map);
+    endpoint_balancer::for_resource(resource_name).set_hosts(hostname_vector);
+    admission_controller::for_resource(resource_name).configure(
+            s3_adaptive_concurrency_enabled(_prop_map),
+            get_adaptive_concurrency_max_in_flight(_prop_map));
+    retry_budget::for_resource(resource_name).configure(get_retry_budget_tokens(_prop_map));
+    hedge_controller::for_resource(resource_name).configure(
+            s3_hedged_reads_enabled(_prop_map),
+            get_hedged_reads_percentile(_prop_map),
+            get_hedged_reads_max_percent(_prop_map) / 100.0);
+    rate_limiter::for_resource(resource_name).configure(
+            get_rate_limit(_prop_map, s3_max_bytes_per_second),
+            get_rate_limit(_prop_map, s3_max_requests_per_second),
+            get_rate_limit(_prop_map, s3_max_bytes_per_second_per_user),
+            get_rate_limit(_prop_map, s3_max_requests_per_second_per_user));
+    delete_batcher::for_resource(resource_name).configure(
+            s3_bulk_delete_enabled(_prop_map),
+            get_bulk_delete_batch_size(_prop_map),
+            std::chrono::milliseconds{get_bulk_delete_max_delay_ms(_prop_map)});
+    delete_queue::for_resource(resource_name).configure(
+            s3_deferred_delete_enabled(_prop_map),
+            get_cache_directory(_prop_map),
+            get_deferred_delete_threads(_prop_map));
+
+    // packs are built in the cache directory of the server hosting the resource
+    // and their members are named when the replicas are created
+    bool pack_small_objects = s3_pack_small_objects_enabled(_prop_map);
+    if (pack_small_objects) {
+        auto [cacheless_mode, attached_mode] = get_modes_from_properties(_prop_map);
+        std::string archive_naming_policy = CONSISTENT_NAMING;
+        _prop_map.get<std::string>(ARCHIVE_NAMING_POLICY_KW, archive_naming_policy);
+        if (!cacheless_mode || !attached_mode || !boost::iequals(archive_naming_policy, DECOUPLED_NAMING)) {
+            s3_logger::warn("[resource_name={}] {} requires HOST_MODE=cacheless_attached and {}={}. "
+                    "Small objects are not packed.", resource_name, s3_pack_small_objects,
+                    ARCHIVE_NAMING_POLICY_KW, DECOUPLED_NAMING);
+            pack_small_objects = false;
+        }
+    }
+    pack_store::for_resource(resource_name).configure(
+            pack_small_objects,
+            get_cache_directory(_prop_map),
+            get_pack_member_maximum_size(_prop_map),
+            get_pack_size_mb(_prop_map) * 1024 * 1024,
+            std::chrono::seconds{get_pack_maximum_age_seconds(_prop_map)},
+            get_pack_compaction_percent(_prop_map));
+
+    // the objects named by their contents that no replica refers to are
+    // deleted through a queue in the cache directory
+    content_release_queue::for_resource(resource_name).configure(get_cache_directory(_prop_map));
+
+    // objects are named by their contents when the cache of a compound
+    // resource is synchronized to them, the replicas of cacheless resources
+    // are written before their contents are known
+    if (s3_content_addressed_naming_enabled(_prop_map)) {
+        std::string archive_naming_policy = CONSISTENT_NAMING;
+        _prop_map.get<std::string>(ARCHIVE_NAMING_POLICY_KW, archive_naming_policy);
+        if (std::get<0>(get_modes_from_properties(_prop_map)) || !boost::iequals(archive_naming_policy, DECOUPLED_NAMING)) {
+            s3_logger::warn("[resource_name={}] {} requires HOST_MODE=archive_attached and {}={}. "
+                    "Objects are not named by their contents.", resource_name, s3_content_addressed_naming,
+                    ARCHIVE_NAMING_POLICY_KW, DECOUPLED_NAMING);
+        }
+    }
+
+    // objects are compressed when the cache of a compound resource is
+    // synchronized to them, there is no cache file to compress otherwise
+    if (s3_compression_enabled(_prop_map) && std::get<0>(get_modes_from_properties(_prop_map))) {
+        s3_logger::warn("[resource_name={}] {} has no effect with HOST_MODE=cacheless_attached or cacheless_detached. "
+                "Objects are not compressed.", resource_name, s3_compression);
+    }
 
     return SUCCESS();
 }
 
-// initialization done on every operation
+// initialization done on every operation.  The library is initialized when the
+// resource starts so this only has work to do if that failed.
 irods::error s3InitPerOperation (
     irods::plugin_property_map& _prop_map ) {
 
+    if (library_lifecycle::initialized()) {
+        return SUCCESS();
+    }
+
     std::string resource_name = get_resource_name(_prop_map);
 
     std::size_t retry_count = S3_DEFAULT_RETRY_COUNT;
@@ -648,11 +803,9 @@ irods::error s3InitPerOperation (
     std::size_t ctr = 0;
     while( ctr < retry_count ) {
         S3Status status;
-        int flags = S3_INIT_ALL;
 
-        std::string&& hostname = s3GetHostname(_prop_map);
-        const char* host_name = hostname.c_str(); // Iterate through on each try
-        status = S3_initialize( "s3", flags, host_name );
+        std::string&& hostname = s3GetCurrentHostname(_prop_map);
+        status = library_lifecycle::initialize(hostname);
 
         auto msg = fmt::format("[resource_name={}]  - Error initializing the S3 library. Status = {}.",
                 resource_name, status);
@@ -809,6 +962,62 @@ ssize_t s3GetMPUThreads (
     return threads;
 }
 
+// Objects at least this large are renamed with a parallel multipart copy.
+std::int64_t s3GetMPUCopyThreshold (irods::plugin_property_map& _prop_map)
+{
+    irods::error ret;
+    std::string threshold_str;
+    std::int64_t bytes = DEFAULT_MPU_COPY_THRESHOLD_MB * 1024 * 1024;
+    ret = _prop_map.get< std::string >(s3_mpu_copy_threshold_mb, threshold_str );
+
+    if (ret.ok()) {
+        std::int64_t megs = std::atol(threshold_str.c_str());
+        if ( megs >= 5 && megs <= s3GetMaxUploadSizeMB(_prop_map) )
+            bytes = megs * 1024 * 1024;
+    }
+    return bytes;
+}
+
+// The part size of a multipart copy of an object of _object_size bytes.  The
+// configured size is increased if the copy would have too many parts.
+std::int64_t s3GetMPUCopyChunksize (irods::plugin_property_map& _prop_map, std::int64_t _object_size)
+{
+    irods::error ret;
+    std::string chunk_str;
+    std::int64_t bytes = DEFAULT_MPU_COPY_CHUNK_MB * 1024 * 1024;
+    ret = _prop_map.get< std::string >(s3_mpu_copy_chunk, chunk_str );
+
+    if (ret.ok()) {
+        std::int64_t megs = std::atol(chunk_str.c_str());
+        if ( megs >= 5 && megs <= s3GetMaxUploadSizeMB(_prop_map) )
+            bytes = megs * 1024 * 1024;
+    }
+
+    const std::int64_t megabyte = 1024 * 1024;
+    const std::int64_t smallest = (_object_size + MAXIMUM_NUMBER_OF_PARTS - 1) / MAXIMUM_NUMBER_OF_PARTS;
+    if (bytes < smallest) {
+        bytes = (smallest + megabyte - 1) / megabyte * megabyte;
+    }
+    return bytes;
+}
+
+ssize_t s3GetMPUCopyThreads (
+    irods::plugin_property_map& _prop_map )
+{
+    irods::error ret;
+    std::string threads_str;
+    int threads = 10; // 10 copy threads by default
+    ret = _prop_map.get< std::string >(
+        s3_mpu_copy_threads,
+        threads_str );
+    if (ret.ok()) {
+        int parse = std::atol(threads_str.c_str());
+        if ( (parse >= 1) && (parse <= 100) )
+            threads = parse;
+    }
+    return threads;
+}
+
 bool s3GetEnableMultiPartUpload (
     irods::plugin_property_map& _prop_map )
 {
@@ -899,9 +1108,6 @@ static void mrdWorkerThread (
 
     S3GetObjectHandler getObjectHandler = { {mrdRangeRespPropCB, mrdRangeRespCompCB }, mrdRangeGetDataCB };
 
-    std::size_t retry_count_limit = get_retry_count(_prop_map);
-    std::size_t retry_wait = get_retry_wait_time_sec(_prop_map);
-    std::size_t max_retry_wait = get_max_retry_wait_time_sec(_prop_map);
 
     /* Will break out when no work detected */
     while (1) {
@@ -921,7 +1127,7 @@ static void mrdWorkerThread (
         g_mrdNext = g_mrdNext + 1;
         g_mrdLock.unlock();
 
-        std::size_t retry_cnt = 0;
+        auto retry = make_retry_policy(_prop_map);
         multirange_data_t rangeData;
         do {
             // Work on a local copy of the structure in case an error occurs in the middle
@@ -941,20 +1147,15 @@ static void mrdWorkerThread (
             std::uint64_t usStart = usNow();
             std::string&& hostname = s3GetHostname(_prop_map);
             bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+            endpoint_request endpoint{resource_name, hostname};
             S3_get_object( &bucketContext, g_mrdKey, NULL, rangeData.get_object_data.offset,
                            rangeData.get_object_data.contentLength, 0, 0, &getObjectHandler, &rangeData );
+            endpoint.finish(rangeData.status, rangeData.get_object_data.contentLength);
             std::uint64_t usEnd = usNow();
             double bw = (g_mrdData[seq-1].get_object_data.contentLength / (1024.0*1024.0)) / ( (usEnd - usStart) / 1000000.0 );
 
             s3_logger::debug(" -- END -- BW={} MB/s", bw);
-            if (rangeData.status != S3StatusOK) {
-                s3_sleep( retry_wait );
-                retry_wait *= 2;
-                if (retry_wait > max_retry_wait) {
-                    retry_wait = max_retry_wait;
-                }
-            }
-        } while ((rangeData.status != S3StatusOK) && S3_status_is_retryable(rangeData.status) && (++retry_cnt <= retry_count_limit));
+        } while (retry.should_retry(rangeData.status));
         if (rangeData.status != S3StatusOK) {
 
             auto msg = fmt::format("[resource_name={}] {} - Error getting the S3 object: \"{}\" range {}",
@@ -1043,80 +1244,926 @@ std::size_t get_retry_wait_time_sec(irods::plugin_property_map& _prop_map) {
             }
         }
     }
-
-    return retry_wait;
+
+    return retry_wait;
+}
+
+// The initial wait between retries in milliseconds.  S3_WAIT_TIME_MILLISECONDS
+// takes priority over S3_WAIT_TIME_SECONDS.  If neither is set the default is
+// S3_DEFAULT_RETRY_WAIT_MILLISECONDS.
+std::size_t get_retry_wait_time_ms(irods::plugin_property_map& _prop_map) {
+
+    std::size_t retry_wait_ms = S3_DEFAULT_RETRY_WAIT_MILLISECONDS;
+    std::string wait_time_str;
+    irods::error ret = _prop_map.get< std::string >( s3_wait_time_milliseconds, wait_time_str );
+    if( ret.ok() ) {
+        try {
+            return boost::lexical_cast<std::size_t>( wait_time_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
+                s3_wait_time_milliseconds.c_str(), wait_time_str.c_str() );
+        }
+    }
+
+    if ( _prop_map.get< std::string >( s3_wait_time_seconds, wait_time_str ).ok() ||
+            _prop_map.get< std::string >( s3_wait_time_sec, wait_time_str ).ok() ) {
+        retry_wait_ms = get_retry_wait_time_sec(_prop_map) * 1000;
+    }
+
+    return retry_wait_ms;
+}
+
+std::size_t get_max_retry_wait_time_sec(irods::plugin_property_map& _prop_map) {
+
+    std::size_t max_retry_wait = S3_DEFAULT_MAX_RETRY_WAIT_SECONDS;
+    std::string max_retry_wait_str;
+    irods::error ret = _prop_map.get< std::string >( s3_max_wait_time_seconds, max_retry_wait_str );
+    if( ret.ok() ) {
+        try {
+            max_retry_wait = boost::lexical_cast<std::size_t>( max_retry_wait_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
+                s3_max_wait_time_seconds.c_str(), max_retry_wait_str.c_str() );
+        }
+    } else {
+        // for backward compatibility, look for S3_MAX_WAIT_TIME_SEC
+        irods::error ret = _prop_map.get< std::string >( s3_max_wait_time_sec, max_retry_wait_str );
+        std::string resource_name = get_resource_name(_prop_map);
+        if( ret.ok() ) {
+            s3_logger::warn("[resource_name={} - {} is being deprecated.  Use {}",
+                        resource_name, s3_max_wait_time_sec, s3_max_wait_time_seconds);
+            try {
+                max_retry_wait = boost::lexical_cast<std::size_t>( max_retry_wait_str );
+            } catch ( const boost::bad_lexical_cast& ) {
+                s3_logger::error(
+                    "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
+                    s3_max_wait_time_sec.c_str(), max_retry_wait_str.c_str() );
+            }
+        }
+    }
+    return max_retry_wait;
+}
+
+std::size_t get_retry_count(irods::plugin_property_map& _prop_map) {
+
+    std::size_t retry_count = S3_DEFAULT_RETRY_COUNT;
+
+    std::string retry_count_str;
+    irods::error ret = _prop_map.get< std::string >( s3_retry_count, retry_count_str );
+    if( ret.ok() ) {
+        try {
+            retry_count = boost::lexical_cast<std::size_t>( retry_count_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
+                s3_retry_count.c_str(), retry_count_str.c_str() );
+        }
+    }
+
+    return retry_count;
+}
+
+unsigned int get_retry_budget_tokens(irods::plugin_property_map& _prop_map) {
+
+    unsigned int retry_budget_tokens = retry_budget::DEFAULT_MAXIMUM_TOKENS;
+    std::string retry_budget_str;
+    irods::error ret = _prop_map.get< std::string >( s3_retry_budget, retry_budget_str );
+    if( ret.ok() ) {
+        try {
+            retry_budget_tokens = boost::lexical_cast<unsigned int>( retry_budget_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_retry_budget.c_str(), retry_budget_str.c_str() );
+        }
+    }
+
+    return retry_budget_tokens;
+}
+
+// Returns the retry policy used for the attempts of one request.
+retry_policy make_retry_policy(
+        irods::plugin_property_map& _prop_map,
+        retry_policy::retryable_predicate _is_retryable) {
+    const auto settings = get_resource_settings(_prop_map);
+    return retry_policy{settings->resource_name,
+                        settings->retry_count,
+                        std::chrono::milliseconds{settings->retry_wait_time_ms},
+                        std::chrono::seconds{settings->max_retry_wait_time_sec},
+                        _is_retryable};
+}
+
+s3_resource_settings make_resource_settings(irods::plugin_property_map& _prop_map) {
+
+    s3_resource_settings settings;
+
+    settings.resource_name = get_resource_name(_prop_map);
+    std::tie(settings.cacheless_mode, settings.attached_mode) = get_modes_from_properties(_prop_map);
+
+    // the credentials are not available before the auth file is read
+    settings.credentials_read = s3GetAuthCredentials(_prop_map, settings.access_key_id, settings.secret_access_key).ok();
+    if (!settings.credentials_read) {
+        settings.access_key_id.clear();
+        settings.secret_access_key.clear();
+    }
+
+    settings.protocol = s3GetProto(_prop_map);
+    if (!_prop_map.get<std::string>(s3_proto, settings.protocol_str).ok()) {
+        settings.protocol_str = "https";
+    }
+    settings.sts_date = s3GetSTSDate(_prop_map);
+    settings.uri_style = s3_get_uri_request_style(_prop_map);
+    settings.region_name = get_region_name(_prop_map);
+    settings.cache_directory = get_cache_directory(_prop_map);
+
+    settings.multipart_enabled = s3GetEnableMultiPartUpload(_prop_map);
+    settings.mpu_chunk_size = s3GetMPUChunksize(_prop_map);
+    settings.mpu_threads = s3GetMPUThreads(_prop_map);
+    settings.max_upload_size_mb = s3GetMaxUploadSizeMB(_prop_map);
+
+    // the circular buffer holds at least two parts
+    settings.circular_buffer_size = S3_DEFAULT_CIRCULAR_BUFFER_SIZE;
+    std::string circular_buffer_size_str;
+    if (_prop_map.get<std::string>(s3_circular_buffer_size, circular_buffer_size_str).ok()) {
+        try {
+            settings.circular_buffer_size = boost::lexical_cast<unsigned int>(circular_buffer_size_str);
+        } catch (const boost::bad_lexical_cast&) {
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. Defaulting to {}.",
+                    settings.resource_name, s3_circular_buffer_size, circular_buffer_size_str, S3_DEFAULT_CIRCULAR_BUFFER_SIZE);
+        }
+    }
+    settings.circular_buffer_size = std::max(settings.circular_buffer_size, 2u);
+
+    settings.circular_buffer_timeout_seconds = S3_DEFAULT_CIRCULAR_BUFFER_TIMEOUT_SECONDS;
+    std::string circular_buffer_timeout_seconds_str;
+    if (_prop_map.get<std::string>(s3_circular_buffer_timeout_seconds, circular_buffer_timeout_seconds_str).ok()) {
+        try {
+            settings.circular_buffer_timeout_seconds = boost::lexical_cast<unsigned int>(circular_buffer_timeout_seconds_str);
+        } catch (const boost::bad_lexical_cast&) {
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. Defaulting to {}.",
+                    settings.resource_name, s3_circular_buffer_timeout_seconds, circular_buffer_timeout_seconds_str,
+                    S3_DEFAULT_CIRCULAR_BUFFER_TIMEOUT_SECONDS);
+        }
+    }
+
+    settings.server_encrypt = s3GetServerEncrypt(_prop_map);
+    settings.storage_class = s3_get_storage_class_from_configuration(_prop_map);
+    settings.restoration_days = s3_get_restoration_days(_prop_map);
+    settings.restoration_tier = s3_get_restoration_tier(_prop_map);
+
+    settings.retry_count = get_retry_count(_prop_map);
+    settings.retry_wait_time_ms = get_retry_wait_time_ms(_prop_map);
+    settings.max_retry_wait_time_sec = get_max_retry_wait_time_sec(_prop_map);
+    settings.non_data_transfer_timeout_seconds = get_non_data_transfer_timeout_seconds(_prop_map);
+    settings.trailing_checksum_on_upload = s3_trailing_checksum_on_upload_enabled(_prop_map);
+    settings.resumable_uploads = s3_resumable_uploads_enabled(_prop_map);
+    settings.stale_upload_age_seconds = get_stale_upload_age_seconds(_prop_map);
+    settings.partial_overwrite = s3_partial_overwrite_enabled(_prop_map);
+    settings.server_side_append = s3_server_side_append_enabled(_prop_map);
+    settings.memory_staging_size_mb = get_memory_staging_size_mb(_prop_map);
+    settings.memory_staging_directory = get_memory_staging_directory(_prop_map);
+
+    return settings;
+}
+
+namespace {
+    using settings_by_resource = std::map<std::string, std::shared_ptr<const s3_resource_settings>>;
+
+    // The settings of every started resource of the agent.  The map is never changed once
+    // published, readers load it atomically without a lock.  Writers, which only run when a
+    // resource starts, copy it under resource_settings_mutex and publish the copy.
+    std::shared_ptr<const settings_by_resource> published_settings{std::make_shared<const settings_by_resource>()};
+
+    // The property map is not thread safe.  Serializes the writers, and guards the
+    // properties while the settings are built from them.
+    std::mutex resource_settings_mutex;
+
+    std::shared_ptr<const s3_resource_settings> find_published_settings(const std::string& _resource_name) {
+        const auto settings = std::atomic_load(&published_settings);
+        const auto iter = settings->find(_resource_name);
+        return iter == settings->end() ? nullptr : iter->second;
+    }
+
+    // resource_settings_mutex must be held
+    void publish_settings(std::shared_ptr<const s3_resource_settings> _settings) {
+        auto settings = std::make_shared<settings_by_resource>(*std::atomic_load(&published_settings));
+        (*settings)[_settings->resource_name] = std::move(_settings);
+        std::atomic_store(&published_settings, std::shared_ptr<const settings_by_resource>{std::move(settings)});
+    }
+}
+
+void update_resource_settings(irods::plugin_property_map& _prop_map) {
+    std::lock_guard<std::mutex> lock(resource_settings_mutex);
+    publish_settings(std::make_shared<const s3_resource_settings>(make_resource_settings(_prop_map)));
+}
+
+std::shared_ptr<const s3_resource_settings> get_resource_settings(irods::plugin_property_map& _prop_map) {
+
+    const std::string resource_name = get_resource_name(_prop_map);
+    if (auto settings = find_published_settings(resource_name); settings) {
+        return settings;
+    }
+
+    std::lock_guard<std::mutex> lock(resource_settings_mutex);
+
+    // another thread may have published them meanwhile
+    if (auto settings = find_published_settings(resource_name); settings) {
+        return settings;
+    }
+
+    // The resource has not started.  The settings are published only if they are
+    // complete, otherwise the credentials read by the start would never be used.
+    auto settings = std::make_shared<const s3_resource_settings>(make_resource_settings(_prop_map));
+    if (settings->credentials_read) {
+        publish_settings(settings);
+    }
+    return settings;
+}
+
+irods::error check_credentials(const s3_resource_settings& _settings) {
+    if (!_settings.credentials_read) {
+        return ERROR(SYS_INVALID_INPUT_PARAM, fmt::format(
+                    "[resource_name={}] Failed to get the S3 credentials.", _settings.resource_name));
+    }
+    return SUCCESS();
+}
+
+S3BucketContext make_bucket_context(const s3_resource_settings& _settings, const std::string& _bucket_name) {
+    S3BucketContext bucket_context{};
+    bucket_context.bucketName      = _bucket_name.c_str();
+    bucket_context.protocol        = _settings.protocol;
+    bucket_context.stsDate         = _settings.sts_date;
+    bucket_context.uriStyle        = _settings.uri_style;
+    bucket_context.accessKeyId     = _settings.access_key_id.c_str();
+    bucket_context.secretAccessKey = _settings.secret_access_key.c_str();
+    bucket_context.authRegion      = _settings.region_name.c_str();
+    return bucket_context;
+}
+
+pack_store::transfer_settings make_pack_transfer_settings(
+        irods::plugin_property_map& _prop_map,
+        const s3_resource_settings& _settings) {
+
+    static const std::string no_bucket;
+    const S3BucketContext bucket_context = make_bucket_context(_settings, no_bucket);
+
+    S3PutProperties put_properties{};
+    put_properties.expires = -1;
+    put_properties.useServerSideEncryption = _settings.server_encrypt;
+    put_properties.xAmzStorageClass = _settings.storage_class.c_str();
+
+    return pack_store::transfer_settings{
+        bucket_context,
+        put_properties,
+        make_retry_policy(_prop_map),
+        static_cast<int>(_settings.non_data_transfer_timeout_seconds * 1000),
+        _settings.multipart_enabled ? _settings.mpu_chunk_size : _settings.max_upload_size_mb * 1024 * 1024,
+        static_cast<unsigned int>(std::max<ssize_t>(_settings.mpu_threads, 1))};
+}
+
+unsigned int get_non_data_transfer_timeout_seconds(irods::plugin_property_map& _prop_map) {
+
+    unsigned int non_data_transfer_timeout_seconds = S3_DEFAULT_NON_DATA_TRANSFER_TIMEOUT_SECONDS;
+    std::string non_data_transfer_timeout_seconds_str;
+    irods::error ret = _prop_map.get< std::string >( s3_non_data_transfer_timeout_seconds, non_data_transfer_timeout_seconds_str );
+    if( ret.ok() ) {
+        try {
+            non_data_transfer_timeout_seconds = boost::lexical_cast<unsigned int>( non_data_transfer_timeout_seconds_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_non_data_transfer_timeout_seconds.c_str(), non_data_transfer_timeout_seconds_str.c_str() );
+        }
+    }
+
+    return non_data_transfer_timeout_seconds;
+}
+
+unsigned int get_adaptive_concurrency_max_in_flight(irods::plugin_property_map& _prop_map) {
+
+    unsigned int max_in_flight = admission_controller::DEFAULT_MAXIMUM_IN_FLIGHT;
+    std::string max_in_flight_str;
+    irods::error ret = _prop_map.get< std::string >( s3_adaptive_concurrency_max_in_flight, max_in_flight_str );
+    if( ret.ok() ) {
+        try {
+            max_in_flight = boost::lexical_cast<unsigned int>( max_in_flight_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_adaptive_concurrency_max_in_flight.c_str(), max_in_flight_str.c_str() );
+        }
+    }
+
+    return max_in_flight;
+}
+
+double get_hedged_reads_percentile(irods::plugin_property_map& _prop_map) {
+
+    double percentile = hedge_controller::DEFAULT_PERCENTILE;
+    std::string percentile_str;
+    irods::error ret = _prop_map.get< std::string >( s3_hedged_reads_percentile, percentile_str );
+    if( ret.ok() ) {
+        try {
+            percentile = boost::lexical_cast<double>( percentile_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to a double", resource_name.c_str(),
+                s3_hedged_reads_percentile.c_str(), percentile_str.c_str() );
+        }
+
+        if (percentile < 1.0 || percentile > 100.0) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 1 and 100. Defaulting to {}.",
+                    resource_name, s3_hedged_reads_percentile, percentile_str, hedge_controller::DEFAULT_PERCENTILE);
+            percentile = hedge_controller::DEFAULT_PERCENTILE;
+        }
+    }
+
+    return percentile;
+}
+
+double get_hedged_reads_max_percent(irods::plugin_property_map& _prop_map) {
+
+    double max_percent = hedge_controller::DEFAULT_MAXIMUM_HEDGE_RATIO * 100.0;
+    std::string max_percent_str;
+    irods::error ret = _prop_map.get< std::string >( s3_hedged_reads_max_percent, max_percent_str );
+    if( ret.ok() ) {
+        try {
+            max_percent = boost::lexical_cast<double>( max_percent_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to a double", resource_name.c_str(),
+                s3_hedged_reads_max_percent.c_str(), max_percent_str.c_str() );
+        }
+
+        if (max_percent < 0.0 || max_percent > 100.0) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 0 and 100. Defaulting to {}.",
+                    resource_name, s3_hedged_reads_max_percent, max_percent_str, hedge_controller::DEFAULT_MAXIMUM_HEDGE_RATIO * 100.0);
+            max_percent = hedge_controller::DEFAULT_MAXIMUM_HEDGE_RATIO * 100.0;
+        }
+    }
+
+    return max_percent;
+}
+
+unsigned int get_listing_shards(irods::plugin_property_map& _prop_map) {
+
+    unsigned int listing_shards = S3_DEFAULT_LISTING_SHARDS;
+    std::string listing_shards_str;
+    irods::error ret = _prop_map.get< std::string >( s3_listing_shards, listing_shards_str );
+    if( ret.ok() ) {
+        try {
+            listing_shards = boost::lexical_cast<unsigned int>( listing_shards_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_listing_shards.c_str(), listing_shards_str.c_str() );
+        }
+
+        if (listing_shards < 1 || listing_shards > S3_MAXIMUM_LISTING_SHARDS) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 1 and {}. Defaulting to {}.",
+                    resource_name, s3_listing_shards, listing_shards_str, S3_MAXIMUM_LISTING_SHARDS, S3_DEFAULT_LISTING_SHARDS);
+            listing_shards = S3_DEFAULT_LISTING_SHARDS;
+        }
+    }
+
+    return listing_shards;
+}
+
+// S3_BULK_DELETE - default is false
+bool s3_bulk_delete_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_bulk_delete, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_bulk_delete, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+    return enable_flag;
+}
+
+unsigned int get_bulk_delete_batch_size(irods::plugin_property_map& _prop_map) {
+
+    unsigned int batch_size = delete_batcher::DEFAULT_BATCH_SIZE;
+    std::string batch_size_str;
+    irods::error ret = _prop_map.get< std::string >( s3_bulk_delete_batch_size, batch_size_str );
+    if( ret.ok() ) {
+        try {
+            batch_size = boost::lexical_cast<unsigned int>( batch_size_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_bulk_delete_batch_size.c_str(), batch_size_str.c_str() );
+        }
+
+        if (batch_size < 1 || batch_size > S3_MAX_DELETE_OBJECTS_COUNT) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 1 and {}. Defaulting to {}.",
+                    resource_name, s3_bulk_delete_batch_size, batch_size_str, S3_MAX_DELETE_OBJECTS_COUNT, delete_batcher::DEFAULT_BATCH_SIZE);
+            batch_size = delete_batcher::DEFAULT_BATCH_SIZE;
+        }
+    }
+
+    return batch_size;
+}
+
+unsigned int get_bulk_delete_max_delay_ms(irods::plugin_property_map& _prop_map) {
+
+    unsigned int max_delay_ms = delete_batcher::DEFAULT_MAXIMUM_DELAY.count();
+    std::string max_delay_ms_str;
+    irods::error ret = _prop_map.get< std::string >( s3_bulk_delete_max_delay_ms, max_delay_ms_str );
+    if( ret.ok() ) {
+        try {
+            max_delay_ms = boost::lexical_cast<unsigned int>( max_delay_ms_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_bulk_delete_max_delay_ms.c_str(), max_delay_ms_str.c_str() );
+        }
+    }
+
+    return max_delay_ms;
+}
+
+// S3_DEFERRED_DELETE - default is false
+bool s3_deferred_delete_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_deferred_delete, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_deferred_delete, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+    return enable_flag;
+}
+
+unsigned int get_deferred_delete_threads(irods::plugin_property_map& _prop_map) {
+
+    unsigned int number_of_threads = delete_queue::DEFAULT_NUMBER_OF_THREADS;
+    std::string number_of_threads_str;
+    irods::error ret = _prop_map.get< std::string >( s3_deferred_delete_threads, number_of_threads_str );
+    if( ret.ok() ) {
+        try {
+            number_of_threads = boost::lexical_cast<unsigned int>( number_of_threads_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_deferred_delete_threads.c_str(), number_of_threads_str.c_str() );
+        }
+
+        if (number_of_threads < 1) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be at least 1. Defaulting to {}.",
+                    resource_name, s3_deferred_delete_threads, number_of_threads_str, delete_queue::DEFAULT_NUMBER_OF_THREADS);
+            number_of_threads = delete_queue::DEFAULT_NUMBER_OF_THREADS;
+        }
+    }
+
+    return number_of_threads;
+}
+
+bool s3_server_side_replication_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = true;
+
+    irods::error ret = _prop_map.get< std::string >( s3_server_side_replication, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 1.",
+                    resource_name, s3_server_side_replication, enable_str);
+        }
+        else if ("0" == enable_str) {
+            enable_flag = false;
+        }
+    }
+    return enable_flag;
+}
+
+bool s3_resumable_uploads_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_resumable_uploads, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_resumable_uploads, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+    return enable_flag;
+}
+
+std::int64_t get_stale_upload_age_seconds(irods::plugin_property_map& _prop_map) {
+
+    std::int64_t age_seconds = s3_transport::S3_DEFAULT_STALE_UPLOAD_AGE_SECONDS;
+    std::string age_seconds_str;
+    irods::error ret = _prop_map.get< std::string >( s3_stale_upload_age_seconds, age_seconds_str );
+    if( ret.ok() ) {
+        try {
+            age_seconds = boost::lexical_cast<std::int64_t>( age_seconds_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an integer", resource_name.c_str(),
+                s3_stale_upload_age_seconds.c_str(), age_seconds_str.c_str() );
+        }
+
+        if (age_seconds < 1) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be at least 1. Defaulting to {}.",
+                    resource_name, s3_stale_upload_age_seconds, age_seconds_str, s3_transport::S3_DEFAULT_STALE_UPLOAD_AGE_SECONDS);
+            age_seconds = s3_transport::S3_DEFAULT_STALE_UPLOAD_AGE_SECONDS;
+        }
+    }
+
+    return age_seconds;
+}
+
+// S3_PARTIAL_OVERWRITE - default is false, and always false if CopyObject is disabled
+bool s3_partial_overwrite_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_partial_overwrite, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_partial_overwrite, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+
+    // the unchanged parts are copied with UploadPartCopy, which a provider without CopyObject does not support
+    if (enable_flag && s3_copyobject_disabled(_prop_map)) {
+        std::string resource_name = get_resource_name(_prop_map);
+        s3_logger::warn("[resource_name={}] {} is ignored because {} is 0.",
+                resource_name, s3_partial_overwrite, s3_enable_copyobject);
+        enable_flag = false;
+    }
+    return enable_flag;
+}
+
+// S3_SERVER_SIDE_APPEND - default is false, and always false if CopyObject is disabled
+bool s3_server_side_append_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_server_side_append, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_server_side_append, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+
+    // UploadPartCopy is a copy, a provider without CopyObject does not support it either
+    if (enable_flag && s3_copyobject_disabled(_prop_map)) {
+        std::string resource_name = get_resource_name(_prop_map);
+        s3_logger::warn("[resource_name={}] {} is ignored because {} is 0.",
+                resource_name, s3_server_side_append, s3_enable_copyobject);
+        enable_flag = false;
+    }
+    return enable_flag;
+}
+
+// S3_PACK_SMALL_OBJECTS - default is false
+bool s3_pack_small_objects_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_pack_small_objects, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_pack_small_objects, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+    return enable_flag;
+}
+
+std::int64_t get_pack_member_maximum_size(irods::plugin_property_map& _prop_map) {
+
+    std::int64_t maximum_size = pack_store::DEFAULT_MEMBER_MAXIMUM_SIZE;
+    std::string maximum_size_str;
+    irods::error ret = _prop_map.get< std::string >( s3_pack_member_maximum_size, maximum_size_str );
+    if( ret.ok() ) {
+        try {
+            maximum_size = boost::lexical_cast<std::int64_t>( maximum_size_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an integer", resource_name.c_str(),
+                s3_pack_member_maximum_size.c_str(), maximum_size_str.c_str() );
+        }
+
+        if (maximum_size < 1 || maximum_size > pack_store::MEMBER_MAXIMUM_SIZE_LIMIT) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 1 and {}. Defaulting to {}.",
+                    resource_name, s3_pack_member_maximum_size, maximum_size_str, pack_store::MEMBER_MAXIMUM_SIZE_LIMIT,
+                    pack_store::DEFAULT_MEMBER_MAXIMUM_SIZE);
+            maximum_size = pack_store::DEFAULT_MEMBER_MAXIMUM_SIZE;
+        }
+    }
+
+    return maximum_size;
+}
+
+std::int64_t get_pack_size_mb(irods::plugin_property_map& _prop_map) {
+
+    const std::int64_t default_size_mb = pack_store::DEFAULT_PACK_SIZE / (1024 * 1024);
+    std::int64_t size_mb = default_size_mb;
+    std::string size_mb_str;
+    irods::error ret = _prop_map.get< std::string >( s3_pack_size_mb, size_mb_str );
+    if( ret.ok() ) {
+        try {
+            size_mb = boost::lexical_cast<std::int64_t>( size_mb_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an integer", resource_name.c_str(),
+                s3_pack_size_mb.c_str(), size_mb_str.c_str() );
+        }
+
+        if (size_mb < 1) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be at least 1. Defaulting to {}.",
+                    resource_name, s3_pack_size_mb, size_mb_str, default_size_mb);
+            size_mb = default_size_mb;
+        }
+    }
+
+    return size_mb;
+}
+
+std::int64_t get_pack_maximum_age_seconds(irods::plugin_property_map& _prop_map) {
+
+    std::int64_t age_seconds = pack_store::DEFAULT_MAXIMUM_AGE.count();
+    std::string age_seconds_str;
+    irods::error ret = _prop_map.get< std::string >( s3_pack_maximum_age_seconds, age_seconds_str );
+    if( ret.ok() ) {
+        try {
+            age_seconds = boost::lexical_cast<std::int64_t>( age_seconds_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an integer", resource_name.c_str(),
+                s3_pack_maximum_age_seconds.c_str(), age_seconds_str.c_str() );
+        }
+
+        if (age_seconds < 1) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be at least 1. Defaulting to {}.",
+                    resource_name, s3_pack_maximum_age_seconds, age_seconds_str, pack_store::DEFAULT_MAXIMUM_AGE.count());
+            age_seconds = pack_store::DEFAULT_MAXIMUM_AGE.count();
+        }
+    }
+
+    return age_seconds;
+}
+
+unsigned int get_pack_compaction_percent(irods::plugin_property_map& _prop_map) {
+
+    unsigned int percent = pack_store::DEFAULT_COMPACTION_PERCENT;
+    std::string percent_str;
+    irods::error ret = _prop_map.get< std::string >( s3_pack_compaction_percent, percent_str );
+    if( ret.ok() ) {
+        try {
+            percent = boost::lexical_cast<unsigned int>( percent_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
+                s3_pack_compaction_percent.c_str(), percent_str.c_str() );
+        }
+
+        if (percent < 1 || percent > 100) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 1 and 100. Defaulting to {}.",
+                    resource_name, s3_pack_compaction_percent, percent_str, pack_store::DEFAULT_COMPACTION_PERCENT);
+            percent = pack_store::DEFAULT_COMPACTION_PERCENT;
+        }
+    }
+
+    return percent;
+}
+
+// S3_COMPRESSION - default is none
+bool s3_compression_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string codec_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_compression, codec_str );
+    if (ret.ok()) {
+        if (boost::iequals(codec_str, "zstd")) {
+            enable_flag = true;
+        }
+        else if (!boost::iequals(codec_str, "none")) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be none or zstd. Defaulting to none.",
+                    resource_name, s3_compression, codec_str);
+        }
+    }
+    return enable_flag;
+}
+
+int get_compression_level(irods::plugin_property_map& _prop_map) {
+
+    int level = irods::experimental::io::s3_transport::DEFAULT_COMPRESSION_LEVEL;
+    std::string level_str;
+    irods::error ret = _prop_map.get< std::string >( s3_compression_level, level_str );
+    if( ret.ok() ) {
+        try {
+            level = boost::lexical_cast<int>( level_str );
+        } catch ( const boost::bad_lexical_cast& ) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::error(
+                "[resource_name={}] failed to cast {} [{}] to an integer", resource_name.c_str(),
+                s3_compression_level.c_str(), level_str.c_str() );
+        }
+
+        if (level < 1 || level > irods::experimental::io::s3_transport::MAXIMUM_COMPRESSION_LEVEL) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be between 1 and {}. Defaulting to {}.",
+                    resource_name, s3_compression_level, level_str,
+                    irods::experimental::io::s3_transport::MAXIMUM_COMPRESSION_LEVEL,
+                    irods::experimental::io::s3_transport::DEFAULT_COMPRESSION_LEVEL);
+            level = irods::experimental::io::s3_transport::DEFAULT_COMPRESSION_LEVEL;
+        }
+    }
+
+    return level;
+}
+
+// S3_CONTENT_ADDRESSED_NAMING - default is false
+bool s3_content_addressed_naming_enabled(irods::plugin_property_map& _prop_map) {
+
+    std::string enable_str;
+    bool enable_flag = false;
+
+    irods::error ret = _prop_map.get< std::string >( s3_content_addressed_naming, enable_str );
+    if (ret.ok()) {
+        // Only 0 = no, 1 = yes.
+        if ("0" != enable_str && "1" != enable_str) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+                    resource_name, s3_content_addressed_naming, enable_str);
+        }
+        else if ("1" == enable_str) {
+            enable_flag = true;
+        }
+    }
+    return enable_flag;
 }
 
-std::size_t get_max_retry_wait_time_sec(irods::plugin_property_map& _prop_map) {
+std::int64_t get_memory_staging_size_mb(irods::plugin_property_map& _prop_map) {
 
-    std::size_t max_retry_wait = S3_DEFAULT_MAX_RETRY_WAIT_SECONDS;
-    std::string max_retry_wait_str;
-    irods::error ret = _prop_map.get< std::string >( s3_max_wait_time_seconds, max_retry_wait_str );
+    std::int64_t size_mb = 0;
+    std::string size_mb_str;
+    irods::error ret = _prop_map.get< std::string >( s3_memory_staging_size_mb, size_mb_str );
     if( ret.ok() ) {
         try {
-            max_retry_wait = boost::lexical_cast<std::size_t>( max_retry_wait_str );
+            size_mb = boost::lexical_cast<std::int64_t>( size_mb_str );
         } catch ( const boost::bad_lexical_cast& ) {
             std::string resource_name = get_resource_name(_prop_map);
             s3_logger::error(
-                "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
-                s3_max_wait_time_seconds.c_str(), max_retry_wait_str.c_str() );
+                "[resource_name={}] failed to cast {} [{}] to an integer", resource_name.c_str(),
+                s3_memory_staging_size_mb.c_str(), size_mb_str.c_str() );
         }
-    } else {
-        // for backward compatibility, look for S3_MAX_WAIT_TIME_SEC
-        irods::error ret = _prop_map.get< std::string >( s3_max_wait_time_sec, max_retry_wait_str );
-        std::string resource_name = get_resource_name(_prop_map);
-        if( ret.ok() ) {
-            s3_logger::warn("[resource_name={} - {} is being deprecated.  Use {}",
-                        resource_name, s3_max_wait_time_sec, s3_max_wait_time_seconds);
-            try {
-                max_retry_wait = boost::lexical_cast<std::size_t>( max_retry_wait_str );
-            } catch ( const boost::bad_lexical_cast& ) {
-                s3_logger::error(
-                    "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
-                    s3_max_wait_time_sec.c_str(), max_retry_wait_str.c_str() );
-            }
+
+        if (size_mb < 0) {
+            std::string resource_name = get_resource_name(_prop_map);
+            s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be at least 0. Defaulting to 0.",
+                    resource_name, s3_memory_staging_size_mb, size_mb_str);
+            size_mb = 0;
         }
     }
-    return max_retry_wait;
+
+    return size_mb;
 }
 
-std::size_t get_retry_count(irods::plugin_property_map& _prop_map) {
+std::string get_memory_staging_directory(irods::plugin_property_map& _prop_map) {
 
-    std::size_t retry_count = S3_DEFAULT_RETRY_COUNT;
+    std::string directory_str;
+    irods::error ret = _prop_map.get< std::string >( s3_memory_staging_dir, directory_str );
+    if (!ret.ok() || directory_str.empty()) {
+        directory_str = "/dev/shm";
+    }
+    return directory_str;
+}
 
-    std::string retry_count_str;
-    irods::error ret = _prop_map.get< std::string >( s3_retry_count, retry_count_str );
-    if( ret.ok() ) {
-        try {
-            retry_count = boost::lexical_cast<std::size_t>( retry_count_str );
-        } catch ( const boost::bad_lexical_cast& ) {
-            std::string resource_name = get_resource_name(_prop_map);
-            s3_logger::error(
-                "[resource_name={}] failed to cast {} [{}] to a std::size_t", resource_name.c_str(),
-                s3_retry_count.c_str(), retry_count_str.c_str() );
-        }
+// Keeps batched or queued unlinks of _key from deleting an object written to
+// it from now on.
+void cancel_pending_delete(
+        irods::plugin_property_map& _prop_map,
+        const std::string& _bucket,
+        const std::string& _key) {
+
+    std::string resource_name = get_resource_name(_prop_map);
+    delete_batcher::for_resource(resource_name).cancel(_bucket, _key);
+    delete_queue::for_resource(resource_name).cancel(_bucket, _key);
+}
+
+// Sends the pending deletes of the resource and logs the keys that could not
+// be deleted.  Returns the failures.
+std::vector<irods::experimental::io::s3_transport::delete_failure> flush_pending_deletes(
+        irods::plugin_property_map& _prop_map,
+        bool _all) {
+
+    std::string resource_name = get_resource_name(_prop_map);
+    auto failures = delete_batcher::for_resource(resource_name).flush(
+            make_retry_policy(_prop_map),
+            get_non_data_transfer_timeout_seconds(_prop_map) * 1000,
+            _all);
+
+    for (const auto& failure : failures) {
+        s3_logger::error("[resource_name={}] Failed to delete the S3 object \"{}\" - \"{}\" {}",
+                resource_name, failure.key,
+                failure.code.empty() ? S3_get_status_name(failure.status) : failure.code,
+                failure.message);
     }
 
-    return retry_count;
+    return failures;
 }
 
-unsigned int get_non_data_transfer_timeout_seconds(irods::plugin_property_map& _prop_map) {
+// Returns the rate limit configured with _keyword.  Zero (the default) means unlimited.
+std::uint64_t get_rate_limit(irods::plugin_property_map& _prop_map, const std::string& _keyword) {
 
-    unsigned int non_data_transfer_timeout_seconds = S3_DEFAULT_NON_DATA_TRANSFER_TIMEOUT_SECONDS;
-    std::string non_data_transfer_timeout_seconds_str;
-    irods::error ret = _prop_map.get< std::string >( s3_non_data_transfer_timeout_seconds, non_data_transfer_timeout_seconds_str );
+    std::uint64_t limit = 0;
+    std::string limit_str;
+    irods::error ret = _prop_map.get< std::string >( _keyword, limit_str );
     if( ret.ok() ) {
         try {
-            non_data_transfer_timeout_seconds = boost::lexical_cast<unsigned int>( non_data_transfer_timeout_seconds_str );
+            limit = boost::lexical_cast<std::uint64_t>( limit_str );
         } catch ( const boost::bad_lexical_cast& ) {
             std::string resource_name = get_resource_name(_prop_map);
             s3_logger::error(
-                "[resource_name={}] failed to cast {} [{}] to an unsigned int", resource_name.c_str(),
-                s3_non_data_transfer_timeout_seconds.c_str(), non_data_transfer_timeout_seconds_str.c_str() );
+                "[resource_name={}] failed to cast {} [{}] to an unsigned integer", resource_name.c_str(),
+                _keyword.c_str(), limit_str.c_str() );
         }
     }
 
-    return non_data_transfer_timeout_seconds;
+    return limit;
 }
 
 unsigned int s3_get_restoration_days(irods::plugin_property_map& _prop_map) {
@@ -1247,6 +2294,54 @@ bool s3_direct_checksum_read_enabled(
 	return enable_flag;
 } // end s3_direct_checksum_read_enabled
 
+// s3_adaptive_concurrency_enabled - default is false
+bool s3_adaptive_concurrency_enabled(
+		irods::plugin_property_map& _prop_map )
+{
+	std::string enable_str;
+	bool enable_flag = false;
+
+	irods::error ret = _prop_map.get< std::string >(
+			s3_adaptive_concurrency,
+			enable_str );
+	if (ret.ok()) {
+		// Only 0 = no, 1 = yes.
+		if ("0" != enable_str && "1" != enable_str) {
+			std::string resource_name = get_resource_name(_prop_map);
+			s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+					resource_name, s3_adaptive_concurrency, enable_str);
+		}
+		else if ("1" == enable_str) {
+			enable_flag = true;
+		}
+	}
+	return enable_flag;
+} // end s3_adaptive_concurrency_enabled
+
+// s3_hedged_reads_enabled - default is false
+bool s3_hedged_reads_enabled(
+		irods::plugin_property_map& _prop_map )
+{
+	std::string enable_str;
+	bool enable_flag = false;
+
+	irods::error ret = _prop_map.get< std::string >(
+			s3_hedged_reads,
+			enable_str );
+	if (ret.ok()) {
+		// Only 0 = no, 1 = yes.
+		if ("0" != enable_str && "1" != enable_str) {
+			std::string resource_name = get_resource_name(_prop_map);
+			s3_logger::warn("[resource_name={}] Invalid value for {} of {}. The value should be 0 or 1. Defaulting to 0.",
+					resource_name, s3_hedged_reads, enable_str);
+		}
+		else if ("1" == enable_str) {
+			enable_flag = true;
+		}
+	}
+	return enable_flag;
+} // end s3_hedged_reads_enabled
+
 // enable_trailing_checksum_on_upload - default is false
 bool s3_trailing_checksum_on_upload_enabled(
 		irods::plugin_property_map& _prop_map )
@@ -1282,13 +2377,11 @@ irods::error s3GetFile(
     rodsLong_t _fileSize,
     const std::string& _key_id,
     const std::string& _access_key,
-    irods::plugin_property_map& _prop_map )
+    irods::plugin_property_map& _prop_map,
+    const std::string& _user_name )
 {
-    std::string resource_name = get_resource_name(_prop_map);
-
-    std::size_t retry_count_limit = get_retry_count(_prop_map);
-    std::size_t retry_wait = get_retry_wait_time_sec(_prop_map);
-    std::size_t max_retry_wait = get_max_retry_wait_time_sec(_prop_map);
+    const auto settings = get_resource_settings(_prop_map);
+    const std::string& resource_name = settings->resource_name;
 
     std::string bucket;
     std::string key;
@@ -1315,17 +2408,11 @@ irods::error s3GetFile(
     }
 
     callback_data_t data;
-    S3BucketContext bucketContext{};
-    bucketContext.bucketName = bucket.c_str();
-    bucketContext.protocol = s3GetProto(_prop_map);
-    bucketContext.stsDate = s3GetSTSDate(_prop_map);
-    bucketContext.uriStyle = s3_get_uri_request_style(_prop_map);
+    S3BucketContext bucketContext = make_bucket_context(*settings, bucket);
     bucketContext.accessKeyId = _key_id.c_str();
     bucketContext.secretAccessKey = _access_key.c_str();
-    std::string authRegionStr = get_region_name(_prop_map);
-    bucketContext.authRegion = authRegionStr.c_str();
 
-    std::int64_t chunksize = s3GetMPUChunksize( _prop_map );
+    std::int64_t chunksize = settings->mpu_chunk_size;
 
     if ( _fileSize < chunksize ) {
         S3GetObjectHandler getObjectHandler = {
@@ -1333,28 +2420,24 @@ irods::error s3GetFile(
             &getObjectDataCallback
         };
 
-        std::size_t retry_cnt = 0;
+        auto retry = make_retry_policy(_prop_map);
         do {
             data = {};
             data.prop_map_ptr = &_prop_map;
+            data.user_name = _user_name;
             data.fd = cache_fd;
             data.contentLength = data.originalContentLength = _fileSize;
             std::uint64_t usStart = usNow();
             std::string&& hostname = s3GetHostname(_prop_map);
             bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+            endpoint_request endpoint{resource_name, hostname};
             data.pCtx = &bucketContext;
             S3_get_object (&bucketContext, key.c_str(), NULL, 0, _fileSize, 0, 0, &getObjectHandler, &data);
+            endpoint.finish(data.status, _fileSize);
             std::uint64_t usEnd = usNow();
             double bw = (_fileSize / (1024.0*1024.0)) / ( (usEnd - usStart) / 1000000.0 );
             s3_logger::debug("GETBW={}", bw);
-            if (data.status != S3StatusOK) {
-                s3_sleep( retry_wait );
-                retry_wait *= 2;
-                if (retry_wait > max_retry_wait) {
-                    retry_wait = max_retry_wait;
-                }
-            }
-        } while ( (data.status != S3StatusOK) && S3_status_is_retryable(data.status) && (++retry_cnt <= retry_count_limit) );
+        } while (retry.should_retry(data.status));
 
         if (data.status != S3StatusOK) {
 
@@ -1375,6 +2458,7 @@ irods::error s3GetFile(
         // Only the FD part of this will be constant
         data = {};
         data.prop_map_ptr = &_prop_map;
+        data.user_name = _user_name;
         data.fd = cache_fd;
         data.contentLength = data.originalContentLength = _fileSize;
 
@@ -1411,7 +2495,7 @@ irods::error s3GetFile(
         }
 
         // Make the worker threads and start
-        int nThreads = s3GetMPUThreads(_prop_map);
+        int nThreads = settings->mpu_threads;
 
         std::uint64_t usStart = usNow();
         std::list<boost::thread*> threads;
@@ -1448,6 +2532,67 @@ irods::error s3GetFile(
     return ret;
 } // s3GetFile
 
+irods::error s3GetCompressedFile(
+    const std::string& _filename,
+    const std::string& _s3ObjName,
+    const compressed_object& _object,
+    const std::string& _key_id,
+    const std::string& _access_key,
+    irods::plugin_property_map& _prop_map )
+{
+    const auto settings = get_resource_settings(_prop_map);
+    const std::string& resource_name = settings->resource_name;
+
+    std::string bucket;
+    std::string key;
+    auto ret = parseS3Path(_s3ObjName, bucket, key, _prop_map);
+    if (!ret.ok()) {
+        return PASSMSG(fmt::format(
+                    "[resource_name={}] Failed parsing the S3 bucket and key from the physical path: \"{}\".",
+                    resource_name, _s3ObjName), ret);
+    }
+
+    ret = s3InitPerOperation( _prop_map );
+    if (!ret.ok()) {
+        return PASSMSG(fmt::format(
+                    "[resource_name={}] Failed to initialize the S3 system.",
+                    resource_name), ret);
+    }
+
+    int cache_fd = open(_filename.c_str(), O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    if (-1 == cache_fd) {
+        return ERROR(UNIX_FILE_OPEN_ERR, fmt::format(
+                    "[resource_name={}] Failed to open the cache file: \"{}\".",
+                    resource_name, _filename));
+    }
+    const auto close_cache_file = irods::at_scope_exit{[cache_fd] { close(cache_fd); }};
+
+    S3BucketContext bucketContext = make_bucket_context(*settings, bucket);
+    bucketContext.accessKeyId = _key_id.c_str();
+    bucketContext.secretAccessKey = _access_key.c_str();
+
+    const auto number_of_threads = static_cast<unsigned int>(std::max<ssize_t>(settings->mpu_threads, 1));
+
+    std::uint64_t usStart = usNow();
+    const S3Status status = irods::experimental::io::s3_transport::download_compressed_object(
+            resource_name, bucketContext, key, _object, cache_fd, settings->mpu_chunk_size,
+            number_of_threads, make_retry_policy(_prop_map));
+    std::uint64_t usEnd = usNow();
+    double bw = (_object.logical_size / (1024.0*1024.0)) / ( (usEnd - usStart) / 1000000.0 );
+    s3_logger::debug("CompressedGETBW={}", bw);
+
+    if (S3StatusOK != status) {
+        // 0-length the file, it's garbage
+        if (ftruncate( cache_fd, 0 ))
+            s3_logger::error("[resource_name={}] Unable to 0-length the result file", resource_name);
+        return ERROR(S3_GET_ERROR, fmt::format(
+                    "[resource_name={}] {} - Error fetching the compressed S3 object: \"{}\" - \"{}\"",
+                    resource_name, __FUNCTION__, _s3ObjName, S3_get_status_name(status)));
+    }
+
+    return SUCCESS();
+} // s3GetCompressedFile
+
 static boost::mutex g_mpuLock; // Multipart upload has a mutex-protected global work queue
 static volatile int g_mpuNext = 0;
 static int g_mpuLast = -1;
@@ -1632,9 +2777,6 @@ static void mpuWorkerThread (
 
     S3PutObjectHandler putObjectHandler = { {mpuPartRespPropCB, mpuPartRespCompCB }, &mpuPartPutDataCB };
 
-    std::size_t retry_count_limit = get_retry_count(_prop_map);
-    std::size_t retry_wait = get_retry_wait_time_sec(_prop_map);
-    std::size_t max_retry_wait = get_max_retry_wait_time_sec(_prop_map);
 
     /* Will break out when no work detected */
     while (1) {
@@ -1655,7 +2797,7 @@ static void mpuWorkerThread (
         g_mpuLock.unlock();
 
         multipart_data_t partData;
-        std::size_t retry_cnt = 0;
+        auto retry = make_retry_policy(_prop_map);
         do {
             // Work on a local copy of the structure in case an error occurs in the middle
             // of an upload.  If we updated in-place, on a retry the part would start
@@ -1676,6 +2818,7 @@ static void mpuWorkerThread (
             std::uint64_t usStart = usNow();
             std::string&& hostname = s3GetHostname(_prop_map);
             bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+            endpoint_request endpoint{resource_name, hostname};
             if (partData.mode == S3_COPYOBJECT) {
                 std::uint64_t startOffset = partData.put_object_data.offset;
 
@@ -1695,6 +2838,7 @@ static void mpuWorkerThread (
                 S3_upload_part(&bucketContext, g_mpuKey, putProps, &putObjectHandler, seq, g_mpuUploadId,
                         partData.put_object_data.contentLength, 0, 0, &partData);
             }
+            endpoint.finish(partData.status, partData.put_object_data.contentLength);
             std::uint64_t usEnd = usNow();
             double bw = (g_mpuData[seq-1].put_object_data.contentLength / (1024.0 * 1024.0)) / ( (usEnd - usStart) / 1000000.0 );
             // Clear up the S3PutProperties, if it exists
@@ -1703,14 +2847,7 @@ static void mpuWorkerThread (
                 free( putProps );
             }
             s3_logger::debug(" -- END -- BW={} MB/s", bw);
-            if (partData.status != S3StatusOK) {
-                s3_sleep( retry_wait );
-                retry_wait *= 2;
-                if (retry_wait > max_retry_wait) {
-                    retry_wait = max_retry_wait;
-                }
-            }
-        } while ((partData.status != S3StatusOK) && S3_status_is_retryable(partData.status) && (++retry_cnt <= retry_count_limit));
+        } while (retry.should_retry(partData.status));
         if (partData.status != S3StatusOK) {
 
             auto msg = fmt::format("[resource_name={}] {} - Error putting the S3 object: \"{}\" part {}",
@@ -1737,7 +2874,9 @@ irods::error s3PutCopyFile(
     rodsLong_t _fileSize,
     const std::string& _key_id,
     const std::string& _access_key,
-    irods::plugin_property_map& _prop_map )
+    irods::plugin_property_map& _prop_map,
+    const std::map<std::string, std::string>& _meta_data,
+    const std::string& _user_name )
 {
     int cache_fd = -1;
     std::string bucket;
@@ -1745,15 +2884,14 @@ irods::error s3PutCopyFile(
     std::string srcBucket;
     std::string srcKey;
     int err_status = 0;
-    std::int64_t chunksize = s3GetMPUChunksize( _prop_map );
-    std::size_t retry_cnt    = 0;
-    bool server_encrypt = s3GetServerEncrypt ( _prop_map );
+    const auto settings = get_resource_settings(_prop_map);
+    // copies have their own part size, parts are copied by S3 rather than sent
+    std::int64_t chunksize = _mode == S3_COPYOBJECT
+        ? s3GetMPUCopyChunksize( _prop_map, _fileSize )
+        : settings->mpu_chunk_size;
+    bool server_encrypt = settings->server_encrypt;
 
-    std::string resource_name = get_resource_name(_prop_map);
-
-    std::size_t retry_count_limit = get_retry_count(_prop_map);
-    std::size_t retry_wait = get_retry_wait_time_sec(_prop_map);
-    std::size_t max_retry_wait = get_max_retry_wait_time_sec(_prop_map);
+    const std::string& resource_name = settings->resource_name;
 
     auto ret = parseS3Path(_s3ObjName, bucket, key, _prop_map);
     if (!ret.ok()) {
@@ -1769,10 +2907,13 @@ irods::error s3PutCopyFile(
                     resource_name), ret);
     }
 
+    // do not let a pending unlink of the previous object delete this one
+    cancel_pending_delete(_prop_map, bucket, key);
+
     if (_mode == S3_PUTFILE) {
         cache_fd = open(_filename.c_str(), O_RDONLY);
         err_status = UNIX_FILE_OPEN_ERR - errno;
-    } else if (_mode == S3_COPYOBJECT && _fileSize > s3GetMPUChunksize( _prop_map )) {
+    } else if (_mode == S3_COPYOBJECT && _fileSize > chunksize) {
         // Multipart copy, don't open anything
         cache_fd = 0;
         err_status = 0;
@@ -1789,35 +2930,38 @@ irods::error s3PutCopyFile(
     }
 
     callback_data_t data;
-    S3BucketContext bucketContext{};
-    bucketContext.bucketName = bucket.c_str();
-    bucketContext.protocol = s3GetProto(_prop_map);
-    bucketContext.stsDate = s3GetSTSDate(_prop_map);
-    bucketContext.uriStyle = s3_get_uri_request_style(_prop_map);
+    S3BucketContext bucketContext = make_bucket_context(*settings, bucket);
     bucketContext.accessKeyId = _key_id.c_str();
     bucketContext.secretAccessKey = _access_key.c_str();
-    std::string authRegionStr = get_region_name(_prop_map);
-    bucketContext.authRegion = authRegionStr.c_str();
 
     S3PutProperties *putProps = NULL;
     putProps = (S3PutProperties*)calloc( sizeof(S3PutProperties), 1 );
     if ( putProps && server_encrypt )
         putProps->useServerSideEncryption = true;
     putProps->expires = -1;
-    std::string storage_class = s3_get_storage_class_from_configuration(_prop_map);
-    putProps->xAmzStorageClass = storage_class.c_str();
+    putProps->xAmzStorageClass = settings->storage_class.c_str();
+
+    // user metadata of the object, e.g. describing its compression
+    std::vector<S3NameValue> meta_data;
+    for (const auto& [name, value] : _meta_data) {
+        meta_data.push_back({name.c_str(), value.c_str()});
+    }
+    putProps->metaDataCount = static_cast<int>(meta_data.size());
+    putProps->metaData = meta_data.empty() ? nullptr : meta_data.data();
 
     // HML: add a check to see whether or not multipart upload is enabled.
-    bool mpu_enabled = s3GetEnableMultiPartUpload(_prop_map);
+    bool mpu_enabled = settings->multipart_enabled;
     if ((!mpu_enabled) || ( _fileSize < chunksize )) {
         S3PutObjectHandler putObjectHandler = {
             { &responsePropertiesCallback, &responseCompleteCallback },
             &putObjectDataCallback
         };
 
+        auto retry = make_retry_policy(_prop_map);
         do {
             data = {};
             data.prop_map_ptr = &_prop_map;
+            data.user_name = _user_name;
             data.fd = cache_fd;
             data.contentLength = data.originalContentLength = _fileSize;
             data.pCtx = &bucketContext;
@@ -1825,18 +2969,13 @@ irods::error s3PutCopyFile(
             std::uint64_t usStart = usNow();
             std::string&& hostname = s3GetHostname(_prop_map);
             bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+            endpoint_request endpoint{resource_name, hostname};
             S3_put_object (&bucketContext, key.c_str(), _fileSize, putProps, 0, 0, &putObjectHandler, &data);
+            endpoint.finish(data.status, _fileSize);
             std::uint64_t usEnd = usNow();
             double bw = (_fileSize / (1024.0*1024.0)) / ( (usEnd - usStart) / 1000000.0 );
             s3_logger::debug("BW={}", bw);
-            if (data.status != S3StatusOK) {
-                s3_sleep( retry_wait );
-                retry_wait *= 2;
-                if (retry_wait > max_retry_wait) {
-                    retry_wait = max_retry_wait;
-                }
-            }
-        } while ( (data.status != S3StatusOK) && S3_status_is_retryable(data.status) && (++retry_cnt <= retry_count_limit) );
+        } while (retry.should_retry(data.status));
         if (data.status != S3StatusOK) {
             auto msg = fmt::format("[resource_name={}]  - Error putting the S3 object: \"{}\"",
                     resource_name,
@@ -1868,10 +3007,11 @@ irods::error s3PutCopyFile(
         std::int64_t totalSeq = (_fileSize + chunksize - 1) / chunksize;
 
         multipart_data_t partData;
-        int partContentLength = 0;
+        std::int64_t partContentLength = 0;
 
         data = {};
         data.prop_map_ptr = &_prop_map;
+        data.user_name = _user_name;
         data.fd = cache_fd;
         data.contentLength = data.originalContentLength = _fileSize;
 
@@ -1914,22 +3054,17 @@ irods::error s3PutCopyFile(
             return ERROR( SYS_MALLOC_ERR, msg );
         }
 
-        retry_cnt = 0;
+        auto retry = make_retry_policy(_prop_map);
         // These expect a upload_manager_t* as cbdata
         S3MultipartInitialHandler mpuInitialHandler = { {mpuInitRespPropCB, mpuInitRespCompCB }, mpuInitXmlCB };
         do {
             std::string&& hostname = s3GetHostname(_prop_map);
             bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+            endpoint_request endpoint{resource_name, hostname};
             manager.pCtx = &bucketContext;
             S3_initiate_multipart(&bucketContext, key.c_str(), putProps, &mpuInitialHandler, NULL, 0, &manager);
-            if (manager.status != S3StatusOK) {
-                s3_sleep( retry_wait );
-                retry_wait *= 2;
-                if (retry_wait > max_retry_wait) {
-                    retry_wait = max_retry_wait;
-                }
-            }
-        } while ( (manager.status != S3StatusOK) && S3_status_is_retryable(manager.status) && ( ++retry_cnt <= retry_count_limit));
+            endpoint.finish(manager.status);
+        } while (retry.should_retry(manager.status));
         if (manager.upload_id == NULL || manager.status != S3StatusOK) {
             // Clear up the S3PutProperties, if it exists
             if (putProps) {
@@ -1950,7 +3085,6 @@ irods::error s3PutCopyFile(
 
         // Following used by S3_COPYOBJECT only
         S3BucketContext srcBucketContext;
-        std::string authRegionStr = get_region_name(_prop_map);
         if (_mode == S3_COPYOBJECT) {
             ret = parseS3Path(_filename, srcBucket, srcKey, _prop_map);
             if (!ret.ok()) {
@@ -1958,14 +3092,9 @@ irods::error s3PutCopyFile(
                             "[resource_name={}] Failed parsing the S3 bucket and key from the physical path: \"{}\".",
                             resource_name, _filename), ret);
             }
-            std::memset(&srcBucketContext, 0, sizeof(srcBucketContext));
-            srcBucketContext.bucketName = srcBucket.c_str();
-            srcBucketContext.protocol = s3GetProto(_prop_map);
-            srcBucketContext.stsDate = s3GetSTSDate(_prop_map);
-            srcBucketContext.uriStyle = s3_get_uri_request_style(_prop_map);
+            srcBucketContext = make_bucket_context(*settings, srcBucket);
             srcBucketContext.accessKeyId = _key_id.c_str();
             srcBucketContext.secretAccessKey = _access_key.c_str();
-            srcBucketContext.authRegion = authRegionStr.c_str();
         }
 
         g_mpuNext = 0;
@@ -1985,7 +3114,7 @@ irods::error s3PutCopyFile(
             partContentLength = (data.contentLength > chunksize)?chunksize:data.contentLength;
             partData.put_object_data.contentLength = partContentLength;
             partData.put_object_data.offset = (seq-1) * chunksize;
-            partData.server_encrypt = s3GetServerEncrypt( _prop_map );
+            partData.server_encrypt = server_encrypt;
             g_mpuData[seq-1] = partData;
             data.contentLength -= partContentLength;
         }
@@ -1993,7 +3122,7 @@ irods::error s3PutCopyFile(
         std::uint64_t usStart = usNow();
 
         // Make the worker threads and start
-        int nThreads = s3GetMPUThreads(_prop_map);
+        int nThreads = _mode == S3_COPYOBJECT ? s3GetMPUCopyThreads(_prop_map) : settings->mpu_threads;
 
         std::list<boost::thread*> threads;
         for (int thr_id=0; thr_id<nThreads; thr_id++) {
@@ -2033,7 +3162,7 @@ irods::error s3PutCopyFile(
             manager.remaining += strlen( manager.xml+manager.remaining );
             int manager_remaining = manager.remaining;
             manager.offset = 0;
-            retry_cnt = 0;
+            retry = make_retry_policy(_prop_map);
             S3MultipartCommitHandler commit_handler = { {mpuCommitRespPropCB, mpuCommitRespCompCB }, mpuCommitXmlCB, NULL };
             do {
                 // On partial error, need to restart XML send from the beginning
@@ -2041,16 +3170,11 @@ irods::error s3PutCopyFile(
                 manager.offset = 0;
                 std::string&& hostname = s3GetHostname(_prop_map);
                 bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+                endpoint_request endpoint{resource_name, hostname};
                 manager.pCtx = &bucketContext;
                 S3_complete_multipart_upload(&bucketContext, key.c_str(), &commit_handler, manager.upload_id, manager.remaining, nullptr, nullptr, 0, &manager);
-                if (manager.status != S3StatusOK) {
-                    s3_sleep( retry_wait );
-                    retry_wait *= 2;
-                    if (retry_wait > max_retry_wait) {
-                        retry_wait = max_retry_wait;
-                    }
-                }
-            } while ((manager.status != S3StatusOK) && S3_status_is_retryable(manager.status) && ( ++retry_cnt <= retry_count_limit));
+                endpoint.finish(manager.status);
+            } while (retry.should_retry(manager.status));
             if (manager.status != S3StatusOK) {
                 auto msg = fmt::format("[resource_name={}] {} - Error putting the S3 object: \"{}\"",
                         resource_name,
@@ -2089,6 +3213,66 @@ irods::error s3PutCopyFile(
     return ret;
 } // s3PutCopyFile
 
+irods::error s3PutCompressedFile(
+    const std::string& _filename,
+    const std::string& _s3ObjName,
+    rodsLong_t _fileSize,
+    const std::string& _key_id,
+    const std::string& _access_key,
+    irods::plugin_property_map& _prop_map,
+    const std::map<std::string, std::string>& _meta_data,
+    const std::string& _user_name )
+{
+    std::string resource_name = get_resource_name(_prop_map);
+
+    // the cache file is compressed into a file next to it
+    const std::string compressed_filename = _filename + ".irods_s3_zstd";
+
+    int cache_fd = open(_filename.c_str(), O_RDONLY);
+    if (-1 == cache_fd) {
+        return ERROR(UNIX_FILE_OPEN_ERR - errno, fmt::format(
+                    "[resource_name={}] Failed to open the cache file: \"{}\".",
+                    resource_name, _filename));
+    }
+    const auto close_cache_file = irods::at_scope_exit{[cache_fd] { close(cache_fd); }};
+
+    int compressed_fd = open(compressed_filename.c_str(), O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    if (-1 == compressed_fd) {
+        return ERROR(UNIX_FILE_OPEN_ERR - errno, fmt::format(
+                    "[resource_name={}] Failed to open the compressed file: \"{}\".",
+                    resource_name, compressed_filename));
+    }
+    const auto remove_compressed_file = irods::at_scope_exit{[compressed_fd, &compressed_filename] {
+        close(compressed_fd);
+        unlink(compressed_filename.c_str());
+    }};
+
+    const auto compressed = irods::experimental::io::s3_transport::compress_file(
+            cache_fd, compressed_fd, get_compression_level(_prop_map));
+    if (!compressed) {
+        return ERROR(UNIX_FILE_WRITE_ERR, fmt::format(
+                    "[resource_name={}] Failed to compress the cache file: \"{}\" into \"{}\".",
+                    resource_name, _filename, compressed_filename));
+    }
+
+    // do not pay for decompressing an object that is not smaller
+    if (compressed->compressed_size >= compressed->logical_size) {
+        s3_logger::debug("[resource_name={}] {} does not compress ({} bytes to {}), uploading it as is.",
+                resource_name, _filename, compressed->logical_size, compressed->compressed_size);
+        return s3PutCopyFile(S3_PUTFILE, _filename, _s3ObjName, _fileSize, _key_id, _access_key, _prop_map, _meta_data,
+                _user_name);
+    }
+
+    s3_logger::debug("[resource_name={}] Compressed {} from {} bytes to {}.",
+            resource_name, _filename, compressed->logical_size, compressed->compressed_size);
+
+    auto meta_data = compressed->meta_data();
+    meta_data.insert(_meta_data.begin(), _meta_data.end());
+
+    return s3PutCopyFile(S3_PUTFILE, compressed_filename, _s3ObjName, compressed->compressed_size,
+            _key_id, _access_key, _prop_map, meta_data, _user_name);
+} // s3PutCompressedFile
+
 
 /// @brief Function to copy the specified src file to the specified dest file
 irods::error s3CopyFile(
@@ -2101,39 +3285,75 @@ irods::error s3CopyFile(
     const S3STSDate _stsDate,
     const S3UriStyle _s3_uri_style)
 {
-    std::string src_bucket;
-    std::string src_key;
-    std::string dest_bucket;
-    std::string dest_key;
-
-    std::size_t retry_count_limit = get_retry_count(_src_ctx.prop_map());
-    std::size_t retry_wait = get_retry_wait_time_sec(_src_ctx.prop_map());
-    std::size_t max_retry_wait = get_max_retry_wait_time_sec(_src_ctx.prop_map());
-
     std::string resource_name = get_resource_name(_src_ctx.prop_map());
 
-    bool mpu_enabled = s3GetEnableMultiPartUpload(_src_ctx.prop_map());
-
     // Check the size, and if too large punt to the multipart copy/put routine
     struct stat statbuf = {};
-    auto ret = irods_s3::s3_file_stat_operation( _src_ctx, &statbuf );
+    std::map<std::string, std::string> meta_data;
+    auto [cacheless_mode, attached_mode] = get_modes_from_properties(_src_ctx.prop_map());
+    auto ret = cacheless_mode
+        ? irods_s3::s3_file_stat_operation( _src_ctx, &statbuf )
+        : irods_s3::s3_file_stat_operation_with_flag_for_retry_on_not_found( _src_ctx, &statbuf, false, &meta_data );
     if (!ret.ok()) {
         return PASSMSG(fmt::format(
                     "[resource_name={}] Unable to get original object size for source file name: \"{}\".",
                     resource_name, _src_file), ret);
     }
 
+    // a compressed object is copied as is, its size is the compressed size
+    // and its metadata describing the compression goes with it
+    if (const auto compressed = compressed_object_from_meta_data(meta_data); compressed) {
+        return s3CopyObject(_src_ctx.prop_map(), _src_file, _dest_file, compressed->compressed_size, _key_id, _access_key,
+                _proto, _stsDate, _s3_uri_style, compressed->meta_data());
+    }
+
+    return s3CopyObject(_src_ctx.prop_map(), _src_file, _dest_file, statbuf.st_size, _key_id, _access_key,
+            _proto, _stsDate, _s3_uri_style);
+} // s3CopyFile
+
+/// @brief Function to copy the specified src object of a known size to the specified dest object
+irods::error s3CopyObject(
+    irods::plugin_property_map& _prop_map,
+    const std::string& _src_file,
+    const std::string& _dest_file,
+    const std::int64_t _object_size,
+    const std::string& _key_id,
+    const std::string& _access_key,
+    const S3Protocol _proto,
+    const S3STSDate _stsDate,
+    const S3UriStyle _s3_uri_style,
+    const std::map<std::string, std::string>& _meta_data)
+{
+    std::string src_bucket;
+    std::string src_key;
+    std::string dest_bucket;
+    std::string dest_key;
+
+    const auto settings = get_resource_settings(_prop_map);
+    const std::string& resource_name = settings->resource_name;
+
+    bool mpu_enabled = settings->multipart_enabled;
+
+    irods::error ret = SUCCESS();
+
     // if we are too big for a copy then we must upload
     // however, only do this is mpu is disabled
-    if ( mpu_enabled && statbuf.st_size > s3GetMaxUploadSizeMB(_src_ctx.prop_map()) * 1024 * 1024 ) {   // amazon allows copies up to 5 GB
-        return s3PutCopyFile( S3_COPYOBJECT, _src_file, _dest_file, statbuf.st_size, _key_id, _access_key, _src_ctx.prop_map() );
+    if ( mpu_enabled && _object_size > settings->max_upload_size_mb * 1024 * 1024 ) {   // amazon allows copies up to 5 GB
+        return s3PutCopyFile( S3_COPYOBJECT, _src_file, _dest_file, _object_size, _key_id, _access_key, _prop_map, _meta_data );
+    }
+
+    // A single CopyObject of a large object is copied serially by the provider
+    // and may run into the timeout.  Copy the parts in parallel instead.
+    if ( mpu_enabled && _object_size >= s3GetMPUCopyThreshold(_prop_map) &&
+            _object_size > s3GetMPUCopyChunksize(_prop_map, _object_size) ) {
+        return s3PutCopyFile( S3_COPYOBJECT, _src_file, _dest_file, _object_size, _key_id, _access_key, _prop_map, _meta_data );
     }
 
     // Note:  If file size > s3GetMaxUploadSizeMB() but multipart is disabled, it is not clear how to proceed.
-    // Go ahead and try a copy.
+    // Go ahead and try a copy.  A single copy keeps the metadata of the source object.
 
     // Parse the src file
-    ret = parseS3Path(_src_file, src_bucket, src_key, _src_ctx.prop_map());
+    ret = parseS3Path(_src_file, src_bucket, src_key, _prop_map);
     if (!ret.ok()) {
         return PASSMSG(fmt::format(
                     "[resource_name={}] Failed to parse the source file name: \"{}\".",
@@ -2141,7 +3361,7 @@ irods::error s3CopyFile(
     }
 
     // Parse the dest file
-    ret = parseS3Path(_dest_file, dest_bucket, dest_key, _src_ctx.prop_map());
+    ret = parseS3Path(_dest_file, dest_bucket, dest_key, _prop_map);
     if (!ret.ok()) {
         return PASSMSG(fmt::format(
                     "[resource_name={}] Failed to parse the destination file name: \"{}\".",
@@ -2149,7 +3369,7 @@ irods::error s3CopyFile(
     }
 
     callback_data_t data;
-    data.prop_map_ptr = &_src_ctx.prop_map();
+    data.prop_map_ptr = &_prop_map;
     S3BucketContext bucketContext;
     std::int64_t lastModified;
     char eTag[256];
@@ -2161,9 +3381,7 @@ irods::error s3CopyFile(
     bucketContext.uriStyle = _s3_uri_style;
     bucketContext.accessKeyId = _key_id.c_str();
     bucketContext.secretAccessKey = _access_key.c_str();
-
-    std::string authRegionStr = get_region_name(_src_ctx.prop_map());
-    bucketContext.authRegion = authRegionStr.c_str();
+    bucketContext.authRegion = settings->region_name.c_str();
 
     S3ResponseHandler responseHandler = {
         &responsePropertiesCallback,
@@ -2175,23 +3393,18 @@ irods::error s3CopyFile(
     memset(&putProps, 0, sizeof(S3PutProperties));
     putProps.expires = -1;
 
-    std::size_t retry_cnt = 0;
+    auto retry = make_retry_policy(_prop_map);
     do {
         data = {};
-        data.prop_map_ptr = &_src_ctx.prop_map();
-        std::string&& hostname = s3GetHostname(_src_ctx.prop_map());
+        data.prop_map_ptr = &_prop_map;
+        std::string&& hostname = s3GetHostname(_prop_map);
         bucketContext.hostName = hostname.c_str(); // Safe to do, this is a local copy of the data structure
+        endpoint_request endpoint{resource_name, hostname};
         data.pCtx = &bucketContext;
         S3_copy_object(&bucketContext, src_key.c_str(), dest_bucket.c_str(), dest_key.c_str(), &putProps, &lastModified, sizeof(eTag), eTag, 0,
                 0, &responseHandler, &data);
-        if (data.status != S3StatusOK) {
-            s3_sleep( retry_wait );
-            retry_wait *= 2;
-            if (retry_wait > max_retry_wait) {
-                retry_wait = max_retry_wait;
-            }
-        }
-    } while ( (data.status != S3StatusOK) && S3_status_is_retryable(data.status) && (++retry_cnt <= retry_count_limit) );
+        endpoint.finish(data.status);
+    } while (retry.should_retry(data.status));
     if (data.status != S3StatusOK) {
         auto msg = fmt::format("[resource_name={}] {} - Error copying the S3 object: \"{}\" to S3 object \"{}\"",
                 resource_name,
@@ -2206,7 +3419,7 @@ irods::error s3CopyFile(
     }
 
     return ret;
-} // s3CopyFile
+} // s3CopyObject
 
 irods::error s3GetAuthCredentials(
     irods::plugin_property_map& _prop_map,
@@ -2279,6 +3492,14 @@ irods:: error s3StartOperation(irods::plugin_property_map& _prop_map)
         return ret;
     }
 
+    // Initialize the S3 library once for the process.  It stays initialized until
+    // the last resource stops.
+    if (const S3Status status = library_lifecycle::acquire(resource_name, s3GetCurrentHostname(_prop_map)); status != S3StatusOK) {
+        return ERROR(S3_INIT_ERROR, fmt::format(
+                        "[resource_name={}] Failed to initialize the S3 library. Status = {} - \"{}\".",
+                        resource_name, status, S3_get_status_name(status)));
+    }
+
     // Retrieve the auth info and set the appropriate fields in the property map
     ret = s3ReadAuthInfo(_prop_map);
     if (!ret.ok()) {
@@ -2288,6 +3509,9 @@ irods:: error s3StartOperation(irods::plugin_property_map& _prop_map)
         return ret;
     }
 
+    // parse the settings used by operations once
+    update_resource_settings(_prop_map);
+
     bool attached_mode = true, cacheless_mode = false;
     std::tie(cacheless_mode, attached_mode) = get_modes_from_properties(_prop_map);
 
@@ -2340,11 +3564,50 @@ irods:: error s3StartOperation(irods::plugin_property_map& _prop_map)
 /// and remove system resources
 irods::error s3StopOperation(irods::plugin_property_map& _prop_map)
 {
-    if(S3Initialized) {
-        S3Initialized = false;
-
-        S3_deinitialize();
+    std::string resource_name = get_resource_name(_prop_map);
+    // the per-host statistics are logged at the info level if a host misbehaved
+    if (auto& balancer = endpoint_balancer::for_resource(resource_name); balancer.degraded()) {
+        s3_logger::info("[resource_name={}] endpoint statistics: {}", resource_name, balancer.to_json().dump());
+    } else {
+        s3_logger::debug("[resource_name={}] endpoint statistics: {}", resource_name, balancer.to_json().dump());
     }
+    s3_logger::debug("[resource_name={}] admission control statistics: {}", resource_name,
+            admission_controller::for_resource(resource_name).to_json().dump());
+    admission_controller::for_resource(resource_name).detach();
+    s3_logger::debug("[resource_name={}] retry budget statistics: {}", resource_name,
+            retry_budget::for_resource(resource_name).to_json().dump());
+    retry_budget::for_resource(resource_name).detach();
+    s3_logger::debug("[resource_name={}] hedged read statistics: {}", resource_name,
+            hedge_controller::for_resource(resource_name).to_json().dump());
+    hedge_controller::for_resource(resource_name).detach();
+    s3_logger::debug("[resource_name={}] rate limits: {}", resource_name,
+            rate_limiter::for_resource(resource_name).to_json().dump());
+    rate_limiter::for_resource(resource_name).detach();
+
+    // unlinks still waiting to be batched are sent before the agent exits
+    if (delete_batcher::for_resource(resource_name).enabled()) {
+        flush_pending_deletes(_prop_map, true);
+    }
+    delete_batcher::for_resource(resource_name).stop();
+    s3_logger::debug("[resource_name={}] bulk delete statistics: {}", resource_name,
+            delete_batcher::for_resource(resource_name).to_json().dump());
+
+    // keys the drainer of this agent has not deleted stay in the queue for the next agent
+    delete_queue::for_resource(resource_name).stop();
+    s3_logger::debug("[resource_name={}] deferred delete statistics: {}", resource_name,
+            delete_queue::for_resource(resource_name).to_json().dump());
+
+    // an agent that wrote members uploads the packs that are full or old enough before it exits
+    if (pack_store::for_resource(resource_name).wrote_members()) {
+        const auto settings = get_resource_settings(_prop_map);
+        pack_store::for_resource(resource_name).seal_ready_packs(make_pack_transfer_settings(_prop_map, *settings));
+    }
+    s3_logger::debug("[resource_name={}] pack statistics: {}", resource_name,
+            pack_store::for_resource(resource_name).to_json().dump());
+
+    // the last resource to stop deinitializes the S3 library
+    library_lifecycle::release(resource_name);
+    s3_logger::debug("[resource_name={}] S3 library: {}", resource_name, library_lifecycle::to_json().dump());
 
     return SUCCESS();
 }
@@ -2401,6 +3664,83 @@ bool determine_unlink_for_repl_policy(
     return true;
 } // determine_unlink_for_repl_policy
 
+bool is_content_addressed_key(const std::string& _key) {
+    return irods::experimental::io::s3_transport::content_address::is_key(_key);
+} // is_content_addressed_key
+
+irods::error get_content_addressed_key(
+    const std::string& _filename,
+    std::string&       _key) {
+
+    int fd = open(_filename.c_str(), O_RDONLY);
+    if (-1 == fd) {
+        return ERROR(UNIX_FILE_OPEN_ERR - errno, fmt::format(
+                    "Failed to open the file: \"{}\".", _filename));
+    }
+    const auto close_fd = irods::at_scope_exit{[fd] { close(fd); }};
+
+    const auto key = irods::experimental::io::s3_transport::content_address::key_of_file(fd);
+    if (!key) {
+        if (0 == errno) {
+            return ERROR(SYS_INTERNAL_ERR, "Failed to compute the SHA-256 digest.");
+        }
+        return ERROR(UNIX_FILE_READ_ERR - errno, fmt::format(
+                    "Failed to read the file: \"{}\".", _filename));
+    }
+
+    _key = *key;
+    return SUCCESS();
+} // get_content_addressed_key
+
+bool determine_unlink_for_content_addressed_object(
+    rsComm_t*          _comm,
+    const std::string& _physical_path,
+    rodsLong_t         _data_id,
+    const std::string& _resource_name) {
+
+    std::string qstr =
+        fmt::format(
+        "SELECT DATA_ID, DATA_RESC_ID WHERE DATA_PATH = '{}'",
+        _physical_path);
+    uint32_t s3_ctr{0};
+    for(const auto& row : irods::query<rsComm_t>{_comm, qstr}) {
+        const std::string& data_id = row[0];
+        const std::string& id      = row[1];
+
+        std::string type;
+        irods::error ret = irods::get_resource_property<std::string>(
+                               std::stol(id.c_str()),
+                               irods::RESOURCE_TYPE,
+                               type);
+        if(!ret.ok()) {
+            s3_logger::error(PASS(ret).result());
+            continue;
+        }
+
+        if("s3" != type) {
+            continue;
+        }
+
+        // the replica being unlinked or moved to other contents does not count
+        std::string name;
+        ret = irods::get_resource_property<std::string>(
+                  std::stol(id.c_str()),
+                  irods::RESOURCE_NAME,
+                  name);
+        if(ret.ok() && name == _resource_name && data_id == std::to_string(_data_id)) {
+            continue;
+        }
+
+        s3_ctr++;
+    } // for row
+
+    if(s3_ctr > 0) {
+        return false;
+    }
+
+    return true;
+} // determine_unlink_for_content_addressed_object
+
 // =-=-=-=-=-=-=-
 // redirect_get - code to determine redirection for get operation
 irods::error s3RedirectCreate(
@@ -0,0 +1,141 @@
+#ifndef S3_TRANSPORT_ADMISSION_CONTROLLER_HPP
+#define S3_TRANSPORT_ADMISSION_CONTROLLER_HPP
+
+// local includes
+#include "irods/private/s3_transport/interprocess_sync.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+// system includes
+#include <sys/types.h>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // Returns true if the status indicates that the provider is throttling
+    // requests (503 SlowDown or ServiceUnavailable).
+    bool is_throttling_status(S3Status _status);
+
+    namespace shared_data
+    {
+        // the slots on a host held by one agent
+        struct admission_slot_owner
+        {
+            pid_t        pid{0};
+            std::int64_t slots{0};
+        };
+
+        struct admission_host_entry
+        {
+            static constexpr std::size_t MAXIMUM_HOST_LENGTH{256};
+            static constexpr std::size_t MAXIMUM_OWNERS{256};
+
+            char                 host[MAXIMUM_HOST_LENGTH]{};
+            double               limit{0.0};
+            std::int64_t         in_flight{0};
+            std::int64_t         last_decrease_us{0};
+            admission_slot_owner owners[MAXIMUM_OWNERS];
+            robust_condition     released;
+        };
+
+        struct admission_table
+        {
+            static constexpr std::size_t MAXIMUM_HOSTS{32};
+            static constexpr std::size_t MAXIMUM_PROCESSES{1024};
+
+            robust_mutex                     mutex;
+            bool                             removed{false};
+            process_set<MAXIMUM_PROCESSES>   processes;
+            std::size_t                      number_of_hosts{0};
+            admission_host_entry             hosts[MAXIMUM_HOSTS];
+        };
+    } // end namespace shared_data
+
+    // Limits the number of requests in flight to each host of a resource.
+    //
+    // The limit follows an additive increase / multiplicative decrease (AIMD)
+    // scheme.  Each successful request raises the limit by 1/limit (so about one
+    // per round of requests) up to the configured maximum.  A throttling response
+    // halves it, at most once per DECREASE_INTERVAL_US so that a burst of SlowDown
+    // responses to requests that were already in flight only counts once.
+    //
+    // The limits and in-flight counts are kept in shared memory so that all agents
+    // on the server share them.  Each slot is recorded against the agent holding
+    // it, and the slots of agents that died mid-request are reclaimed whenever a
+    // request has waited WAIT_INTERVAL_US for a slot.  The limit is never above the
+    // maximum configured for the agent taking a slot.  The last agent to detach
+    // removes the shared memory.
+    class admission_controller
+    {
+      public:
+        static constexpr double        DECREASE_FACTOR{0.5};
+        static constexpr double        MINIMUM_LIMIT{1.0};
+        static constexpr std::int64_t  DECREASE_INTERVAL_US{1000000};
+        static constexpr std::int64_t  WAIT_INTERVAL_US{1000000};
+        static constexpr unsigned int  DEFAULT_MAXIMUM_IN_FLIGHT{64};
+
+        inline static const std::string SHARED_MEMORY_KEY_PREFIX{"irods_s3_admission_v2-shm-"};
+
+        // Returns the controller for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> admission_controller&;
+
+        // Enables or disables the controller.  Until this is called with _enabled
+        // set to true every request is admitted immediately.
+        void configure(bool _enabled, unsigned int _maximum_in_flight);
+
+        // Waits until a request may be sent to the host.  Returns true if a slot
+        // was taken, in which case release() must be called once the request is done.
+        bool acquire(const std::string& _host);
+
+        // Takes a slot only if one is free right away, for optional requests such as
+        // hedges.  Returns std::nullopt if the host has no free slot, otherwise what
+        // acquire() would have returned.
+        auto try_acquire(const std::string& _host) -> std::optional<bool>;
+
+        void release(const std::string& _host, S3Status _status);
+
+        // Detaches the agent from the shared memory, removing it if no other live
+        // agent is attached.  The controller is disabled until configured again.
+        void detach();
+
+        auto to_json() const -> nlohmann::json;
+
+        explicit admission_controller(const std::string& _resource_name);
+
+      private:
+        static auto find_or_add_host(shared_data::admission_table& _table,
+                                     const std::string& _host,
+                                     double _initial_limit) -> shared_data::admission_host_entry*;
+
+        // Returns the owner entry of _pid on the host, taking a free one if _add is set.
+        static auto find_owner(shared_data::admission_host_entry& _entry, pid_t _pid, bool _add)
+            -> shared_data::admission_slot_owner*;
+
+        // Takes a slot on the host, waiting for one if _wait is set.  Returns std::nullopt
+        // if there is no free slot and _wait is not set.
+        auto take_slot(const std::string& _host, bool _wait) -> std::optional<bool>;
+
+        // Releases the slots of agents that are no longer running.
+        void reclaim_dead_owners(shared_data::admission_host_entry& _entry) const;
+
+        const std::string                                          resource_name_;
+        mutable std::mutex                                         mutex_;
+        bool                                                       enabled_;
+        double                                                     maximum_in_flight_;
+        shared_data::shared_table<shared_data::admission_table>    shared_table_;
+        shared_data::admission_table*                              table_;
+
+    }; // admission_controller
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_ADMISSION_CONTROLLER_HPP
@@ -0,0 +1,161 @@
+#ifndef S3_TRANSPORT_BUCKET_LISTER_HPP
+#define S3_TRANSPORT_BUCKET_LISTER_HPP
+
+// local includes
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    struct bucket_list_entry
+    {
+        std::string key;            // for a common prefix the delimiter is removed
+        bool        is_common_prefix;
+    };
+
+    // Iterates over the keys and common prefixes under a prefix of a bucket, in
+    // key order.
+    //
+    // The key space can be split into shards at a list of boundary keys.  Shard i
+    // holds the keys after boundary i-1 up to and including boundary i.  Each
+    // shard is a separate marker chain listed by its own thread, so a large flat
+    // prefix is listed concurrently.  The results are returned shard by shard,
+    // which keeps them in key order.  Without boundaries there is one shard.
+    //
+    // Pages are requested with the largest page size S3 supports.  Each shard
+    // fetches up to _pages_per_shard pages ahead of the caller, so with the
+    // default of one shard and one page the next page is fetched while the
+    // caller consumes the current one and at most two pages are held in memory.
+    //
+    // A bucket_lister is not thread safe.  The destructor stops the shard threads
+    // and waits for requests in progress to finish.  They are also stopped
+    // before the S3 library is deinitialized, after which the listing fails with
+    // S3StatusInterrupted.
+    class bucket_lister
+    {
+      public:
+        static constexpr int         MAXIMUM_KEYS_PER_PAGE{1000};
+        static constexpr std::size_t DEFAULT_PAGES_PER_SHARD{1};
+
+        // Characters commonly found in object names, used to split a prefix into
+        // shards when nothing is known about the keys.
+        inline static const std::string DEFAULT_ALPHABET{
+            "-.0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz"};
+
+        // Returns the boundaries splitting _prefix into (at most) _shard_count shards
+        // of roughly equal share of _alphabet.  Keys sampled from the bucket can be
+        // used as boundaries instead when the distribution of the keys is known.
+        static auto alphabet_boundaries(const std::string& _prefix,
+                                        std::size_t        _shard_count,
+                                        const std::string& _alphabet = DEFAULT_ALPHABET)
+            -> std::vector<std::string>;
+
+        // The strings referenced by _bucket_context are copied.  The hostName
+        // is ignored, a host is selected by the endpoint balancer of the resource
+        // for each page.  _retry_policy is copied for each page.
+        bucket_lister(const std::string&       _resource_name,
+                      const S3BucketContext&   _bucket_context,
+                      const std::string&       _prefix,
+                      const std::string&       _delimiter,
+                      const retry_policy&      _retry_policy,
+                      std::vector<std::string> _boundaries = {},
+                      std::size_t              _pages_per_shard = DEFAULT_PAGES_PER_SHARD);
+
+        ~bucket_lister();
+
+        bucket_lister(const bucket_lister&) = delete;
+        auto operator=(const bucket_lister&) -> bucket_lister& = delete;
+
+        // Sets _entry to the next entry or to nothing when the listing is complete.
+        // Returns the status of the failing request if a page could not be listed.
+        auto next(std::optional<bucket_list_entry>& _entry) -> S3Status;
+
+      private:
+        struct page
+        {
+            std::vector<bucket_list_entry> entries;
+            bool                           is_truncated{false};
+            std::string                    next_marker;
+            S3Status                       status{S3StatusOK};
+        };
+
+        struct shard
+        {
+            std::string                marker;      // list keys after this, empty for the start of the prefix
+            std::optional<std::string> end_at;      // last key of the shard, nothing for the end of the prefix
+            std::deque<page>           pages;
+            bool                       done{false};
+            S3Status                   status{S3StatusOK};
+            std::thread                worker;
+        };
+
+        auto fetch_page(const std::string& _marker) const -> page;
+        void run_shard(shard& _shard);
+
+        // Lists the next page of _shard and queues it.  Returns false when the
+        // shard is complete.
+        bool fetch_next_page(shard& _shard);
+
+        auto raw_key(const bucket_list_entry& _entry) const -> std::string;
+
+        // Stops and joins the shard threads and ends the shards not yet done.
+        void stop();
+
+        const std::string                   resource_name_;
+        const std::string                   bucket_name_;
+        const std::string                   access_key_id_;
+        const std::string                   secret_access_key_;
+        const std::string                   security_token_;
+        const std::string                   auth_region_;
+        const S3Protocol                    protocol_;
+        const S3UriStyle                    uri_style_;
+        const S3STSDate                     sts_date_;
+        const std::string                   prefix_;
+        const std::string                   delimiter_;
+        const retry_policy                  retry_policy_;
+        const std::size_t                   pages_per_shard_;
+
+        std::mutex                          mutex_;
+        std::condition_variable             cv_;
+        bool                                stopping_;
+        std::vector<std::unique_ptr<shard>> shards_;
+        std::uint64_t                       stop_hook_id_;
+
+        // only used by the caller's thread
+        std::size_t                         current_shard_;
+        page                                current_;
+        std::size_t                         position_;
+        std::optional<std::string>          last_raw_key_;
+
+    }; // bucket_lister
+
+    // Lists all keys (and common prefixes if _delimiter is not empty) under _prefix
+    // with _shard_count concurrent marker chains and calls _callback for each entry
+    // in key order.  The listing stops early if _callback returns false.
+    auto list_bucket(const std::string&                                  _resource_name,
+                     const S3BucketContext&                              _bucket_context,
+                     const std::string&                                  _prefix,
+                     const std::string&                                  _delimiter,
+                     const retry_policy&                                 _retry_policy,
+                     std::size_t                                         _shard_count,
+                     const std::function<bool(const bucket_list_entry&)>& _callback) -> S3Status;
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_BUCKET_LISTER_HPP
@@ -0,0 +1,212 @@
+#ifndef S3_TRANSPORT_BULK_DELETE_HPP
+#define S3_TRANSPORT_BULK_DELETE_HPP
+
+// local includes
+#include "irods/private/s3_transport/interprocess_sync.hpp"
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // A key that could not be deleted.  If the whole request failed, status is
+    // its status and code is empty.  Otherwise code and message are the S3
+    // error returned for the key.
+    struct delete_failure
+    {
+        std::string key;
+        S3Status    status;
+        std::string code;
+        std::string message;
+    };
+
+    // Deletes _keys from the bucket with multi-object delete requests of up to
+    // S3_MAX_DELETE_OBJECTS_COUNT keys.  The hostName of _bucket_context is
+    // ignored, a host is selected by the endpoint balancer of the resource for
+    // each request.
+    //
+    // Keys that cannot be sent in a multi-object delete (see
+    // S3_is_valid_delete_objects_key) are deleted one at a time.
+    //
+    // A request that fails is retried under _retry_policy.  Keys the provider
+    // reports as temporarily not deleted (InternalError, SlowDown,
+    // ServiceUnavailable) are sent again in the next attempt.  The keys that
+    // still could not be deleted are appended to _failures.  A key that does
+    // not exist counts as deleted.
+    //
+    // Returns S3StatusOK if every key was deleted, otherwise the status of the
+    // last failure.
+    auto delete_objects(const std::string&              _resource_name,
+                        const S3BucketContext&          _bucket_context,
+                        const std::vector<std::string>& _keys,
+                        const retry_policy&             _retry_policy,
+                        int                             _timeout_ms,
+                        std::vector<delete_failure>&    _failures) -> S3Status;
+
+    namespace shared_data
+    {
+        // A cancel of the deletes of a key pending when it was recorded.
+        struct delete_cancel_entry
+        {
+            std::uint64_t key_hash{0};
+            std::uint64_t sequence{0};
+        };
+
+        // A multi-object delete in progress.  sequence is the number of cancels
+        // recorded when its keys were checked.  A pid of zero marks a free slot.
+        struct delete_request_slot
+        {
+            pid_t         pid{0};
+            std::uint64_t sequence{0};
+        };
+
+        struct delete_batch_table
+        {
+            static constexpr std::size_t MAXIMUM_CANCELS{8192};
+            static constexpr std::size_t MAXIMUM_REQUESTS{256};
+            static constexpr std::size_t MAXIMUM_PROCESSES{1024};
+
+            robust_mutex                   mutex;
+            bool                           removed{false};
+            process_set<MAXIMUM_PROCESSES> processes;
+            robust_condition               request_finished;
+            std::uint64_t                  sequence{0};
+            delete_cancel_entry            cancels[MAXIMUM_CANCELS];
+            delete_request_slot            requests[MAXIMUM_REQUESTS];
+        };
+    } // end namespace shared_data
+
+    // Collects the unlinks of an agent and sends them as multi-object deletes.
+    //
+    // Keys are grouped per bucket (and credentials).  A group is due when it
+    // holds _batch_size keys or when its oldest key has been pending for
+    // _max_delay.  Due groups are sent when flush() is called, which the
+    // resource does after adding a key and when the agent stops, and by a
+    // flusher thread of the agent that wakes up at least every _max_delay so
+    // that the keys of an agent that stops unlinking are not held until it
+    // exits.
+    //
+    // A key written again while its delete is pending, by any agent, must be
+    // removed from the batches with cancel(), otherwise the new object would be
+    // deleted.  The cancels are recorded in a ring in shared memory, which the
+    // batchers of all agents check before sending a request, and cancel() waits
+    // for the requests of all agents that were sent before it.  A key added
+    // before the last MAXIMUM_CANCELS cancels is not deleted, since a cancel of
+    // it may have been overwritten, and is logged instead.  If the shared
+    // memory cannot be mapped cancels only apply to the agent itself.
+    class delete_batcher
+    {
+      public:
+        static constexpr std::size_t DEFAULT_BATCH_SIZE{S3_MAX_DELETE_OBJECTS_COUNT};
+        static constexpr std::chrono::milliseconds DEFAULT_MAXIMUM_DELAY{1000};
+        static constexpr std::chrono::microseconds WAIT_INTERVAL{100000};
+
+        inline static const std::string SHARED_MEMORY_KEY_PREFIX{"irods_s3_bulk_delete-shm-"};
+
+        // Returns the batcher for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> delete_batcher&;
+
+        explicit delete_batcher(const std::string& _resource_name);
+        ~delete_batcher();
+
+        delete_batcher(const delete_batcher&) = delete;
+        auto operator=(const delete_batcher&) -> delete_batcher& = delete;
+
+        void configure(bool _enabled, std::size_t _batch_size, std::chrono::milliseconds _max_delay);
+
+        bool enabled() const;
+
+        // Queues the delete of _key and starts the flusher of this agent if
+        // needed.  The strings referenced by _bucket_context are copied.  The
+        // flusher sends the due groups with _retry_policy and _timeout_ms.
+        void add(const S3BucketContext& _bucket_context,
+                 const std::string&     _key,
+                 const retry_policy&    _retry_policy,
+                 int                    _timeout_ms);
+
+        // Removes pending deletes of _key from the batches of all agents and
+        // waits for the requests already sent.  Returns true if one was pending
+        // in this agent.
+        bool cancel(const std::string& _bucket_name, const std::string& _key);
+
+        // Sends the due groups, or all groups if _all is set, and returns the keys
+        // that could not be deleted.
+        auto flush(const retry_policy& _retry_policy, int _timeout_ms, bool _all = false)
+            -> std::vector<delete_failure>;
+
+        // Stops the flusher of this agent and detaches from the shared cancels.
+        // Keys still pending are sent by the next flush().
+        void stop();
+
+        auto to_json() const -> nlohmann::json;
+
+      private:
+        struct pending_key
+        {
+            std::string   key;
+            std::uint64_t cancel_sequence;
+        };
+
+        struct pending_group
+        {
+            std::string                           bucket_name;
+            std::string                           access_key_id;
+            std::string                           secret_access_key;
+            std::string                           security_token;
+            std::string                           auth_region;
+            S3Protocol                            protocol;
+            S3UriStyle                            uri_style;
+            S3STSDate                             sts_date;
+            std::vector<pending_key>              keys;
+            std::chrono::steady_clock::time_point oldest;
+        };
+
+        void run_flusher();
+
+        // Removes the keys cancelled since they were added and claims a request
+        // slot.  Returns the slot, or nothing if the cancels are not shared.
+        auto begin_request(const std::string& _bucket_name, std::vector<pending_key>& _keys)
+            -> std::optional<std::size_t>;
+
+        void end_request(std::optional<std::size_t> _slot);
+
+        const std::string                    resource_name_;
+        mutable std::mutex                   mutex_;
+        std::condition_variable              cv_;
+        bool                                 enabled_;
+        std::size_t                          batch_size_;
+        std::chrono::milliseconds            max_delay_;
+        std::map<std::string, pending_group> pending_;
+        std::optional<retry_policy>          retry_policy_;
+        int                                  timeout_ms_;
+        bool                                 stopping_;
+        std::thread                          flusher_;
+
+        shared_data::shared_table<shared_data::delete_batch_table> shared_table_;
+
+        // statistics
+        std::uint64_t                        keys_queued_;
+        std::uint64_t                        keys_cancelled_;
+        std::uint64_t                        keys_failed_;
+        std::uint64_t                        batches_sent_;
+
+    }; // delete_batcher
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_BULK_DELETE_HPP
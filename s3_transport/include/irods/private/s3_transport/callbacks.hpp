@@ -33,6 +33,7 @@
 #include "irods/private/s3_transport/circular_buffer.hpp"
 #include "irods/private/s3_transport/managed_shared_memory_object.hpp"
 #include "irods/private/s3_transport/multipart_shared_data.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
 #include "irods/private/s3_transport/types.hpp"
 #include "irods/private/s3_transport/logging_category.hpp"
 #include "irods/irods_hasher_factory.hpp"
@@ -48,6 +49,10 @@ namespace irods::experimental::io::s3_transport
     namespace log  = irods::experimental::log;
     using logger = log::logger<s3_transport_logging_category>;
 
+    using named_shared_memory_object =
+        irods::experimental::interprocess::shared_memory::named_shared_memory_object
+        <shared_data::multipart_shared_data>;
+
     template <typename CharT>
     class s3_transport;
 
@@ -63,6 +68,10 @@ namespace irods::experimental::io::s3_transport
                 , bytes_read_from_s3{0}
                 , shmem_key{}
                 , shared_memory_timeout_in_seconds{constants::DEFAULT_SHARED_MEMORY_TIMEOUT_IN_SECONDS}
+                , shm_obj_ptr{nullptr}
+                , resource_name{}
+                , user_name{}
+                , limiter{nullptr}
                 , callback_counter{0}
                 , status{libs3_types::status_ok}
             {}
@@ -74,22 +83,18 @@ namespace irods::experimental::io::s3_transport
                                                        const libs3_types::char_type *libs3_buffer,
                                                        void *callback_data)
             {
-                using named_shared_memory_object =
-                    irods::experimental::interprocess::shared_memory::named_shared_memory_object
-                    <shared_data::multipart_shared_data>;
-
                 callback_for_read_from_s3_base *data =
                     static_cast<callback_for_read_from_s3_base*>(callback_data);
 
                 // just touch shmem so we know we are active
                 if (data->callback_counter++ % 10000 == 0) {
-                    auto shmem_key =  data->shmem_key;
-                    auto shared_memory_timeout_in_seconds = data->shared_memory_timeout_in_seconds;
+                    data->shm_obj_ptr->exec([](auto&) {});
+                }
 
-                    named_shared_memory_object shm_obj{shmem_key,
-                        shared_memory_timeout_in_seconds,
-                        constants::MAX_S3_SHMEM_SIZE};
+                if (!data->limiter) {
+                    data->limiter = &rate_limiter::for_resource(data->resource_name);
                 }
+                data->limiter->acquire_transfer_bytes(libs3_buffer_size, data->user_name);
 
                 return data->callback_implementation(libs3_buffer_size, libs3_buffer);
             }
@@ -120,6 +125,10 @@ namespace irods::experimental::io::s3_transport
             std::int64_t                 bytes_read_from_s3;
             std::string                  shmem_key;
             time_t                       shared_memory_timeout_in_seconds;
+            named_shared_memory_object*  shm_obj_ptr;     // mapped by the transport for the open
+            std::string                  resource_name;   // for bandwidth limits
+            std::string                  user_name;
+            rate_limiter*                limiter;         // looked up on the first chunk of the transfer
 
             // Counter incremented each data callback.  Every Nth iteration touch shared memory
             // so that we know the process didn't die and leave shared memory corrupted
@@ -143,7 +152,7 @@ namespace irods::experimental::io::s3_transport
                 assert(libs3_buffer_size >= 0);
 
                 if (!cache_fstream.is_open()) {
-                    cache_fstream.open(filename.c_str(), std::ios_base::out);
+                    cache_fstream.open(filename.c_str(), std::ios_base::in | std::ios_base::out);
                 }
 
                 if (!cache_fstream) {
@@ -173,10 +182,12 @@ namespace irods::experimental::io::s3_transport
                 }
             };
 
+            // The cache file must exist.  It is not truncated since each thread writes its
+            // own range of the file.
             void set_and_open_cache_file(std::string& f)
             {
                 filename = f;
-                cache_fstream.open(filename.c_str(), std::ios_base::out);
+                cache_fstream.open(filename.c_str(), std::ios_base::in | std::ios_base::out);
                 if (!cache_fstream) {
                     logger::error("{}:{} ({}) [[{}]] could not open cache file",
                             __FILE__, __LINE__, __func__, this->thread_identifier);
@@ -268,6 +279,10 @@ namespace irods::experimental::io::s3_transport
                     , object_key{}
                     , shmem_key{}
                     , shared_memory_timeout_in_seconds{constants::DEFAULT_SHARED_MEMORY_TIMEOUT_IN_SECONDS}
+                    , shm_obj_ptr{nullptr}
+                    , resource_name{}
+                    , user_name{}
+                    , limiter{nullptr}
                     , content_length{0}
                     , saved_bucket_context{_saved_bucket_context}
                     , manager{_manager}
@@ -292,24 +307,20 @@ namespace irods::experimental::io::s3_transport
                                            void *callback_data)
                 {
 
-                    using named_shared_memory_object =
-                        irods::experimental::interprocess::shared_memory::named_shared_memory_object
-                        <shared_data::multipart_shared_data>;
-
                     callback_for_write_to_s3_base *data =
                         static_cast<callback_for_write_to_s3_base*>(callback_data);
 
                     // just touch shmem so we know we are active
                     if (data->callback_counter++ % 10000 == 0) {
-                        auto shmem_key =  data->shmem_key;
-                        auto shared_memory_timeout_in_seconds = data->shared_memory_timeout_in_seconds;
-
-                        named_shared_memory_object shm_obj{shmem_key,
-                            shared_memory_timeout_in_seconds,
-                            constants::MAX_S3_SHMEM_SIZE};
+                        data->shm_obj_ptr->exec([](auto&) {});
                     }
 
-                    return data->callback_implementation(libs3_buffer_size, libs3_buffer);
+                    const int bytes = data->callback_implementation(libs3_buffer_size, libs3_buffer);
+                    if (!data->limiter) {
+                        data->limiter = &rate_limiter::for_resource(data->resource_name);
+                    }
+                    data->limiter->acquire_transfer_bytes(bytes, data->user_name);
+                    return bytes;
                 }
 
                 static libs3_types::status on_response_properties(const libs3_types::response_properties *properties,
@@ -346,6 +357,10 @@ namespace irods::experimental::io::s3_transport
                 std::string                  object_key;
                 std::string                  shmem_key;
                 time_t                       shared_memory_timeout_in_seconds;
+                named_shared_memory_object*  shm_obj_ptr;     // mapped by the transport for the open
+                std::string                  resource_name;   // for bandwidth limits
+                std::string                  user_name;
+                rate_limiter*                limiter;         // looked up on the first chunk of the transfer
 
                 std::int64_t                 content_length;
                 libs3_types::bucket_context& saved_bucket_context; // To enable more detailed error messages
@@ -456,10 +471,6 @@ namespace irods::experimental::io::s3_transport
                 int callback_implementation(int libs3_buffer_size,
                                             libs3_types::buffer_type libs3_buffer)
                 {
-                    using named_shared_memory_object =
-                        irods::experimental::interprocess::shared_memory::named_shared_memory_object
-                        <shared_data::multipart_shared_data>;
-
                     assert(libs3_buffer_size >= 0);
 
                     // if a critical error occurred in the transport, the writer to the buffer
@@ -491,18 +502,8 @@ namespace irods::experimental::io::s3_transport
                                 __FILE__, __LINE__, __func__, this->thread_identifier);
 
                         // save that we got a timeout so that we don't keep retrying
-
-                        auto shmem_key =  this->shmem_key;
-                        auto shared_memory_timeout_in_seconds = this->shared_memory_timeout_in_seconds;
-
-                        named_shared_memory_object shm_obj{shmem_key,
-                            shared_memory_timeout_in_seconds,
-                            constants::MAX_S3_SHMEM_SIZE};
-
-                        shm_obj.atomic_exec([](auto& data) {
-
+                        this->shm_obj_ptr->exec([](auto& data) {
                             data.circular_buffer_read_timeout = true;
-
                         });
 
                         return 0;
@@ -586,6 +587,10 @@ namespace irods::experimental::io::s3_transport
                     , object_key{}
                     , shmem_key{}
                     , shared_memory_timeout_in_seconds{constants::DEFAULT_SHARED_MEMORY_TIMEOUT_IN_SECONDS}
+                    , shm_obj_ptr{nullptr}
+                    , resource_name{}
+                    , user_name{}
+                    , limiter{nullptr}
                     , sequence{0}
                     , content_length{0}
                     , saved_bucket_context{_saved_bucket_context}
@@ -611,23 +616,19 @@ namespace irods::experimental::io::s3_transport
                                            void *callback_data)
                 {
 
-                    using named_shared_memory_object =
-                        irods::experimental::interprocess::shared_memory::named_shared_memory_object
-                        <shared_data::multipart_shared_data>;
-
                     callback_for_write_to_s3_base *data = static_cast<callback_for_write_to_s3_base*>(callback_data);
 
                     // just touch shmem so we know we are active
                     if (data->callback_counter++ % 10000 == 0) {
-                        auto shmem_key =  data->shmem_key;
-                        auto shared_memory_timeout_in_seconds = data->shared_memory_timeout_in_seconds;
-
-                        named_shared_memory_object shm_obj{shmem_key,
-                            shared_memory_timeout_in_seconds,
-                            constants::MAX_S3_SHMEM_SIZE};
+                        data->shm_obj_ptr->exec([](auto&) {});
                     }
 
-                    return data->callback_implementation(libs3_buffer_size, libs3_buffer);
+                    const int bytes = data->callback_implementation(libs3_buffer_size, libs3_buffer);
+                    if (!data->limiter) {
+                        data->limiter = &rate_limiter::for_resource(data->resource_name);
+                    }
+                    data->limiter->acquire_transfer_bytes(bytes, data->user_name);
+                    return bytes;
                 }
 
                 static libs3_types::status on_response_properties(const libs3_types::response_properties *properties,
@@ -639,19 +640,7 @@ namespace irods::experimental::io::s3_transport
                     callback_for_write_to_s3_base *callback_for_write_to_s3_base_data
                         = static_cast<callback_for_write_to_s3_base*>(callback_data);
 
-                    using named_shared_memory_object =
-                        irods::experimental::interprocess::shared_memory::named_shared_memory_object
-                        <shared_data::multipart_shared_data>;
-
-                    auto shmem_key =  callback_for_write_to_s3_base_data->shmem_key;
-                    auto shared_memory_timeout_in_seconds =
-                        callback_for_write_to_s3_base_data->shared_memory_timeout_in_seconds;
-
-                    named_shared_memory_object shm_obj{shmem_key,
-                        shared_memory_timeout_in_seconds,
-                        constants::MAX_S3_SHMEM_SIZE};
-
-                    return shm_obj.atomic_exec([properties,
+                    return callback_for_write_to_s3_base_data->shm_obj_ptr->atomic_exec([properties,
                             &callback_for_write_to_s3_base_data](auto& data) {
 
                         const char *etag = properties->eTag;
@@ -701,6 +690,10 @@ namespace irods::experimental::io::s3_transport
                 std::string                  object_key;
                 std::string                  shmem_key;
                 time_t                       shared_memory_timeout_in_seconds;
+                named_shared_memory_object*  shm_obj_ptr;     // mapped by the transport for the open
+                std::string                  resource_name;   // for bandwidth limits
+                std::string                  user_name;
+                rate_limiter*                limiter;         // looked up on the first chunk of the transfer
 
                 std::uint64_t                sequence;
                 std::int64_t                 content_length;
@@ -817,10 +810,6 @@ namespace irods::experimental::io::s3_transport
                 int callback_implementation(int libs3_buffer_size,
                                             libs3_types::buffer_type libs3_buffer)
                 {
-                    using named_shared_memory_object =
-                        irods::experimental::interprocess::shared_memory::named_shared_memory_object
-                        <shared_data::multipart_shared_data>;
-
                     assert(libs3_buffer_size >= 0);
 
                     // if a critical error occurred in the transport, the writer to the buffer
@@ -857,17 +846,8 @@ namespace irods::experimental::io::s3_transport
                                 __FILE__, __LINE__, __func__, this->thread_identifier);
 
                         // save that we got a timeout so that we don't keep retrying
-                        auto shmem_key =  this->shmem_key;
-                        auto shared_memory_timeout_in_seconds = this->shared_memory_timeout_in_seconds;
-
-                        named_shared_memory_object shm_obj{shmem_key,
-                            shared_memory_timeout_in_seconds,
-                            constants::MAX_S3_SHMEM_SIZE};
-
-                        shm_obj.atomic_exec([](auto& data) {
-
+                        this->shm_obj_ptr->exec([](auto& data) {
                             data.circular_buffer_read_timeout = true;
-
                         });
 
                         return 0;
@@ -918,6 +898,23 @@ namespace irods::experimental::io::s3_transport
                                       void *callback_data);
         } // end namespace cancel_callback
 
+        // Copying a range of the existing object as a part of the upload
+        namespace copy_part_callback
+        {
+            struct data
+            {
+                libs3_types::bucket_context& saved_bucket_context;
+                libs3_types::status          status;
+            };
+
+            libs3_types::status on_response_properties (const libs3_types::response_properties *properties,
+                                                        void *callback_data);
+
+            void on_response_completion (libs3_types::status status,
+                                         const libs3_types::error_details *error,
+                                         void *callback_data);
+        } // end namespace copy_part_callback
+
     } // end namespace s3_multipart_upload
 
     namespace restore_object_callback
@@ -0,0 +1,77 @@
+#ifndef S3_TRANSPORT_COMPRESSION_HPP
+#define S3_TRANSPORT_COMPRESSION_HPP
+
+// local includes
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // Objects are compressed into independently decodable zstd frames of
+    // COMPRESSION_FRAME_SIZE bytes followed by a seek table in the zstd
+    // seekable format, which maps every frame to its range in the object
+    // before and after compression.  A range of the object is read by fetching
+    // and decoding only the frames that hold it.  The zstd command line tool
+    // decompresses such an object as is.
+    //
+    // A compressed object carries user metadata naming the codec, its size
+    // before and after compression, and the size of the seek table at its end,
+    // so that a HEAD is enough to report its size and locate the seek table.
+    inline const std::string  COMPRESSION_CODEC{"zstd-seekable"};
+    inline const std::string  COMPRESSION_CODEC_META_DATA{"irods-compression"};
+    inline const std::string  LOGICAL_SIZE_META_DATA{"irods-logical-size"};
+    inline const std::string  COMPRESSED_SIZE_META_DATA{"irods-compressed-size"};
+    inline const std::string  SEEK_TABLE_SIZE_META_DATA{"irods-seek-table-size"};
+
+    constexpr std::int64_t    COMPRESSION_FRAME_SIZE{1024 * 1024};
+    constexpr int             DEFAULT_COMPRESSION_LEVEL{3};
+    constexpr int             MAXIMUM_COMPRESSION_LEVEL{19};
+
+    struct compressed_object
+    {
+        std::int64_t logical_size;
+        std::int64_t compressed_size;   // including the seek table
+        std::int64_t seek_table_size;
+
+        // The user metadata stored with the object.
+        auto meta_data() const -> std::map<std::string, std::string>;
+    };
+
+    // Returns the compressed object described by the user metadata of an
+    // object, or nothing if the object is not compressed.
+    auto compressed_object_from_meta_data(const std::map<std::string, std::string>& _meta_data)
+        -> std::optional<compressed_object>;
+
+    // Compresses the file _input_fd into the empty file _output_fd at _level.
+    // Returns nothing if a file could not be read or written.
+    auto compress_file(int _input_fd, int _output_fd, int _level) -> std::optional<compressed_object>;
+
+    // Downloads a compressed object and writes its decompressed bytes into the
+    // file _fd, which is truncated to the size of the object.
+    //
+    // The seek table is read first.  The frames are then fetched in range GETs
+    // of about _chunk_size compressed bytes by _number_of_threads threads, and
+    // each frame is decoded and written at its offset as soon as its range
+    // arrives.  The hostName of the bucket context is ignored, a host is
+    // selected by the endpoint balancer of the resource for each request.
+    auto download_compressed_object(const std::string&       _resource_name,
+                                    const S3BucketContext&   _bucket_context,
+                                    const std::string&       _key,
+                                    const compressed_object& _object,
+                                    int                      _fd,
+                                    std::int64_t             _chunk_size,
+                                    unsigned int             _number_of_threads,
+                                    const retry_policy&      _retry_policy) -> S3Status;
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_COMPRESSION_HPP
@@ -0,0 +1,43 @@
+#ifndef S3_TRANSPORT_CONTENT_ADDRESS_HPP
+#define S3_TRANSPORT_CONTENT_ADDRESS_HPP
+
+// stdlib includes
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace irods::experimental::io::s3_transport::content_address
+{
+
+    // With content addressed naming an object is named by the SHA-256 of its
+    // contents, "<KEY_PREFIX><hex digest>", so that the replicas with the same
+    // contents share one object.  The digest is also stored in the user
+    // metadata of the object when it is uploaded, so that an object written
+    // under such a key by other means is not mistaken for the contents.
+    inline const std::string KEY_PREFIX{"irods_s3_content/sha256/"};
+    inline const std::string DIGEST_META_DATA{"irods-sha256"};
+
+    // True if _key names an object by its contents.
+    bool is_key(const std::string& _key);
+
+    // Returns the key of the contents of the file _fd, read from its current
+    // offset to its end.  Returns nothing if the file could not be read, with
+    // errno set, or if the digest could not be computed, with errno set to 0.
+    auto key_of_file(int _fd) -> std::optional<std::string>;
+
+    // Returns the digest a key names, or an empty string if it is not a key
+    // named by contents.
+    auto digest_of_key(const std::string& _key) -> std::string;
+
+    // True if an object of _object_size bytes with the user metadata
+    // _meta_data, found under _key, holds contents of _size bytes named by
+    // _key and so can be shared instead of uploaded again.
+    bool holds_contents(const std::string&                        _key,
+                        std::int64_t                              _size,
+                        std::int64_t                              _object_size,
+                        const std::map<std::string, std::string>& _meta_data);
+
+} // irods::experimental::io::s3_transport::content_address
+
+#endif // S3_TRANSPORT_CONTENT_ADDRESS_HPP
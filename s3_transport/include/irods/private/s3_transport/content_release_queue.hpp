@@ -0,0 +1,69 @@
+#ifndef S3_TRANSPORT_CONTENT_RELEASE_QUEUE_HPP
+#define S3_TRANSPORT_CONTENT_RELEASE_QUEUE_HPP
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // The objects named by their contents that no replica referred to when
+    // they were released, kept in a file in the cache directory shared by all
+    // agents of a resource on the server.
+    //
+    // An object is not deleted when its last replica is unlinked.  A replica
+    // synchronized to the same contents at that time finds the object, and is
+    // registered to it after the unlink counted the replicas.  Instead the
+    // object is queued and deleted by a later operation once GRACE_PERIOD has
+    // passed, if no replica refers to it by then.
+    //
+    // Each record is appended with a single write, and the file is rewritten
+    // under an exclusive lock when the due records are taken.  A record of an
+    // object that could not be deleted is added again by the caller.
+    class content_release_queue
+    {
+      public:
+        static constexpr std::chrono::seconds GRACE_PERIOD{600};
+        inline static const std::string       FILE_NAME{".irods_s3_content_releases"};
+
+        struct entry
+        {
+            std::string  bucket_name;
+            std::string  key;
+            std::int64_t time;
+        };
+
+        // Returns the queue for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> content_release_queue&;
+
+        explicit content_release_queue(const std::string& _resource_name);
+
+        content_release_queue(const content_release_queue&) = delete;
+        auto operator=(const content_release_queue&) -> content_release_queue& = delete;
+
+        // The file is FILE_NAME in _cache_directory.
+        void configure(const std::string& _cache_directory, std::chrono::seconds _grace_period = GRACE_PERIOD);
+
+        // Durably records that _key in _bucket_name may be deleted once the
+        // grace period has passed.  Returns false if it could not be recorded.
+        bool add(const std::string& _bucket_name, const std::string& _key);
+
+        // Removes and returns the entries whose grace period has passed.
+        auto take_due() -> std::vector<entry>;
+
+      private:
+        const std::string    resource_name_;
+
+        mutable std::mutex   mutex_;
+        std::string          path_;
+        std::chrono::seconds grace_period_;
+
+    }; // content_release_queue
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_CONTENT_RELEASE_QUEUE_HPP
@@ -0,0 +1,144 @@
+#ifndef S3_TRANSPORT_DELETE_QUEUE_HPP
+#define S3_TRANSPORT_DELETE_QUEUE_HPP
+
+// local includes
+#include "irods/private/s3_transport/bulk_delete.hpp"
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // A durable queue of objects to delete, kept in files under a directory
+    // shared by all agents of a resource on the server.
+    //
+    // An unlink appends a record to the "queue" file and returns.  A drainer
+    // thread, run by at most one agent at a time, renames the queue file to
+    // "draining" and deletes its keys with multi-object delete requests sent by
+    // up to _number_of_threads threads.  A draining file left by an agent that
+    // crashed is replayed by the next drainer.  Deletes that fail with a
+    // transient error are appended to the queue again, others are logged.
+    //
+    // Writing a key while its delete is queued must call cancel(), which appends
+    // a cancel record and waits for the delete requests in progress, so the
+    // drainer never deletes an object written after the unlink.  Each delete
+    // request reads the cancels under a shared lock held until it completes
+    // and the cancel takes that lock exclusively, so a cancel waits for at most
+    // one request per drainer thread.
+    class delete_queue
+    {
+      public:
+        static constexpr unsigned int              DEFAULT_NUMBER_OF_THREADS{4};
+        static constexpr std::chrono::milliseconds POLL_INTERVAL{1000};
+        inline static const std::string            DIRECTORY_NAME{".irods_s3_delete_queue"};
+
+        // Returns the queue for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> delete_queue&;
+
+        explicit delete_queue(const std::string& _resource_name);
+        ~delete_queue();
+
+        delete_queue(const delete_queue&) = delete;
+        auto operator=(const delete_queue&) -> delete_queue& = delete;
+
+        // The queue files are kept in DIRECTORY_NAME under _cache_directory.
+        void configure(bool _enabled, const std::string& _cache_directory, unsigned int _number_of_threads);
+
+        bool enabled() const;
+
+        // Durably queues the delete of _key and starts the drainer of this agent if
+        // needed.  The drainer uses the credentials of _bucket_context (the strings
+        // are copied), _retry_policy and _timeout_ms.  Returns false if the record
+        // could not be written, in which case the caller deletes the object itself.
+        bool enqueue(const S3BucketContext& _bucket_context,
+                     const std::string&     _key,
+                     const retry_policy&    _retry_policy,
+                     int                    _timeout_ms);
+
+        // Prevents queued deletes of _key from deleting an object written after
+        // this returns.
+        void cancel(const std::string& _bucket_name, const std::string& _key);
+
+        // Stops the drainer of this agent.  Keys it has not deleted stay queued.
+        void stop();
+
+        auto to_json() const -> nlohmann::json;
+
+      private:
+        struct entry
+        {
+            std::string bucket_name;
+            std::string key;
+        };
+
+        struct credentials
+        {
+            std::string access_key_id;
+            std::string secret_access_key;
+            std::string security_token;
+            std::string auth_region;
+            S3Protocol  protocol;
+            S3UriStyle  uri_style;
+            S3STSDate   sts_date;
+        };
+
+        auto path(const std::string& _file_name) const -> std::string;
+
+        bool append(const std::vector<std::string>& _records);
+        auto read_entries(const std::string& _file_name, bool _cancels_only) const -> std::vector<entry>;
+
+        // The (bucket, key) of the cancel records in the queue file.
+        auto read_cancels() const -> std::set<std::pair<std::string, std::string>>;
+
+        void run_drainer();
+
+        // Renames the queue to the draining file.  Returns false if the queue is empty.
+        bool rotate_queue();
+
+        // Deletes the keys of the draining file and removes it.  Returns false if
+        // the drainer is stopping or should wait before draining again.
+        bool process_draining();
+
+        // Returns true if a delete that failed was queued again.
+        bool delete_chunk(std::vector<entry>& _chunk);
+
+        const std::string            resource_name_;
+
+        mutable std::mutex           mutex_;
+        std::condition_variable      cv_;
+        bool                         enabled_;
+        std::string                  directory_;
+        unsigned int                 number_of_threads_;
+        std::optional<credentials>   credentials_;
+        std::optional<retry_policy>  retry_policy_;
+        int                          timeout_ms_;
+        bool                         stopping_;
+        std::thread                  drainer_;
+
+        // statistics
+        std::uint64_t                keys_queued_;
+        std::uint64_t                keys_cancelled_;
+        std::uint64_t                keys_deleted_;
+        std::uint64_t                keys_requeued_;
+        std::uint64_t                keys_failed_;
+
+    }; // delete_queue
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_DELETE_QUEUE_HPP
@@ -0,0 +1,198 @@
+#ifndef S3_TRANSPORT_ENDPOINT_BALANCER_HPP
+#define S3_TRANSPORT_ENDPOINT_BALANCER_HPP
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // Returns true if the status indicates that the endpoint itself is not healthy
+    // (name lookup, connection failures, timeouts, or server errors) rather than an
+    // error caused by the request itself (not found, access denied, etc.).
+    bool is_endpoint_failure(S3Status _status);
+
+    // Chooses which of the hosts in S3_DEFAULT_HOSTNAME a request is sent to.
+    //
+    // For every host an exponentially weighted moving average (EWMA) of the request
+    // latency and of the failure rate is kept along with the number of requests that
+    // are currently in flight.  The latency of a request that moved more than
+    // LATENCY_REFERENCE_BYTES is scaled down to the time taken per LATENCY_REFERENCE_BYTES
+    // so that a host serving large parts does not look slower than one answering HEADs.  The healthy host with the lowest expected cost
+    // ((latency + FAILURE_PENALTY_US * failure rate) * (in flight + 1)) is chosen.  A
+    // host that has failed but never succeeded is given a latency of FAILURE_PENALTY_US.
+    // Hosts that have not yet been used are preferred so that every host gets a sample.
+    //
+    // After EJECT_AFTER_CONSECUTIVE_FAILURES consecutive failures a host is ejected.
+    // Once the ejection period has elapsed select_host() hands the host out once as a
+    // probe.  If the probe succeeds the host is back in rotation, otherwise the ejection
+    // period is doubled (up to MAXIMUM_EJECTION_TIME).  A probe that is never reported
+    // (the host was selected but no request was sent) is given up after PROBE_TIMEOUT.
+    // Callers that only need a host name and do not track a request against it use
+    // current_host(), which never hands out a probe.
+    //
+    // There is one balancer per resource in each agent.  All threads of the agent
+    // (archive mode workers and s3_transport threads in cacheless mode) share it.
+    class endpoint_balancer
+    {
+      public:
+        static constexpr unsigned int              EJECT_AFTER_CONSECUTIVE_FAILURES{3};
+        static constexpr std::chrono::milliseconds INITIAL_EJECTION_TIME{5000};
+        static constexpr std::chrono::milliseconds MAXIMUM_EJECTION_TIME{120000};
+        static constexpr std::chrono::milliseconds PROBE_TIMEOUT{300000};
+        static constexpr double                    EWMA_WEIGHT{0.2};
+        static constexpr double                    FAILURE_PENALTY_US{1000000.0};
+        static constexpr std::int64_t              LATENCY_REFERENCE_BYTES{1024 * 1024};
+
+        struct host_statistics
+        {
+            std::string   host;
+            double        ewma_latency_us{0.0};
+            double        ewma_failure_rate{0.0};
+            std::uint64_t in_flight{0};
+            std::uint64_t requests{0};
+            std::uint64_t failures{0};
+            std::uint64_t ejections{0};
+            unsigned int  consecutive_failures{0};
+            bool          ejected{false};
+            std::int64_t  ejected_for_ms{0};
+        };
+
+        // Returns the balancer for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> endpoint_balancer&;
+
+        // Sets the list of hosts.  Statistics are kept for hosts that remain in the list.
+        void set_hosts(const std::vector<std::string>& _hosts);
+
+        // Returns the host that should be used for the next request or an empty
+        // string if no hosts have been set.  If the host is an ejected host due for a
+        // probe, the probe is claimed before the lock is released so that no other
+        // thread sends one.
+        auto select_host() -> std::string;
+
+        // Returns the host select_host() would choose among the hosts in rotation without
+        // claiming a probe or moving the round robin on.  For requests that are not
+        // tracked by an endpoint_request (e.g. initializing the library or filling in
+        // a default host name).
+        auto current_host() const -> std::string;
+
+        void request_started(const std::string& _host);
+
+        // _bytes is the number of bytes the request moved, if known.
+        void request_finished(const std::string& _host,
+                              bool _success,
+                              std::chrono::microseconds _elapsed,
+                              std::int64_t _bytes = 0);
+
+        // The request ended without a result for the host (e.g. an exception was thrown
+        // or it was never sent).  Only the in flight count and a claimed probe are released.
+        void request_abandoned(const std::string& _host);
+
+        // The request was cancelled after _elapsed because another request for the
+        // same data answered first.  It is not counted as a success or a failure but,
+        // as the host took at least _elapsed, that is folded into its latency.
+        void request_cancelled(const std::string& _host, std::chrono::microseconds _elapsed);
+
+        auto statistics() const -> std::vector<host_statistics>;
+
+        // True if a request to any host has failed or a host has been ejected in this agent.
+        bool degraded() const;
+
+        // Per-host statistics, suitable for logging.
+        auto to_json() const -> nlohmann::json;
+
+      private:
+        using clock_type = std::chrono::steady_clock;
+
+        struct host_state
+        {
+            std::string                 host;
+            double                      ewma_latency_us{0.0};
+            double                      ewma_failure_rate{0.0};
+            std::uint64_t               in_flight{0};
+            std::uint64_t               requests{0};
+            std::uint64_t               failures{0};
+            std::uint64_t               ejections{0};
+            unsigned int                consecutive_failures{0};
+            bool                        ejected{false};
+            bool                        probe_in_flight{false};
+            std::chrono::milliseconds   ejection_time{INITIAL_EJECTION_TIME};
+            clock_type::time_point      ejected_until{};
+            clock_type::time_point      probe_claimed_until{};
+        };
+
+        auto find_host(const std::string& _host) -> host_state*;
+
+        // The mutex must be held and there must be at least one host.  Returns the index
+        // of the host to use, which is an ejected host due for a probe only if _allow_probe
+        // is set.  The probe is not claimed.
+        auto choose_host(clock_type::time_point _now, bool _allow_probe) const -> std::size_t;
+
+        static bool probe_due(const host_state& _state, clock_type::time_point _now);
+
+        mutable std::mutex      mutex_;
+        std::vector<host_state> hosts_;
+        std::size_t             next_index_{0};
+
+    }; // endpoint_balancer
+
+    // Tracks one request against a host selected by the balancer of a resource.
+    // The request is counted as in flight from construction until finish() or cancel()
+    // is called or the object is destroyed.  The constructor waits for the request rate limits of
+    // the resource (and of _user_name if given) and, if adaptive concurrency is enabled
+    // for the resource, for an admission slot on the host.
+    class endpoint_request
+    {
+      public:
+        endpoint_request(const std::string& _resource_name,
+                         const std::string& _host,
+                         const std::string& _user_name = "");
+        ~endpoint_request();
+
+        // Starts a request only if the rate limits and the admission controller let it
+        // be sent right away, for optional requests such as hedges.  Returns nullptr,
+        // taking nothing, otherwise.
+        static auto try_start(const std::string& _resource_name,
+                              const std::string& _host,
+                              const std::string& _user_name = "") -> std::unique_ptr<endpoint_request>;
+
+        endpoint_request(const endpoint_request&) = delete;
+        auto operator=(const endpoint_request&) -> endpoint_request& = delete;
+
+        // _bytes is the number of bytes the request moved, if known.
+        void finish(S3Status _status, std::int64_t _bytes = 0);
+
+        // The request was cancelled because another request for the same data
+        // answered first (see endpoint_balancer::request_cancelled).
+        void cancel();
+
+        auto user_name() const -> const std::string& { return user_name_; }
+
+      private:
+        endpoint_request(const std::string& _resource_name,
+                         const std::string& _host,
+                         const std::string& _user_name,
+                         bool _admission_acquired);
+
+        std::string                           resource_name_;
+        endpoint_balancer&                    balancer_;
+        std::string                           host_;
+        std::string                           user_name_;
+        bool                                  admission_acquired_;
+        std::chrono::steady_clock::time_point start_;
+        bool                                  finished_;
+
+    }; // endpoint_request
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_ENDPOINT_BALANCER_HPP
@@ -0,0 +1,153 @@
+#ifndef S3_TRANSPORT_HEDGED_GET_HPP
+#define S3_TRANSPORT_HEDGED_GET_HPP
+
+// local includes
+#include "irods/private/s3_transport/interprocess_sync.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    class endpoint_request;
+
+    namespace shared_data
+    {
+        // The samples and the token bucket of a hedge_controller.
+        struct hedge_statistics
+        {
+            static constexpr std::size_t SAMPLE_COUNT{512};
+
+            std::int64_t  samples[SAMPLE_COUNT]{};
+            std::size_t   sample_count{0};
+            std::size_t   next_sample{0};
+            std::size_t   samples_since_recalculation{0};
+            bool          has_delay{false};
+            std::int64_t  delay_us{0};
+            double        tokens{0.0};
+            std::uint64_t requests{0};
+            std::uint64_t hedges{0};
+            std::uint64_t hedges_won{0};
+        };
+
+        struct hedge_table
+        {
+            static constexpr std::size_t MAXIMUM_PROCESSES{1024};
+
+            robust_mutex                   mutex;
+            bool                           removed{false};
+            process_set<MAXIMUM_PROCESSES> processes;
+            hedge_statistics               statistics;
+        };
+    } // end namespace shared_data
+
+    // Decides when a range GET of a resource is hedged.
+    //
+    // The time to first byte of GET requests is sampled.  Once enough samples
+    // are available the hedge delay is the configured percentile of the samples.
+    // A GET that has not received any data by then gets a duplicate request.
+    //
+    // The number of hedges is capped with a token bucket.  Every GET adds
+    // maximum_hedge_ratio tokens (up to MAXIMUM_BURST) and every hedge takes one,
+    // so at most that fraction of requests is duplicated even when the provider
+    // is slow for everyone.
+    //
+    // The samples and the tokens of a resource are kept in shared memory so
+    // that all agents on the server learn the delay together and share the cap.
+    // If the shared memory cannot be mapped each agent keeps its own.
+    class hedge_controller
+    {
+      public:
+        static constexpr std::size_t SAMPLE_COUNT{shared_data::hedge_statistics::SAMPLE_COUNT};
+        static constexpr std::size_t MINIMUM_SAMPLES{32};
+        static constexpr std::size_t SAMPLES_PER_RECALCULATION{16};
+        static constexpr double      MAXIMUM_BURST{10.0};
+        static constexpr double      DEFAULT_PERCENTILE{95.0};
+        static constexpr double      DEFAULT_MAXIMUM_HEDGE_RATIO{0.05};
+
+        inline static const std::string SHARED_MEMORY_KEY_PREFIX{"irods_s3_hedge-shm-"};
+
+        // Returns the controller for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> hedge_controller&;
+
+        explicit hedge_controller(const std::string& _resource_name);
+
+        void configure(bool _enabled, double _percentile, double _maximum_hedge_ratio);
+
+        bool enabled() const;
+
+        // Returns the time to wait for the first byte before hedging, or nothing if
+        // hedging is disabled or there are not enough samples yet.
+        auto hedge_delay() const -> std::optional<std::chrono::microseconds>;
+
+        void record_request();
+        void record_first_byte(std::chrono::microseconds _elapsed);
+
+        // Takes a token for one hedge.  Returns false if the hedge rate cap is reached.
+        bool try_start_hedge();
+
+        // Gives back the token of a hedge that could not be sent after all.
+        void cancel_hedge();
+
+        void record_hedge_won();
+
+        // Detaches the agent from the shared statistics, removing them if no other
+        // live agent is attached.
+        void detach();
+
+        auto to_json() const -> nlohmann::json;
+
+      private:
+        // Calls _function with the statistics of the resource, holding the lock of
+        // the shared statistics if they are shared.  mutex_ must be held.
+        template <typename Function>
+        auto with_statistics(Function _function) const;
+
+        void recalculate_delay(shared_data::hedge_statistics& _statistics) const;
+
+        const std::string                     resource_name_;
+        mutable std::mutex                    mutex_;
+        bool                                  enabled_{false};
+        double                                percentile_{DEFAULT_PERCENTILE};
+        double                                maximum_hedge_ratio_{DEFAULT_MAXIMUM_HEDGE_RATIO};
+        std::unique_ptr<shared_data::hedge_statistics> local_statistics_;
+
+        mutable shared_data::shared_table<shared_data::hedge_table> shared_table_;
+
+    }; // hedge_controller
+
+    // Sends a range GET for _key.  The request is sent to _bucket_context.hostName
+    // and tracked by _endpoint, which this finishes with the result of that
+    // request alone.
+    //
+    // If hedging is enabled for the resource and no data has arrived by the hedge
+    // delay, the same GET is also sent to the host chosen by the endpoint balancer
+    // (possibly the same host), provided the rate limits of the user of _endpoint
+    // and the admission controller of the resource let it go right away.  The
+    // first request to receive data is used and the other one is cancelled.  Only
+    // one request ever calls the data callback of _handler and the completion
+    // callback is called once.  Each request is credited to its own host.  A
+    // request cancelled because the other one won is counted as neither a success
+    // nor a failure.
+    void hedged_get_object(const std::string&         _resource_name,
+                           endpoint_request&          _endpoint,
+                           const S3BucketContext&     _bucket_context,
+                           const std::string&         _key,
+                           std::uint64_t              _offset,
+                           std::uint64_t              _length,
+                           const S3GetObjectHandler&  _handler,
+                           void*                      _callback_data);
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_HEDGED_GET_HPP
@@ -0,0 +1,306 @@
+#ifndef S3_TRANSPORT_INTERPROCESS_SYNC_HPP
+#define S3_TRANSPORT_INTERPROCESS_SYNC_HPP
+
+// stdlib includes
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <memory>
+#include <string>
+
+// boost includes
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+// system includes
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport::shared_data
+{
+
+    // A process shared mutex that is released by the kernel if the process
+    // holding it dies.  The boost interprocess mutexes are not robust, an agent
+    // killed while holding one would block every other agent forever.
+    //
+    // Must be constructed in the shared memory itself.
+    class robust_mutex
+    {
+      public:
+        robust_mutex()
+        {
+            pthread_mutexattr_t attributes;
+            pthread_mutexattr_init(&attributes);
+            pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+            pthread_mutex_init(&mutex_, &attributes);
+            pthread_mutexattr_destroy(&attributes);
+        }
+
+        ~robust_mutex()
+        {
+            pthread_mutex_destroy(&mutex_);
+        }
+
+        robust_mutex(const robust_mutex&) = delete;
+        auto operator=(const robust_mutex&) -> robust_mutex& = delete;
+
+        // Returns true if the previous owner died while holding the mutex, in
+        // which case the data it protects may be half updated.
+        bool lock()
+        {
+            return recover(pthread_mutex_lock(&mutex_));
+        }
+
+        void unlock()
+        {
+            pthread_mutex_unlock(&mutex_);
+        }
+
+        auto native_handle() -> pthread_mutex_t*
+        {
+            return &mutex_;
+        }
+
+        // Marks the mutex consistent if its owner died.
+        auto recover(int _result) -> bool
+        {
+            if (_result == EOWNERDEAD) {
+                pthread_mutex_consistent(&mutex_);
+                return true;
+            }
+            return false;
+        }
+
+      private:
+        pthread_mutex_t mutex_;
+
+    }; // robust_mutex
+
+    // Holds a robust_mutex for its lifetime.
+    class robust_lock
+    {
+      public:
+        explicit robust_lock(robust_mutex& _mutex)
+            : mutex_{_mutex}
+            , owner_died_{_mutex.lock()}
+        {
+        }
+
+        ~robust_lock()
+        {
+            mutex_.unlock();
+        }
+
+        robust_lock(const robust_lock&) = delete;
+        auto operator=(const robust_lock&) -> robust_lock& = delete;
+
+        auto mutex() -> robust_mutex& { return mutex_; }
+
+        // True if a previous owner of the mutex died while holding it.
+        bool owner_died() const { return owner_died_; }
+
+        void set_owner_died() { owner_died_ = true; }
+
+      private:
+        robust_mutex& mutex_;
+        bool          owner_died_;
+
+    }; // robust_lock
+
+    // A process shared condition variable for a robust_mutex, timed on the
+    // monotonic clock.  Must be constructed in the shared memory itself.
+    class robust_condition
+    {
+      public:
+        robust_condition()
+        {
+            pthread_condattr_t attributes;
+            pthread_condattr_init(&attributes);
+            pthread_condattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+            pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+            pthread_cond_init(&condition_, &attributes);
+            pthread_condattr_destroy(&attributes);
+        }
+
+        ~robust_condition()
+        {
+            pthread_cond_destroy(&condition_);
+        }
+
+        robust_condition(const robust_condition&) = delete;
+        auto operator=(const robust_condition&) -> robust_condition& = delete;
+
+        // Returns false if _timeout elapsed without a notification.
+        bool wait_for(robust_lock& _lock, std::chrono::microseconds _timeout)
+        {
+            timespec deadline{};
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            const auto total_ns = static_cast<long long>(deadline.tv_nsec) + _timeout.count() * 1000;
+            deadline.tv_sec += static_cast<time_t>(total_ns / 1000000000);
+            deadline.tv_nsec = static_cast<long>(total_ns % 1000000000);
+
+            const int result = pthread_cond_timedwait(&condition_, _lock.mutex().native_handle(), &deadline);
+            if (_lock.mutex().recover(result)) {
+                _lock.set_owner_died();
+            }
+            return result != ETIMEDOUT;
+        }
+
+        void notify_all()
+        {
+            pthread_cond_broadcast(&condition_);
+        }
+
+      private:
+        pthread_cond_t condition_;
+
+    }; // robust_condition
+
+    inline bool process_is_alive(pid_t _pid)
+    {
+        return _pid > 0 && (::kill(_pid, 0) == 0 || errno != ESRCH);
+    }
+
+    // The processes attached to a shared memory segment, so that the last one to
+    // detach can remove it.  Processes that died without detaching are skipped.
+    // The protecting mutex must be held.
+    template <std::size_t N>
+    struct process_set
+    {
+        pid_t pids[N]{};
+
+        // Returns false if the set is full of live processes.
+        bool add(pid_t _pid)
+        {
+            pid_t* free_slot = nullptr;
+            for (auto& pid : pids) {
+                if (pid == _pid) {
+                    return true;
+                }
+                if (!free_slot && (pid == 0 || !process_is_alive(pid))) {
+                    free_slot = &pid;
+                }
+            }
+            if (!free_slot) {
+                return false;
+            }
+            *free_slot = _pid;
+            return true;
+        }
+
+        // Returns true if no live process remains attached.
+        bool remove(pid_t _pid)
+        {
+            bool others_alive = false;
+            for (auto& pid : pids) {
+                if (pid == _pid || (pid != 0 && !process_is_alive(pid))) {
+                    pid = 0;
+                }
+                others_alive = others_alive || pid != 0;
+            }
+            return !others_alive;
+        }
+    };
+
+    // A table of type T in a named shared memory segment shared by the agents on
+    // the server.  T must have a robust_mutex named mutex, a bool named removed,
+    // and a process_set named processes.
+    //
+    // Agents attach when they open the table (or, if forked from an agent that
+    // opened it, when they first lock it) and detach when they are done.  The
+    // last live agent to detach unlinks the segment while it holds the table
+    // lock and marks the table removed, so an agent that opened the old segment
+    // concurrently opens the name again and gets a new segment.
+    template <typename T>
+    class shared_table
+    {
+      public:
+        shared_table()
+            : table_{nullptr}
+            , attached_pid_{0}
+        {
+        }
+
+        shared_table(const shared_table&) = delete;
+        auto operator=(const shared_table&) -> shared_table& = delete;
+
+        // Maps the table named _key, creating it if necessary.  Throws
+        // boost::interprocess::interprocess_exception if it cannot be mapped.
+        void open(const std::string& _key, std::size_t _size)
+        {
+            namespace bi = boost::interprocess;
+
+            for (int attempt = 0; !table_ && attempt < 3; ++attempt) {
+                auto segment = std::make_unique<bi::managed_shared_memory>(bi::open_or_create, _key.c_str(), _size);
+                auto* table = segment->template find_or_construct<T>("table")();
+
+                robust_lock lock(table->mutex);
+                if (!table->removed) {
+                    key_ = _key;
+                    segment_ = std::move(segment);
+                    table_ = table;
+                    attach();
+                }
+            }
+
+            if (!table_) {
+                throw bi::interprocess_exception("the shared memory was removed while it was opened");
+            }
+        }
+
+        auto get() const -> T* { return table_; }
+
+        // Attaches an agent forked after the table was opened.  The table mutex
+        // must be held.
+        void attach_if_forked()
+        {
+            if (attached_pid_ != ::getpid()) {
+                attach();
+            }
+        }
+
+        void detach()
+        {
+            if (!table_) {
+                return;
+            }
+
+            {
+                robust_lock lock(table_->mutex);
+                if (table_->processes.remove(::getpid())) {
+                    table_->removed = true;
+                    boost::interprocess::shared_memory_object::remove(key_.c_str());
+                }
+            }
+
+            table_ = nullptr;
+            segment_.reset();
+            attached_pid_ = 0;
+        }
+
+      private:
+        // the table mutex must be held
+        void attach()
+        {
+            // If the set is full the agent is not recorded.  The segment may then
+            // be removed while the agent still has it mapped, after which new
+            // agents use a new segment.
+            table_->processes.add(::getpid());
+            attached_pid_ = ::getpid();
+        }
+
+        std::string                                                 key_;
+        std::unique_ptr<boost::interprocess::managed_shared_memory> segment_;
+        T*                                                          table_;
+        std::atomic<pid_t>                                          attached_pid_;
+
+    }; // shared_table
+
+} // irods::experimental::io::s3_transport::shared_data
+
+#endif // S3_TRANSPORT_INTERPROCESS_SYNC_HPP
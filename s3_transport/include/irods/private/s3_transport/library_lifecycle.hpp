@@ -0,0 +1,74 @@
+#ifndef S3_TRANSPORT_LIBRARY_LIFECYCLE_HPP
+#define S3_TRANSPORT_LIBRARY_LIFECYCLE_HPP
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // Owns the process-wide state of libs3 (curl, libxml2, and the connection
+    // pools and TLS sessions built on them).
+    //
+    // The library is initialized once, by the first call to acquire() or
+    // initialize(), and stays initialized while any resource holds it.  It is
+    // deinitialized when the last hold is released or at process exit, so that
+    // operations never pay for initializing and tearing down the library.
+    // S3_initialize and S3_deinitialize must not be called anywhere else.
+    //
+    // Before the library is deinitialized the registered stop hooks are run,
+    // which stop the threads that would otherwise send requests later (such as
+    // the listing threads), and the requests in progress under a usage are
+    // waited for.
+    class library_lifecycle
+    {
+      public:
+        // Marks the library in use for the lifetime of the object, which keeps
+        // the last release() from deinitializing it until the object is gone.
+        class usage
+        {
+          public:
+            usage();
+            ~usage();
+
+            usage(const usage&) = delete;
+            auto operator=(const usage&) -> usage& = delete;
+
+        }; // usage
+
+        // Initializes the library if needed and takes a hold on it until
+        // release().  Called when a resource starts.
+        static auto acquire(const std::string& _resource_name, const std::string& _default_hostname) -> S3Status;
+
+        // Releases a hold taken by acquire().  The last release deinitializes
+        // the library.
+        static void release(const std::string& _resource_name);
+
+        // Registers _stop to be called before the library is deinitialized.  It
+        // must stop and join the threads of its owner.  Returns the id passed to
+        // remove_stop_hook().
+        static auto add_stop_hook(std::function<void()> _stop) -> std::uint64_t;
+
+        // Waits for the hook to finish if it is running.
+        static void remove_stop_hook(std::uint64_t _id);
+
+        // Makes sure the library is initialized without holding it.  This is a
+        // single atomic load once the library is initialized.  A failed
+        // initialization is attempted again by the next call.
+        static auto initialize(const std::string& _default_hostname) -> S3Status;
+
+        static bool initialized();
+
+        static auto to_json() -> nlohmann::json;
+
+    }; // library_lifecycle
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_LIBRARY_LIFECYCLE_HPP
@@ -0,0 +1,76 @@
+#ifndef S3_TRANSPORT_MEMORY_STAGING_HPP
+#define S3_TRANSPORT_MEMORY_STAGING_HPP
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace irods::experimental::io::s3_transport::memory_staging
+{
+
+    // A parallel upload that must be assembled before it is sent to S3 can be
+    // staged in a file on a memory backed file system (/dev/shm by default)
+    // instead of in the cache directory.  The threads and agents writing the
+    // object share the file as they would share the cache file, and its parts
+    // are read from memory when it is flushed.
+    //
+    // The staging files of a resource are kept in a directory of their own and
+    // together they may not be larger than the budget of the resource.  The
+    // space of a file is reserved when it is created, at the size of the
+    // object, and released when the file is removed after the flush.
+    //
+    // Each open of a staged object holds a shared lock on its file until it
+    // is closed, including the flush, however long it takes.  Files that no
+    // open holds and that were not written for STALE_AGE were left by agents
+    // that died and are removed when space is reserved.  The age keeps a file
+    // whose opens have all closed from being removed while the agents of a
+    // parallel transfer that have not opened it yet are still to come.
+    inline const std::string       DIRECTORY_NAME{"irods_s3_staging"};
+    constexpr std::chrono::seconds STALE_AGE{3600};
+
+    // A shared lock on a staging file.  The lock is released, even if the
+    // agent dies, when the object is destroyed.
+    class file_lock
+    {
+      public:
+        file_lock() = default;
+
+        // Locks the file at _path.  The lock is not held if the file could not
+        // be opened and locked.
+        explicit file_lock(const std::string& _path);
+
+        ~file_lock();
+
+        file_lock(file_lock&& _other) noexcept;
+        auto operator=(file_lock&& _other) noexcept -> file_lock&;
+
+        file_lock(const file_lock&) = delete;
+        auto operator=(const file_lock&) -> file_lock& = delete;
+
+        bool held() const { return fd_ >= 0; }
+
+      private:
+        int fd_{-1};
+
+    }; // file_lock
+
+    // The path of the staging file _name of the resource under _directory.
+    auto path(const std::string& _directory,
+              const std::string& _resource_name,
+              const std::string& _name) -> std::string;
+
+    // Creates the staging file _name with a size of _size bytes if the staging
+    // files of the resource fit in _budget bytes with it, and returns a lock
+    // on it.  The lock is not held if the object does not fit or the file
+    // could not be created, in which case the object is staged in the cache
+    // directory.  The lock stays with the file if it is renamed.
+    auto reserve(const std::string& _directory,
+                 const std::string& _resource_name,
+                 const std::string& _name,
+                 std::int64_t       _size,
+                 std::int64_t       _budget) -> file_lock;
+
+} // irods::experimental::io::s3_transport::memory_staging
+
+#endif // S3_TRANSPORT_MEMORY_STAGING_HPP
@@ -19,6 +19,7 @@
 
 #include <fmt/format.h>
 
+#include <atomic>
 #include <cstdint>
 
 namespace irods::experimental::io::s3_transport::shared_data
@@ -56,6 +57,7 @@ namespace irods::experimental::io::s3_transport::shared_data
             , cache_file_download_progress{cache_file_download_status::NOT_STARTED}
             , ref_count{0}
             , existing_object_size{-1}
+            , existing_object_etag{allocator}
             , circular_buffer_read_timeout{false}
             , file_open_counter{0}
             , cache_file_flushed{false}
@@ -63,6 +65,11 @@ namespace irods::experimental::io::s3_transport::shared_data
             , checksum_vector{allocator}
 			, part_size_vector{allocator}
             , first_open_has_trunc_flag{false}
+            , sparse_part_size{0}
+            , filled_parts{allocator}
+            , dirty_parts{allocator}
+            , filling_parts{allocator}
+            , memory_staged{false}
         {}
 
         bool can_delete() {
@@ -75,11 +82,14 @@ namespace irods::experimental::io::s3_transport::shared_data
         bool                                  done_initiate_multipart;
         interprocess_types::shm_char_string   upload_id;
         interprocess_types::shm_string_vector etags;
-        error_codes                           last_error_code;
+
+        // read and set by the part upload threads without taking the access mutex
+        std::atomic<error_codes>              last_error_code;
         cache_file_download_status            cache_file_download_progress;
         int                                   ref_count;
         std::int64_t                          existing_object_size;
-        bool                                  circular_buffer_read_timeout;
+        interprocess_types::shm_char_string   existing_object_etag;
+        std::atomic<bool>                     circular_buffer_read_timeout;
         int                                   file_open_counter;
         bool                                  cache_file_flushed;
         bool                                  know_number_of_threads;
@@ -89,6 +99,25 @@ namespace irods::experimental::io::s3_transport::shared_data
         // this is set so that multiple processes that are used to write to the file don't download the file
         // to cache if the trunc flag is not set.
         bool                                  first_open_has_trunc_flag;
+
+        // Set when the cache file of an existing object is filled one part at a time instead of
+        // being downloaded.  filled_parts and dirty_parts hold a bit for each part of
+        // sparse_part_size bytes, set once the part is read from S3 and once it is written.
+        // The parts copied from the object are copied only if its etag is still
+        // existing_object_etag.
+        std::int64_t                          sparse_part_size;
+        interprocess_types::uint64_t_vector   filled_parts;
+        interprocess_types::uint64_t_vector   dirty_parts;
+
+        // a bit for each part being read from S3 by a thread that released the lock to read it
+        interprocess_types::uint64_t_vector   filling_parts;
+
+        // set by the first open when the cache file is a staging file in memory
+        bool                                  memory_staged;
+
+        // the atomics are shared between processes so they must not use a lock
+        static_assert(std::atomic<error_codes>::is_always_lock_free);
+        static_assert(std::atomic<bool>::is_always_lock_free);
     };
 
 }
@@ -0,0 +1,207 @@
+#ifndef S3_TRANSPORT_PACK_STORE_HPP
+#define S3_TRANSPORT_PACK_STORE_HPP
+
+// local includes
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // Stores small objects as members of large pack objects so that writing,
+    // reading, and keeping them costs one request and one object per pack
+    // instead of per object.
+    //
+    // A member is a range of a pack.  Its key, used as the physical path of the
+    // replica, names the pack, the offset, and the length of the member, so a
+    // read is a range GET of the pack.
+    //
+    // Packs are staged in files under a directory in the cache directory shared
+    // by all agents of a resource on the server.  Space for a member is reserved
+    // in the open pack when the replica is created and its bytes are written
+    // into the file of the pack.  The index of the pack is a journal: a member
+    // is recorded in it, after its bytes are synced to disk, when the replica is
+    // closed.  Only a pack is ever written to S3, once it is full or old enough
+    // and all its members are written (with a multipart upload if it is larger
+    // than a part).  Until then its members are read from the staged file, so a
+    // member of a pack that is not uploaded can only be read on this server.
+    //
+    // The index of each pack also records the members that were deleted.  A
+    // deletion that takes the deleted members of an uploaded pack to the
+    // compaction threshold queues the pack for compaction, which the agents
+    // writing members run later: the live members are packed again, the caller
+    // moves the replicas to their new location, and the pack is deleted.
+    class pack_store
+    {
+      public:
+        static constexpr std::int64_t         DEFAULT_MEMBER_MAXIMUM_SIZE{64 * 1024};
+        static constexpr std::int64_t         MEMBER_MAXIMUM_SIZE_LIMIT{16 * 1024 * 1024};
+        static constexpr std::int64_t         DEFAULT_PACK_SIZE{64 * 1024 * 1024};
+        static constexpr std::chrono::seconds DEFAULT_MAXIMUM_AGE{300};
+        static constexpr unsigned int         DEFAULT_COMPACTION_PERCENT{50};
+        static constexpr std::chrono::seconds SEAL_CHECK_INTERVAL{10};
+        static constexpr std::chrono::seconds RESERVATION_TIMEOUT{3600};
+        inline static const std::string       DIRECTORY_NAME{".irods_s3_packs"};
+        inline static const std::string       KEY_PREFIX{"irods_s3_packs/"};
+
+        struct member
+        {
+            std::string  pack_id;
+            std::int64_t offset;
+            std::int64_t length;
+        };
+
+        // What the requests of the store are sent with.  The strings are owned by
+        // the caller.  The hostName of the bucket context is ignored, a host is
+        // selected by the endpoint balancer of the resource for each request,
+        // and the bucket name is replaced by the one of each pack.
+        struct transfer_settings
+        {
+            S3BucketContext bucket_context;
+            S3PutProperties put_properties;
+            retry_policy    retry;
+            int             timeout_ms;
+            std::int64_t    part_size;
+            unsigned int    number_of_threads;
+        };
+
+        enum class relocation
+        {
+            moved,      // the replicas of the member now refer to the new member
+            orphaned,   // no replica refers to the member
+            failed
+        };
+
+        // Called with the bucket of the pack being compacted.
+        using relocate_function =
+            std::function<relocation(const std::string& _bucket_name, const member& _from, const member& _to)>;
+
+        // The key of a member is "<KEY_PREFIX><pack id>:<offset>:<length>".
+        static auto key(const member& _member) -> std::string;
+        static auto pack_key(const std::string& _pack_id) -> std::string;
+
+        // Returns the member named by _key, or nothing if _key is not the key of a member.
+        static auto parse_key(const std::string& _key) -> std::optional<member>;
+
+        // Returns the store for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> pack_store&;
+
+        explicit pack_store(const std::string& _resource_name);
+
+        pack_store(const pack_store&) = delete;
+        auto operator=(const pack_store&) -> pack_store& = delete;
+
+        // The packs are built in DIRECTORY_NAME under _cache_directory.
+        void configure(bool                 _enabled,
+                       const std::string&   _cache_directory,
+                       std::int64_t         _member_maximum_size,
+                       std::int64_t         _pack_size,
+                       std::chrono::seconds _maximum_age,
+                       unsigned int         _compaction_percent);
+
+        bool enabled() const;
+
+        // True if an object of _size bytes is stored as a member.
+        bool accepts(std::int64_t _size) const;
+
+        // Reserves _length bytes in the open pack of _bucket_name, opening a new
+        // pack if there is none or it is full or too old.
+        auto reserve(const std::string& _bucket_name, std::int64_t _length) -> std::optional<member>;
+
+        // Writes _length bytes at _offset of a member that is not uploaded yet.
+        bool write(const member& _member, std::int64_t _offset, const char* _buffer, std::int64_t _length);
+
+        // Durably records that the member is written.  Returns false if the pack
+        // was uploaded without it, which happens only if the member was not
+        // written within RESERVATION_TIMEOUT.
+        bool complete(const member& _member);
+
+        // True if members were completed by this agent.
+        bool wrote_members() const;
+
+        // Reads _length bytes at _offset of a member into _buffer, from the file
+        // of the pack if it is not uploaded yet, otherwise from the pack in S3.
+        // Reads past the end of the member are cut short, _bytes_read is set to
+        // the number of bytes read.
+        auto read(const transfer_settings& _settings,
+                  const std::string&       _bucket_name,
+                  const member&            _member,
+                  std::int64_t             _offset,
+                  char*                    _buffer,
+                  std::int64_t             _length,
+                  std::int64_t&            _bytes_read) -> S3Status;
+
+        // Records that the member was deleted.  Returns true if its pack is
+        // uploaded and was queued for compaction.
+        bool remove(const member& _member);
+
+        // Uploads the packs that are ready.  Unless _force is set or a pack was
+        // filled since, this does nothing if it ran less than SEAL_CHECK_INTERVAL
+        // ago.  Packs whose members were all deleted are discarded.
+        void seal_ready_packs(const transfer_settings& _settings, bool _force = false);
+
+        // Compacts the packs queued by remove.  This does nothing if it ran less
+        // than SEAL_CHECK_INTERVAL ago.  A pack that could not be compacted is
+        // queued again.
+        void compact_ready_packs(const transfer_settings& _settings, const relocate_function& _relocate);
+
+        // Packs the live members of an uploaded pack again and calls _relocate for
+        // each one.  The pack is deleted once no replica refers to it.  Returns
+        // false if the pack is being compacted by another agent or a member could
+        // not be moved, in which case the pack is kept.
+        bool compact(const transfer_settings& _settings,
+                     const std::string&       _pack_id,
+                     const relocate_function& _relocate);
+
+        auto to_json() const -> nlohmann::json;
+
+      private:
+        auto path(const std::string& _file_name) const -> std::string;
+
+        // Uploads the pack and marks it sealed.  Returns false if it is being
+        // uploaded by another agent or the upload failed.
+        bool upload_pack(const transfer_settings& _settings, const std::string& _pack_id);
+
+        // Appends the pack to the compaction queue shared by the agents.
+        bool queue_compaction(const std::string& _pack_id);
+
+        const std::string    resource_name_;
+
+        mutable std::mutex   mutex_;
+        bool                 enabled_;
+        std::string          directory_;
+        std::int64_t         member_maximum_size_;
+        std::int64_t         pack_size_;
+        std::chrono::seconds maximum_age_;
+        unsigned int         compaction_percent_;
+        bool                 full_pack_pending_;
+
+        std::chrono::steady_clock::time_point last_seal_check_;
+        std::chrono::steady_clock::time_point last_compaction_check_;
+
+        // statistics
+        std::uint64_t        members_reserved_;
+        std::uint64_t        members_completed_;
+        std::uint64_t        members_deleted_;
+        std::uint64_t        members_moved_;
+        std::uint64_t        packs_uploaded_;
+        std::uint64_t        packs_discarded_;
+        std::uint64_t        packs_compacted_;
+
+    }; // pack_store
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_PACK_STORE_HPP
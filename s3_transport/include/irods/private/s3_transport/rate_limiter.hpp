@@ -0,0 +1,138 @@
+#ifndef S3_TRANSPORT_RATE_LIMITER_HPP
+#define S3_TRANSPORT_RATE_LIMITER_HPP
+
+// local includes
+#include "irods/private/s3_transport/interprocess_sync.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+
+// stdlib includes
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    namespace shared_data
+    {
+        struct rate_bucket
+        {
+            double       tokens{0.0};
+            std::int64_t last_refill_us{0};
+        };
+
+        struct rate_limit_user_entry
+        {
+            static constexpr std::size_t MAXIMUM_USER_LENGTH{64};
+
+            char         user[MAXIMUM_USER_LENGTH]{};
+            rate_bucket  bytes;
+            rate_bucket  requests;
+            std::int64_t last_used_us{0};
+        };
+
+        struct rate_limit_table
+        {
+            static constexpr std::size_t MAXIMUM_USERS{128};
+            static constexpr std::size_t MAXIMUM_PROCESSES{1024};
+
+            robust_mutex                   mutex;
+            bool                           removed{false};
+            process_set<MAXIMUM_PROCESSES> processes;
+            rate_bucket                    bytes;
+            rate_bucket                    requests;
+            std::size_t                    number_of_users{0};
+            rate_limit_user_entry          users[MAXIMUM_USERS];
+        };
+    } // end namespace shared_data
+
+    // Limits the bytes per second and requests per second sent to or received
+    // from the S3 provider by a resource, and optionally by each user of the
+    // resource.
+    //
+    // Each limit is a token bucket that holds up to one second worth of tokens.
+    // A caller takes the tokens it needs right away, possibly leaving the bucket
+    // in debt, and then sleeps until the debt would be repaid.  This keeps the
+    // average rate at the limit without a caller ever waiting for a bucket to
+    // fill up to a large amount.
+    //
+    // The buckets are kept in shared memory so that the limits apply to all
+    // threads and agents on the server.  A limit of zero means unlimited.
+    // Without any limit, which is the default, a caller returns right away
+    // without taking a lock.
+    //
+    // Bytes taken while a transfer is in progress (from the data callbacks of
+    // libs3) never make the caller wait longer than it would take to transfer
+    // them at MINIMUM_TRANSFER_BYTES_PER_SECOND.  libs3 aborts a transfer slower
+    // than 1024 bytes per second for 15 seconds, which a connection sharing a
+    // low limit with many others would otherwise reach.  The debt stays in the
+    // bucket, so requests that start later wait for it.
+    class rate_limiter
+    {
+      public:
+        static constexpr double MINIMUM_TRANSFER_BYTES_PER_SECOND{4096.0};
+
+        inline static const std::string SHARED_MEMORY_KEY_PREFIX{"irods_s3_rate_limit-shm-"};
+
+        // Returns the limiter for the resource, creating it if necessary.  The
+        // lookup takes a global lock, so callers that take bytes for every
+        // chunk of a transfer keep the reference for the whole transfer.
+        static auto for_resource(const std::string& _resource_name) -> rate_limiter&;
+
+        void configure(std::uint64_t _bytes_per_second,
+                       std::uint64_t _requests_per_second,
+                       std::uint64_t _bytes_per_second_per_user,
+                       std::uint64_t _requests_per_second_per_user);
+
+        // Waits until _bytes may be transferred.  _user may be empty if the user
+        // is not known, in which case only the resource limit applies.
+        void acquire_bytes(std::int64_t _bytes, const std::string& _user = "");
+
+        // Waits until _bytes of a transfer in progress may be transferred, for at
+        // most _bytes / MINIMUM_TRANSFER_BYTES_PER_SECOND seconds.
+        void acquire_transfer_bytes(std::int64_t _bytes, const std::string& _user = "");
+
+        // Waits until a request may be sent.
+        void acquire_request(const std::string& _user = "");
+
+        // Takes a request only if one may be sent right away, for optional requests
+        // such as hedges.  Returns false, taking nothing, otherwise.
+        bool try_acquire_request(const std::string& _user = "");
+
+        // Detaches the agent from the shared buckets, removing them if no other
+        // live agent is attached.
+        void detach();
+
+        auto to_json() const -> nlohmann::json;
+
+        explicit rate_limiter(const std::string& _resource_name);
+
+      private:
+        struct limits
+        {
+            double bytes_per_second{0.0};
+            double requests_per_second{0.0};
+            double bytes_per_second_per_user{0.0};
+            double requests_per_second_per_user{0.0};
+        };
+
+        // Waits for at most _maximum_wait_us microseconds if it is not negative.
+        void acquire(bool _bytes, double _amount, const std::string& _user, std::int64_t _maximum_wait_us);
+
+        const std::string                                        resource_name_;
+        mutable std::mutex                                       mutex_;
+        limits                                                   limits_;
+
+        // true if any limit is set and the buckets are mapped
+        std::atomic<bool>                                        limited_;
+        shared_data::shared_table<shared_data::rate_limit_table> shared_table_;
+
+    }; // rate_limiter
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_RATE_LIMITER_HPP
@@ -0,0 +1,141 @@
+#ifndef S3_TRANSPORT_RETRY_POLICY_HPP
+#define S3_TRANSPORT_RETRY_POLICY_HPP
+
+// local includes
+#include "irods/private/s3_transport/interprocess_sync.hpp"
+
+// misc includes
+#include <nlohmann/json.hpp>
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    namespace shared_data
+    {
+        struct retry_budget_table
+        {
+            static constexpr std::size_t MAXIMUM_PROCESSES{1024};
+
+            robust_mutex                   mutex;
+            bool                           removed{false};
+            process_set<MAXIMUM_PROCESSES> processes;
+            bool                           initialized{false};
+            double                         tokens{0.0};
+            std::uint64_t                  retries{0};
+            std::uint64_t                  retries_shed{0};
+        };
+    } // end namespace shared_data
+
+    // A token bucket that bounds the number of retries a resource may send.
+    //
+    // Every retry takes RETRY_COST tokens and every successful request returns
+    // SUCCESS_REFUND tokens, up to the configured maximum.  While the error rate
+    // is low the bucket stays full.  When many requests start failing (e.g. the
+    // provider is browning out) the bucket drains and further retries are shed
+    // so that the failures are returned to the client rather than multiplied by
+    // every thread retrying.
+    //
+    // The bucket of a resource is kept in shared memory so that it bounds the
+    // retries of all agents on the server together.  If the shared memory cannot
+    // be mapped each agent keeps its own bucket.  A maximum of zero tokens
+    // disables the budget.
+    class retry_budget
+    {
+      public:
+        static constexpr double       RETRY_COST{1.0};
+        static constexpr double       SUCCESS_REFUND{0.1};
+        static constexpr unsigned int DEFAULT_MAXIMUM_TOKENS{100};
+
+        inline static const std::string SHARED_MEMORY_KEY_PREFIX{"irods_s3_retry_budget-shm-"};
+
+        // Returns the budget for the resource, creating it if necessary.
+        static auto for_resource(const std::string& _resource_name) -> retry_budget&;
+
+        explicit retry_budget(const std::string& _resource_name);
+
+        void configure(unsigned int _maximum_tokens);
+
+        // Takes the tokens for one retry.  Returns false if the budget is exhausted.
+        bool try_acquire();
+
+        void record_success();
+
+        // Detaches the agent from the shared bucket, removing it if no other live
+        // agent is attached.
+        void detach();
+
+        auto to_json() const -> nlohmann::json;
+
+      private:
+        // Returns the shared bucket or nothing if the agent keeps its own.
+        auto shared_bucket() const -> shared_data::retry_budget_table*;
+
+        const std::string  resource_name_;
+        mutable std::mutex mutex_;
+        double             maximum_tokens_{DEFAULT_MAXIMUM_TOKENS};
+        double             tokens_{DEFAULT_MAXIMUM_TOKENS};
+        std::uint64_t      retries_{0};
+        std::uint64_t      retries_shed_{0};
+
+        shared_data::shared_table<shared_data::retry_budget_table> shared_table_;
+
+    }; // retry_budget
+
+    // Decides whether a failed request is retried and waits before the retry.
+    //
+    // The wait uses "decorrelated jitter": each delay is drawn uniformly between
+    // the base wait and three times the previous delay, capped at the maximum
+    // wait.  Delays have millisecond resolution so the first retry of a transient
+    // error is cheap, while repeated failures still back off quickly and threads
+    // that failed together do not retry together.
+    //
+    // One retry_policy is used for the attempts of a single request:
+    //
+    //     retry_policy retry{resource_name, retry_count_limit, base_wait, max_wait};
+    //     do {
+    //         ... send the request ...
+    //     } while (retry.should_retry(status));
+    class retry_policy
+    {
+      public:
+        using retryable_predicate = int (*)(S3Status);
+
+        retry_policy(const std::string& _resource_name,
+                     std::size_t _retry_count_limit,
+                     std::chrono::milliseconds _base_wait,
+                     std::chrono::milliseconds _max_wait,
+                     retryable_predicate _is_retryable = S3_status_is_retryable);
+
+        // Returns true if the request should be sent again after a request that
+        // completed with _status.  In that case this has already slept for the
+        // backoff delay.  Returns false on success, on a non-retryable error, when
+        // the retry count limit is reached, or when the retry budget is exhausted.
+        bool should_retry(S3Status _status);
+
+        // Number of retries done so far.
+        auto retries() const -> std::size_t { return retries_; }
+
+      private:
+        auto next_delay() -> std::chrono::milliseconds;
+
+        std::string               resource_name_;
+        std::size_t               retry_count_limit_;
+        std::chrono::milliseconds base_wait_;
+        std::chrono::milliseconds max_wait_;
+        std::chrono::milliseconds previous_delay_;
+        retryable_predicate       is_retryable_;
+        std::size_t               retries_;
+
+    }; // retry_policy
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_RETRY_POLICY_HPP
@@ -22,12 +22,17 @@
 #include "libs3/libs3_chunked.h"
 
 // stdlib and misc includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
 #include <string>
 #include <thread>
 #include <vector>
 #include <cstdio>
 #include <ios>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <new>
@@ -59,6 +64,13 @@
 #include "irods/private/s3_transport/types.hpp"
 #include "irods/private/s3_transport/util.hpp"
 #include "irods/private/s3_transport/callbacks.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/hedged_get.hpp"
+#include "irods/private/s3_transport/memory_staging.hpp"
+#include "irods/private/s3_transport/sparse_cache.hpp"
+#include "irods/private/s3_transport/library_lifecycle.hpp"
+#include "irods/private/s3_transport/retry_policy.hpp"
+#include "irods/private/s3_transport/upload_journal.hpp"
 #include "irods/private/s3_transport/logging_category.hpp"
 
 extern const unsigned int S3_DEFAULT_NON_DATA_TRANSFER_TIMEOUT_SECONDS;
@@ -79,6 +91,8 @@ namespace irods::experimental::io::s3_transport
     extern const std::string  S3_STORAGE_CLASS_GLACIER_IR;
     extern const std::string  S3_DEFAULT_STORAGE_CLASS;
 
+    extern const std::int64_t S3_DEFAULT_STALE_UPLOAD_AGE_SECONDS;
+
     namespace log  = irods::experimental::log;
     using logger = log::logger<s3_transport_logging_category>;
 
@@ -90,7 +104,9 @@ namespace irods::experimental::io::s3_transport
             libs3_types::bucket_context& bucket_context,
             std::int64_t& object_size,
             object_s3_status& object_status,
-            std::string& storage_class);
+            std::string& storage_class,
+            std::map<std::string, std::string>* meta_data = nullptr,
+            std::string* etag = nullptr);
 
     irods::error handle_glacier_status(const std::string& object_key,
             libs3_types::bucket_context& bucket_context,
@@ -116,7 +132,7 @@ namespace irods::experimental::io::s3_transport
             , number_of_client_transfer_threads{0}  // this is the number of transfer threads defined by iRODS for PUTs, GETs
             , bytes_this_thread{1000}
             , retry_count_limit{3}
-            , retry_wait_seconds{3}
+            , retry_wait_milliseconds{100}
             , max_retry_wait_seconds{30}
             , hostname{"s3.amazonaws.com"}
             , region_name{"us-east-1"}
@@ -136,12 +152,19 @@ namespace irods::experimental::io::s3_transport
             , multipart_enabled{true}
             , put_repl_flag{false}
             , resource_name{""}
+            , user_name{""}
             , restoration_days{S3_DEFAULT_RESTORATION_DAYS}
             , restoration_tier{S3_DEFAULT_RESTORATION_TIER}
             , max_single_part_upload_size{DEFAULT_MAX_SINGLE_PART_UPLOAD_SIZE}
             , non_data_transfer_timeout_seconds{S3_DEFAULT_NON_DATA_TRANSFER_TIMEOUT_SECONDS}
             , s3_storage_class{S3_DEFAULT_STORAGE_CLASS}
             , trailing_checksum_on_upload_enabled{false}
+            , resumable_uploads_enabled{false}
+            , stale_upload_age_seconds{S3_DEFAULT_STALE_UPLOAD_AGE_SECONDS}
+            , partial_overwrite_enabled{false}
+            , server_side_append_enabled{false}
+            , memory_staging_directory{"/dev/shm"}
+            , memory_staging_budget{0}
         {}
 
         std::int64_t object_size;
@@ -149,7 +172,7 @@ namespace irods::experimental::io::s3_transport
         int number_of_client_transfer_threads;           // controlled by iRODS
         std::int64_t bytes_this_thread;                  // only used when doing a multipart upload
         unsigned int retry_count_limit;
-        int          retry_wait_seconds;
+        int          retry_wait_milliseconds;
         int          max_retry_wait_seconds;
         std::string  hostname;
         std::string  region_name;
@@ -184,6 +207,7 @@ namespace irods::experimental::io::s3_transport
         bool         put_repl_flag;
 
         std::string  resource_name;
+        std::string  user_name;                        // used for per-user rate limits, may be empty
         unsigned int restoration_days;
         std::string  restoration_tier;
 
@@ -191,6 +215,27 @@ namespace irods::experimental::io::s3_transport
         unsigned int non_data_transfer_timeout_seconds;
         std::string  s3_storage_class;
         bool         trailing_checksum_on_upload_enabled;
+
+        // If true, the multipart upload of a cache file is recorded in a journal in the
+        // cache directory and resumed by the next flush of the object if it fails.
+        // Recorded uploads not written for stale_upload_age_seconds are aborted.
+        bool         resumable_uploads_enabled;
+        std::int64_t stale_upload_age_seconds;
+
+        // If true, an existing object opened for writing through the cache is not downloaded.
+        // Each part of the cache file is read from S3 when it is first read or written, and on
+        // close the parts that were not written are copied from the object by S3.
+        bool         partial_overwrite_enabled;
+
+        // If true, an existing object opened for appending is handled as with
+        // partial_overwrite_enabled, so only the appended bytes are uploaded.
+        bool         server_side_append_enabled;
+
+        // If memory_staging_budget is greater than zero, a parallel upload that must be
+        // assembled before it is uploaded is staged in memory_staging_directory (a memory
+        // backed file system) instead of the cache directory if it fits in the budget.
+        std::string  memory_staging_directory;
+        std::int64_t memory_staging_budget;
     };
 
 
@@ -214,6 +259,18 @@ namespace irods::experimental::io::s3_transport
             irods::experimental::interprocess::shared_memory::named_shared_memory_object
             <shared_data::multipart_shared_data>;
 
+        // a range of the cache file uploaded as one part of a multipart upload
+        struct cache_file_part
+        {
+            unsigned int number;
+            unsigned int number_limit;    // one past the last part number the range may be split into
+            std::int64_t offset;
+            std::int64_t size;
+            bool         uploaded;
+        };
+
+        using sparse_cache_file_part = sparse_cache::file_part;
+
         // clang-format off
         const static int uninitialized_file_descriptor = -1;
         const static int minimum_valid_file_descriptor = 3;
@@ -246,6 +303,8 @@ namespace irods::experimental::io::s3_transport
             , download_to_cache_{true}
             , use_cache_{true}
             , object_must_exist_{false}
+            , sparse_cache_file_{false}
+            , memory_staged_{false}
             , bucket_context_{}
             , upload_manager_{bucket_context_}
             , last_file_to_close_{false}
@@ -299,14 +358,6 @@ namespace irods::experimental::io::s3_transport
                 }
             }
 
-            // each process must initialize and deinitiatize.
-            {
-                std::lock_guard<std::mutex> lock(s3_initialized_counter_mutex_);
-                if (--s3_initialized_counter_ == 0) {
-                    S3_deinitialize();
-                }
-            }
-
         }
 
         off_t get_offset() {
@@ -418,13 +469,12 @@ namespace irods::experimental::io::s3_transport
                 begin_part_upload_thread_ptr_ = nullptr;
             }
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
 
             enum struct additional_processing_enum {
                 CONTINUE,
-                DO_FLUSH_CACHE_FILE
+                DO_FLUSH_CACHE_FILE,
+                DO_COMPLETE_MULTIPART_UPLOAD
             };
 
             // only allow one open/close to happen at a time
@@ -478,11 +528,9 @@ namespace irods::experimental::io::s3_transport
                     } else {
 
 
+                        // the multipart upload is completed after the lock is released
                         if ( this->use_streaming_multipart()  ) {
-
-                            if (error_codes::SUCCESS != complete_multipart_upload()) {
-                                return_value = false;
-                            }
+                            rv = additional_processing_enum::DO_COMPLETE_MULTIPART_UPLOAD;
                         }
 
                         return_value = true;
@@ -516,8 +564,22 @@ namespace irods::experimental::io::s3_transport
                     this->set_error(ERROR(S3_PUT_ERROR, "flush_cache_file returned error"));
                     return_value = false;
                 }
+
+            } else if (result == additional_processing_enum::DO_COMPLETE_MULTIPART_UPLOAD) {
+
+                if (error_codes::SUCCESS != complete_multipart_upload()) {
+                    return_value = false;
+                }
+
+                // the upload was completed or cancelled
+                if (streaming_journal_enabled()) {
+                    upload_journal::discard(config_.cache_directory, config_.resource_name,
+                            config_.bucket_name, object_key_);
+                }
             }
 
+            memory_staging_lock_ = {};
+            release_shared_memory();
 
             return return_value;
         }
@@ -528,6 +590,18 @@ namespace irods::experimental::io::s3_transport
         {
             if (use_cache_) {
                 auto position_before_read = cache_fstream_.tellg();
+
+                // read the parts of a sparse cache file that were not read from S3 yet
+                if (sparse_cache_file_) {
+                    if (!fill_cache_file_parts(shared_memory(), position_before_read, _buffer_size, false)) {
+                        this->set_error(ERROR(S3_GET_ERROR, "Failed to read the object into the cache file"));
+                        return 0;
+                    }
+
+                    // discard what the stream buffered before the parts were filled
+                    cache_fstream_.seekg(position_before_read);
+                }
+
                 cache_fstream_.read(_buffer, _buffer_size);
                 return cache_fstream_.tellg() - position_before_read;
             }
@@ -549,19 +623,31 @@ namespace irods::experimental::io::s3_transport
         {
             thread_local std::ofstream tmp;
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
 
             if (use_cache_) {
 
-                named_shared_memory_object shm_obj{shmem_key_,
-                    config_.shared_memory_timeout_in_seconds,
-                    constants::MAX_S3_SHMEM_SIZE};
+                // Read the parts of a sparse cache file that are partly overwritten before taking the
+                // lock for the write.  Appends go past the end of the existing object, which is never
+                // read.
+                if (sparse_cache_file_ && !(mode_ & std::ios_base::app)) {
+                    const std::streamoff position = cache_fstream_.tellp();
+                    if (!fill_cache_file_parts(shm_obj, position, _buffer_size, true)) {
+                        this->set_error(ERROR(S3_GET_ERROR, "Failed to read the object into the cache file"));
+                        return 0;
+                    }
+                    cache_fstream_.seekp(position);
+                }
 
                 return shm_obj.atomic_exec([this, _buffer, _buffer_size](auto& data) {
 
+                    // writes in append mode always go to the end of the file
+                    if (this->mode_ & std::ios_base::app) {
+                        this->cache_fstream_.seekp(0, std::ios_base::end);
+                    }
+
                     std::streamoff position_before_write = this->cache_fstream_.tellp();
+
                     this->cache_fstream_.write(_buffer, _buffer_size);
                     this->cache_fstream_.flush();
 
@@ -581,7 +667,8 @@ namespace irods::experimental::io::s3_transport
 
             // if this is a multipart upload and we have not yet initiated it, do so
             bool return_value = true;
-            shm_obj.atomic_exec([this, &shm_obj, &return_value](auto& data) {
+            bool initiated = false;
+            shm_obj.atomic_exec([this, &shm_obj, &return_value, &initiated](auto& data) {
 
                 if ( this->use_streaming_multipart() && !data.done_initiate_multipart ) {
 
@@ -591,6 +678,10 @@ namespace irods::experimental::io::s3_transport
                         return_value = false;
                     } else {
                         data.done_initiate_multipart = true;
+                        initiated = true;
+
+                        // size the part entries once for all threads
+                        this->reserve_part_entries(data, this->expected_number_of_parts());
                     }
                 }
             });
@@ -601,6 +692,10 @@ namespace irods::experimental::io::s3_transport
                 return 0;
             }
 
+            if (initiated) {
+                journal_streaming_upload(shm_obj);
+            }
+
             // if config_.bytes_this_thread is 0 then bail
             if (config_.number_of_client_transfer_threads > 1 && 0 == get_bytes_this_thread()) {
                 logger::error("{}:{} ({}) [[{}]] part size is zero", __FILE__, __LINE__,
@@ -843,9 +938,7 @@ namespace irods::experimental::io::s3_transport
                 return false;
             }
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
 
             return shm_obj.atomic_exec([](auto& data) -> bool
             {
@@ -856,6 +949,9 @@ namespace irods::experimental::io::s3_transport
 
         std::string get_cache_file_path() {
             namespace bf = boost::filesystem;
+            if (memory_staged_) {
+                return memory_staging::path(config_.memory_staging_directory, config_.resource_name, shmem_key_);
+            }
             bf::path cache_file =  bf::path(config_.cache_directory) / bf::path(object_key_ + "-cache");
             return cache_file.string();
         }
@@ -873,10 +969,108 @@ namespace irods::experimental::io::s3_transport
             return file_offset_;
         }
 
+        // Returns the handle to the shared memory of the object.  The segment is
+        // mapped on first use and stays mapped until close so that sends and part
+        // uploads do not map it and take its named mutex again.
+        //
+        // Every transport sizes the segment for the largest layout because the
+        // first one to open it creates it and the others, which may be writers
+        // of a larger object or flushes of the cache file, get its size.  The
+        // segment is sparse, only the pages of the entries in use are allocated.
+        named_shared_memory_object& shared_memory() {
+            std::lock_guard<std::mutex> lock(shm_obj_mutex_);
+            if (!shm_obj_) {
+                shm_obj_ = std::make_unique<named_shared_memory_object>(shmem_key_,
+                        config_.shared_memory_timeout_in_seconds,
+                        constants::MAX_S3_SHMEM_SIZE);
+            }
+            return *shm_obj_;
+        }
+
+        // Unmaps the shared memory.  The last transport to release it removes the
+        // segment once all threads have closed.
+        void release_shared_memory() {
+            std::lock_guard<std::mutex> lock(shm_obj_mutex_);
+            shm_obj_.reset();
+        }
+
+        // Returns the number of part entries reserved when the upload starts.
+        // Reads do not upload parts.  The number of parts of a streaming upload is
+        // known from the object size but a cache flush may split the file into
+        // more parts on retries, so it reserves the maximum.
+        std::int64_t expected_number_of_parts() {
+            if (!(mode_ & std::ios_base::out)) {
+                return 0;
+            }
+
+            if (use_cache_ || config_.object_size == config::UNKNOWN_OBJECT_SIZE || config_.circular_buffer_size == 0) {
+                return constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD;
+            }
+
+            // each thread may round its last part up
+            const std::int64_t maximum_number_of_parts = constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD;
+            const std::int64_t number_of_threads = std::max(config_.number_of_client_transfer_threads, 1);
+            const std::int64_t number_of_parts = config_.object_size / config_.circular_buffer_size + 1 + number_of_threads;
+
+            return std::min(number_of_parts, maximum_number_of_parts);
+        }
+
+        // Grows the etags, checksum and part size vectors in shared memory to hold
+        // _number_of_parts entries.  Must be called with the shared memory locked.
+        // Returns false if the segment is too small.
+        template <typename SharedData>
+        bool reserve_part_entries(SharedData& data, std::int64_t _number_of_parts) {
+            namespace types = shared_data::interprocess_types;
+
+            if (_number_of_parts <= static_cast<std::int64_t>(data.etags.size())) {
+                return true;
+            }
+
+            logger::debug( "{}:{} ({}) [[{}]] resize etags vector from {} to {}",
+                    __FILE__, __LINE__, __func__, get_thread_identifier(), data.etags.size(), _number_of_parts);
+
+            try {
+                // reserve first so the vectors are allocated once at their final size
+                data.etags.reserve(_number_of_parts);
+                data.checksum_vector.reserve(_number_of_parts);
+                data.part_size_vector.reserve(_number_of_parts);
+                data.etags.resize(_number_of_parts, types::shm_char_string("", shared_memory().get_allocator()));
+                data.checksum_vector.resize(_number_of_parts);
+                data.part_size_vector.resize(_number_of_parts);
+            } catch (const boost::interprocess::bad_alloc&) {
+                logger::error("{}:{} ({}) [[{}]] no room for {} parts in shared memory [free_memory={}]",
+                        __FILE__, __LINE__, __func__, get_thread_identifier(), _number_of_parts,
+                        shared_memory().get_free_memory());
+                data.last_error_code = error_codes::BAD_ALLOC;
+                return false;
+            }
+
+            return true;
+        }
+
         std::uint64_t get_thread_identifier() const {
             return std::hash<std::thread::id>{}(std::this_thread::get_id());
         }
 
+        // Selects the host for the next data transfer request from the endpoint balancer
+        // of the resource.  If no hosts have been registered for the resource (the transport
+        // is being used outside of the plugin), config_.hostname is used.
+        std::string select_hostname() {
+            std::string hostname = endpoint_balancer::for_resource(config_.resource_name).select_host();
+            return hostname.empty() ? config_.hostname : hostname;
+        }
+
+        // Returns the retry policy for one request.  Retries are limited by
+        // config_.retry_count_limit and by the retry budget of the resource.
+        auto make_retry_policy() const -> retry_policy
+        {
+            return retry_policy{config_.resource_name,
+                                config_.retry_count_limit,
+                                std::chrono::milliseconds{config_.retry_wait_milliseconds},
+                                std::chrono::seconds{config_.max_retry_wait_seconds},
+                                irods::experimental::io::s3_transport::S3_status_is_retryable};
+        }
+
         auto get_cache_file_size() -> std::int64_t
         {
             std::fstream fs(cache_file_path_);
@@ -893,8 +1087,8 @@ namespace irods::experimental::io::s3_transport
 
         bool begin_multipart_upload(named_shared_memory_object& shm_obj)
         {
-            auto last_error_code = shm_obj.atomic_exec([](auto& data) {
-                    return data.last_error_code;
+            auto last_error_code = shm_obj.exec([](auto& data) {
+                    return data.last_error_code.load();
             });
 
             // first one in initiates the multipart (everyone has same shared_memory_lock)
@@ -941,7 +1135,7 @@ namespace irods::experimental::io::s3_transport
 
             namespace bf = boost::filesystem;
 
-            bf::path cache_file =  bf::path(config_.cache_directory) / bf::path(object_key_ + "-cache");
+            bf::path cache_file = get_cache_file_path();
             bf::path parent_path = cache_file.parent_path();
             try {
                 boost::filesystem::create_directories(parent_path);
@@ -965,6 +1159,11 @@ namespace irods::experimental::io::s3_transport
             // first thread/process will spawn multiple threads to download object to cache
             if (start_download) {
 
+                // the parts of the object are read when they are used instead
+                if (const std::int64_t part_size = sparse_cache_part_size(s3_object_size); part_size > 0) {
+                    return create_sparse_cache_file(shm_obj, s3_object_size, part_size);
+                }
+
                 // download the object to a cache file
 
                 std::int64_t disk_space_available = bf::space(config_.cache_directory).available;
@@ -980,6 +1179,15 @@ namespace irods::experimental::io::s3_transport
                     });
                 }
 
+                // create the file once, the download threads write their ranges into it
+                if (std::ofstream cache_fstream{cache_file_path_, std::ios_base::out | std::ios_base::trunc}; !cache_fstream) {
+                    logger::error("{}:{} ({}) [[{}]] Could not create cache file {}.",
+                            __FILE__, __LINE__, __func__, get_thread_identifier(), cache_file_path_);
+                    return shm_obj.atomic_exec([](auto& data) {
+                        return data.cache_file_download_progress = cache_file_download_status::FAILED;
+                    });
+                }
+
                 std::int64_t bytes_downloaded = 0;
                 std::mutex bytes_downloaded_mutex;
 
@@ -1010,7 +1218,7 @@ namespace irods::experimental::io::s3_transport
                             }
 
                             std::int64_t this_bytes_downloaded =
-                                this->s3_download_part_worker_routine(nullptr, this_part_size, this_part_offset, true);
+                                this->s3_download_part_worker_routine(nullptr, this_part_size, this_part_offset);
 
                             {
                                 std::lock_guard<std::mutex> lock(bytes_downloaded_mutex);
@@ -1043,6 +1251,144 @@ namespace irods::experimental::io::s3_transport
 
         }
 
+        // Returns the size of the parts a sparse cache file for an existing object of _object_size
+        // bytes is tracked in, or 0 if the object must be downloaded to the cache.  Every part but
+        // the last is uploaded or copied whole so it must be at least the minimum part size, and
+        // there are at most 10,000 of them.  The parts copied by S3 have no trailing checksum.
+        std::int64_t sparse_cache_part_size(std::int64_t _object_size) const
+        {
+            const bool enabled = (mode_ & std::ios_base::app)
+                ? config_.server_side_append_enabled || config_.partial_overwrite_enabled
+                : config_.partial_overwrite_enabled && (mode_ & std::ios_base::out);
+
+            if (!enabled || !config_.multipart_enabled || config_.trailing_checksum_on_upload_enabled) {
+                return 0;
+            }
+
+            return sparse_cache::part_size(_object_size, config_.minimum_part_size,
+                    constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD);
+        }
+
+        // Creates a cache file of _object_size bytes that holds none of the object yet.  The
+        // file is sparse so this does not use disk space.  Shared memory is already locked.
+        cache_file_download_status create_sparse_cache_file(named_shared_memory_object& shm_obj,
+                                                            std::int64_t _object_size,
+                                                            std::int64_t _part_size)
+        {
+            namespace bf = boost::filesystem;
+
+            boost::system::error_code ec;
+            if (std::ofstream cache_fstream{cache_file_path_, std::ios_base::out | std::ios_base::trunc}; cache_fstream) {
+                cache_fstream.close();
+                bf::resize_file(cache_file_path_, static_cast<std::uintmax_t>(_object_size), ec);
+            } else {
+                ec = boost::system::errc::make_error_code(boost::system::errc::io_error);
+            }
+
+            if (ec) {
+                logger::error("{}:{} ({}) [[{}]] Could not create cache file {}.  {}",
+                        __FILE__, __LINE__, __func__, get_thread_identifier(), cache_file_path_, ec.message());
+                return shm_obj.atomic_exec([](auto& data) {
+                    return data.cache_file_download_progress = cache_file_download_status::FAILED;
+                });
+            }
+
+            logger::debug("{}:{} ({}) [[{}]] created sparse cache file {} [size={}][part_size={}]",
+                    __FILE__, __LINE__, __func__, get_thread_identifier(), cache_file_path_, _object_size, _part_size);
+
+            return shm_obj.atomic_exec([_object_size, _part_size](auto& data) {
+                const auto number_of_words = sparse_cache::number_of_words(_object_size, _part_size);
+                try {
+                    data.filled_parts.assign(number_of_words, 0);
+                    data.dirty_parts.assign(number_of_words, 0);
+                    data.filling_parts.assign(number_of_words, 0);
+                } catch (const boost::interprocess::bad_alloc&) {
+                    data.filled_parts.clear();
+                    data.dirty_parts.clear();
+                    data.filling_parts.clear();
+                    return data.cache_file_download_progress = cache_file_download_status::FAILED;
+                }
+                data.sparse_part_size = _part_size;
+                return data.cache_file_download_progress = cache_file_download_status::SUCCESS;
+            });
+        }
+
+        // Reads the parts of a sparse cache file that overlap the _length bytes at _offset from S3,
+        // unless they were read already.  If _overwrite is true the bytes are about to be written,
+        // so a part they cover entirely is not read, and the parts are marked dirty.  Returns false
+        // if a part could not be read.
+        //
+        // The parts are marked as being filled under the shared memory lock and read without it, so
+        // the other threads and agents using the file are not blocked by the downloads.  Then they
+        // are marked filled under the lock.  A part being filled by someone else is waited for,
+        // unless that takes longer than the shared memory timeout, in which case its reader is
+        // assumed to be dead and the part is read again.
+        bool fill_cache_file_parts(named_shared_memory_object& shm_obj, std::int64_t _offset, std::int64_t _length, bool _overwrite)
+        {
+            if (_offset < 0 || _length <= 0) {
+                return true;
+            }
+
+            const auto wait_limit = std::chrono::steady_clock::now() +
+                std::chrono::seconds{config_.shared_memory_timeout_in_seconds};
+
+            while (true) {
+                const bool take_over = std::chrono::steady_clock::now() >= wait_limit;
+
+                std::vector<sparse_cache::part_to_read> parts_to_read;
+                std::int64_t part_size = 0;
+                bool waiting = false;
+
+                shm_obj.atomic_exec([_offset, _length, _overwrite, take_over, &parts_to_read, &part_size, &waiting](auto& data) {
+                    part_size = data.sparse_part_size;
+                    waiting = sparse_cache::claim_parts(data, _offset, _length, _overwrite, take_over, parts_to_read);
+                });
+
+                std::vector<bool> read(parts_to_read.size(), false);
+                for (std::size_t i = 0; i < parts_to_read.size(); ++i) {
+                    const auto [part, part_length] = parts_to_read[i];
+                    read[i] = part_length == s3_download_part_worker_routine(nullptr, part_length, part * part_size);
+                    if (!read[i]) {
+                        logger::error("{}:{} ({}) [[{}]] failed to read part {} of {} into the cache file.",
+                                __FILE__, __LINE__, __func__, get_thread_identifier(), part + 1, object_key_);
+                        break;
+                    }
+                }
+
+                if (!parts_to_read.empty()) {
+                    shm_obj.atomic_exec([_overwrite, &parts_to_read, &read](auto& data) {
+                        sparse_cache::release_parts(data, parts_to_read, read, _overwrite);
+                    });
+                }
+
+                if (std::find(read.begin(), read.end(), false) != read.end()) {
+                    return false;
+                }
+
+                if (!waiting) {
+                    return true;
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            }
+        }
+
+        // Reads the parts of a sparse cache file of _cache_file_size bytes that were not read from
+        // S3 yet so the file can be uploaded whole.
+        bool fill_sparse_cache_file(named_shared_memory_object& shm_obj, std::int64_t _cache_file_size)
+        {
+            if (!fill_cache_file_parts(shm_obj, 0, _cache_file_size, false)) {
+                return false;
+            }
+
+            return shm_obj.atomic_exec([this, _cache_file_size](auto& data) {
+                // the whole last part was read even if the file is shorter
+                boost::system::error_code ec;
+                boost::filesystem::resize_file(cache_file_path_, static_cast<std::uintmax_t>(_cache_file_size), ec);
+                return !ec;
+            });
+        }
+
         error_codes flush_cache_file(named_shared_memory_object& shm_obj) {
 
             logger::debug("{}:{} ({}) [[{}]] Flushing cache file.",
@@ -1054,8 +1400,7 @@ namespace irods::experimental::io::s3_transport
 
             // Flush the cache file to S3.
 
-            bf::path cache_file =  bf::path(config_.cache_directory) / bf::path(object_key_ + "-cache");
-            cache_file_path_ = cache_file.string();
+            cache_file_path_ = get_cache_file_path();
 
             // calculate the part size
             std::ifstream ifs;
@@ -1098,17 +1443,52 @@ namespace irods::experimental::io::s3_transport
             // file size (1 TiB) to be uploaded within the 10,000 part limit imposed by AWS.
             int64_t preferred_part_size = 1LL*1024*1024*1024;
 
-            // Try the part uploads with the current preferred_part_size.  If we get timeouts uploading a part
-            // (Amazon has a 2 minute limit) loop again with a part size half the previous one.  Continue doing
-            // this on errors until we get a part size that is too small to transfer the file within the 10,000
-            // part count limit.  Break out and return success when the parts all complete successfully.
+            // A sparse cache file only holds the parts of the object that were read or written.  The
+            // parts that were not written are copied from the object by S3 if the file can still be
+            // uploaded in the parts it was tracked in, otherwise the parts not read yet are read now
+            // and the file is uploaded like any other.
+            bool uploaded = false;
+            if (sparse_cache_file_) {
+                const auto layout = make_sparse_cache_file_layout(shm_obj, cache_file_size);
+                const std::int64_t maximum_number_of_parts = constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD;
+
+                if (config_.multipart_enabled && !layout.empty() &&
+                        static_cast<std::int64_t>(layout.size()) <= maximum_number_of_parts) {
+                    return_value = upload_sparse_cache_file(shm_obj, layout);
+                    uploaded = true;
+                } else if (!fill_sparse_cache_file(shm_obj, cache_file_size)) {
+                    return_value = error_codes::DOWNLOAD_FILE_ERROR;
+                    uploaded = true;
+                }
+            }
+
+            // Record the multipart upload so that a flush that fails or is interrupted by a crash
+            // can be resumed by the next flush of this object.
+            if (config_.resumable_uploads_enabled && config_.multipart_enabled && !uploaded) {
+                upload_journal::sweep(config_.cache_directory, config_.resource_name, bucket_context_,
+                        std::chrono::seconds{config_.stale_upload_age_seconds},
+                        config_.non_data_transfer_timeout_seconds * 1000);
+
+                upload_journal_ = std::make_unique<upload_journal>(config_.cache_directory,
+                        config_.resource_name, config_.bucket_name, object_key_);
+                if (!upload_journal_->valid()) {
+                    upload_journal_.reset();
+                }
+            }
+
+            // Try the upload with the current preferred_part_size.  A multipart upload splits the parts that
+            // time out (Amazon has a 2 minute limit) into smaller parts itself.  If a single part upload times
+            // out loop again with a part size half the previous one, which may turn it into a multipart upload.
+            // Continue doing this on errors until we get a part size that is too small to transfer the file
+            // within the 10,000 part count limit.  Break out and return success when the parts all complete
+            // successfully.
             //
             // While exit conditions:
             // 1.  As we try different part sizes when flushing the file, if the part sizes get so small that
             //     the file can't be flushed within the 10,000 part count limit, we break out with an error.
             // 2.  If all part uploads are successful, we break out with a success code.
 
-            while (true) {
+            while (!uploaded) {
 
                 // Calculate the number of parts.
                 unsigned int number_of_parts = config_.number_of_cache_transfer_threads;
@@ -1127,45 +1507,19 @@ namespace irods::experimental::io::s3_transport
 
                 if (config_.multipart_enabled && number_of_parts > 1) {
 
-                    initiate_multipart_upload();
-
-                    unsigned int part_number = 1;
-
-                    std::int64_t part_size_all_but_last_part = cache_file_size / number_of_parts;
+                    return_value = upload_cache_file_parts(shm_obj, cache_file_size, number_of_parts);
 
-                    while (part_number <= number_of_parts) {
-
-                        irods::thread_pool cache_flush_threads{static_cast<int>(config_.number_of_cache_transfer_threads)};
-
-                        // run number_of_cache_transfer_threads simultaneously
-                        for (unsigned int i = 0; i < config_.number_of_cache_transfer_threads; ++i) {
-
-                            if (part_number > number_of_parts) {
-                                break;
-                            }
-
-                            std::int64_t part_size = part_size_all_but_last_part;
-
-                            // give extra bytes to last part
-                            if (part_number == number_of_parts) {
-                                part_size += (cache_file_size % number_of_parts);
-                            }
-
-                            off_t offset = (part_number - 1) * part_size_all_but_last_part;
-
-                            irods::thread_pool::post(cache_flush_threads, [this, part_number, part_size, offset] () {
-                                // upload part and read your part from cache file
-                                s3_upload_part_worker_routine(true, part_number, part_size, offset);
-                            });
+                } else {
 
-                            ++part_number;
+                    // a recorded multipart upload is not resumed by a single part upload
+                    if (upload_journal_) {
+                        if (const auto recorded = upload_journal_->load(); recorded) {
+                            mpu_cancel(recorded->upload_id);
                         }
-                        cache_flush_threads.join();
+                        upload_journal_->remove();
+                        upload_journal_.reset();
                     }
 
-                    return_value = complete_multipart_upload();
-
-                } else {
                     return_value = s3_upload_file(true);
                 }
 
@@ -1186,6 +1540,14 @@ namespace irods::experimental::io::s3_transport
                 }
             } // while
 
+            // the upload is complete or the journal is kept so that the next flush resumes it
+            if (upload_journal_) {
+                if (error_codes::SUCCESS == return_value) {
+                    upload_journal_->remove();
+                }
+                upload_journal_.reset();
+            }
+
             // remove cache file
             logger::debug("{}:{} ({}) [[{}]] removing cache file {}",
                     __FILE__, __LINE__, __func__, this->get_thread_identifier(), cache_file_path_.c_str());
@@ -1195,12 +1557,30 @@ namespace irods::experimental::io::s3_transport
             // already locked so just exec()
             shm_obj.atomic_exec([](auto& data) {
                     data.cache_file_download_progress = cache_file_download_status::NOT_STARTED;
+                    data.sparse_part_size = 0;
+                    data.filled_parts.clear();
+                    data.dirty_parts.clear();
+                    data.filling_parts.clear();
                     return data.cache_file_download_progress;
             });
 
             return return_value;
         }
 
+        // True for a parallel put of a known size that falls back to a cache file because
+        // the threads cannot stream their parts as parts of a multipart upload.  These are
+        // written once from start to end, so they may be staged in memory.
+        bool is_memory_staging_candidate() const {
+            using std::ios_base;
+            const auto m = mode_ & ~(ios_base::ate | ios_base::binary);
+            return config_.memory_staging_budget > 0 &&
+                config_.put_repl_flag &&
+                (ios_base::out | ios_base::trunc) == m &&
+                config_.number_of_client_transfer_threads > 1 &&
+                config_.object_size > 0 &&
+                config_.object_size <= config_.memory_staging_budget;
+        }
+
         bool is_full_upload() {
             //return config_.put_repl_flag;
             using std::ios_base;
@@ -1340,6 +1720,9 @@ namespace irods::experimental::io::s3_transport
 				this->config_.number_of_client_transfer_threads = -1;
 			}
 
+            // a handle left by a failed open belongs to the previous key
+            release_shared_memory();
+
 			object_key_ = _p.string();
 			shmem_key_ = constants::SHARED_MEMORY_KEY_PREFIX +
                 std::to_string(std::hash<std::string>{}(config_.resource_name + "/" + object_key_));
@@ -1348,6 +1731,8 @@ namespace irods::experimental::io::s3_transport
             upload_manager_.shmem_key = shmem_key_;
 
             mode_ = _mode;
+            memory_staged_ = false;
+            memory_staging_lock_ = {};
 
             populate_open_mode_flags();
 
@@ -1366,30 +1751,35 @@ namespace irods::experimental::io::s3_transport
             }
 
 
-            // each process must intitialize S3
-            {
-                std::lock_guard<std::mutex> lock(s3_initialized_counter_mutex_);
-                if (s3_initialized_counter_ == 0) {
-
-                    int flags = S3_INIT_ALL;
-
-                    int status = S3_initialize( "s3", flags, bucket_context_.hostName );
-                    if (status != libs3_types::status_ok) {
-                        logger::error("S3_initialize returned error");
-                        this->set_error(ERROR(S3_INIT_ERROR, "S3_initialize returned error"));
-                        return false;
-                    }
-                }
-                ++s3_initialized_counter_;
+            // the library stays initialized for the life of the process
+            if (library_lifecycle::initialize(config_.hostname) != libs3_types::status_ok) {
+                logger::error("S3_initialize returned error");
+                this->set_error(ERROR(S3_INIT_ERROR, "S3_initialize returned error"));
+                return false;
             }
 
             // only allow open/close to run one at a time for this object
             bool return_value = true;
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
+
+            // Reserving staging space scans the staging directory, so it is done before the
+            // shared memory is locked, by an open that is likely the first one.  The file is
+            // reserved under a name of its own and renamed to the staging file of the object
+            // only if the open turns out to be the first, otherwise it is removed.
+            std::string reserved_staging_path;
+            memory_staging::file_lock reserved_staging_lock;
+            if (use_cache_ && is_memory_staging_candidate() &&
+                    shm_obj.atomic_exec([](auto& data) { return 0 == data.file_open_counter; })) {
+                const auto name = fmt::format("{}.{}", shmem_key_, get_thread_identifier());
+                reserved_staging_lock = memory_staging::reserve(config_.memory_staging_directory,
+                        config_.resource_name, name, config_.object_size, config_.memory_staging_budget);
+                if (reserved_staging_lock.held()) {
+                    reserved_staging_path = memory_staging::path(config_.memory_staging_directory,
+                            config_.resource_name, name);
+                }
+            }
 
-            shm_obj.atomic_exec([this, &return_value, &shm_obj](auto& data) {
+            shm_obj.atomic_exec([this, &return_value, &shm_obj, &reserved_staging_path, &reserved_staging_lock](auto& data) {
 
                 // Issue #2261 - Store in shared memory a flag indicating that a previous open had
                 // the trunc flag set.  In that case subsequent opens without the trunc flag
@@ -1411,6 +1801,10 @@ namespace irods::experimental::io::s3_transport
                         data.part_size_vector.clear();
                         data.last_error_code = error_codes::SUCCESS;
                         data.circular_buffer_read_timeout = false;
+                        data.sparse_part_size = 0;
+                        data.filled_parts.clear();
+                        data.dirty_parts.clear();
+                        data.filling_parts.clear();
                     }
                     data.first_open_has_trunc_flag = true;
                 }
@@ -1441,12 +1835,21 @@ namespace irods::experimental::io::s3_transport
                     if (data.cache_file_download_progress == cache_file_download_status::SUCCESS) {
                         object_status = object_s3_status::IN_S3;
                     } else {
-                        irods::error ret = get_object_s3_status(object_key_, bucket_context_, s3_object_size, object_status, storage_class);
+                        std::string etag;
+                        irods::error ret = get_object_s3_status(object_key_, bucket_context_, s3_object_size, object_status,
+                                storage_class, nullptr, &etag);
                         if (!ret.ok()) {
                             return_value = false;
                             this->set_error(ret);
                         }
                         data.existing_object_size = s3_object_size;
+
+                        // the parts of the object copied by a sparse cache file upload must come from this version
+                        try {
+                            data.existing_object_etag = etag.c_str();
+                        } catch (const boost::interprocess::bad_alloc&) {
+                            data.existing_object_etag.clear();
+                        }
                     }
 
                     // save the size of the existing object as we may need it later
@@ -1479,6 +1882,31 @@ namespace irods::experimental::io::s3_transport
                     }
                 }
 
+                this->sparse_cache_file_ = this->use_cache_ && data.sparse_part_size > 0;
+
+                // If we know the number of threads, use threads_remaining_to_close to determine if this is the
+                // first open. If we do not know the number of threads, use file_open_counter.
+                const bool first_open = (data.know_number_of_threads && 0 == data.threads_remaining_to_close) ||
+                                        (!data.know_number_of_threads && 1 == data.file_open_counter);
+
+                // the first open of an upload that must be assembled decides where it is staged
+                if (first_open) {
+                    data.memory_staged = !reserved_staging_path.empty() &&
+                        0 == ::rename(reserved_staging_path.c_str(), memory_staging::path(this->config_.memory_staging_directory,
+                                    this->config_.resource_name, shmem_key_).c_str());
+                }
+                if (!reserved_staging_path.empty() && !(first_open && data.memory_staged)) {
+                    ::unlink(reserved_staging_path.c_str());
+                }
+                this->memory_staged_ = this->use_cache_ && data.memory_staged;
+
+                // the staging file is held until this open is closed so it is not removed as stale
+                if (this->memory_staged_) {
+                    this->memory_staging_lock_ = first_open
+                        ? std::move(reserved_staging_lock)
+                        : memory_staging::file_lock{this->get_cache_file_path()};
+                }
+
                 if (this->use_cache_) {
 
                     // using cache, open the cache file for subsequent reads/writes
@@ -1486,7 +1914,7 @@ namespace irods::experimental::io::s3_transport
 
                     if (!this->cache_fstream_ || !this->cache_fstream_.is_open()) {
 
-                        bf::path cache_file =  bf::path(this->config_.cache_directory) / bf::path(object_key_ + "-cache");
+                        bf::path cache_file = this->get_cache_file_path();
                         bf::path parent_path = cache_file.parent_path();
 
                         try {
@@ -1507,10 +1935,8 @@ namespace irods::experimental::io::s3_transport
                         std::ios_base::openmode mode;
                         bool trunc_flag = false;
 
-						// If we know the number of threads, use threads_remaining_to_close to determine if this is the
-						// first open. If we do not know the number of threads, use file_open_counter.
-						if ((data.know_number_of_threads && 0 == data.threads_remaining_to_close) ||
-						    (!data.know_number_of_threads && 1 == data.file_open_counter))
+						// The staging file was sized when it was reserved so it is not truncated.
+						if (first_open && !this->memory_staged_)
 						{
 							trunc_flag = true;
                             mode = mode_;
@@ -1587,13 +2013,512 @@ namespace irods::experimental::io::s3_transport
 
         }  // end open_impl
 
+        // Uploads the cache file as a multipart upload of number_of_parts parts and completes it.
+        //
+        // Each part of the initial layout owns the part numbers up to the first one of the next
+        // part, so the numbers are spread over the 10,000 allowed.  When parts time out, the parts
+        // that were uploaded are kept and each part that timed out is split in two using the part
+        // numbers it owns, then only those are uploaded again.  S3 only requires the part numbers to
+        // be ascending, and part_size_vector records the size of each part number used.
+        error_codes upload_cache_file_parts(named_shared_memory_object& shm_obj,
+                                            std::int64_t cache_file_size,
+                                            unsigned int number_of_parts)
+        {
+            const std::int64_t maximum_number_of_parts = constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD;
+            const unsigned int stride = static_cast<unsigned int>(maximum_number_of_parts / number_of_parts);
+
+            // clear the entries left by a previous attempt since the part numbers are not contiguous
+            const bool reserved = shm_obj.atomic_exec([this, maximum_number_of_parts](auto& data) {
+                if (!this->reserve_part_entries(data, maximum_number_of_parts)) {
+                    return false;
+                }
+                for (auto& etag : data.etags) {
+                    etag.clear();
+                }
+                std::fill(data.checksum_vector.begin(), data.checksum_vector.end(), 0);
+                std::fill(data.part_size_vector.begin(), data.part_size_vector.end(), 0);
+                return true;
+            });
+
+            if (!reserved) {
+                return error_codes::BAD_ALLOC;
+            }
+
+            std::int64_t part_size_all_but_last_part = cache_file_size / number_of_parts;
+
+            std::vector<cache_file_part> parts;
+            parts.reserve(number_of_parts);
+            for (unsigned int i = 0; i < number_of_parts; ++i) {
+                const std::int64_t offset = i * part_size_all_but_last_part;
+
+                // give extra bytes to last part
+                const std::int64_t part_size = i + 1 == number_of_parts
+                    ? cache_file_size - offset
+                    : part_size_all_but_last_part;
+
+                parts.push_back({i * stride + 1, (i + 1) * stride + 1, offset, part_size, false});
+            }
+
+            if (!resume_multipart_upload(cache_file_size, part_size_all_but_last_part, parts)) {
+
+                if (error_codes::SUCCESS == initiate_multipart_upload() && upload_journal_) {
+                    const std::string upload_id = shm_obj.atomic_exec([](auto& data) {
+                        return std::string{data.upload_id.c_str()};
+                    });
+                    if (!upload_journal_->start(upload_id, cache_file_size,
+                                part_size_all_but_last_part, number_of_parts)) {
+                        logger::warn("{}:{} ({}) [[{}]] failed to write the upload journal, the upload of {} "
+                                "cannot be resumed.", __FILE__, __LINE__, __func__, get_thread_identifier(),
+                                object_key_);
+                        upload_journal_.reset();
+                    }
+                }
+            }
+
+            while (true) {
+
+                std::vector<cache_file_part*> pending_parts;
+                for (auto& part : parts) {
+                    if (!part.uploaded) {
+                        pending_parts.push_back(&part);
+                    }
+                }
+
+                // run number_of_cache_transfer_threads simultaneously
+                for (std::size_t next = 0; next < pending_parts.size();) {
+
+                    irods::thread_pool cache_flush_threads{static_cast<int>(config_.number_of_cache_transfer_threads)};
+
+                    for (unsigned int i = 0; i < config_.number_of_cache_transfer_threads && next < pending_parts.size(); ++i) {
+                        cache_file_part* part = pending_parts[next++];
+                        irods::thread_pool::post(cache_flush_threads, [this, part] () {
+                            // upload part and read your part from cache file
+                            part->uploaded = s3_upload_part_worker_routine(true, part->number, part->size, part->offset);
+                        });
+                    }
+                    cache_flush_threads.join();
+                }
+
+                if (std::all_of(parts.begin(), parts.end(), [](const auto& part) { return part.uploaded; })) {
+                    break;
+                }
+
+                const error_codes last_error_code = shm_obj.atomic_exec([](auto& data) {
+                    return data.last_error_code.load();
+                });
+
+                // only timeouts are worth another try with smaller parts, the completion below
+                // cancels the upload on any other error
+                if (error_codes::UPLOAD_PART_TIMEOUT != last_error_code) {
+                    if (error_codes::SUCCESS == last_error_code) {
+                        shm_obj.atomic_exec([](auto& data) {
+                            data.last_error_code = error_codes::UPLOAD_FILE_ERROR;
+                        });
+                    }
+                    break;
+                }
+
+                // keep the uploaded parts and split the others in two
+                std::vector<cache_file_part> layout;
+                std::size_t failed_parts = 0;
+                std::size_t split_parts = 0;
+                for (const auto& part : parts) {
+
+                    if (part.uploaded) {
+                        layout.push_back(part);
+                        continue;
+                    }
+                    ++failed_parts;
+
+                    // every part but the last must be at least minimum_part_size
+                    const std::int64_t count = std::min<std::int64_t>({2,
+                            part.number_limit - part.number,
+                            part.size / std::max<std::int64_t>(config_.minimum_part_size, 1)});
+
+                    if (count < 2) {
+                        // retried as it is
+                        layout.push_back(part);
+                        continue;
+                    }
+                    ++split_parts;
+
+                    const std::int64_t size = part.size / count;
+                    const unsigned int numbers = static_cast<unsigned int>((part.number_limit - part.number) / count);
+                    for (std::int64_t i = 0; i < count; ++i) {
+                        const bool last = i + 1 == count;
+                        layout.push_back({static_cast<unsigned int>(part.number + i * numbers),
+                                last ? part.number_limit : static_cast<unsigned int>(part.number + (i + 1) * numbers),
+                                part.offset + i * size,
+                                last ? part.size - i * size : size,
+                                false});
+                    }
+                }
+
+                // parts get smaller on every pass so this ends
+                if (split_parts == 0) {
+                    logger::error("{}:{} ({}) [[{}]] Multiple timeouts resulted in parts that are too small to upload "
+                            "the {} size file.", __FILE__, __LINE__, __func__, get_thread_identifier(), cache_file_size);
+                    shm_obj.atomic_exec([](auto& data) {
+                        data.last_error_code = error_codes::UPLOAD_FILE_ERROR;
+                    });
+                    break;
+                }
+
+                // reset saved errors
+                shm_obj.atomic_exec([](auto& data) {
+                    data.last_error_code = error_codes::SUCCESS;
+                });
+                this->set_error(SUCCESS());
+
+                logger::warn("{}:{} ({}) [[{}]] {} parts timed out while flushing the cache file.  Uploading them "
+                        "again as {} parts.", __FILE__, __LINE__, __func__, get_thread_identifier(), failed_parts,
+                        layout.size() - (parts.size() - failed_parts));
+
+                parts = std::move(layout);
+            }
+
+            // the part numbers of a cache flush are not contiguous
+            std::vector<unsigned int> part_numbers;
+            part_numbers.reserve(parts.size());
+            for (const auto& part : parts) {
+                part_numbers.push_back(part.number);
+            }
+
+            return complete_multipart_upload(part_numbers);
+
+        } // end upload_cache_file_parts
+
+        bool streaming_journal_enabled() const
+        {
+            return config_.resumable_uploads_enabled && !config_.cache_directory.empty();
+        }
+
+        // Records a multipart upload streamed without the cache so that the sweeper aborts it
+        // if it is never completed.  It cannot be resumed, the data is not kept.
+        void journal_streaming_upload(named_shared_memory_object& shm_obj)
+        {
+            if (!streaming_journal_enabled()) {
+                return;
+            }
+
+            upload_journal::sweep(config_.cache_directory, config_.resource_name, bucket_context_,
+                    std::chrono::seconds{config_.stale_upload_age_seconds},
+                    config_.non_data_transfer_timeout_seconds * 1000);
+
+            const std::string upload_id = shm_obj.atomic_exec([](auto& data) {
+                return std::string{data.upload_id.c_str()};
+            });
+
+            upload_journal journal{config_.cache_directory, config_.resource_name, config_.bucket_name, object_key_};
+            if (!journal.start(upload_id, config_.object_size, upload_journal::STREAMING_PART_SIZE, 0)) {
+                logger::warn("{}:{} ({}) [[{}]] failed to write the upload journal, the upload of {} is not "
+                        "aborted if it is never completed.", __FILE__, __LINE__, __func__, get_thread_identifier(),
+                        object_key_);
+            }
+        } // end journal_streaming_upload
+
+        // Resumes the multipart upload recorded in the journal if it was made for a cache file
+        // of the same size split into the same parts.  A recorded part is reused if S3 lists a
+        // part with its number and size, the etags match, and the etag is the MD5 of that range
+        // of the cache file.
+        //
+        // A part of _parts may have been split after a timeout, so the reused parts within its
+        // numbers and bytes replace it, and the bytes between them become parts numbered between
+        // theirs.  Reused parts are marked as uploaded and their etag, checksum and size are put
+        // in shared memory.  A recorded upload that cannot be resumed is aborted.  Returns false
+        // if a new upload must be initiated.
+        bool resume_multipart_upload(std::int64_t                  _cache_file_size,
+                                     std::int64_t                  _part_size,
+                                     std::vector<cache_file_part>& _parts)
+        {
+            if (!upload_journal_) {
+                return false;
+            }
+
+            const auto recorded = upload_journal_->load();
+            if (!recorded) {
+                return false;
+            }
+
+            if (recorded->object_size == _cache_file_size && recorded->part_size == _part_size &&
+                    recorded->number_of_parts == static_cast<std::int64_t>(_parts.size())) {
+
+                std::map<std::int64_t, upload_journal::part> listed_parts;
+                const S3Status status = list_parts(config_.resource_name, bucket_context_, object_key_,
+                        recorded->upload_id, make_retry_policy(), config_.non_data_transfer_timeout_seconds * 1000,
+                        listed_parts);
+
+                if (status == S3StatusOK) {
+
+                    // a part number uploaded again is recorded again, the last record is the one S3 has
+                    std::map<std::int64_t, upload_journal::part> verified_parts;
+                    for (const auto& part : recorded->parts) {
+                        const auto listed = listed_parts.find(part.number);
+                        if (listed != listed_parts.end() && listed->second.size == part.size &&
+                                listed->second.etag == part.etag) {
+                            verified_parts[part.number] = part;
+                        }
+                    }
+
+                    std::vector<cache_file_part>      layout;
+                    std::vector<upload_journal::part> reused_parts;
+                    for (const auto& layout_part : _parts) {
+
+                        const std::int64_t end = layout_part.offset + layout_part.size;
+
+                        std::vector<cache_file_part>      pieces;
+                        std::vector<upload_journal::part> reused_pieces;
+                        std::int64_t offset = layout_part.offset;
+                        unsigned int number = layout_part.number;
+                        bool usable = true;
+
+                        for (auto iter = verified_parts.lower_bound(layout_part.number);
+                                iter != verified_parts.end() && iter->first < layout_part.number_limit; ++iter) {
+
+                            const auto& part = iter->second;
+                            if (part.offset < offset || part.offset + part.size > end ||
+                                    (part.offset > offset && number >= part.number) ||
+                                    !etag_matches_file_range(part.etag, cache_file_path_, part.offset, part.size)) {
+                                usable = false;
+                                break;
+                            }
+
+                            if (part.offset > offset) {
+                                pieces.push_back({number, static_cast<unsigned int>(part.number), offset, part.offset - offset, false});
+                            }
+                            pieces.push_back({static_cast<unsigned int>(part.number), static_cast<unsigned int>(part.number + 1),
+                                    part.offset, part.size, true});
+                            reused_pieces.push_back(part);
+
+                            offset = part.offset + part.size;
+                            number = static_cast<unsigned int>(part.number + 1);
+                        }
+
+                        if (usable && offset < end) {
+                            if (number < layout_part.number_limit) {
+                                pieces.push_back({number, layout_part.number_limit, offset, end - offset, false});
+                            } else {
+                                usable = false;
+                            }
+                        }
+
+                        // the part is uploaded again whole if its recorded parts do not fit in it
+                        if (!usable) {
+                            layout.push_back(layout_part);
+                            continue;
+                        }
+
+                        layout.insert(layout.end(), pieces.begin(), pieces.end());
+                        reused_parts.insert(reused_parts.end(), reused_pieces.begin(), reused_pieces.end());
+                    }
+
+                    named_shared_memory_object& shm_obj = shared_memory();
+                    const bool stored = shm_obj.atomic_exec([&recorded, &reused_parts](auto& data) {
+                        try {
+                            data.upload_id = recorded->upload_id.c_str();
+                            for (const auto& part : reused_parts) {
+                                data.etags[part.number - 1] = part.etag.c_str();
+                                data.checksum_vector[part.number - 1] = part.checksum;
+                                data.part_size_vector[part.number - 1] = part.size;
+                            }
+                        } catch (const boost::interprocess::bad_alloc&) {
+                            return false;
+                        }
+                        return true;
+                    });
+
+                    if (stored) {
+                        logger::info("{}:{} ({}) [[{}]] resuming the multipart upload of {} [upload_id={}], "
+                                "{} of {} parts are already uploaded.", __FILE__, __LINE__, __func__,
+                                get_thread_identifier(), object_key_, recorded->upload_id, reused_parts.size(),
+                                layout.size());
+                        _parts = std::move(layout);
+                        return true;
+                    }
+                } else {
+                    logger::warn("{}:{} ({}) [[{}]] failed to list the parts of the multipart upload of {} "
+                            "[upload_id={}], starting a new upload - {}", __FILE__, __LINE__, __func__,
+                            get_thread_identifier(), object_key_, recorded->upload_id, S3_get_status_name(status));
+                }
+            }
+
+            // the recorded upload cannot be resumed
+            mpu_cancel(recorded->upload_id);
+            return false;
+
+        } // end resume_multipart_upload
+
+        // Splits a sparse cache file of _cache_file_size bytes into the parts it is uploaded in.
+        auto make_sparse_cache_file_layout(named_shared_memory_object& shm_obj,
+                                           std::int64_t _cache_file_size) -> std::vector<sparse_cache_file_part>
+        {
+            return shm_obj.atomic_exec([_cache_file_size](auto& data) {
+                return sparse_cache::make_layout(data, _cache_file_size);
+            });
+
+        } // end make_sparse_cache_file_layout
+
+        // Uploads a sparse cache file as a multipart upload of the parts in _layout and completes
+        // it.  The parts to copy are copied from the existing object by S3 with UploadPartCopy.  The
+        // other parts are uploaded from the cache file after the bytes of the object they hold are
+        // read from S3 if they were not read yet.
+        error_codes upload_sparse_cache_file(named_shared_memory_object& shm_obj,
+                                             const std::vector<sparse_cache_file_part>& _layout)
+        {
+            const auto number_of_parts = static_cast<std::int64_t>(_layout.size());
+
+            // clear the entries left by a previous attempt
+            const bool reserved = shm_obj.atomic_exec([this, number_of_parts](auto& data) {
+                if (!this->reserve_part_entries(data, number_of_parts)) {
+                    return false;
+                }
+                for (auto& etag : data.etags) {
+                    etag.clear();
+                }
+                std::fill(data.checksum_vector.begin(), data.checksum_vector.end(), 0);
+                std::fill(data.part_size_vector.begin(), data.part_size_vector.end(), 0);
+                return true;
+            });
+
+            if (!reserved) {
+                return error_codes::BAD_ALLOC;
+            }
+
+            if (error_codes::SUCCESS != initiate_multipart_upload()) {
+                return error_codes::INITIATE_MULTIPART_UPLOAD_ERROR;
+            }
+
+            const std::string upload_id = shm_obj.atomic_exec([](auto& data) {
+                return std::string{data.upload_id.c_str()};
+            });
+
+            std::atomic<std::int64_t> copied_bytes{0};
+
+            // run number_of_cache_transfer_threads simultaneously
+            for (std::int64_t next = 0; next < number_of_parts;) {
+
+                irods::thread_pool threads{static_cast<int>(config_.number_of_cache_transfer_threads)};
+
+                for (unsigned int i = 0; i < config_.number_of_cache_transfer_threads && next < number_of_parts; ++i, ++next) {
+
+                    const sparse_cache_file_part& part = _layout[next];
+                    const auto part_number = static_cast<unsigned int>(next + 1);
+
+                    irods::thread_pool::post(threads, [this, &shm_obj, &upload_id, &copied_bytes, &part, part_number] () {
+
+                        if (part.copy) {
+                            if (this->copy_object_part(upload_id, part_number, part.offset, part.size)) {
+                                copied_bytes += part.size;
+                            }
+                            return;
+                        }
+
+                        if (part.unread > 0 &&
+                                part.unread != this->s3_download_part_worker_routine(nullptr, part.unread, part.offset)) {
+                            shm_obj.exec([](auto& data) {
+                                data.last_error_code = error_codes::DOWNLOAD_FILE_ERROR;
+                            });
+                            return;
+                        }
+
+                        this->s3_upload_part_worker_routine(true, part_number, part.size, part.offset);
+                    });
+                }
+                threads.join();
+            }
+
+            logger::debug("{}:{} ({}) [[{}]] {} bytes of {} were copied from the existing object in {} parts.",
+                    __FILE__, __LINE__, __func__, get_thread_identifier(), copied_bytes.load(), object_key_,
+                    number_of_parts);
+
+            return complete_multipart_upload();
+
+        } // end upload_sparse_cache_file
+
+        // Copies the _size bytes at _offset of the existing object to part _part_number of the
+        // multipart upload with UploadPartCopy.  The etag and size of the part are put in shared
+        // memory.
+        bool copy_object_part(const std::string& _upload_id,
+                              unsigned int       _part_number,
+                              std::int64_t       _offset,
+                              std::int64_t       _size)
+        {
+            S3ResponseHandler copy_handler
+                = { s3_multipart_upload::copy_part_callback::on_response_properties,
+                    s3_multipart_upload::copy_part_callback::on_response_completion };
+
+            s3_multipart_upload::copy_part_callback::data copy_data{bucket_context_, libs3_types::status_ok};
+            std::array<char, 512> etag{};
+
+            // the object may have been replaced since it was opened
+            const std::string source_etag = shared_memory().atomic_exec([](auto& data) {
+                return std::string{data.existing_object_etag.c_str()};
+            });
+
+            auto retry = make_retry_policy();
+
+            do {
+                S3PutProperties put_props{};
+                put_props.expires = -1;
+                std::int64_t last_modified = 0;
+
+                copy_data.status = libs3_types::status_ok;
+
+                libs3_types::bucket_context bucket_context = bucket_context_;
+                std::string hostname = select_hostname();
+                bucket_context.hostName = hostname.c_str();
+                endpoint_request endpoint{config_.resource_name, hostname, config_.user_name};
+
+                logger::debug("{}:{} ({}) [[{}]] Multipart:  Copy part {}, key \"{}\", upload_id \"{}\", offset {}, len {}",
+                        __FILE__, __LINE__, __func__, get_thread_identifier(), _part_number, object_key_,
+                        _upload_id, _offset, _size);
+
+                // the source and the destination are the object, it is replaced when the upload completes
+                S3_copy_object_range_if_match(&bucket_context, object_key_.c_str(), nullptr, nullptr,
+                        static_cast<int>(_part_number), _upload_id.c_str(),
+                        static_cast<unsigned long>(_offset), static_cast<unsigned long>(_size),
+                        source_etag.empty() ? nullptr : source_etag.c_str(),
+                        &put_props, &last_modified, static_cast<int>(etag.size()), etag.data(),
+                        nullptr, 0, &copy_handler, &copy_data);
+
+                endpoint.finish(copy_data.status, static_cast<std::int64_t>(_size));
+
+                if (copy_data.status != libs3_types::status_ok) {
+                    logger::error("{}:{} ({}) [[{}]] S3_copy_object_range returned error [status={}][part={}][attempt={}][retry_count_limit={}].",
+                            __FILE__, __LINE__, __func__, get_thread_identifier(), S3_get_status_name(copy_data.status),
+                            _part_number, retry.retries() + 1, config_.retry_count_limit);
+                }
+
+            } while (retry.should_retry(copy_data.status));
+
+            named_shared_memory_object& shm_obj = shared_memory();
+
+            return shm_obj.atomic_exec([this, &copy_data, &etag, _part_number, _size](auto& data) {
+                if (copy_data.status != libs3_types::status_ok || '\0' == etag.front()) {
+                    const auto msg = fmt::format("Failed to copy part {} of the object", _part_number);
+                    this->set_error(ERROR(S3_PUT_ERROR, msg.c_str()));
+                    data.last_error_code = error_codes::UPLOAD_FILE_ERROR;
+                    return false;
+                }
+
+                try {
+                    data.etags[_part_number - 1] = etag.data();
+                } catch (const boost::interprocess::bad_alloc&) {
+                    data.last_error_code = error_codes::BAD_ALLOC;
+                    return false;
+                }
+                data.checksum_vector[_part_number - 1] = 0;
+                data.part_size_vector[_part_number - 1] = _size;
+                return true;
+            });
+
+        } // end copy_object_part
+
         error_codes initiate_multipart_upload()
         {
             namespace bi = boost::interprocess;
             namespace types = shared_data::interprocess_types;
 
-            unsigned int retry_cnt    = 0;
-
             S3PutProperties put_props{};
             put_props.useServerSideEncryption = config_.server_encrypt_flag;
             put_props.xAmzStorageClass = config_.s3_storage_class.c_str();
@@ -1622,15 +2547,11 @@ namespace irods::experimental::io::s3_transport
 
             // read shared memory entry for this key
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
 
-            return shm_obj.atomic_exec([this, &put_props, &retry_cnt](auto& data) {
+            return shm_obj.atomic_exec([this, &put_props](auto& data) {
 
-                int retry_wait_seconds = this->config_.retry_wait_seconds;
-
-                retry_cnt = 0;
+                auto retry = make_retry_policy();
 
                 // These expect a upload_manager* as cbdata
                 S3MultipartInitialHandler mpu_initial_handler
@@ -1651,17 +2572,7 @@ namespace irods::experimental::io::s3_transport
                     logger::debug("{}:{} ({}) [[{}]] [manager.status={}]", __FILE__, __LINE__,
                             __func__, get_thread_identifier(), S3_get_status_name(upload_manager_.status));
 
-                    if (upload_manager_.status != libs3_types::status_ok) {
-                        s3_sleep( retry_wait_seconds );
-                        retry_wait_seconds *= 2;
-                        if (retry_wait_seconds > config_.max_retry_wait_seconds) {
-                            retry_wait_seconds = config_.max_retry_wait_seconds;
-                        }
-                    }
-
-                } while ( (upload_manager_.status != libs3_types::status_ok)
-                        && irods::experimental::io::s3_transport::S3_status_is_retryable(upload_manager_.status)
-                        && ( ++retry_cnt <= config_.retry_count_limit));
+                } while (retry.should_retry(upload_manager_.status));
 
                 if ("" == data.upload_id || upload_manager_.status != libs3_types::status_ok) {
                     return error_codes::INITIATE_MULTIPART_UPLOAD_ERROR;
@@ -1687,15 +2598,18 @@ namespace irods::experimental::io::s3_transport
 
             // read shared memory entry for this key
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
 
             // read upload_id from shared_memory
             std::string upload_id = shm_obj.atomic_exec([](auto& data) {
                 return data.upload_id.c_str();
             });
 
+            mpu_cancel(upload_id);
+        } // end mpu_cancel
+
+        void mpu_cancel(const std::string& upload_id)
+        {
             S3AbortMultipartUploadHandler abort_handler
                 = { { s3_multipart_upload::cancel_callback::on_response_properties,
                       s3_multipart_upload::cancel_callback::on_response_completion } };
@@ -1723,25 +2637,56 @@ namespace irods::experimental::io::s3_transport
         } // end mpu_cancel
 
 
-        error_codes complete_multipart_upload()
+        // Completes the multipart upload with the parts numbered _part_numbers, or if it is empty
+        // with the parts numbered from 1 up to the last part that has an etag.  If any of those
+        // parts has no etag the upload is not completed and is cancelled.
+        error_codes complete_multipart_upload(const std::vector<unsigned int>& _part_numbers = {})
         {
             namespace bi = boost::interprocess;
             namespace types = shared_data::interprocess_types;
 
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
-
-            error_codes result = shm_obj.atomic_exec([this](auto& data) {
+            named_shared_memory_object& shm_obj = shared_memory();
 
-                int retry_wait_seconds = this->config_.retry_wait_seconds;
+            // Build the request from the etags and checksums under the lock.  The request is sent
+            // without holding it so the other threads and agents using this object are not blocked
+            // for the duration of the request and its retries.
+            std::string upload_id;
+            std::string xml;
+            const bool have_upload_id = shm_obj.atomic_exec([this, &upload_id, &xml, &_part_numbers](auto& data) {
 
-                std::string upload_id  = data.upload_id.c_str();
+                upload_id = data.upload_id.c_str();
 
                 if ("" == upload_id) {
-                    this->set_error(ERROR(S3_PUT_ERROR, "null upload_id in complete_multipart_upload"));
-                    return error_codes::COMPLETE_MULTIPART_UPLOAD_ERROR;
+                    return false;
+                }
+
+                std::vector<std::uint64_t> indexes;
+                if (_part_numbers.empty()) {
+                    std::uint64_t count = data.etags.size();
+                    while (count > 0 && data.etags[count - 1].empty()) {
+                        --count;
+                    }
+                    for (std::uint64_t i = 0; i < count; ++i) {
+                        indexes.push_back(i);
+                    }
+                } else {
+                    for (const unsigned int part_number : _part_numbers) {
+                        indexes.push_back(part_number - 1);
+                    }
+                }
+
+                if (error_codes::SUCCESS == data.last_error_code) {
+                    const auto missing = std::find_if(indexes.begin(), indexes.end(), [&data](std::uint64_t _i) {
+                        return _i >= data.etags.size() || data.etags[_i].empty();
+                    });
+                    if (indexes.empty() || missing != indexes.end()) {
+                        logger::error("{}:{} ({}) [[{}]] not completing the multipart upload of {} [upload_id={}], "
+                                "part {} has no etag", __FILE__, __LINE__, __func__, get_thread_identifier(),
+                                object_key_, upload_id, indexes.empty() ? 1 : *missing + 1);
+                        this->set_error(ERROR(S3_PUT_ERROR, fmt::format("a part of {} has no etag", object_key_)));
+                        data.last_error_code = error_codes::UPLOAD_FILE_ERROR;
+                    }
                 }
 
                 if (error_codes::SUCCESS == data.last_error_code) { // If someone aborted, don't complete...
@@ -1749,10 +2694,9 @@ namespace irods::experimental::io::s3_transport
                     logger::debug( "{}:{} ({}) [[{}]] {}", __FILE__, __LINE__, __func__, get_thread_identifier(),
                             msg.c_str() );
 
-                    std::uint64_t i;
+                    xml = fmt::format("<CompleteMultipartUpload>\n");
+                    for (const std::uint64_t i : indexes) {
 
-                    auto xml = fmt::format("<CompleteMultipartUpload>\n");
-                    for ( i = 0; i < data.etags.size() && !data.etags[i].empty(); i++ ) {
                         // Check if we have a checksum for this part
 #ifdef IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
                         if (this->config_.trailing_checksum_on_upload_enabled &&
@@ -1784,87 +2728,111 @@ namespace irods::experimental::io::s3_transport
 #endif // IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
                     }
                     xml += fmt::format("</CompleteMultipartUpload>\n");
+                }
+
+                return true;
+
+            });
+
+            if (!have_upload_id) {
+                this->set_error(ERROR(S3_PUT_ERROR, "null upload_id in complete_multipart_upload"));
+                return error_codes::COMPLETE_MULTIPART_UPLOAD_ERROR;
+            }
+
+            if (!xml.empty()) {
+
+                logger::debug( "{}:{} ({}) [[{}]] [key={}] Request: {}", __FILE__, __LINE__, __func__, get_thread_identifier(),
+                        object_key_.c_str(), xml.c_str() );
+
+                int manager_remaining = xml.size();
+                upload_manager_.offset = 0;
+                auto retry = make_retry_policy();
+                S3MultipartCommitHandler commit_handler
+                    = { {s3_multipart_upload::commit_callback::on_response_properties,
+                         s3_multipart_upload::commit_callback::on_response_completion },
+                        s3_multipart_upload::commit_callback::on_response, nullptr };
 
-                    logger::debug( "{}:{} ({}) [[{}]] [key={}] Request: {}", __FILE__, __LINE__, __func__, get_thread_identifier(),
-                            object_key_.c_str(), xml.c_str() );
+                do {
+                    // On partial error, need to restart XML send from the beginning
+                    upload_manager_.remaining = manager_remaining;
+                    upload_manager_.xml = xml.c_str();
 
-                    int manager_remaining = xml.size();
                     upload_manager_.offset = 0;
-                    unsigned int retry_cnt = 0;
-                    S3MultipartCommitHandler commit_handler
-                        = { {s3_multipart_upload::commit_callback::on_response_properties,
-                             s3_multipart_upload::commit_callback::on_response_completion },
-                            s3_multipart_upload::commit_callback::on_response, nullptr };
-
-                    do {
-                        // On partial error, need to restart XML send from the beginning
-                        upload_manager_.remaining = manager_remaining;
-                        upload_manager_.xml = xml.c_str();
-
-                        upload_manager_.offset = 0;
-                        S3_complete_multipart_upload(&bucket_context_,
-                                object_key_.c_str(),
-                                &commit_handler,
-                                upload_id.c_str(),
-                                upload_manager_.remaining,
-                                nullptr,  // putProperties
-                                nullptr,
-                                config_.non_data_transfer_timeout_seconds * 1000,   // timeout (ms)
-                                &upload_manager_);
-
-                        logger::debug("{}:{} ({}) [[{}]] [key={}][manager.status={}]", __FILE__, __LINE__,
-                                __func__, get_thread_identifier(), object_key_.c_str(), S3_get_status_name(upload_manager_.status));
-
-                        retry_cnt++;
-
-                        // Treating a timeout as a success here and below because under load we sometimes get a timeout
-                        // but the multipart completes later.  A head/stat will detect this later.
-                        if (upload_manager_.status != libs3_types::status_ok &&
-                                upload_manager_.status != libs3_types::status_request_timeout &&
-                                retry_cnt <= config_.retry_count_limit) {
-
-                            logger::error("{}:{} ({}) [[{}]] S3_complete_multipart_upload returned error [status={}][object_key={}][attempt={}][retry_count_limit={}].  Sleeping for {} seconds",
-                                    __FILE__, __LINE__, __func__, get_thread_identifier(),
-                                    S3_get_status_name(upload_manager_.status), object_key_.c_str(), retry_cnt, config_.retry_count_limit, retry_wait_seconds);
-                            s3_sleep( retry_wait_seconds );
-                            retry_wait_seconds *= 2;
-                            if (retry_wait_seconds > config_.max_retry_wait_seconds) {
-                                retry_wait_seconds = config_.max_retry_wait_seconds;
-                            }
-                        }
+                    S3_complete_multipart_upload(&bucket_context_,
+                            object_key_.c_str(),
+                            &commit_handler,
+                            upload_id.c_str(),
+                            upload_manager_.remaining,
+                            nullptr,  // putProperties
+                            nullptr,
+                            config_.non_data_transfer_timeout_seconds * 1000,   // timeout (ms)
+                            &upload_manager_);
+
+                    logger::debug("{}:{} ({}) [[{}]] [key={}][manager.status={}]", __FILE__, __LINE__,
+                            __func__, get_thread_identifier(), object_key_.c_str(), S3_get_status_name(upload_manager_.status));
+
+                    // Treating a timeout as a success here and below because under load we sometimes get a timeout
+                    // but the multipart completes later.  A head/stat will detect this later.
+                    if (upload_manager_.status != libs3_types::status_ok &&
+                            upload_manager_.status != libs3_types::status_request_timeout) {
+
+                        logger::error("{}:{} ({}) [[{}]] S3_complete_multipart_upload returned error [status={}][object_key={}][attempt={}][retry_count_limit={}].",
+                                __FILE__, __LINE__, __func__, get_thread_identifier(),
+                                S3_get_status_name(upload_manager_.status), object_key_.c_str(), retry.retries() + 1, config_.retry_count_limit);
+                    }
 
-                    } while (upload_manager_.status != libs3_types::status_ok &&
-                            upload_manager_.status != libs3_types::status_request_timeout  &&
-                            irods::experimental::io::s3_transport::S3_status_is_retryable(upload_manager_.status) &&
-                            ( retry_cnt <= config_.retry_count_limit ));
+                } while (upload_manager_.status != libs3_types::status_request_timeout &&
+                        retry.should_retry(upload_manager_.status));
 
-                    if (upload_manager_.status != libs3_types::status_ok && upload_manager_.status != libs3_types::status_request_timeout) {
-                        auto msg  = fmt::format("{}  - Error putting the S3 object: \"{}\"",
-                                __func__,
-                                object_key_);
-                        if(upload_manager_.status >= 0) {
-                            msg += fmt::format(" - \"{}\"", S3_get_status_name( upload_manager_.status ));
-                        }
-                        this->set_error(ERROR(S3_PUT_ERROR, msg.c_str()));
-                        return error_codes::COMPLETE_MULTIPART_UPLOAD_ERROR;
+                if (upload_manager_.status != libs3_types::status_ok && upload_manager_.status != libs3_types::status_request_timeout) {
+                    auto msg  = fmt::format("{}  - Error putting the S3 object: \"{}\"",
+                            __func__,
+                            object_key_);
+                    if(upload_manager_.status >= 0) {
+                        msg += fmt::format(" - \"{}\"", S3_get_status_name( upload_manager_.status ));
                     }
+                    this->set_error(ERROR(S3_PUT_ERROR, msg.c_str()));
+                    return error_codes::COMPLETE_MULTIPART_UPLOAD_ERROR;
                 }
+            }
 
-                if (error_codes::SUCCESS != data.last_error_code && "" != data.upload_id ) {
+            const bool completed = !xml.empty();
 
-                    // Someone aborted after we started, delete the partial object on S3
-                    logger::debug("Cancelling multipart upload");
-                    mpu_cancel();
+            return shm_obj.atomic_exec([this, &upload_id, completed](auto& data) {
 
-                    // Return the error
-                    return data.last_error_code;
+                if (error_codes::SUCCESS == data.last_error_code) {
+                    return error_codes::SUCCESS;
                 }
 
-                return error_codes::SUCCESS;
+                // Someone recorded an error while the upload was completed.  The upload no longer
+                // exists and the object is whole, so it is kept and only the error is returned.
+                if (completed) {
+                    logger::warn("{}:{} ({}) [[{}]] an error was recorded while the multipart upload of {} "
+                            "[upload_id={}] was completed [last_error_code={}]", __FILE__, __LINE__, __func__,
+                            get_thread_identifier(), object_key_, upload_id, static_cast<int>(data.last_error_code.load()));
+                    return data.last_error_code.load();
+                }
 
-            });
+                // The upload was not completed because of the error.  A new upload of the object may
+                // have started while the lock was released, only cancel ours.
+                if (upload_id == data.upload_id.c_str()) {
+
+                    // a journaled upload is kept for the next flush to resume, the sweeper
+                    // aborts it if that never happens
+                    if (upload_journal_) {
+                        logger::info("{}:{} ({}) [[{}]] keeping the multipart upload of {} [upload_id={}] to be resumed.",
+                                __FILE__, __LINE__, __func__, get_thread_identifier(), object_key_, upload_id);
+                        return data.last_error_code.load();
+                    }
+
+                    // abort the upload so S3 discards its parts
+                    logger::debug("Cancelling multipart upload");
+                    mpu_cancel(upload_id);
+                }
 
-            return result;
+                return data.last_error_code.load();
+
+            });
         } // end complete_multipart_upload
 
 
@@ -1875,22 +2843,16 @@ namespace irods::experimental::io::s3_transport
         //     length               - The length to be downloaded.
         //     offset               - If provided this is the offset of the object that is being downloaded.  If not
         //                            provided the current offset (file_offset_) is used.
-        //     shmem_already_locked - If provided and true then no locking is done in shmem.
-        //                            The default is false (with shmem locking).
         //
-        //         Note:  The mutex is recursive but when reading from cache this is called by newly created
-        //                threads and thus we need the flag if shmem is already locked.
+        //         Note:  This does not lock shmem so it may be called by threads that hold the lock.
         //
         std::streamsize s3_download_part_worker_routine(char_type *buffer,
                 std::int64_t length,
-                off_t offset = -1,
-                bool shmem_already_locked = false)
+                off_t offset = -1)
         {
             namespace bi = boost::interprocess;
             namespace types = shared_data::interprocess_types;
 
-            unsigned int retry_cnt = 0;
-
             if (0 > offset) {
                 offset = get_file_offset();
             }
@@ -1940,8 +2902,11 @@ namespace irods::experimental::io::s3_transport
             read_callback->thread_identifier = get_thread_identifier();
             read_callback->shmem_key = shmem_key_;
             read_callback->shared_memory_timeout_in_seconds = config_.shared_memory_timeout_in_seconds;
+            read_callback->shm_obj_ptr = &shared_memory();
+            read_callback->resource_name = config_.resource_name;
+            read_callback->user_name = config_.user_name;
 
-            int retry_wait_seconds = config_.retry_wait_seconds;
+            auto retry = make_retry_policy();
 
             do {
 
@@ -1964,9 +2929,15 @@ namespace irods::experimental::io::s3_transport
 
                 std::uint64_t start_microseconds = get_time_in_microseconds();
 
-                S3_get_object( &bucket_context_, object_key_.c_str(), NULL,
-                        offset, read_callback->content_length, 0, 0,
-                        &get_object_handler, read_callback.get() );
+                libs3_types::bucket_context bucket_context = bucket_context_;
+                std::string hostname = select_hostname();
+                bucket_context.hostName = hostname.c_str();
+                endpoint_request endpoint{config_.resource_name, hostname, config_.user_name};
+
+                // sends a second request if the first one is slow to respond and hedging is enabled
+                hedged_get_object(config_.resource_name, endpoint, bucket_context, object_key_,
+                        offset, read_callback->content_length,
+                        get_object_handler, read_callback.get());
 
                 std::uint64_t end_microseconds = get_time_in_microseconds();
                 double bw = (read_callback->content_length / (1024.0*1024.0)) /
@@ -1975,17 +2946,7 @@ namespace irods::experimental::io::s3_transport
                 logger::debug("{}:{} ({}) [[{}]] {}", __FILE__, __LINE__, __func__,
                         get_thread_identifier(), msg.c_str());
 
-                if (read_callback->status != libs3_types::status_ok) {
-                    s3_sleep( retry_wait_seconds );
-                    retry_wait_seconds *= 2;
-                    if (retry_wait_seconds > config_.max_retry_wait_seconds) {
-                        retry_wait_seconds = config_.max_retry_wait_seconds;
-                    }
-                }
-
-            } while ((read_callback->status != libs3_types::status_ok)
-                    && irods::experimental::io::s3_transport::S3_status_is_retryable(read_callback->status)
-                    && (++retry_cnt <= config_.retry_count_limit));
+            } while (retry.should_retry(read_callback->status));
 
             if (read_callback->status != libs3_types::status_ok) {
                 auto msg = fmt::format(" - Error getting the S3 object: \"{}\"", object_key_);
@@ -1997,28 +2958,18 @@ namespace irods::experimental::io::s3_transport
 
                 this->set_error(ERROR(S3_GET_ERROR, msg.c_str()));
 
-                // update the last error in shmem
-
-                named_shared_memory_object shm_obj{shmem_key_,
-                    config_.shared_memory_timeout_in_seconds,
-                    constants::MAX_S3_SHMEM_SIZE};
+                // update the last error in shmem - the error code is atomic so no lock is needed
 
-                if (shmem_already_locked) {
-                    shm_obj.atomic_exec([](auto& data) {
-                        data.last_error_code = error_codes::DOWNLOAD_FILE_ERROR;
-                    });
-                } else {
-                    shm_obj.atomic_exec([](auto& data) {
-                        data.last_error_code = error_codes::DOWNLOAD_FILE_ERROR;
-                    });
-                }
+                shared_memory().exec([](auto& data) {
+                    data.last_error_code = error_codes::DOWNLOAD_FILE_ERROR;
+                });
 
             }
             return static_cast<std::streamsize>(read_callback->bytes_read_from_s3);
 
         } // end s3_download_part_worker_routine
 
-        void s3_upload_part_worker_routine(bool read_from_cache = false,
+        bool s3_upload_part_worker_routine(bool read_from_cache = false,
                                            unsigned int part_number = 1,       // one based part number for cache only
                                            std::int64_t bytes_this_thread = 0,      // set for cache only
                                            off_t file_offset = 0
@@ -2033,9 +2984,7 @@ namespace irods::experimental::io::s3_transport
 
             // read upload_id from shmem
 
-            named_shared_memory_object shm_obj{shmem_key_,
-                config_.shared_memory_timeout_in_seconds,
-                constants::MAX_S3_SHMEM_SIZE};
+            named_shared_memory_object& shm_obj = shared_memory();
 
             // if not using cache, the bytes_this_thread is set up by the s3_transport
             if (!use_cache_) {
@@ -2064,11 +3013,9 @@ namespace irods::experimental::io::s3_transport
             });
 
             if (error) {
-                return;
+                return false;
             }
 
-            unsigned int retry_cnt = 0;
-
             S3PutObjectHandler put_object_handler = {
                 {
                     s3_multipart_upload::callback_for_write_to_s3_base<CharT>::on_response_properties,
@@ -2082,38 +3029,6 @@ namespace irods::experimental::io::s3_transport
             std::int64_t content_length;
             std::vector<std::int64_t> part_sizes;
 
-            // resize the etags and checksum vectors if necessary
-            int resize_error = shm_obj.atomic_exec([this, &shm_obj](auto& data) {
-
-                if (constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD > data.etags.size()) {
-
-                    std::int64_t maximum_number_etags_per_upload = constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD;
-
-                    logger::debug( "{}:{} ({}) [[{}]] resize etags vector from {} to {}",
-                            __FILE__, __LINE__, __func__, get_thread_identifier(), data.etags.size(), maximum_number_etags_per_upload);
-
-                    try {
-                        data.etags.resize(constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD, types::shm_char_string("", shm_obj.get_allocator()));
-                        data.checksum_vector.resize(constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD);
-                        data.part_size_vector.resize(constants::MAXIMUM_NUMBER_ETAGS_PER_UPLOAD);
-                    } catch (boost::interprocess::bad_alloc &biba) {
-                        this->set_error(ERROR(S3_PUT_ERROR, "Error on reallocation of etags, checksum, or part size vectors in shared memory."));
-                        data.last_error_code = error_codes::BAD_ALLOC;
-                        return true;
-                    }
-
-                }
-
-                return false;
-
-            });
-
-            if (resize_error) {
-                logger::error("Error on reallocation of etags, checksum, or part size vectors in shared memory.");
-                this->set_error(ERROR(S3_PUT_ERROR, "Error on reallocation of etags, checksum, or part size vectors in shared memory."));
-                return;
-            }
-
             if (read_from_cache) {
 
                 // read from cache, write to s3
@@ -2147,20 +3062,31 @@ namespace irods::experimental::io::s3_transport
 
             }
 
+            // grow the etags, checksum and part size vectors if this thread has parts beyond them
+            const bool resize_error = shm_obj.atomic_exec([this, end_part_number](auto& data) {
+                return !this->reserve_part_entries(data, end_part_number);
+            });
+
+            if (resize_error) {
+                this->set_error(ERROR(S3_PUT_ERROR, "Error on reallocation of etags, checksum, or part size vectors in shared memory."));
+                return false;
+            }
+
             write_callback->enable_md5 = config_.enable_md5_flag;
             write_callback->thread_identifier = get_thread_identifier();
             write_callback->object_key = object_key_;
             write_callback->shmem_key = shmem_key_;
             write_callback->shared_memory_timeout_in_seconds = config_.shared_memory_timeout_in_seconds;
+            write_callback->shm_obj_ptr = &shared_memory();
+            write_callback->resource_name = config_.resource_name;
+            write_callback->user_name = config_.user_name;
             write_callback->transport_object_ptr = this;
 
-            int retry_wait_seconds = config_.retry_wait_seconds;
-
             bool circular_buffer_read_timeout = false;
 
             for (unsigned int part_number = start_part_number; part_number <= end_part_number; ++part_number) {
 
-                retry_cnt = 0;
+                auto retry = make_retry_policy();
 
                 do {
 
@@ -2190,6 +3116,11 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                     // server encrypt flag not valid for part upload
                     put_props.useServerSideEncryption = false;
 
+                    libs3_types::bucket_context bucket_context = bucket_context_;
+                    std::string hostname = select_hostname();
+                    bucket_context.hostName = hostname.c_str();
+                    endpoint_request endpoint{config_.resource_name, hostname, config_.user_name};
+
 #ifdef IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
                     if (config_.trailing_checksum_on_upload_enabled) {
                         write_callback->calculate_crc64_nvme = true;
@@ -2239,7 +3170,7 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                                object_key_.c_str(), part_number,
                                (std::int64_t)bytes_this_thread);
 
-                        S3_upload_part_chunked(&bucket_context_, object_key_.c_str(), &put_props,
+                        S3_upload_part_chunked(&bucket_context, object_key_.c_str(), &put_props,
                                 part_number, upload_id.c_str(),
                                 nullptr, 120000, &chunked_handler, write_callback.get());
 
@@ -2253,7 +3184,7 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                                object_key_.c_str(), part_number,
                                write_callback->content_length, (std::int64_t)bytes_this_thread);
 
-                        S3_upload_part(&bucket_context_, object_key_.c_str(), &put_props,
+                        S3_upload_part(&bucket_context, object_key_.c_str(), &put_props,
                                 &put_object_handler, part_number, upload_id.c_str(),
                                 write_callback->content_length, 0, 120000, write_callback.get());
 
@@ -2264,16 +3195,17 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                     }
 #endif // IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
 
+                    endpoint.finish(write_callback->status, write_callback->content_length);
+
                     msg = fmt::format("Multipart:  -- END --");
                     logger::debug( "{}:{} ({}) [[{}]] {}", __FILE__, __LINE__, __func__, get_thread_identifier(),
                             msg.c_str() );
 
-                    retry_cnt += 1;
-                    if (write_callback->status != libs3_types::status_ok && retry_cnt <= config_.retry_count_limit) {
+                    if (write_callback->status != libs3_types::status_ok) {
 
                         // Check for a timeout reading from circular buffer.  If we got one then bypass retries.
-                        circular_buffer_read_timeout =  shm_obj.atomic_exec([](auto& data) {
-                            return data.circular_buffer_read_timeout;
+                        circular_buffer_read_timeout = shm_obj.exec([](auto& data) {
+                            return data.circular_buffer_read_timeout.load();
                         });
 
                         // break out of do/while if we timed out reading from circular buffer
@@ -2282,17 +3214,9 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                         } else {
 
                             logger::error(
-                                    "{}:{} ({}) [[{}]] S3_upload_part returned error [status={}][attempt={}][retry_count_limit={}].  "
-                                    "Sleeping between {} and {} seconds",
+                                    "{}:{} ({}) [[{}]] S3_upload_part returned error [status={}][attempt={}][retry_count_limit={}].",
                                     __FILE__, __LINE__, __func__, get_thread_identifier(),
-                                    S3_get_status_name(write_callback->status), retry_cnt, config_.retry_count_limit,
-                                    retry_wait_seconds >> 1, retry_wait_seconds);
-
-                            s3_sleep( retry_wait_seconds );
-                            retry_wait_seconds *= 2;
-                            if (retry_wait_seconds > config_.max_retry_wait_seconds) {
-                                retry_wait_seconds = config_.max_retry_wait_seconds;
-                            }
+                                    S3_get_status_name(write_callback->status), retry.retries() + 1, config_.retry_count_limit);
 
                             // Reset bytes_written and hasher for retry
                             write_callback->bytes_written = 0;
@@ -2304,20 +3228,18 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                         }
                     }
 
-                } while ((write_callback->status != libs3_types::status_ok)
-                        && irods::experimental::io::s3_transport::S3_status_is_retryable(write_callback->status)
-                        && (retry_cnt <= config_.retry_count_limit));
+                } while (retry.should_retry(write_callback->status));
 
                 if (write_callback->status != libs3_types::status_ok) {
 
                     this->set_error(ERROR(S3_PUT_ERROR, "failed in S3_upload_part"));
 
                     if (write_callback->status == libs3_types::status_request_timeout) {
-                        shm_obj.atomic_exec([](auto& data) {
+                        shm_obj.exec([](auto& data) {
                             data.last_error_code = error_codes::UPLOAD_PART_TIMEOUT;
                         });
                     } else {
-                        shm_obj.atomic_exec([](auto& data) {
+                        shm_obj.exec([](auto& data) {
                             data.last_error_code = error_codes::UPLOAD_FILE_ERROR;
                         });
                     }
@@ -2379,6 +3301,25 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
 					}
                 });
 
+                // keep the journal of a streamed upload from looking stale
+                if (!read_from_cache && streaming_journal_enabled()) {
+                    upload_journal::touch(config_.cache_directory, config_.resource_name,
+                            config_.bucket_name, object_key_);
+                }
+
+                // record the part so a later flush does not upload it again
+                if (read_from_cache && upload_journal_) {
+                    upload_journal::part part{part_number, file_offset, actual_part_size, "", 0};
+                    shm_obj.atomic_exec([&part](auto& data) {
+                        part.etag = data.etags[part.number - 1].c_str();
+                        part.checksum = data.checksum_vector[part.number - 1];
+                    });
+                    if (!upload_journal_->add_part(part)) {
+                        logger::warn("{}:{} ({}) [[{}]] failed to record part {} of {} in the upload journal.",
+                                __FILE__, __LINE__, __func__, get_thread_identifier(), part_number, object_key_);
+                    }
+                }
+
 #ifdef IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
                 // Reset hasher for next part
                 if (config_.trailing_checksum_on_upload_enabled) {
@@ -2390,6 +3331,8 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
 
             logger::debug("{}:{} ({}) [[{}]] Breaking out of circular_buffer_read loop.  End part number = {}",
                     __FILE__, __LINE__, __func__, get_thread_identifier(), end_part_number);
+
+            return write_callback->status == libs3_types::status_ok && !circular_buffer_read_timeout;
         }
 
         error_codes s3_upload_file(bool read_from_cache = false)
@@ -2401,9 +3344,7 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
 
             std::shared_ptr<s3_upload::callback_for_write_to_s3_base<CharT>> write_callback;
 
-            unsigned int retry_cnt = 0;
-
-            int retry_wait_seconds = config_.retry_wait_seconds;
+            auto retry = make_retry_policy();
             bool circular_buffer_read_timeout = false;
 
             do {
@@ -2451,6 +3392,9 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                 write_callback->object_key = object_key_;
                 write_callback->shmem_key = shmem_key_;
                 write_callback->shared_memory_timeout_in_seconds = config_.shared_memory_timeout_in_seconds;
+                write_callback->shm_obj_ptr = &shared_memory();
+                write_callback->resource_name = config_.resource_name;
+                write_callback->user_name = config_.user_name;
                 write_callback->transport_object_ptr = this;
 
                 S3PutProperties put_props{};
@@ -2462,6 +3406,11 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                 // zero out bytes_written in case of failure and re-run
                 write_callback->bytes_written = 0;
 
+                libs3_types::bucket_context bucket_context = bucket_context_;
+                std::string hostname = select_hostname();
+                bucket_context.hostName = hostname.c_str();
+                endpoint_request endpoint{config_.resource_name, hostname, config_.user_name};
+
 #ifdef IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
                 if (config_.trailing_checksum_on_upload_enabled) {
                     write_callback->calculate_crc64_nvme = true;
@@ -2513,7 +3462,7 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                            __FILE__, __LINE__, __func__, get_thread_identifier(),
                            object_key_.c_str());
 
-                    S3_put_object_chunked(&bucket_context_, object_key_.c_str(),
+                    S3_put_object_chunked(&bucket_context, object_key_.c_str(),
                             &put_props, nullptr, 0, &chunked_handler, write_callback.get());
 
                     logger::debug("{}:{} ({}) [[{}]] S3_put_object_chunked returned [status={}].",
@@ -2528,7 +3477,7 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                            object_key_.c_str(),
                            write_callback->content_length);
 
-                    S3_put_object(&bucket_context_, object_key_.c_str(), write_callback->content_length,
+                    S3_put_object(&bucket_context, object_key_.c_str(), write_callback->content_length,
                             &put_props, 0, 0, &put_object_handler, write_callback.get());
 
                     logger::debug("{}:{} ({}) [[{}]] S3_put_object returned [status={}].",
@@ -2538,33 +3487,24 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
                 }
 #endif // IRODS_LIBRARY_FEATURE_CHECKSUM_ALGORITHM_CRC64NVME
 
+                endpoint.finish(write_callback->status, write_callback->content_length);
+
                 if (write_callback->status != libs3_types::status_ok) {
 
                     // Check for a timeout reading from circular buffer.  If we got one then bypass retries.
-                    named_shared_memory_object shm_obj{shmem_key_,
-                        config_.shared_memory_timeout_in_seconds,
-                        constants::MAX_S3_SHMEM_SIZE};
+                    named_shared_memory_object& shm_obj = shared_memory();
 
-                    circular_buffer_read_timeout =  shm_obj.atomic_exec([](auto& data) {
-                        return data.circular_buffer_read_timeout;
+                    circular_buffer_read_timeout = shm_obj.exec([](auto& data) {
+                        return data.circular_buffer_read_timeout.load();
                     });
 
                     // break out of do/while if we timed out reading from circular buffer
                     if (circular_buffer_read_timeout) {
                         break;
-                    } else {
-
-                        s3_sleep( retry_wait_seconds );
-                        retry_wait_seconds *= 2;
-                        if (retry_wait_seconds > config_.max_retry_wait_seconds) {
-                            retry_wait_seconds = config_.max_retry_wait_seconds;
-                        }
                     }
                 }
 
-            } while ((write_callback->status != libs3_types::status_ok)
-                    && irods::experimental::io::s3_transport::S3_status_is_retryable(write_callback->status)
-                    && (++retry_cnt <= config_.retry_count_limit));
+            } while (retry.should_retry(write_callback->status));
 
             if (write_callback->status != libs3_types::status_ok) {
                 this->set_error(ERROR(S3_PUT_ERROR, "failed in S3_put_object"));
@@ -2615,26 +3555,29 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
         bool                         use_cache_;
         bool                         object_must_exist_;
 
+        // the cache file holds only the parts of the object that were read or written
+        bool                         sparse_cache_file_;
+
+        // the cache file is a staging file in config_.memory_staging_directory
+        bool                         memory_staged_;
+        memory_staging::file_lock    memory_staging_lock_;
+
         libs3_types::bucket_context  bucket_context_;
         upload_manager               upload_manager_;
 
         std::string                  object_key_;
         std::string                  shmem_key_;
 
+        // the segment for shmem_key_ stays mapped from open until close
+        std::mutex                   shm_obj_mutex_;
+        std::unique_ptr<named_shared_memory_object>
+                                     shm_obj_;
+
         std::string                  cache_file_path_;
         std::fstream                 cache_fstream_;
 
         inline static int            file_descriptor_counter_ = minimum_valid_file_descriptor;
 
-        // This counter keeps track of whether this process has initialized
-        // S3 and how many threads in the process are active.  The first thread (counter=0)
-        // intitializes S3 and the last thread (counter decremented to 0) deinitializes.
-        // If we are in a multithreaded / single process environment the
-        // initialization will run only once.  If we are in a multiprocess
-        // environment it will run multiple times.
-        inline static int            s3_initialized_counter_ = 0;
-        inline static std::mutex     s3_initialized_counter_mutex_;
-
         inline static std::mutex     region_name_mutex_;
         inline static std::mutex     bytes_this_thread_mutex_;
 
@@ -2645,6 +3588,9 @@ logger::debug( "{}:{} ({}) [[{}]] write_callback->content_length is set to {} ",
         inline static std::mutex     error_mutex_;
         irods::error                 error_;
 
+        // set while a cache file is flushed with resumable uploads enabled
+        std::unique_ptr<upload_journal> upload_journal_;
+
 
     }; // s3_transport
 
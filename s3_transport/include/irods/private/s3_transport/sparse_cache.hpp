@@ -0,0 +1,197 @@
+#ifndef S3_TRANSPORT_SPARSE_CACHE_HPP
+#define S3_TRANSPORT_SPARSE_CACHE_HPP
+
+// stdlib includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport::sparse_cache
+{
+
+    // The bookkeeping of a cache file of an existing object that is filled one
+    // part at a time instead of being downloaded whole.
+    //
+    // The parts are tracked in three bitmaps of 64 parts per word: filled_parts
+    // has a bit set once the part is read from S3, dirty_parts once the part is
+    // written, and filling_parts while a thread reads the part from S3.  The
+    // functions taking a Data are given the multipart shared data with its lock
+    // held, or anything with the same members.
+
+    // a range of a sparse cache file copied from the existing object or uploaded as one part
+    struct file_part
+    {
+        std::int64_t offset;
+        std::int64_t size;
+        bool         copy;
+        std::int64_t unread;          // bytes of the object at offset not read into the cache file yet
+    };
+
+    // The part index and length of a part read from S3.
+    using part_to_read = std::pair<std::int64_t, std::int64_t>;
+
+    // Returns the size of the parts an existing object of _object_size bytes is
+    // tracked in, or 0 if it must be downloaded instead.  Every part but the
+    // last is uploaded or copied whole so it must be at least
+    // _minimum_part_size, and there are at most _maximum_number_of_parts.
+    inline auto part_size(std::int64_t _object_size,
+                          std::int64_t _minimum_part_size,
+                          std::int64_t _maximum_number_of_parts) -> std::int64_t
+    {
+        const std::int64_t part_size = std::max<std::int64_t>({_minimum_part_size, 1,
+                (_object_size + _maximum_number_of_parts - 1) / _maximum_number_of_parts});
+
+        // an object smaller than the minimum part size cannot be copied as a part, it is downloaded
+        return _object_size >= part_size ? part_size : 0;
+    } // end part_size
+
+    // The number of words of the bitmaps of an object of _object_size bytes.
+    inline auto number_of_words(std::int64_t _object_size, std::int64_t _part_size) -> std::size_t
+    {
+        return static_cast<std::size_t>((_object_size + _part_size - 1) / _part_size / 64 + 1);
+    } // end number_of_words
+
+    template <typename Bitmap>
+    bool is_set(const Bitmap& _parts, std::int64_t _part)
+    {
+        const auto word = static_cast<std::size_t>(_part / 64);
+        return word < _parts.size() && (_parts[word] & (std::uint64_t{1} << (_part % 64))) != 0;
+    } // end is_set
+
+    template <typename Bitmap>
+    void set(Bitmap& _parts, std::int64_t _part)
+    {
+        _parts[static_cast<std::size_t>(_part / 64)] |= std::uint64_t{1} << (_part % 64);
+    } // end set
+
+    template <typename Bitmap>
+    void clear(Bitmap& _parts, std::int64_t _part)
+    {
+        _parts[static_cast<std::size_t>(_part / 64)] &= ~(std::uint64_t{1} << (_part % 64));
+    } // end clear
+
+    // Claims the parts overlapping the _length bytes at _offset that must be
+    // read from S3 before they are used, and adds them to _parts_to_read.  If
+    // _overwrite is true the bytes are about to be written, so a part they
+    // cover entirely is marked filled without being read, and the parts are
+    // marked dirty.  Parts being read by another thread are skipped unless
+    // _take_over is true.  Returns true if a part was skipped and must be
+    // waited for.
+    template <typename Data>
+    bool claim_parts(Data&                      _data,
+                     std::int64_t               _offset,
+                     std::int64_t               _length,
+                     bool                       _overwrite,
+                     bool                       _take_over,
+                     std::vector<part_to_read>& _parts_to_read)
+    {
+        const std::int64_t part_size = _data.sparse_part_size;
+        if (part_size <= 0 || _offset < 0 || _length <= 0) {
+            return false;
+        }
+
+        // the bytes past the end of the object are not in S3
+        const std::int64_t existing_object_size = _data.existing_object_size;
+        const std::int64_t end = std::min(_offset + _length, existing_object_size);
+
+        bool waiting = false;
+        for (std::int64_t part = _offset / part_size; part * part_size < end; ++part) {
+            const std::int64_t part_offset = part * part_size;
+            const std::int64_t part_length = std::min(part_size, existing_object_size - part_offset);
+
+            if (is_set(_data.filled_parts, part)) {
+                if (_overwrite) {
+                    set(_data.dirty_parts, part);
+                }
+                continue;
+            }
+
+            if (is_set(_data.filling_parts, part) && !_take_over) {
+                waiting = true;
+                continue;
+            }
+
+            // a part that is written whole is not read
+            if (_overwrite && _offset <= part_offset && _offset + _length >= part_offset + part_length) {
+                set(_data.filled_parts, part);
+                set(_data.dirty_parts, part);
+                continue;
+            }
+
+            set(_data.filling_parts, part);
+            _parts_to_read.emplace_back(part, part_length);
+        }
+
+        return waiting;
+    } // end claim_parts
+
+    // Releases the parts claimed by claim_parts, marking those that were read
+    // filled, and dirty as well if _overwrite is true.  _read holds whether
+    // each part of _parts_to_read was read.
+    template <typename Data>
+    void release_parts(Data&                            _data,
+                       const std::vector<part_to_read>& _parts_to_read,
+                       const std::vector<bool>&         _read,
+                       bool                             _overwrite)
+    {
+        for (std::size_t i = 0; i < _parts_to_read.size(); ++i) {
+            const std::int64_t part = _parts_to_read[i].first;
+            clear(_data.filling_parts, part);
+            if (_read[i]) {
+                set(_data.filled_parts, part);
+                if (_overwrite) {
+                    set(_data.dirty_parts, part);
+                }
+            }
+        }
+    } // end release_parts
+
+    // Splits a sparse cache file of _cache_file_size bytes into the parts it is
+    // uploaded in.  Each part of the existing object that was not written is
+    // copied by S3.  The end of the object joins the last copied part if it was
+    // not written either, so the bytes appended to an object are uploaded
+    // without reading any of it.  The rest of the file is uploaded in parts of
+    // the tracked size.  Returns no parts if the file is shorter than the object.
+    template <typename Data>
+    auto make_layout(const Data& _data, std::int64_t _cache_file_size) -> std::vector<file_part>
+    {
+        std::vector<file_part> layout;
+
+        const std::int64_t part_size = _data.sparse_part_size;
+        const std::int64_t existing_object_size = _data.existing_object_size;
+
+        if (part_size <= 0 || _cache_file_size < existing_object_size) {
+            return layout;
+        }
+
+        const std::int64_t whole_parts = existing_object_size / part_size;
+        for (std::int64_t part = 0; part < whole_parts; ++part) {
+            layout.push_back({part * part_size, part_size,
+                    !is_set(_data.dirty_parts, part),
+                    is_set(_data.filled_parts, part) ? 0 : part_size});
+        }
+
+        std::int64_t offset = whole_parts * part_size;
+        if (offset < existing_object_size && !is_set(_data.dirty_parts, whole_parts) &&
+                !layout.empty() && layout.back().copy) {
+            layout.back().size += existing_object_size - offset;
+            offset = existing_object_size;
+        }
+
+        while (offset < _cache_file_size) {
+            const std::int64_t size = std::min(part_size, _cache_file_size - offset);
+            const std::int64_t unread = offset < existing_object_size && !is_set(_data.filled_parts, offset / part_size)
+                ? std::min(size, existing_object_size - offset)
+                : 0;
+            layout.push_back({offset, size, false, unread});
+            offset += size;
+        }
+
+        return layout;
+    } // end make_layout
+
+} // irods::experimental::io::s3_transport::sparse_cache
+
+#endif // S3_TRANSPORT_SPARSE_CACHE_HPP
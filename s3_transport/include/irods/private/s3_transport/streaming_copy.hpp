@@ -0,0 +1,53 @@
+#ifndef S3_TRANSPORT_STREAMING_COPY_HPP
+#define S3_TRANSPORT_STREAMING_COPY_HPP
+
+// local includes
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <cstdint>
+#include <string>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // Copies an object by downloading it and uploading it again, for providers
+    // where CopyObject cannot be used.
+    //
+    // The object is split into parts of _part_size bytes (increased if more
+    // than 10000 parts would be needed).  _number_of_threads parts are in flight
+    // at any time, each one being downloaded with a range GET or uploaded as a
+    // part of a multipart upload, so downloads and uploads overlap.  Every
+    // thread owns one part buffer, which bounds the memory used to
+    // _number_of_threads * _part_size bytes.  An object that fits in one part is
+    // copied with a single GET and PUT.
+    //
+    // If _multipart_upload is false (the provider does not support multipart
+    // uploads) the object is uploaded with a single PUT.  The parts are then
+    // downloaded one at a time, by a thread that stays at most two parts ahead
+    // of the upload.
+    //
+    // The hostName of the bucket contexts is ignored, a host is selected by the
+    // endpoint balancer of the resource for each request.  Each request is
+    // retried under a copy of _retry_policy.  _timeout_ms applies to the requests
+    // that do not transfer data.  On failure the multipart upload is aborted and
+    // the status of the failing request is returned.
+    auto streaming_copy(const std::string&     _resource_name,
+                        const S3BucketContext& _source_bucket_context,
+                        const std::string&     _source_key,
+                        const S3BucketContext& _destination_bucket_context,
+                        const std::string&     _destination_key,
+                        std::int64_t           _object_size,
+                        std::int64_t           _part_size,
+                        unsigned int           _number_of_threads,
+                        bool                   _multipart_upload,
+                        const S3PutProperties& _put_properties,
+                        const retry_policy&    _retry_policy,
+                        int                    _timeout_ms) -> S3Status;
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_STREAMING_COPY_HPP
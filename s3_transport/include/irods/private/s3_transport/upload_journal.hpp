@@ -0,0 +1,144 @@
+#ifndef S3_TRANSPORT_UPLOAD_JOURNAL_HPP
+#define S3_TRANSPORT_UPLOAD_JOURNAL_HPP
+
+// local includes
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+// misc includes
+#include "libs3/libs3.h"
+
+// stdlib includes
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+
+    // A record of a multipart upload of a cache file, kept in a file under a
+    // directory in the cache directory so that a flush interrupted by a crash
+    // or a failed transfer can be resumed by the next flush of the object.
+    //
+    // The first line of the file describes the upload and each following line
+    // records a part that was uploaded.  Each line is appended with a single
+    // write, so the threads uploading parts do not interleave their records
+    // and a line cut short by a crash is ignored when the journal is loaded.
+    //
+    // The file is locked for the lifetime of the journal, which serializes
+    // flushes of the same object and keeps the sweeper away from it.
+    //
+    // A multipart upload streamed without the cache is journaled too, so the
+    // sweeper aborts it if the agents writing it die.  Its journal has a part
+    // size of 0 and is never resumed.  It is not locked, since the parts come
+    // from several agents.  Each part touches it instead, so the sweeper leaves
+    // it alone while parts are uploaded.
+    class upload_journal
+    {
+      public:
+        static constexpr std::chrono::seconds SWEEP_INTERVAL{3600};
+        static constexpr std::int64_t         STREAMING_PART_SIZE{0};
+        inline static const std::string       DIRECTORY_NAME{".irods_s3_upload_journal"};
+
+        struct part
+        {
+            std::int64_t  number;
+            std::int64_t  offset;
+            std::int64_t  size;
+            std::string   etag;
+            std::uint64_t checksum;
+        };
+
+        struct upload
+        {
+            std::string       upload_id;
+            std::int64_t      object_size;
+            std::int64_t      part_size;
+            std::int64_t      number_of_parts;
+            std::vector<part> parts;
+        };
+
+        // Opens and locks the journal of _key in _bucket_name, waiting for any
+        // other agent flushing the same object.
+        upload_journal(const std::string& _cache_directory,
+                       const std::string& _resource_name,
+                       const std::string& _bucket_name,
+                       const std::string& _key);
+        ~upload_journal();
+
+        upload_journal(const upload_journal&) = delete;
+        auto operator=(const upload_journal&) -> upload_journal& = delete;
+
+        // False if the journal could not be opened and locked.
+        bool valid() const;
+
+        // Returns the upload recorded for the object, if any.
+        auto load() const -> std::optional<upload>;
+
+        // Replaces the contents of the journal with a new upload.
+        bool start(const std::string& _upload_id,
+                   std::int64_t       _object_size,
+                   std::int64_t       _part_size,
+                   std::int64_t       _number_of_parts);
+
+        bool add_part(const part& _part);
+
+        // Removes the journal file.  The journal stays locked until it is destroyed.
+        void remove();
+
+        // Updates the modification time of the journal of _key, if it exists,
+        // so that the sweeper does not consider the upload stale.
+        static void touch(const std::string& _cache_directory,
+                          const std::string& _resource_name,
+                          const std::string& _bucket_name,
+                          const std::string& _key);
+
+        // Removes the journal of _key, if it exists, once no flush holds it.
+        static void discard(const std::string& _cache_directory,
+                            const std::string& _resource_name,
+                            const std::string& _bucket_name,
+                            const std::string& _key);
+
+        // Aborts the uploads of _resource_name whose journal has not been written
+        // for _maximum_age and removes their journals.  Does nothing if a sweep
+        // of the directory was run by any agent less than SWEEP_INTERVAL ago or
+        // is being run by another agent.  The bucket name in _bucket_context is
+        // replaced by the one of each journal.
+        static void sweep(const std::string&     _cache_directory,
+                          const std::string&     _resource_name,
+                          const S3BucketContext& _bucket_context,
+                          std::chrono::seconds   _maximum_age,
+                          int                    _timeout_ms);
+
+      private:
+        const std::string resource_name_;
+        const std::string bucket_name_;
+        const std::string key_;
+        std::string       path_;
+        int               fd_;
+
+    }; // upload_journal
+
+    // Lists the parts of a multipart upload into _parts, keyed by part number.
+    // The offset and checksum of the listed parts are not set.
+    auto list_parts(const std::string&                            _resource_name,
+                    const S3BucketContext&                        _bucket_context,
+                    const std::string&                            _key,
+                    const std::string&                            _upload_id,
+                    const retry_policy&                           _retry_policy,
+                    int                                           _timeout_ms,
+                    std::map<std::int64_t, upload_journal::part>& _parts) -> S3Status;
+
+    // Returns true if _etag, as returned for an uploaded part, is the MD5 of the
+    // _length bytes at _offset in the file at _path.  Parts encrypted with a
+    // KMS key do not have an MD5 etag and never match.
+    bool etag_matches_file_range(const std::string& _etag,
+                                 const std::string& _path,
+                                 std::int64_t       _offset,
+                                 std::int64_t       _length);
+
+} // irods::experimental::io::s3_transport
+
+#endif // S3_TRANSPORT_UPLOAD_JOURNAL_HPP
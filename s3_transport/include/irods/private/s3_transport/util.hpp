@@ -13,6 +13,7 @@
 #include "libs3/libs3.h"
 
 // stdlib and misc includes
+#include <map>
 #include <string>
 #include <thread>
 #include <vector>
@@ -61,10 +62,11 @@ namespace irods::experimental::io::s3_transport
         // be enough.
         //
         // Each part (maximum count of MAXIMUM_NUMBER_ETAGS_PER_UPLOAD) can have an ETAG, 8 bytes for part size,
-		// and 8 bytes for CRC64/NVME checksum
+		// and 8 bytes for CRC64/NVME checksum.  A sparse cache file also uses two bits per part.
         static constexpr std::int64_t  MAX_S3_SHMEM_SIZE{100*sizeof(void*) +
 			sizeof(shared_data::multipart_shared_data) +
 			MAXIMUM_NUMBER_ETAGS_PER_UPLOAD * (BYTES_PER_ETAG + 16 + 1) +
+			2 * (MAXIMUM_NUMBER_ETAGS_PER_UPLOAD / 64 + 1) * sizeof(std::uint64_t) +
 			UPLOAD_ID_SIZE + 1};
 
         static const int                DEFAULT_SHARED_MEMORY_TIMEOUT_IN_SECONDS{900};
@@ -150,6 +152,8 @@ namespace irods::experimental::io::s3_transport
             , content_length{0}
             , x_amz_storage_class{}   // for glacier
             , x_amz_restore{}         // for glacier
+            , meta_data{}
+            , etag{}
             , status{libs3_types::status_ok}
             , bucket_context{_bucket_context}
         {}
@@ -158,6 +162,8 @@ namespace irods::experimental::io::s3_transport
         std::int64_t                       content_length;
         std::string                        x_amz_storage_class;
         std::string                        x_amz_restore;
+        std::map<std::string, std::string> meta_data;
+        std::string                        etag;
         libs3_types::status                status;
         libs3_types::bucket_context&       bucket_context;
     };
@@ -0,0 +1,297 @@
+// local includes
+#include "irods/private/s3_transport/admission_controller.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+
+// boost includes
+#include <boost/interprocess/exceptions.hpp>
+
+// system includes
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    namespace bi   = boost::interprocess;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        // steady_clock is CLOCK_MONOTONIC on Linux which is the same for all processes
+        auto now_in_microseconds() -> std::int64_t
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        constexpr std::size_t ADMISSION_SHMEM_SIZE{100*sizeof(void*) + sizeof(shared_data::admission_table) + 4096};
+    }
+
+    bool is_throttling_status(S3Status _status)
+    {
+        return _status == S3StatusErrorSlowDown || _status == S3StatusErrorServiceUnavailable;
+    } // end is_throttling_status
+
+    auto admission_controller::for_resource(const std::string& _resource_name) -> admission_controller&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<admission_controller>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& controller = registry[_resource_name];
+        if (!controller) {
+            controller = std::make_unique<admission_controller>(_resource_name);
+        }
+        return *controller;
+    } // end for_resource
+
+    admission_controller::admission_controller(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , enabled_{false}
+        , maximum_in_flight_{DEFAULT_MAXIMUM_IN_FLIGHT}
+        , shared_table_{}
+        , table_{nullptr}
+    {
+    }
+
+    void admission_controller::configure(bool _enabled, unsigned int _maximum_in_flight)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        maximum_in_flight_ = std::max(MINIMUM_LIMIT, static_cast<double>(_maximum_in_flight));
+
+        if (_enabled && !table_) {
+            const std::string shmem_key = SHARED_MEMORY_KEY_PREFIX +
+                std::to_string(std::hash<std::string>{}(resource_name_));
+            try {
+                shared_table_.open(shmem_key, ADMISSION_SHMEM_SIZE);
+                table_ = shared_table_.get();
+            } catch (const bi::interprocess_exception& e) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to map admission control shared memory, "
+                        "adaptive concurrency is disabled.  {}", __FILE__, __LINE__, __func__, resource_name_, e.what());
+                enabled_ = false;
+                return;
+            }
+        }
+
+        enabled_ = _enabled;
+    } // end configure
+
+    bool admission_controller::acquire(const std::string& _host)
+    {
+        return take_slot(_host, true).value_or(false);
+    } // end acquire
+
+    auto admission_controller::try_acquire(const std::string& _host) -> std::optional<bool>
+    {
+        return take_slot(_host, false);
+    } // end try_acquire
+
+    auto admission_controller::take_slot(const std::string& _host, bool _wait) -> std::optional<bool>
+    {
+        shared_data::admission_table* table = nullptr;
+        double maximum_in_flight = 0.0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!enabled_) {
+                return false;
+            }
+            table = table_;
+            maximum_in_flight = maximum_in_flight_;
+        }
+
+        const pid_t pid = ::getpid();
+
+        shared_data::robust_lock lock(table->mutex);
+
+        shared_table_.attach_if_forked();
+
+        auto* entry = find_or_add_host(*table, _host, maximum_in_flight);
+        if (!entry) {
+            return false;
+        }
+
+        if (lock.owner_died()) {
+            reclaim_dead_owners(*entry);
+        }
+
+        while (true) {
+
+            // the maximum may have been lowered since the limit was raised
+            entry->limit = std::min(entry->limit, maximum_in_flight);
+
+            if (entry->in_flight < static_cast<std::int64_t>(entry->limit) && find_owner(*entry, pid, true)) {
+                break;
+            }
+
+            if (!_wait) {
+                return std::nullopt;
+            }
+
+            // Nothing was released for a while.  The slots may be held by an agent
+            // that went away without releasing them.
+            if (!entry->released.wait_for(lock, std::chrono::microseconds{WAIT_INTERVAL_US}) || lock.owner_died()) {
+                reclaim_dead_owners(*entry);
+            }
+        }
+
+        ++find_owner(*entry, pid, true)->slots;
+        ++entry->in_flight;
+        return true;
+    } // end take_slot
+
+    void admission_controller::release(const std::string& _host, S3Status _status)
+    {
+        shared_data::admission_table* table = nullptr;
+        double maximum_in_flight = 0.0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!table_) {
+                return;
+            }
+            table = table_;
+            maximum_in_flight = maximum_in_flight_;
+        }
+
+        shared_data::robust_lock lock(table->mutex);
+
+        auto* entry = find_or_add_host(*table, _host, maximum_in_flight);
+        if (!entry) {
+            return;
+        }
+
+        // the slot was taken by this agent, it cannot have been reclaimed
+        if (auto* owner = find_owner(*entry, ::getpid(), false); owner && owner->slots > 0) {
+            if (--owner->slots == 0) {
+                owner->pid = 0;
+            }
+            entry->in_flight = std::max<std::int64_t>(0, entry->in_flight - 1);
+        }
+
+        const auto now = now_in_microseconds();
+
+        if (is_throttling_status(_status)) {
+            if (now - entry->last_decrease_us > DECREASE_INTERVAL_US) {
+                entry->limit = std::max(MINIMUM_LIMIT, entry->limit * DECREASE_FACTOR);
+                entry->last_decrease_us = now;
+                logger::info("{}:{} ({}) [resource_name={}] host [{}] is throttling requests, "
+                        "in-flight limit reduced to {}", __FILE__, __LINE__, __func__, resource_name_,
+                        entry->host, static_cast<std::int64_t>(entry->limit));
+            }
+        } else if (_status == S3StatusOK) {
+            entry->limit = entry->limit + 1.0 / entry->limit;
+        }
+        entry->limit = std::min(maximum_in_flight, entry->limit);
+
+        entry->released.notify_all();
+    } // end release
+
+    void admission_controller::detach()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        shared_table_.detach();
+        table_ = nullptr;
+        enabled_ = false;
+    } // end detach
+
+    auto admission_controller::to_json() const -> nlohmann::json
+    {
+        auto hosts = nlohmann::json::array();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_ || !table_) {
+            return hosts;
+        }
+
+        shared_data::robust_lock table_lock(table_->mutex);
+        for (std::size_t i = 0; i < table_->number_of_hosts; ++i) {
+            const auto& entry = table_->hosts[i];
+            hosts.push_back({
+                {"host", entry.host},
+                {"limit", entry.limit},
+                {"in_flight", entry.in_flight}
+            });
+        }
+
+        return hosts;
+    } // end to_json
+
+    // the table mutex must be held
+    auto admission_controller::find_or_add_host(shared_data::admission_table& _table,
+                                                const std::string& _host,
+                                                double _initial_limit) -> shared_data::admission_host_entry*
+    {
+        if (_host.empty() || _host.size() >= shared_data::admission_host_entry::MAXIMUM_HOST_LENGTH) {
+            return nullptr;
+        }
+
+        for (std::size_t i = 0; i < _table.number_of_hosts; ++i) {
+            if (_host == _table.hosts[i].host) {
+                return &_table.hosts[i];
+            }
+        }
+
+        if (_table.number_of_hosts == shared_data::admission_table::MAXIMUM_HOSTS) {
+            return nullptr;
+        }
+
+        auto& entry = _table.hosts[_table.number_of_hosts++];
+        std::strncpy(entry.host, _host.c_str(), shared_data::admission_host_entry::MAXIMUM_HOST_LENGTH - 1);
+        entry.limit = _initial_limit;
+        entry.in_flight = 0;
+        return &entry;
+    } // end find_or_add_host
+
+    // the table mutex must be held
+    auto admission_controller::find_owner(shared_data::admission_host_entry& _entry, pid_t _pid, bool _add)
+        -> shared_data::admission_slot_owner*
+    {
+        shared_data::admission_slot_owner* free_owner = nullptr;
+        for (auto& owner : _entry.owners) {
+            if (owner.pid == _pid) {
+                return &owner;
+            }
+            if (!free_owner && owner.pid == 0) {
+                free_owner = &owner;
+            }
+        }
+
+        if (!_add || !free_owner) {
+            return nullptr;
+        }
+
+        free_owner->pid = _pid;
+        free_owner->slots = 0;
+        return free_owner;
+    } // end find_owner
+
+    // the table mutex must be held
+    void admission_controller::reclaim_dead_owners(shared_data::admission_host_entry& _entry) const
+    {
+        std::int64_t reclaimed = 0;
+        for (auto& owner : _entry.owners) {
+            if (owner.pid != 0 && !shared_data::process_is_alive(owner.pid)) {
+                reclaimed += owner.slots;
+                owner = shared_data::admission_slot_owner{};
+            }
+        }
+
+        if (reclaimed > 0) {
+            logger::warn("{}:{} ({}) [resource_name={}] reclaiming {} admission slots for host [{}] "
+                    "held by agents that are no longer running", __FILE__, __LINE__, __func__, resource_name_,
+                    reclaimed, _entry.host);
+            _entry.in_flight = std::max<std::int64_t>(0, _entry.in_flight - reclaimed);
+            _entry.released.notify_all();
+        }
+    } // end reclaim_dead_owners
+
+} // irods::experimental::io::s3_transport
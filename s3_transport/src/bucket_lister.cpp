@@ -0,0 +1,396 @@
+// local includes
+#include "irods/private/s3_transport/bucket_lister.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/library_lifecycle.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <system_error>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        // pages each shard may list ahead of the caller for a bulk listing
+        constexpr std::size_t BULK_PAGES_PER_SHARD{8};
+    }
+
+    auto bucket_lister::alphabet_boundaries(const std::string& _prefix,
+                                            std::size_t        _shard_count,
+                                            const std::string& _alphabet) -> std::vector<std::string>
+    {
+        std::string alphabet = _alphabet;
+        std::sort(alphabet.begin(), alphabet.end(),
+                [](char _a, char _b) { return static_cast<unsigned char>(_a) < static_cast<unsigned char>(_b); });
+        alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+
+        std::vector<std::string> boundaries;
+
+        const std::size_t shard_count = std::min(_shard_count, alphabet.size());
+        for (std::size_t i = 1; i < shard_count; ++i) {
+            boundaries.push_back(_prefix + alphabet[i * alphabet.size() / shard_count]);
+        }
+
+        return boundaries;
+    } // end alphabet_boundaries
+
+    bucket_lister::bucket_lister(const std::string&       _resource_name,
+                                 const S3BucketContext&   _bucket_context,
+                                 const std::string&       _prefix,
+                                 const std::string&       _delimiter,
+                                 const retry_policy&      _retry_policy,
+                                 std::vector<std::string> _boundaries,
+                                 std::size_t              _pages_per_shard)
+        : resource_name_{_resource_name}
+        , bucket_name_{_bucket_context.bucketName ? _bucket_context.bucketName : ""}
+        , access_key_id_{_bucket_context.accessKeyId ? _bucket_context.accessKeyId : ""}
+        , secret_access_key_{_bucket_context.secretAccessKey ? _bucket_context.secretAccessKey : ""}
+        , security_token_{_bucket_context.securityToken ? _bucket_context.securityToken : ""}
+        , auth_region_{_bucket_context.authRegion ? _bucket_context.authRegion : ""}
+        , protocol_{_bucket_context.protocol}
+        , uri_style_{_bucket_context.uriStyle}
+        , sts_date_{_bucket_context.stsDate}
+        , prefix_{_prefix}
+        , delimiter_{_delimiter}
+        , retry_policy_{_retry_policy}
+        , pages_per_shard_{std::max<std::size_t>(1, _pages_per_shard)}
+        , stopping_{false}
+        , shards_{}
+        , stop_hook_id_{0}
+        , current_shard_{0}
+        , current_{}
+        , position_{0}
+        , last_raw_key_{}
+    {
+        // boundaries outside of the prefix would produce empty shards
+        _boundaries.erase(std::remove_if(_boundaries.begin(), _boundaries.end(),
+                    [this](const std::string& _b) { return _b.compare(0, prefix_.size(), prefix_) != 0; }),
+                _boundaries.end());
+        std::sort(_boundaries.begin(), _boundaries.end());
+        _boundaries.erase(std::unique(_boundaries.begin(), _boundaries.end()), _boundaries.end());
+
+        for (std::size_t i = 0; i <= _boundaries.size(); ++i) {
+            auto s = std::make_unique<shard>();
+            if (i > 0) {
+                s->marker = _boundaries[i - 1];
+            }
+            if (i < _boundaries.size()) {
+                s->end_at = _boundaries[i];
+            }
+            shards_.push_back(std::move(s));
+        }
+
+        stop_hook_id_ = library_lifecycle::add_stop_hook([this] { stop(); });
+
+        for (auto& s : shards_) {
+            try {
+                s->worker = std::thread{&bucket_lister::run_shard, this, std::ref(*s)};
+            } catch (const std::system_error& e) {
+                // the shard is listed by the caller's thread when it is reached
+                logger::debug("{}:{} ({}) [resource_name={}] could not start listing thread, listing synchronously. {}",
+                        __FILE__, __LINE__, __func__, resource_name_, e.what());
+            }
+        }
+    }
+
+    bucket_lister::~bucket_lister()
+    {
+        library_lifecycle::remove_stop_hook(stop_hook_id_);
+        stop();
+    }
+
+    void bucket_lister::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+
+        for (auto& s : shards_) {
+            if (s->worker.joinable()) {
+                s->worker.join();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& s : shards_) {
+                if (!s->done) {
+                    s->done = true;
+                    s->status = S3StatusInterrupted;
+                }
+            }
+        }
+        cv_.notify_all();
+    } // end stop
+
+    auto bucket_lister::next(std::optional<bucket_list_entry>& _entry) -> S3Status
+    {
+        _entry.reset();
+
+        while (true) {
+
+            while (position_ < current_.entries.size()) {
+                auto& entry = current_.entries[position_++];
+
+                // A common prefix that straddles a shard boundary is returned by both
+                // shards.  Entries are sorted so anything not after the last one is a
+                // duplicate.
+                std::string raw = raw_key(entry);
+                if (last_raw_key_ && raw <= *last_raw_key_) {
+                    continue;
+                }
+                last_raw_key_ = std::move(raw);
+
+                _entry = std::move(entry);
+                return S3StatusOK;
+            }
+
+            if (current_shard_ >= shards_.size()) {
+                // listing complete
+                return S3StatusOK;
+            }
+
+            shard& s = *shards_[current_shard_];
+
+            if (!s.worker.joinable()) {
+                bool more = true;
+                while (more) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (!s.pages.empty() || s.done) {
+                            break;
+                        }
+                    }
+                    more = fetch_next_page(s);
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&s] { return !s.pages.empty() || s.done; });
+
+            if (!s.pages.empty()) {
+                current_ = std::move(s.pages.front());
+                s.pages.pop_front();
+                position_ = 0;
+                lock.unlock();
+                cv_.notify_all();
+                continue;
+            }
+
+            if (s.status != S3StatusOK) {
+                return s.status;
+            }
+
+            ++current_shard_;
+        }
+    } // end next
+
+    void bucket_lister::run_shard(shard& _shard)
+    {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this, &_shard] { return stopping_ || _shard.pages.size() < pages_per_shard_; });
+                if (stopping_) {
+                    return;
+                }
+            }
+
+            if (!fetch_next_page(_shard)) {
+                return;
+            }
+        }
+    } // end run_shard
+
+    bool bucket_lister::fetch_next_page(shard& _shard)
+    {
+        // only the thread listing the shard changes the marker
+        page result = fetch_page(_shard.marker);
+
+        bool more = result.is_truncated;
+        if (result.status == S3StatusOK && _shard.end_at) {
+            const std::string& end_at = *_shard.end_at;
+
+            const auto past_end = std::remove_if(result.entries.begin(), result.entries.end(),
+                    [this, &end_at](const bucket_list_entry& _e) { return raw_key(_e) > end_at; });
+            if (past_end != result.entries.end()) {
+                result.entries.erase(past_end, result.entries.end());
+                more = false;
+            }
+
+            if (more && result.next_marker >= end_at) {
+                more = false;
+            }
+        }
+        _shard.marker = result.next_marker;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (result.status != S3StatusOK) {
+                _shard.status = result.status;
+                more = false;
+            } else if (!result.entries.empty()) {
+                _shard.pages.push_back(std::move(result));
+            }
+
+            // the caller's thread may list a shard while the lister is stopped
+            if (stopping_ && more) {
+                _shard.status = S3StatusInterrupted;
+                more = false;
+            }
+
+            _shard.done = !more;
+        }
+        cv_.notify_all();
+
+        return more;
+    } // end fetch_next_page
+
+    auto bucket_lister::raw_key(const bucket_list_entry& _entry) const -> std::string
+    {
+        return _entry.is_common_prefix ? _entry.key + delimiter_ : _entry.key;
+    } // end raw_key
+
+    auto bucket_lister::fetch_page(const std::string& _marker) const -> page
+    {
+        struct callback_data
+        {
+            page*       result;
+            std::string last_key;
+            std::string last_common_prefix;
+            std::string delimiter;
+        };
+
+        S3ListBucketHandler list_bucket_handler = {
+            {
+                [] (const S3ResponseProperties*, void*) -> S3Status {
+                    return S3StatusOK;
+                },
+                [] (S3Status _status, const S3ErrorDetails* _error, void* _callback_data) -> void {
+                    auto* data = static_cast<callback_data*>(_callback_data);
+                    data->result->status = _status;
+                    if (_status != S3StatusOK && _error && _error->message) {
+                        logger::debug("{}:{} ({}) S3 list bucket error message: {}", __FILE__, __LINE__, __func__, _error->message);
+                    }
+                }
+            },
+            [] (int _is_truncated, const char* _next_marker, int _contents_count,
+                    const S3ListBucketContent* _contents, int _common_prefixes_count,
+                    const char** _common_prefixes, void* _callback_data) -> S3Status {
+
+                auto* data = static_cast<callback_data*>(_callback_data);
+                page& result = *data->result;
+
+                // this may be called more than once for a single response
+                result.is_truncated = _is_truncated;
+                result.next_marker = _next_marker == nullptr ? "" : _next_marker;
+
+                for (int i = 0; i < _contents_count; ++i) {
+                    result.entries.push_back({_contents[i].key, false});
+                    data->last_key = _contents[i].key;
+                }
+
+                for (int i = 0; i < _common_prefixes_count; ++i) {
+                    std::string name{_common_prefixes[i]};
+                    data->last_common_prefix = name;
+                    if (!data->delimiter.empty() && name.ends_with(data->delimiter)) {
+                        name.resize(name.size() - data->delimiter.size());
+                    }
+                    result.entries.push_back({std::move(name), true});
+                }
+
+                return S3StatusOK;
+            }
+        };
+
+        page result;
+        callback_data data{&result, "", "", delimiter_};
+
+        auto retry = retry_policy_;
+        do {
+            result = page{};
+            data.last_key.clear();
+            data.last_common_prefix.clear();
+
+            const std::string hostname = endpoint_balancer::for_resource(resource_name_).select_host();
+
+            S3BucketContext bucket_context = {};
+            bucket_context.hostName = hostname.c_str();
+            bucket_context.bucketName = bucket_name_.c_str();
+            bucket_context.protocol = protocol_;
+            bucket_context.uriStyle = uri_style_;
+            bucket_context.accessKeyId = access_key_id_.c_str();
+            bucket_context.secretAccessKey = secret_access_key_.c_str();
+            bucket_context.securityToken = security_token_.empty() ? nullptr : security_token_.c_str();
+            bucket_context.authRegion = auth_region_.c_str();
+            bucket_context.stsDate = sts_date_;
+
+            const library_lifecycle::usage usage;
+            endpoint_request endpoint{resource_name_, hostname};
+            S3_list_bucket(&bucket_context,
+                    prefix_.c_str(),
+                    _marker.empty() ? nullptr : _marker.c_str(),
+                    delimiter_.empty() ? nullptr : delimiter_.c_str(),
+                    MAXIMUM_KEYS_PER_PAGE,
+                    nullptr,
+                    0,
+                    &list_bucket_handler,
+                    &data);
+            endpoint.finish(result.status);
+
+        } while (retry.should_retry(result.status));
+
+        if (result.status != S3StatusOK) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to list [bucket={}][prefix={}][marker={}] [status={}]",
+                    __FILE__, __LINE__, __func__, resource_name_, bucket_name_, prefix_, _marker,
+                    S3_get_status_name(result.status));
+            return result;
+        }
+
+        // Without a delimiter S3 does not return a NextMarker.  The listing continues
+        // after the last key or common prefix returned, whichever sorts last.
+        if (result.is_truncated && result.next_marker.empty()) {
+            result.next_marker = std::max(data.last_key, data.last_common_prefix);
+        }
+
+        // keys and common prefixes are each sorted but are returned separately
+        std::sort(result.entries.begin(), result.entries.end(),
+                [this](const bucket_list_entry& _a, const bucket_list_entry& _b) { return raw_key(_a) < raw_key(_b); });
+
+        return result;
+    } // end fetch_page
+
+    auto list_bucket(const std::string&                                  _resource_name,
+                     const S3BucketContext&                              _bucket_context,
+                     const std::string&                                  _prefix,
+                     const std::string&                                  _delimiter,
+                     const retry_policy&                                 _retry_policy,
+                     std::size_t                                         _shard_count,
+                     const std::function<bool(const bucket_list_entry&)>& _callback) -> S3Status
+    {
+        bucket_lister lister{_resource_name, _bucket_context, _prefix, _delimiter, _retry_policy,
+            bucket_lister::alphabet_boundaries(_prefix, _shard_count), BULK_PAGES_PER_SHARD};
+
+        std::optional<bucket_list_entry> entry;
+        while (true) {
+            const S3Status status = lister.next(entry);
+            if (status != S3StatusOK || !entry) {
+                return status;
+            }
+            if (!_callback(*entry)) {
+                return S3StatusOK;
+            }
+        }
+    } // end list_bucket
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,611 @@
+// local includes
+#include "irods/private/s3_transport/bulk_delete.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// boost includes
+#include <boost/interprocess/exceptions.hpp>
+
+// stdlib includes
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <system_error>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        // The per-key errors that are worth sending again.  Returns S3StatusOK
+        // for any other error.
+        auto retryable_key_error_status(const std::string& _code) -> S3Status
+        {
+            if (_code == "InternalError") {
+                return S3StatusErrorInternalError;
+            }
+            if (_code == "SlowDown") {
+                return S3StatusErrorSlowDown;
+            }
+            if (_code == "ServiceUnavailable") {
+                // S3_status_is_retryable does not retry S3StatusErrorServiceUnavailable
+                return S3StatusErrorSlowDown;
+            }
+            return S3StatusOK;
+        }
+
+        struct delete_callback_data
+        {
+            S3Status                    status{S3StatusOK};
+            std::vector<delete_failure> key_errors;
+        };
+
+        // Sends one multi-object delete request.
+        void send_delete_objects(const std::string&              _resource_name,
+                                 const S3BucketContext&          _bucket_context,
+                                 const std::vector<std::string>& _keys,
+                                 int                             _timeout_ms,
+                                 delete_callback_data&           _data)
+        {
+            S3DeleteObjectsHandler handler = {
+                {
+                    [] (const S3ResponseProperties*, void*) -> S3Status {
+                        return S3StatusOK;
+                    },
+                    [] (S3Status _status, const S3ErrorDetails* _error, void* _callback_data) -> void {
+                        auto* data = static_cast<delete_callback_data*>(_callback_data);
+                        data->status = _status;
+                        if (_status != S3StatusOK && _error && _error->message) {
+                            logger::debug("{}:{} ({}) S3 delete objects error message: {}", __FILE__, __LINE__, __func__, _error->message);
+                        }
+                    }
+                },
+                [] (const char* _key, int _deleted, const char* _error_code,
+                        const char* _error_message, void* _callback_data) -> S3Status {
+                    // the request is sent in quiet mode so only errors are reported
+                    if (!_deleted) {
+                        auto* data = static_cast<delete_callback_data*>(_callback_data);
+                        data->key_errors.push_back({_key,
+                                S3StatusErrorUnknown,
+                                _error_code == nullptr ? "" : _error_code,
+                                _error_message == nullptr ? "" : _error_message});
+                    }
+                    return S3StatusOK;
+                }
+            };
+
+            std::vector<const char*> key_pointers;
+            key_pointers.reserve(_keys.size());
+            for (const auto& key : _keys) {
+                key_pointers.push_back(key.c_str());
+            }
+
+            const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+
+            S3BucketContext bucket_context = _bucket_context;
+            bucket_context.hostName = hostname.c_str();
+
+            endpoint_request endpoint{_resource_name, hostname};
+            S3_delete_objects(&bucket_context,
+                    static_cast<int>(key_pointers.size()),
+                    key_pointers.data(),
+                    1,
+                    nullptr,
+                    _timeout_ms,
+                    &handler,
+                    &_data);
+            endpoint.finish(_data.status);
+        } // end send_delete_objects
+
+        // Deletes a key that cannot be sent in a multi-object delete on its own.
+        auto delete_object(const std::string&     _resource_name,
+                           const S3BucketContext& _bucket_context,
+                           const std::string&     _key,
+                           const retry_policy&    _retry_policy,
+                           int                    _timeout_ms) -> S3Status
+        {
+            S3ResponseHandler handler = {
+                [] (const S3ResponseProperties*, void*) -> S3Status {
+                    return S3StatusOK;
+                },
+                [] (S3Status _status, const S3ErrorDetails*, void* _callback_data) -> void {
+                    *static_cast<S3Status*>(_callback_data) = _status;
+                }
+            };
+
+            auto retry = _retry_policy;
+            S3Status status = S3StatusOK;
+            do {
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.hostName = hostname.c_str();
+
+                status = S3StatusOK;
+                endpoint_request endpoint{_resource_name, hostname};
+                S3_delete_object(&bucket_context, _key.c_str(), nullptr, _timeout_ms, &handler, &status);
+                endpoint.finish(status);
+            } while (retry.should_retry(status));
+
+            // the object is gone either way
+            return status == S3StatusErrorNoSuchKey ? S3StatusOK : status;
+        } // end delete_object
+
+        auto hash_key(const std::string& _bucket_name, const std::string& _key) -> std::uint64_t
+        {
+            return std::hash<std::string>{}(_bucket_name + '/' + _key);
+        }
+
+        constexpr std::size_t BULK_DELETE_SHMEM_SIZE{100*sizeof(void*) + sizeof(shared_data::delete_batch_table) + 4096};
+    }
+
+    auto delete_objects(const std::string&              _resource_name,
+                        const S3BucketContext&          _bucket_context,
+                        const std::vector<std::string>& _keys,
+                        const retry_policy&             _retry_policy,
+                        int                             _timeout_ms,
+                        std::vector<delete_failure>&    _failures) -> S3Status
+    {
+        S3Status result = S3StatusOK;
+
+        std::vector<std::string> keys;
+        keys.reserve(_keys.size());
+        for (const auto& key : _keys) {
+            if (S3_is_valid_delete_objects_key(key.c_str())) {
+                keys.push_back(key);
+                continue;
+            }
+
+            const S3Status status = delete_object(_resource_name, _bucket_context, key, _retry_policy, _timeout_ms);
+            if (status != S3StatusOK) {
+                result = status;
+                _failures.push_back({key, status, "", ""});
+            }
+        }
+
+        for (std::size_t begin = 0; begin < keys.size(); begin += S3_MAX_DELETE_OBJECTS_COUNT) {
+
+            const std::size_t end = std::min(keys.size(), begin + S3_MAX_DELETE_OBJECTS_COUNT);
+            std::vector<std::string> remaining(keys.begin() + begin, keys.begin() + end);
+
+            delete_callback_data data;
+            std::vector<delete_failure> retryable_errors;
+
+            auto retry = _retry_policy;
+            S3Status status = S3StatusOK;
+            do {
+                data = delete_callback_data{};
+                send_delete_objects(_resource_name, _bucket_context, remaining, _timeout_ms, data);
+
+                status = data.status;
+                if (status != S3StatusOK) {
+                    continue;
+                }
+
+                // keep the keys with a transient error for the next attempt
+                remaining.clear();
+                retryable_errors.clear();
+                for (auto& error : data.key_errors) {
+                    const S3Status key_status = retryable_key_error_status(error.code);
+                    if (key_status != S3StatusOK) {
+                        error.status = key_status;
+                        remaining.push_back(error.key);
+                        retryable_errors.push_back(std::move(error));
+                        status = key_status;
+                    } else {
+                        result = S3StatusErrorUnknown;
+                        _failures.push_back(std::move(error));
+                    }
+                }
+            } while (retry.should_retry(status));
+
+            if (data.status != S3StatusOK) {
+                result = data.status;
+                for (auto& key : remaining) {
+                    _failures.push_back({std::move(key), data.status, "", ""});
+                }
+            } else if (!retryable_errors.empty()) {
+                result = retryable_errors.back().status;
+                std::move(retryable_errors.begin(), retryable_errors.end(), std::back_inserter(_failures));
+            }
+        }
+
+        return result;
+    } // end delete_objects
+
+    auto delete_batcher::for_resource(const std::string& _resource_name) -> delete_batcher&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<delete_batcher>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& batcher = registry[_resource_name];
+        if (!batcher) {
+            batcher = std::make_unique<delete_batcher>(_resource_name);
+        }
+        return *batcher;
+    } // end for_resource
+
+    delete_batcher::delete_batcher(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , enabled_{false}
+        , batch_size_{DEFAULT_BATCH_SIZE}
+        , max_delay_{DEFAULT_MAXIMUM_DELAY}
+        , timeout_ms_{0}
+        , stopping_{false}
+        , keys_queued_{0}
+        , keys_cancelled_{0}
+        , keys_failed_{0}
+        , batches_sent_{0}
+    {
+    }
+
+    delete_batcher::~delete_batcher()
+    {
+        stop();
+    }
+
+    void delete_batcher::configure(bool _enabled, std::size_t _batch_size, std::chrono::milliseconds _max_delay)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        enabled_ = _enabled;
+        batch_size_ = std::clamp<std::size_t>(_batch_size, 1, S3_MAX_DELETE_OBJECTS_COUNT);
+        max_delay_ = _max_delay;
+
+        // the flusher of a previous start has been joined by stop()
+        if (!flusher_.joinable()) {
+            stopping_ = false;
+        }
+
+        if (enabled_ && !shared_table_.get()) {
+            const std::string shmem_key = SHARED_MEMORY_KEY_PREFIX +
+                std::to_string(std::hash<std::string>{}(resource_name_));
+            try {
+                shared_table_.open(shmem_key, BULK_DELETE_SHMEM_SIZE);
+            } catch (const boost::interprocess::interprocess_exception& e) {
+                logger::warn("{}:{} ({}) [resource_name={}] failed to map bulk delete shared memory, "
+                        "writing an object does not cancel its pending deletes in other agents.  {}",
+                        __FILE__, __LINE__, __func__, resource_name_, e.what());
+            }
+        }
+    } // end configure
+
+    bool delete_batcher::enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return enabled_;
+    } // end enabled
+
+    void delete_batcher::add(const S3BucketContext& _bucket_context,
+                             const std::string&     _key,
+                             const retry_policy&    _retry_policy,
+                             int                    _timeout_ms)
+    {
+        const auto group_key = fmt::format("{}/{}/{}", _bucket_context.bucketName,
+                _bucket_context.accessKeyId, _bucket_context.authRegion == nullptr ? "" : _bucket_context.authRegion);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // only the cancels recorded from now on apply to this delete
+        std::uint64_t cancel_sequence = 0;
+        if (auto* table = shared_table_.get(); table) {
+            shared_data::robust_lock table_lock(table->mutex);
+            shared_table_.attach_if_forked();
+            cancel_sequence = table->sequence;
+        }
+
+        auto [iter, inserted] = pending_.try_emplace(group_key);
+        pending_group& group = iter->second;
+        if (inserted) {
+            group.bucket_name = _bucket_context.bucketName;
+            group.access_key_id = _bucket_context.accessKeyId;
+            group.secret_access_key = _bucket_context.secretAccessKey;
+            group.security_token = _bucket_context.securityToken == nullptr ? "" : _bucket_context.securityToken;
+            group.auth_region = _bucket_context.authRegion == nullptr ? "" : _bucket_context.authRegion;
+            group.protocol = _bucket_context.protocol;
+            group.uri_style = _bucket_context.uriStyle;
+            group.sts_date = _bucket_context.stsDate;
+        }
+
+        if (group.keys.empty()) {
+            group.oldest = std::chrono::steady_clock::now();
+        }
+        group.keys.push_back({_key, cancel_sequence});
+        ++keys_queued_;
+
+        retry_policy_ = _retry_policy;
+        timeout_ms_ = _timeout_ms;
+
+        if (!flusher_.joinable() && !stopping_) {
+            try {
+                flusher_ = std::thread(&delete_batcher::run_flusher, this);
+            } catch (const std::system_error& e) {
+                // the keys are sent by the next flush()
+                logger::warn("{}:{} ({}) [resource_name={}] failed to start the bulk delete flusher.  {}",
+                        __FILE__, __LINE__, __func__, resource_name_, e.what());
+            }
+        }
+        cv_.notify_all();
+    } // end add
+
+    bool delete_batcher::cancel(const std::string& _bucket_name, const std::string& _key)
+    {
+        bool cancelled = false;
+        shared_data::delete_batch_table* table = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for (auto& [group_key, group] : pending_) {
+                if (group.bucket_name != _bucket_name) {
+                    continue;
+                }
+                const auto past_end = std::remove_if(group.keys.begin(), group.keys.end(),
+                        [&_key](const pending_key& _pending) { return _pending.key == _key; });
+                if (past_end != group.keys.end()) {
+                    keys_cancelled_ += std::distance(past_end, group.keys.end());
+                    group.keys.erase(past_end, group.keys.end());
+                    cancelled = true;
+                }
+            }
+
+            table = shared_table_.get();
+        }
+
+        // mutex_ is not held while waiting, the requests of this agent must be able to finish
+        if (!table) {
+            return cancelled;
+        }
+
+        shared_data::robust_lock table_lock(table->mutex);
+        shared_table_.attach_if_forked();
+
+        const std::uint64_t sequence = ++table->sequence;
+        table->cancels[(sequence - 1) % shared_data::delete_batch_table::MAXIMUM_CANCELS] =
+            {hash_key(_bucket_name, _key), sequence};
+
+        // Requests sent from now on check this cancel.  Wait for the ones sent
+        // before it, which may hold the key.
+        for (;;) {
+            bool waiting = false;
+            for (auto& slot : table->requests) {
+                if (slot.pid != 0 && slot.sequence < sequence) {
+                    if (shared_data::process_is_alive(slot.pid)) {
+                        waiting = true;
+                    } else {
+                        slot = shared_data::delete_request_slot{};
+                    }
+                }
+            }
+            if (!waiting) {
+                break;
+            }
+            table->request_finished.wait_for(table_lock, WAIT_INTERVAL);
+        }
+
+        return cancelled;
+    } // end cancel
+
+    auto delete_batcher::begin_request(const std::string& _bucket_name, std::vector<pending_key>& _keys)
+        -> std::optional<std::size_t>
+    {
+        shared_data::delete_batch_table* table = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            table = shared_table_.get();
+        }
+
+        if (!table) {
+            return std::nullopt;
+        }
+
+        shared_data::robust_lock table_lock(table->mutex);
+        shared_table_.attach_if_forked();
+
+        // the hashes of the keys cancelled since the oldest key was added
+        std::uint64_t oldest_sequence = table->sequence;
+        for (const auto& pending : _keys) {
+            oldest_sequence = std::min(oldest_sequence, pending.cancel_sequence);
+        }
+        const std::uint64_t first_recorded = table->sequence > shared_data::delete_batch_table::MAXIMUM_CANCELS
+                                           ? table->sequence - shared_data::delete_batch_table::MAXIMUM_CANCELS
+                                           : 0;
+
+        std::map<std::uint64_t, std::uint64_t> last_cancels;
+        for (std::uint64_t sequence = std::max(oldest_sequence, first_recorded) + 1; sequence <= table->sequence; ++sequence) {
+            const auto& entry = table->cancels[(sequence - 1) % shared_data::delete_batch_table::MAXIMUM_CANCELS];
+            last_cancels[entry.key_hash] = entry.sequence;
+        }
+
+        const auto past_end = std::remove_if(_keys.begin(), _keys.end(), [&](const pending_key& _pending) {
+            if (_pending.cancel_sequence < first_recorded) {
+                logger::warn("{}:{} ({}) [resource_name={}] not deleting {}/{}, too many objects were written "
+                        "while its delete was pending to tell whether it was written again", __FILE__, __LINE__,
+                        __func__, resource_name_, _bucket_name, _pending.key);
+                return true;
+            }
+            const auto iter = last_cancels.find(hash_key(_bucket_name, _pending.key));
+            return iter != last_cancels.end() && iter->second > _pending.cancel_sequence;
+        });
+        _keys.erase(past_end, _keys.end());
+
+        for (;;) {
+            for (std::size_t i = 0; i < shared_data::delete_batch_table::MAXIMUM_REQUESTS; ++i) {
+                auto& slot = table->requests[i];
+                if (slot.pid == 0 || !shared_data::process_is_alive(slot.pid)) {
+                    slot = {::getpid(), table->sequence};
+                    return i;
+                }
+            }
+            table->request_finished.wait_for(table_lock, WAIT_INTERVAL);
+        }
+    } // end begin_request
+
+    void delete_batcher::end_request(std::optional<std::size_t> _slot)
+    {
+        if (!_slot) {
+            return;
+        }
+
+        shared_data::delete_batch_table* table = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            table = shared_table_.get();
+        }
+
+        if (!table) {
+            return;
+        }
+
+        shared_data::robust_lock table_lock(table->mutex);
+        table->requests[*_slot] = shared_data::delete_request_slot{};
+        table->request_finished.notify_all();
+    } // end end_request
+
+    auto delete_batcher::flush(const retry_policy& _retry_policy, int _timeout_ms, bool _all)
+        -> std::vector<delete_failure>
+    {
+        // take the due groups out of the batcher so that the requests are sent
+        // without holding the lock
+        std::vector<pending_group> due;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto now = std::chrono::steady_clock::now();
+            for (auto iter = pending_.begin(); iter != pending_.end();) {
+                pending_group& group = iter->second;
+                if (!group.keys.empty() &&
+                        (_all || group.keys.size() >= batch_size_ || now - group.oldest >= max_delay_)) {
+                    due.push_back(std::move(group));
+                    iter = pending_.erase(iter);
+                } else {
+                    ++iter;
+                }
+            }
+        }
+
+        std::vector<delete_failure> failures;
+        for (auto& group : due) {
+
+            S3BucketContext bucket_context = {};
+            bucket_context.bucketName = group.bucket_name.c_str();
+            bucket_context.protocol = group.protocol;
+            bucket_context.uriStyle = group.uri_style;
+            bucket_context.accessKeyId = group.access_key_id.c_str();
+            bucket_context.secretAccessKey = group.secret_access_key.c_str();
+            bucket_context.securityToken = group.security_token.empty() ? nullptr : group.security_token.c_str();
+            bucket_context.authRegion = group.auth_region.c_str();
+            bucket_context.stsDate = group.sts_date;
+
+            // one request slot per multi-object delete so that a cancel waits for that request only
+            for (std::size_t begin = 0; begin < group.keys.size(); begin += S3_MAX_DELETE_OBJECTS_COUNT) {
+
+                const std::size_t end = std::min(group.keys.size(), begin + S3_MAX_DELETE_OBJECTS_COUNT);
+                std::vector<pending_key> chunk(std::make_move_iterator(group.keys.begin() + begin),
+                                               std::make_move_iterator(group.keys.begin() + end));
+
+                const std::size_t keys_added = chunk.size();
+                const auto slot = begin_request(group.bucket_name, chunk);
+
+                std::vector<std::string> keys;
+                keys.reserve(chunk.size());
+                for (auto& pending : chunk) {
+                    keys.push_back(std::move(pending.key));
+                }
+
+                const std::size_t failures_before = failures.size();
+                if (!keys.empty()) {
+                    delete_objects(resource_name_, bucket_context, keys, _retry_policy, _timeout_ms, failures);
+                }
+
+                end_request(slot);
+
+                logger::debug("{}:{} ({}) [resource_name={}] deleted {} of {} keys from bucket {}",
+                        __FILE__, __LINE__, __func__, resource_name_,
+                        keys.size() - (failures.size() - failures_before), keys.size(), group.bucket_name);
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                keys_cancelled_ += keys_added - keys.size();
+                batches_sent_ += keys.empty() ? 0 : 1;
+                keys_failed_ += failures.size() - failures_before;
+            }
+        }
+
+        return failures;
+    } // end flush
+
+    void delete_batcher::run_flusher()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+
+            // wake up when the oldest group is due, and at least every max_delay_
+            auto wake_up = std::chrono::steady_clock::now() + max_delay_;
+            for (const auto& [group_key, group] : pending_) {
+                if (!group.keys.empty()) {
+                    wake_up = std::min(wake_up, group.oldest + max_delay_);
+                }
+            }
+            cv_.wait_until(lock, wake_up, [this] { return stopping_; });
+            if (stopping_ || !retry_policy_) {
+                continue;
+            }
+
+            const auto policy = *retry_policy_;
+            const int timeout_ms = timeout_ms_;
+            lock.unlock();
+
+            for (const auto& failure : flush(policy, timeout_ms)) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to delete the S3 object {} - \"{}\" {}",
+                        __FILE__, __LINE__, __func__, resource_name_, failure.key,
+                        failure.code.empty() ? S3_get_status_name(failure.status) : failure.code,
+                        failure.message);
+            }
+
+            lock.lock();
+        }
+    } // end run_flusher
+
+    void delete_batcher::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+
+        if (flusher_.joinable()) {
+            flusher_.join();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        shared_table_.detach();
+    } // end stop
+
+    auto delete_batcher::to_json() const -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::size_t keys_pending = 0;
+        for (const auto& [group_key, group] : pending_) {
+            keys_pending += group.keys.size();
+        }
+
+        return {
+            {"enabled", enabled_},
+            {"batch_size", batch_size_},
+            {"max_delay_milliseconds", max_delay_.count()},
+            {"keys_queued", keys_queued_},
+            {"keys_cancelled", keys_cancelled_},
+            {"keys_failed", keys_failed_},
+            {"keys_pending", keys_pending},
+            {"batches_sent", batches_sent_}
+        };
+    } // end to_json
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,416 @@
+// local includes
+#include "irods/private/s3_transport/compression.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/hedged_get.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+#include <zstd.h>
+
+// stdlib includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// boost includes
+#include <boost/lexical_cast.hpp>
+
+// system includes
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        // See the seekable format in the contrib directory of zstd.
+        constexpr std::uint32_t SKIPPABLE_FRAME_MAGIC{0x184D2A5E};
+        constexpr std::uint32_t SEEKABLE_MAGIC{0x8F92EAB1};
+        constexpr std::int64_t  SKIPPABLE_HEADER_SIZE{8};
+        constexpr std::int64_t  SEEK_TABLE_FOOTER_SIZE{9};
+        constexpr std::uint8_t  CHECKSUM_FLAG{0x80};
+
+        struct frame
+        {
+            std::int64_t logical_offset;
+            std::int64_t logical_size;
+            std::int64_t compressed_offset;
+            std::int64_t compressed_size;
+        };
+
+        void put_u32(std::string& _buffer, std::uint32_t _value)
+        {
+            for (int i = 0; i < 4; ++i) {
+                _buffer.push_back(static_cast<char>((_value >> (8 * i)) & 0xff));
+            }
+        }
+
+        auto get_u32(const char* _buffer) -> std::uint32_t
+        {
+            std::uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= static_cast<std::uint32_t>(static_cast<unsigned char>(_buffer[i])) << (8 * i);
+            }
+            return value;
+        }
+
+        bool write_all(int _fd, const char* _buffer, std::int64_t _length, std::int64_t _offset)
+        {
+            while (_length > 0) {
+                const ssize_t written = ::pwrite(_fd, _buffer, _length, _offset);
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return false;
+                }
+                _buffer += written;
+                _offset += written;
+                _length -= written;
+            }
+            return true;
+        }
+
+        // Returns the frames listed in the seek table of an object, or nothing
+        // if the table is malformed or does not match the object.
+        auto parse_seek_table(const std::string& _table, const compressed_object& _object)
+            -> std::optional<std::vector<frame>>
+        {
+            const auto size = static_cast<std::int64_t>(_table.size());
+            if (size < SKIPPABLE_HEADER_SIZE + SEEK_TABLE_FOOTER_SIZE ||
+                    get_u32(_table.data()) != SKIPPABLE_FRAME_MAGIC ||
+                    get_u32(_table.data() + 4) != size - SKIPPABLE_HEADER_SIZE ||
+                    get_u32(_table.data() + size - 4) != SEEKABLE_MAGIC) {
+                return std::nullopt;
+            }
+
+            const char* footer = _table.data() + size - SEEK_TABLE_FOOTER_SIZE;
+            const std::int64_t number_of_frames = get_u32(footer);
+            const std::int64_t entry_size = (static_cast<std::uint8_t>(footer[4]) & CHECKSUM_FLAG) ? 12 : 8;
+            if (SKIPPABLE_HEADER_SIZE + number_of_frames * entry_size + SEEK_TABLE_FOOTER_SIZE != size) {
+                return std::nullopt;
+            }
+
+            std::vector<frame> frames;
+            frames.reserve(number_of_frames);
+            std::int64_t logical_offset = 0;
+            std::int64_t compressed_offset = 0;
+            for (std::int64_t i = 0; i < number_of_frames; ++i) {
+                const char* entry = _table.data() + SKIPPABLE_HEADER_SIZE + i * entry_size;
+                frame f{logical_offset, get_u32(entry + 4), compressed_offset, get_u32(entry)};
+                logical_offset += f.logical_size;
+                compressed_offset += f.compressed_size;
+                frames.push_back(f);
+            }
+
+            if (logical_offset != _object.logical_size || compressed_offset + size != _object.compressed_size) {
+                return std::nullopt;
+            }
+            return frames;
+        } // end parse_seek_table
+
+        struct transfer_data
+        {
+            char*        buffer{nullptr};
+            std::int64_t length{0};
+            std::int64_t offset{0};
+            S3Status     status{S3StatusOK};
+        };
+
+        void on_response_completion(S3Status _status, const S3ErrorDetails* _error, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            data->status = _status;
+            if (_status != S3StatusOK && _error && _error->message) {
+                logger::debug("{}:{} ({}) S3 error message: {}", __FILE__, __LINE__, __func__, _error->message);
+            }
+        }
+
+        S3Status on_get_data(int _size, const char* _buffer, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            if (data->offset + _size > data->length) {
+                return S3StatusAbortedByCallback;
+            }
+            std::memcpy(data->buffer + data->offset, _buffer, _size);
+            data->offset += _size;
+            return S3StatusOK;
+        }
+
+        auto get_range(const std::string&     _resource_name,
+                       const S3BucketContext& _bucket_context,
+                       const std::string&     _key,
+                       std::int64_t           _offset,
+                       char*                  _buffer,
+                       std::int64_t           _length,
+                       const retry_policy&    _retry_policy) -> S3Status
+        {
+            S3GetObjectHandler handler = { { nullptr, on_response_completion }, on_get_data };
+
+            rate_limiter::for_resource(_resource_name).acquire_bytes(_length);
+
+            transfer_data data;
+            data.buffer = _buffer;
+            data.length = _length;
+
+            auto retry = _retry_policy;
+            do {
+                data.offset = 0;
+                data.status = S3StatusOK;
+
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.hostName = hostname.c_str();
+
+                endpoint_request endpoint{_resource_name, hostname};
+                hedged_get_object(_resource_name, endpoint, bucket_context, _key, _offset, _length, handler, &data);
+
+                // a short transfer is an error even if the request succeeded
+                if (data.status == S3StatusOK && data.offset != data.length) {
+                    data.status = S3StatusErrorIncompleteBody;
+                }
+            } while (retry.should_retry(data.status));
+
+            return data.status;
+        } // end get_range
+    } // end anonymous namespace
+
+    auto compressed_object::meta_data() const -> std::map<std::string, std::string>
+    {
+        return {
+            {COMPRESSION_CODEC_META_DATA, COMPRESSION_CODEC},
+            {LOGICAL_SIZE_META_DATA, std::to_string(logical_size)},
+            {COMPRESSED_SIZE_META_DATA, std::to_string(compressed_size)},
+            {SEEK_TABLE_SIZE_META_DATA, std::to_string(seek_table_size)}
+        };
+    } // end meta_data
+
+    auto compressed_object_from_meta_data(const std::map<std::string, std::string>& _meta_data)
+        -> std::optional<compressed_object>
+    {
+        const auto codec = _meta_data.find(COMPRESSION_CODEC_META_DATA);
+        if (codec == _meta_data.end()) {
+            return std::nullopt;
+        }
+        if (codec->second != COMPRESSION_CODEC) {
+            logger::warn("{}:{} ({}) unknown compression codec [{}]", __FILE__, __LINE__, __func__, codec->second);
+            return std::nullopt;
+        }
+
+        try {
+            compressed_object object{
+                boost::lexical_cast<std::int64_t>(_meta_data.at(LOGICAL_SIZE_META_DATA)),
+                boost::lexical_cast<std::int64_t>(_meta_data.at(COMPRESSED_SIZE_META_DATA)),
+                boost::lexical_cast<std::int64_t>(_meta_data.at(SEEK_TABLE_SIZE_META_DATA))};
+            if (object.logical_size < 0 || object.seek_table_size <= 0 || object.seek_table_size > object.compressed_size) {
+                throw boost::bad_lexical_cast{};
+            }
+            return object;
+        }
+        catch (const std::exception&) {
+            logger::warn("{}:{} ({}) invalid metadata for a compressed object", __FILE__, __LINE__, __func__);
+            return std::nullopt;
+        }
+    } // end compressed_object_from_meta_data
+
+    auto compress_file(int _input_fd, int _output_fd, int _level) -> std::optional<compressed_object>
+    {
+        std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context{ZSTD_createCCtx(), ZSTD_freeCCtx};
+        if (!context) {
+            return std::nullopt;
+        }
+
+        std::vector<char> input(COMPRESSION_FRAME_SIZE);
+        std::vector<char> output(ZSTD_compressBound(COMPRESSION_FRAME_SIZE));
+
+        std::string seek_table;
+        put_u32(seek_table, SKIPPABLE_FRAME_MAGIC);
+        put_u32(seek_table, 0); // size of the table, set below
+
+        std::int64_t logical_size = 0;
+        std::int64_t compressed_size = 0;
+        std::uint32_t number_of_frames = 0;
+        while (true) {
+            // fill a whole frame unless the end of the file is reached
+            std::int64_t length = 0;
+            while (length < COMPRESSION_FRAME_SIZE) {
+                const ssize_t count = ::pread(_input_fd, input.data() + length, COMPRESSION_FRAME_SIZE - length,
+                        logical_size + length);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count < 0) {
+                    return std::nullopt;
+                }
+                if (count == 0) {
+                    break;
+                }
+                length += count;
+            }
+            if (length == 0) {
+                break;
+            }
+
+            const std::size_t frame_size = ZSTD_compressCCtx(context.get(), output.data(), output.size(),
+                    input.data(), length, _level);
+            if (ZSTD_isError(frame_size)) {
+                logger::error("{}:{} ({}) compression failed - {}", __FILE__, __LINE__, __func__,
+                        ZSTD_getErrorName(frame_size));
+                return std::nullopt;
+            }
+            if (!write_all(_output_fd, output.data(), frame_size, compressed_size)) {
+                return std::nullopt;
+            }
+
+            put_u32(seek_table, static_cast<std::uint32_t>(frame_size));
+            put_u32(seek_table, static_cast<std::uint32_t>(length));
+            logical_size += length;
+            compressed_size += frame_size;
+            ++number_of_frames;
+        }
+
+        put_u32(seek_table, number_of_frames);
+        seek_table.push_back('\0'); // no frame checksums
+        put_u32(seek_table, SEEKABLE_MAGIC);
+
+        const auto table_content_size = static_cast<std::uint32_t>(seek_table.size() - SKIPPABLE_HEADER_SIZE);
+        for (int i = 0; i < 4; ++i) {
+            seek_table[4 + i] = static_cast<char>((table_content_size >> (8 * i)) & 0xff);
+        }
+        if (!write_all(_output_fd, seek_table.data(), seek_table.size(), compressed_size)) {
+            return std::nullopt;
+        }
+
+        const auto seek_table_size = static_cast<std::int64_t>(seek_table.size());
+        return compressed_object{logical_size, compressed_size + seek_table_size, seek_table_size};
+    } // end compress_file
+
+    auto download_compressed_object(const std::string&       _resource_name,
+                                    const S3BucketContext&   _bucket_context,
+                                    const std::string&       _key,
+                                    const compressed_object& _object,
+                                    int                      _fd,
+                                    std::int64_t             _chunk_size,
+                                    unsigned int             _number_of_threads,
+                                    const retry_policy&      _retry_policy) -> S3Status
+    {
+        std::string table(_object.seek_table_size, '\0');
+        S3Status status = get_range(_resource_name, _bucket_context, _key,
+                _object.compressed_size - _object.seek_table_size, table.data(), _object.seek_table_size, _retry_policy);
+        if (status != S3StatusOK) {
+            return status;
+        }
+
+        const auto frames = parse_seek_table(table, _object);
+        if (!frames) {
+            logger::error("{}:{} ({}) [resource_name={}] the seek table of {} is invalid",
+                    __FILE__, __LINE__, __func__, _resource_name, _key);
+            return S3StatusErrorIncompleteBody;
+        }
+
+        if (::ftruncate(_fd, _object.logical_size) != 0) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to size the file for {} - {}",
+                    __FILE__, __LINE__, __func__, _resource_name, _key, std::strerror(errno));
+            return S3StatusAbortedByCallback;
+        }
+
+        // consecutive frames are fetched together in chunks of about _chunk_size bytes
+        std::vector<std::pair<std::size_t, std::size_t>> chunks;
+        for (std::size_t first = 0; first < frames->size();) {
+            std::size_t last = first;
+            std::int64_t length = (*frames)[first].compressed_size;
+            while (last + 1 < frames->size() && length + (*frames)[last + 1].compressed_size <= _chunk_size) {
+                length += (*frames)[++last].compressed_size;
+            }
+            chunks.emplace_back(first, last);
+            first = last + 1;
+        }
+
+        std::atomic<std::size_t> next_chunk{0};
+        std::atomic<bool> failed{false};
+        std::mutex status_mutex;
+
+        const auto worker = [&] {
+            std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context{ZSTD_createDCtx(), ZSTD_freeDCtx};
+            std::vector<char> compressed;
+            std::vector<char> decompressed;
+
+            const auto fail = [&](S3Status _status) {
+                std::lock_guard<std::mutex> lock(status_mutex);
+                if (!failed.exchange(true)) {
+                    status = _status;
+                }
+            };
+
+            if (!context) {
+                fail(S3StatusOutOfMemory);
+                return;
+            }
+
+            for (std::size_t index; !failed && (index = next_chunk++) < chunks.size();) {
+                const auto& first = (*frames)[chunks[index].first];
+                const auto& last = (*frames)[chunks[index].second];
+                const std::int64_t length = last.compressed_offset + last.compressed_size - first.compressed_offset;
+
+                compressed.resize(length);
+                const S3Status get_status = get_range(_resource_name, _bucket_context, _key,
+                        first.compressed_offset, compressed.data(), length, _retry_policy);
+                if (get_status != S3StatusOK) {
+                    fail(get_status);
+                    return;
+                }
+
+                for (std::size_t i = chunks[index].first; i <= chunks[index].second; ++i) {
+                    const auto& f = (*frames)[i];
+                    decompressed.resize(f.logical_size);
+                    const std::size_t size = ZSTD_decompressDCtx(context.get(), decompressed.data(), decompressed.size(),
+                            compressed.data() + (f.compressed_offset - first.compressed_offset), f.compressed_size);
+                    if (ZSTD_isError(size) || static_cast<std::int64_t>(size) != f.logical_size) {
+                        logger::error("{}:{} ({}) [resource_name={}] frame {} of {} is corrupt - {}",
+                                __FILE__, __LINE__, __func__, _resource_name, i, _key,
+                                ZSTD_isError(size) ? ZSTD_getErrorName(size) : "unexpected size");
+                        fail(S3StatusErrorInvalidArgument);
+                        return;
+                    }
+                    if (!write_all(_fd, decompressed.data(), f.logical_size, f.logical_offset)) {
+                        logger::error("{}:{} ({}) [resource_name={}] failed to write to the file for {} - {}",
+                                __FILE__, __LINE__, __func__, _resource_name, _key, std::strerror(errno));
+                        fail(S3StatusAbortedByCallback);
+                        return;
+                    }
+                }
+            }
+        };
+
+        const unsigned int number_of_threads = static_cast<unsigned int>(
+                std::clamp<std::size_t>(_number_of_threads, 1, std::max<std::size_t>(chunks.size(), 1)));
+
+        std::vector<std::thread> threads;
+        try {
+            for (unsigned int i = 1; i < number_of_threads; ++i) {
+                threads.emplace_back(worker);
+            }
+        }
+        catch (const std::system_error& e) {
+            logger::warn("{}:{} ({}) [resource_name={}] started {} of {} threads - {}",
+                    __FILE__, __LINE__, __func__, _resource_name, threads.size() + 1, number_of_threads, e.what());
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        return status;
+    } // end download_compressed_object
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,80 @@
+// local includes
+#include "irods/private/s3_transport/content_address.hpp"
+
+// misc includes
+#include <fmt/format.h>
+#include <openssl/evp.h>
+
+// stdlib includes
+#include <cerrno>
+#include <memory>
+#include <vector>
+
+// system includes
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport::content_address
+{
+
+    bool is_key(const std::string& _key)
+    {
+        return _key.compare(0, KEY_PREFIX.size(), KEY_PREFIX) == 0;
+    } // end is_key
+
+    auto key_of_file(int _fd) -> std::optional<std::string>
+    {
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+        if (!context || EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr) != 1) {
+            errno = 0;
+            return std::nullopt;
+        }
+
+        std::vector<char> buffer(1024 * 1024);
+        while (true) {
+            const ssize_t bytes_read = ::read(_fd, buffer.data(), buffer.size());
+            if (bytes_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_read < 0) {
+                return std::nullopt;
+            }
+            if (bytes_read == 0) {
+                break;
+            }
+            if (EVP_DigestUpdate(context.get(), buffer.data(), bytes_read) != 1) {
+                errno = 0;
+                return std::nullopt;
+            }
+        }
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        if (EVP_DigestFinal_ex(context.get(), digest, &digest_length) != 1) {
+            errno = 0;
+            return std::nullopt;
+        }
+
+        std::string key = KEY_PREFIX;
+        for (unsigned int i = 0; i < digest_length; ++i) {
+            key += fmt::format("{:02x}", digest[i]);
+        }
+        return key;
+    } // end key_of_file
+
+    auto digest_of_key(const std::string& _key) -> std::string
+    {
+        return is_key(_key) ? _key.substr(KEY_PREFIX.size()) : std::string{};
+    } // end digest_of_key
+
+    bool holds_contents(const std::string&                        _key,
+                        std::int64_t                              _size,
+                        std::int64_t                              _object_size,
+                        const std::map<std::string, std::string>& _meta_data)
+    {
+        const std::string digest = digest_of_key(_key);
+        const auto stored_digest = _meta_data.find(DIGEST_META_DATA);
+        return !digest.empty() && _object_size == _size && stored_digest != _meta_data.end() &&
+            stored_digest->second == digest;
+    } // end holds_contents
+
+} // irods::experimental::io::s3_transport::content_address
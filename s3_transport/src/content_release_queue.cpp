@@ -0,0 +1,204 @@
+// local includes
+#include "irods/private/s3_transport/content_release_queue.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+// stdlib includes
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+
+// boost includes
+#include <boost/filesystem.hpp>
+
+// system includes
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    namespace bf   = boost::filesystem;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        // Closes a file descriptor when it goes out of scope.
+        class scoped_fd
+        {
+          public:
+            explicit scoped_fd(int _fd)
+                : fd_{_fd}
+            {
+            }
+
+            ~scoped_fd()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+
+            scoped_fd(const scoped_fd&) = delete;
+            auto operator=(const scoped_fd&) -> scoped_fd& = delete;
+
+            int get() const { return fd_; }
+
+          private:
+            int fd_;
+
+        }; // scoped_fd
+
+        bool lock(int _fd)
+        {
+            int result = 0;
+            do {
+                result = ::flock(_fd, LOCK_EX);
+            } while (result == -1 && errno == EINTR);
+            return result == 0;
+        }
+
+        bool write_all(int _fd, const std::string& _contents)
+        {
+            for (std::size_t written = 0; written < _contents.size();) {
+                const ssize_t count = ::write(_fd, _contents.data() + written, _contents.size() - written);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count <= 0) {
+                    return false;
+                }
+                written += count;
+            }
+            return ::fdatasync(_fd) == 0;
+        }
+
+        auto read_file(int _fd) -> std::string
+        {
+            std::string contents;
+            char buffer[65536];
+            off_t offset = 0;
+            for (ssize_t count; (count = ::pread(_fd, buffer, sizeof(buffer), offset)) > 0; offset += count) {
+                contents.append(buffer, count);
+            }
+            return contents;
+        }
+
+        auto now_seconds() -> std::int64_t
+        {
+            return std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    } // end anonymous namespace
+
+    auto content_release_queue::for_resource(const std::string& _resource_name) -> content_release_queue&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<content_release_queue>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& queue = registry[_resource_name];
+        if (!queue) {
+            queue = std::make_unique<content_release_queue>(_resource_name);
+        }
+        return *queue;
+    } // end for_resource
+
+    content_release_queue::content_release_queue(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , grace_period_{GRACE_PERIOD}
+    {
+    }
+
+    void content_release_queue::configure(const std::string& _cache_directory, std::chrono::seconds _grace_period)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = (bf::path{_cache_directory} / FILE_NAME).string();
+        grace_period_ = _grace_period;
+    } // end configure
+
+    bool content_release_queue::add(const std::string& _bucket_name, const std::string& _key)
+    {
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            path = path_;
+        }
+
+        boost::system::error_code ec;
+        bf::create_directories(bf::path{path}.parent_path(), ec);
+
+        const scoped_fd file{path.empty() ? -1 : ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)};
+        const nlohmann::json record{{"bucket", _bucket_name}, {"key", _key}, {"time", now_seconds()}};
+
+        // the lock keeps the record from being appended while the file is rewritten
+        if (file.get() < 0 || !lock(file.get()) || !write_all(file.get(), record.dump() + "\n")) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to record the release of {} in {}.  {}", __FILE__,
+                    __LINE__, __func__, resource_name_, _key, path, std::strerror(errno));
+            return false;
+        }
+
+        return true;
+    } // end add
+
+    auto content_release_queue::take_due() -> std::vector<entry>
+    {
+        std::string path;
+        std::int64_t grace_period = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            path = path_;
+            grace_period = grace_period_.count();
+        }
+
+        std::vector<entry> due;
+
+        const scoped_fd file{path.empty() ? -1 : ::open(path.c_str(), O_RDWR | O_CLOEXEC)};
+        if (file.get() < 0 || !lock(file.get())) {
+            return due;
+        }
+
+        const std::int64_t now = now_seconds();
+
+        std::istringstream lines{read_file(file.get())};
+        std::string remaining;
+        for (std::string line; std::getline(lines, line);) {
+            // a line cut short by a crash is discarded
+            const auto record = nlohmann::json::parse(line, nullptr, false);
+            if (record.is_discarded() || !record.is_object()) {
+                continue;
+            }
+
+            entry e{record.value("bucket", ""), record.value("key", ""), record.value("time", std::int64_t{0})};
+            if (e.bucket_name.empty() || e.key.empty()) {
+                continue;
+            }
+
+            if (e.time + grace_period <= now) {
+                due.push_back(std::move(e));
+            } else {
+                remaining += line + "\n";
+            }
+        }
+
+        if (due.empty()) {
+            return due;
+        }
+
+        if (::ftruncate(file.get(), 0) != 0 || ::lseek(file.get(), 0, SEEK_SET) != 0 ||
+                !write_all(file.get(), remaining)) {
+            // the records that are lost leave their objects in the bucket
+            logger::error("{}:{} ({}) [resource_name={}] failed to rewrite {}.  {}", __FILE__, __LINE__, __func__,
+                    resource_name_, path, std::strerror(errno));
+        }
+
+        return due;
+    } // end take_due
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,583 @@
+// local includes
+#include "irods/private/s3_transport/delete_queue.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <system_error>
+#include <utility>
+
+// boost includes
+#include <boost/filesystem.hpp>
+
+// system includes
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    namespace bf   = boost::filesystem;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        const std::string QUEUE_FILE{"queue"};
+        const std::string DRAINING_FILE{"draining"};
+        const std::string DRAINER_LOCK_FILE{"drainer.lock"};
+        const std::string IN_FLIGHT_LOCK_FILE{"inflight.lock"};
+        const std::string GATE_LOCK_FILE{"gate.lock"};
+
+        const std::string DELETE_RECORD{"D"};
+        const std::string CANCEL_RECORD{"C"};
+
+        // A file opened and locked with flock.  Closing the file releases the lock.
+        class locked_file
+        {
+          public:
+            locked_file(const std::string& _path, int _open_flags, int _lock_operation)
+                : fd_{::open(_path.c_str(), _open_flags | O_CLOEXEC, 0600)}
+                , locked_{false}
+            {
+                if (fd_ < 0) {
+                    return;
+                }
+
+                int result = 0;
+                do {
+                    result = ::flock(fd_, _lock_operation);
+                } while (result == -1 && errno == EINTR);
+                locked_ = result == 0;
+            }
+
+            ~locked_file()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+
+            locked_file(const locked_file&) = delete;
+            auto operator=(const locked_file&) -> locked_file& = delete;
+
+            bool locked() const { return locked_; }
+            int fd() const { return fd_; }
+
+          private:
+            int  fd_;
+            bool locked_;
+
+        }; // locked_file
+
+        auto make_record(const std::string& _op, const std::string& _bucket_name, const std::string& _key) -> std::string
+        {
+            return nlohmann::json{{"op", _op}, {"bucket", _bucket_name}, {"key", _key}}.dump();
+        }
+
+        // Takes the in flight lock shared, for one delete request.  The gate is
+        // held while waiting for it so that a cancel waiting for the exclusive
+        // lock is not starved by the requests of the drainer threads.
+        auto lock_in_flight_shared(const std::string& _gate_path, const std::string& _in_flight_path)
+            -> std::unique_ptr<locked_file>
+        {
+            locked_file gate{_gate_path, O_RDWR | O_CREAT, LOCK_SH};
+            return std::make_unique<locked_file>(_in_flight_path, O_RDWR | O_CREAT, LOCK_SH);
+        }
+    }
+
+    auto delete_queue::for_resource(const std::string& _resource_name) -> delete_queue&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<delete_queue>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& queue = registry[_resource_name];
+        if (!queue) {
+            queue = std::make_unique<delete_queue>(_resource_name);
+        }
+        return *queue;
+    } // end for_resource
+
+    delete_queue::delete_queue(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , enabled_{false}
+        , number_of_threads_{DEFAULT_NUMBER_OF_THREADS}
+        , timeout_ms_{0}
+        , stopping_{false}
+        , keys_queued_{0}
+        , keys_cancelled_{0}
+        , keys_deleted_{0}
+        , keys_requeued_{0}
+        , keys_failed_{0}
+    {
+    }
+
+    delete_queue::~delete_queue()
+    {
+        stop();
+    }
+
+    void delete_queue::configure(bool _enabled, const std::string& _cache_directory, unsigned int _number_of_threads)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        enabled_ = _enabled;
+        directory_ = (bf::path{_cache_directory} / DIRECTORY_NAME).string();
+        number_of_threads_ = std::max(_number_of_threads, 1u);
+
+        if (enabled_) {
+            try {
+                bf::create_directories(directory_);
+            } catch (const bf::filesystem_error& e) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to create the delete queue directory {}, "
+                        "objects are deleted when they are unlinked.  {}", __FILE__, __LINE__, __func__,
+                        resource_name_, directory_, e.what());
+                enabled_ = false;
+            }
+        }
+    } // end configure
+
+    bool delete_queue::enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return enabled_;
+    } // end enabled
+
+    auto delete_queue::path(const std::string& _file_name) const -> std::string
+    {
+        return (bf::path{directory_} / _file_name).string();
+    } // end path
+
+    bool delete_queue::enqueue(const S3BucketContext& _bucket_context,
+                               const std::string&     _key,
+                               const retry_policy&    _retry_policy,
+                               int                    _timeout_ms)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            credentials_ = credentials{
+                _bucket_context.accessKeyId,
+                _bucket_context.secretAccessKey,
+                _bucket_context.securityToken == nullptr ? "" : _bucket_context.securityToken,
+                _bucket_context.authRegion == nullptr ? "" : _bucket_context.authRegion,
+                _bucket_context.protocol,
+                _bucket_context.uriStyle,
+                _bucket_context.stsDate};
+            retry_policy_ = _retry_policy;
+            timeout_ms_ = _timeout_ms;
+        }
+
+        if (!append({make_record(DELETE_RECORD, _bucket_context.bucketName, _key)})) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++keys_queued_;
+        if (!drainer_.joinable() && !stopping_) {
+            try {
+                drainer_ = std::thread(&delete_queue::run_drainer, this);
+            } catch (const std::system_error& e) {
+                // the key stays queued for the drainer of another agent
+                logger::warn("{}:{} ({}) [resource_name={}] failed to start the delete queue drainer.  {}",
+                        __FILE__, __LINE__, __func__, resource_name_, e.what());
+            }
+        }
+        return true;
+    } // end enqueue
+
+    void delete_queue::cancel(const std::string& _bucket_name, const std::string& _key)
+    {
+        if (!enabled()) {
+            return;
+        }
+
+        // nothing is queued if both files are gone
+        boost::system::error_code ec;
+        if (!bf::exists(path(QUEUE_FILE), ec) && !bf::exists(path(DRAINING_FILE), ec)) {
+            return;
+        }
+
+        // Holding the in flight lock waits for the delete requests in progress and
+        // keeps new ones from reading the cancels until this one is written.  The
+        // gate keeps new requests from taking the in flight lock meanwhile.
+        locked_file gate{path(GATE_LOCK_FILE), O_RDWR | O_CREAT, LOCK_EX};
+        locked_file in_flight{path(IN_FLIGHT_LOCK_FILE), O_RDWR | O_CREAT, LOCK_EX};
+        if (!append({make_record(CANCEL_RECORD, _bucket_name, _key)})) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to cancel the queued delete of {}/{}",
+                    __FILE__, __LINE__, __func__, resource_name_, _bucket_name, _key);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++keys_cancelled_;
+    } // end cancel
+
+    void delete_queue::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+
+        if (drainer_.joinable()) {
+            drainer_.join();
+        }
+    } // end stop
+
+    bool delete_queue::append(const std::vector<std::string>& _records)
+    {
+        std::string data;
+        for (const auto& record : _records) {
+            data += record;
+            data += '\n';
+        }
+
+        const std::string queue_path = path(QUEUE_FILE);
+
+        // retry if the drainer renamed the queue between the open and the lock
+        constexpr int MAXIMUM_ATTEMPTS{10};
+        for (int attempt = 0; attempt < MAXIMUM_ATTEMPTS; ++attempt) {
+            locked_file queue{queue_path, O_WRONLY | O_APPEND | O_CREAT, LOCK_SH};
+            if (!queue.locked()) {
+                break;
+            }
+
+            struct stat opened{};
+            struct stat current{};
+            if (::fstat(queue.fd(), &opened) != 0) {
+                break;
+            }
+            if (::stat(queue_path.c_str(), &current) != 0 ||
+                    opened.st_ino != current.st_ino || opened.st_dev != current.st_dev) {
+                continue;
+            }
+
+            // one write per append so that concurrent appends are not interleaved
+            const ssize_t written = ::write(queue.fd(), data.data(), data.size());
+            if (written != static_cast<ssize_t>(data.size()) || ::fdatasync(queue.fd()) != 0) {
+                break;
+            }
+            return true;
+        }
+
+        logger::error("{}:{} ({}) [resource_name={}] failed to append to the delete queue {}.  {}",
+                __FILE__, __LINE__, __func__, resource_name_, queue_path, std::strerror(errno));
+        return false;
+    } // end append
+
+    auto delete_queue::read_cancels() const -> std::set<std::pair<std::string, std::string>>
+    {
+        // the cancels in the queue were written after every record of the draining file
+        std::set<std::pair<std::string, std::string>> cancelled;
+        for (auto& e : read_entries(QUEUE_FILE, true)) {
+            cancelled.emplace(std::move(e.bucket_name), std::move(e.key));
+        }
+        return cancelled;
+    } // end read_cancels
+
+    auto delete_queue::read_entries(const std::string& _file_name, bool _cancels_only) const -> std::vector<entry>
+    {
+        std::vector<std::pair<std::string, entry>> records;
+
+        std::ifstream in{path(_file_name)};
+        std::string line;
+        while (std::getline(in, line)) {
+            // a line cut short by a crash is ignored
+            const auto record = nlohmann::json::parse(line, nullptr, false);
+            if (record.is_discarded() || !record.is_object() || !record.contains("op") ||
+                    !record.contains("bucket") || !record.contains("key")) {
+                continue;
+            }
+            try {
+                records.emplace_back(record.at("op").get<std::string>(),
+                        entry{record.at("bucket").get<std::string>(), record.at("key").get<std::string>()});
+            } catch (const nlohmann::json::exception&) {
+                continue;
+            }
+        }
+
+        std::vector<entry> entries;
+
+        if (_cancels_only) {
+            for (auto& [op, e] : records) {
+                if (op == CANCEL_RECORD) {
+                    entries.push_back(std::move(e));
+                }
+            }
+            return entries;
+        }
+
+        // A cancel removes the deletes of its key before it.  Walk backwards so
+        // the cancels seen so far are the ones after the current record.
+        std::set<std::pair<std::string, std::string>> cancelled;
+        for (auto iter = records.rbegin(); iter != records.rend(); ++iter) {
+            auto& [op, e] = *iter;
+            if (op == CANCEL_RECORD) {
+                cancelled.emplace(e.bucket_name, e.key);
+            } else if (op == DELETE_RECORD && !cancelled.contains({e.bucket_name, e.key})) {
+                entries.push_back(std::move(e));
+            }
+        }
+        std::reverse(entries.begin(), entries.end());
+
+        return entries;
+    } // end read_entries
+
+    void delete_queue::run_drainer()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            lock.unlock();
+
+            {
+                // only one agent drains the queue at a time
+                locked_file drainer_lock{path(DRAINER_LOCK_FILE), O_RDWR | O_CREAT, LOCK_EX | LOCK_NB};
+                if (drainer_lock.locked()) {
+                    // a draining file that exists now was left by a drainer that crashed
+                    boost::system::error_code ec;
+                    while ((bf::exists(path(DRAINING_FILE), ec) || rotate_queue()) && process_draining()) {
+                    }
+                }
+            }
+
+            lock.lock();
+            cv_.wait_for(lock, POLL_INTERVAL, [this] { return stopping_; });
+        }
+    } // end run_drainer
+
+    bool delete_queue::rotate_queue()
+    {
+        const std::string queue_path = path(QUEUE_FILE);
+
+        // the exclusive lock waits for appends in progress
+        locked_file queue{queue_path, O_RDWR, LOCK_EX};
+        if (!queue.locked()) {
+            return false;
+        }
+
+        struct stat status{};
+        if (::fstat(queue.fd(), &status) != 0 || status.st_size == 0) {
+            return false;
+        }
+
+        if (::rename(queue_path.c_str(), path(DRAINING_FILE).c_str()) != 0) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to rename the delete queue {}.  {}",
+                    __FILE__, __LINE__, __func__, resource_name_, queue_path, std::strerror(errno));
+            return false;
+        }
+
+        return true;
+    } // end rotate_queue
+
+    bool delete_queue::process_draining()
+    {
+        std::vector<entry> entries = read_entries(DRAINING_FILE, false);
+
+        std::size_t chunk_size = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            chunk_size = number_of_threads_ * static_cast<std::size_t>(S3_MAX_DELETE_OBJECTS_COUNT);
+        }
+
+        bool requeued = false;
+
+        for (std::size_t begin = 0; begin < entries.size(); begin += chunk_size) {
+
+            bool stopping = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping = stopping_;
+            }
+
+            if (stopping) {
+                // Leave the rest for the next drainer.  The records are appended
+                // after the cancels read, under the in flight lock, so a cancel
+                // written later still applies to them.
+                const auto in_flight = lock_in_flight_shared(path(GATE_LOCK_FILE), path(IN_FLIGHT_LOCK_FILE));
+                const auto cancelled = read_cancels();
+
+                std::vector<std::string> records;
+                for (std::size_t i = begin; i < entries.size(); ++i) {
+                    if (!cancelled.contains({entries[i].bucket_name, entries[i].key})) {
+                        records.push_back(make_record(DELETE_RECORD, entries[i].bucket_name, entries[i].key));
+                    }
+                }
+                if (!records.empty() && !append(records)) {
+                    return false;
+                }
+                boost::system::error_code ec;
+                bf::remove(path(DRAINING_FILE), ec);
+                return false;
+            }
+
+            const std::size_t end = std::min(entries.size(), begin + chunk_size);
+            std::vector<entry> chunk(std::make_move_iterator(entries.begin() + begin),
+                                     std::make_move_iterator(entries.begin() + end));
+
+            requeued = delete_chunk(chunk) || requeued;
+        }
+
+        boost::system::error_code ec;
+        if (!bf::remove(path(DRAINING_FILE), ec) && ec) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to remove {}.  {}",
+                    __FILE__, __LINE__, __func__, resource_name_, path(DRAINING_FILE), ec.message());
+            return false;
+        }
+
+        // wait for the poll interval before sending the failed deletes again
+        return !requeued;
+    } // end process_draining
+
+    bool delete_queue::delete_chunk(std::vector<entry>& _chunk)
+    {
+        std::optional<credentials> creds;
+        std::optional<retry_policy> policy;
+        int timeout_ms = 0;
+        unsigned int number_of_threads = 1;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            creds = credentials_;
+            policy = retry_policy_;
+            timeout_ms = timeout_ms_;
+            number_of_threads = number_of_threads_;
+        }
+
+        if (!creds || !policy) {
+            return false;
+        }
+
+        // one task per bucket and S3_MAX_DELETE_OBJECTS_COUNT keys
+        std::map<std::string, std::vector<std::string>> keys_by_bucket;
+        for (auto& e : _chunk) {
+            keys_by_bucket[e.bucket_name].push_back(std::move(e.key));
+        }
+
+        struct task
+        {
+            const std::string*       bucket_name;
+            std::vector<std::string> keys;
+            std::uint64_t            deleted{0};
+            std::uint64_t            requeued{0};
+            std::uint64_t            failed{0};
+        };
+
+        std::vector<task> tasks;
+        for (auto& [bucket_name, keys] : keys_by_bucket) {
+            for (std::size_t begin = 0; begin < keys.size(); begin += S3_MAX_DELETE_OBJECTS_COUNT) {
+                const std::size_t end = std::min(keys.size(), begin + S3_MAX_DELETE_OBJECTS_COUNT);
+                tasks.push_back({&bucket_name, std::vector<std::string>(keys.begin() + begin, keys.begin() + end)});
+            }
+        }
+
+        // Each request holds the in flight lock from reading the cancels until its
+        // failed deletes are queued again, so a cancel waits for that request only.
+        auto run_task = [&](task& _task) {
+            const auto in_flight = lock_in_flight_shared(path(GATE_LOCK_FILE), path(IN_FLIGHT_LOCK_FILE));
+
+            const auto cancelled = read_cancels();
+            const auto past_end = std::remove_if(_task.keys.begin(), _task.keys.end(),
+                    [&](const std::string& _key) { return cancelled.contains({*_task.bucket_name, _key}); });
+            _task.keys.erase(past_end, _task.keys.end());
+
+            if (_task.keys.empty()) {
+                return;
+            }
+
+            S3BucketContext bucket_context = {};
+            bucket_context.bucketName = _task.bucket_name->c_str();
+            bucket_context.protocol = creds->protocol;
+            bucket_context.uriStyle = creds->uri_style;
+            bucket_context.accessKeyId = creds->access_key_id.c_str();
+            bucket_context.secretAccessKey = creds->secret_access_key.c_str();
+            bucket_context.securityToken = creds->security_token.empty() ? nullptr : creds->security_token.c_str();
+            bucket_context.authRegion = creds->auth_region.c_str();
+            bucket_context.stsDate = creds->sts_date;
+
+            std::vector<delete_failure> failures;
+            delete_objects(resource_name_, bucket_context, _task.keys, *policy, timeout_ms, failures);
+
+            std::vector<std::string> requeue;
+            for (const auto& failure : failures) {
+                if (S3_status_is_retryable(failure.status)) {
+                    requeue.push_back(make_record(DELETE_RECORD, *_task.bucket_name, failure.key));
+                } else {
+                    ++_task.failed;
+                    logger::error("{}:{} ({}) [resource_name={}] failed to delete the queued S3 object {}/{} - \"{}\" {}",
+                            __FILE__, __LINE__, __func__, resource_name_, *_task.bucket_name, failure.key,
+                            failure.code.empty() ? S3_get_status_name(failure.status) : failure.code,
+                            failure.message);
+                }
+            }
+
+            if (!requeue.empty() && !append(requeue)) {
+                _task.failed += requeue.size();
+                requeue.clear();
+            }
+
+            _task.requeued = requeue.size();
+            _task.deleted = _task.keys.size() - _task.failed - _task.requeued;
+        };
+
+        std::atomic<std::size_t> next_task{0};
+        auto run_tasks = [&] {
+            for (std::size_t i = next_task++; i < tasks.size(); i = next_task++) {
+                run_task(tasks[i]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        const std::size_t number_of_workers = std::min<std::size_t>(number_of_threads, tasks.size());
+        for (std::size_t i = 1; i < number_of_workers; ++i) {
+            try {
+                workers.emplace_back(run_tasks);
+            } catch (const std::system_error&) {
+                break;
+            }
+        }
+        run_tasks();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        std::uint64_t requeued = 0;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& t : tasks) {
+            keys_deleted_ += t.deleted;
+            keys_requeued_ += t.requeued;
+            keys_failed_ += t.failed;
+            requeued += t.requeued;
+        }
+
+        return requeued > 0;
+    } // end delete_chunk
+
+    auto delete_queue::to_json() const -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {
+            {"enabled", enabled_},
+            {"directory", directory_},
+            {"number_of_threads", number_of_threads_},
+            {"keys_queued", keys_queued_},
+            {"keys_cancelled", keys_cancelled_},
+            {"keys_deleted", keys_deleted_},
+            {"keys_requeued", keys_requeued_},
+            {"keys_failed", keys_failed_}
+        };
+    } // end to_json
+
+} // irods::experimental::io::s3_transport
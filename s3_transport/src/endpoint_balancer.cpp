@@ -0,0 +1,454 @@
+// local includes
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/admission_controller.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
+#include "irods/private/s3_transport/retry_policy.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <optional>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    bool is_endpoint_failure(S3Status _status)
+    {
+        switch (_status) {
+            case S3StatusNameLookupError:
+            case S3StatusFailedToConnect:
+            case S3StatusConnectionFailed:
+            case S3StatusErrorInternalError:
+            case S3StatusErrorRequestTimeout:
+            case S3StatusErrorServiceUnavailable:
+            case S3StatusHttpErrorUnknown:
+                return true;
+            default:
+                return false;
+        }
+    } // end is_endpoint_failure
+
+    auto endpoint_balancer::for_resource(const std::string& _resource_name) -> endpoint_balancer&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<endpoint_balancer>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& balancer = registry[_resource_name];
+        if (!balancer) {
+            balancer = std::make_unique<endpoint_balancer>();
+        }
+        return *balancer;
+    } // end for_resource
+
+    void endpoint_balancer::set_hosts(const std::vector<std::string>& _hosts)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::vector<host_state> hosts;
+        hosts.reserve(_hosts.size());
+        for (const auto& host : _hosts) {
+            if (auto* existing = find_host(host); existing) {
+                hosts.push_back(*existing);
+            } else {
+                host_state state;
+                state.host = host;
+                hosts.push_back(state);
+            }
+        }
+        hosts_ = std::move(hosts);
+
+        if (next_index_ >= hosts_.size()) {
+            next_index_ = 0;
+        }
+    } // end set_hosts
+
+    auto endpoint_balancer::choose_host(clock_type::time_point _now, bool _allow_probe) const -> std::size_t
+    {
+        std::optional<std::size_t> best;
+        double best_cost = std::numeric_limits<double>::max();
+
+        std::optional<std::size_t> earliest_ejected;
+
+        // Start the scan at next_index_ so that hosts with equal cost are used round robin.
+        for (std::size_t i = 0; i < hosts_.size(); ++i) {
+
+            const std::size_t index = (next_index_ + i) % hosts_.size();
+            const auto& state = hosts_[index];
+
+            if (state.ejected) {
+
+                // the first ejected host whose ejection period has expired gets a probe
+                if (_allow_probe && probe_due(state, _now)) {
+                    return index;
+                }
+
+                if (!earliest_ejected || state.ejected_until < hosts_[*earliest_ejected].ejected_until) {
+                    earliest_ejected = index;
+                }
+                continue;
+            }
+
+            // A host without any samples has a cost of zero so every host gets tried.  A host
+            // that has only failed has no latency sample, it must not look faster than the others.
+            const double latency_us = state.ewma_latency_us > 0.0 || state.requests == 0
+                                    ? state.ewma_latency_us
+                                    : FAILURE_PENALTY_US;
+            const double cost = (latency_us + FAILURE_PENALTY_US * state.ewma_failure_rate)
+                              * static_cast<double>(state.in_flight + 1);
+
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = index;
+            }
+        }
+
+        // every host is ejected, use the one that will come back first
+        return best ? *best : *earliest_ejected;
+    } // end choose_host
+
+    bool endpoint_balancer::probe_due(const host_state& _state, clock_type::time_point _now)
+    {
+        return _state.ejected && _now >= _state.ejected_until &&
+            (!_state.probe_in_flight || _now >= _state.probe_claimed_until);
+    } // end probe_due
+
+    auto endpoint_balancer::select_host() -> std::string
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (hosts_.empty()) {
+            return {};
+        }
+
+        const auto now = clock_type::now();
+
+        const std::size_t index = choose_host(now, true);
+        auto& state = hosts_[index];
+
+        if (state.ejected) {
+            // not due for a probe if every host is ejected and none is due
+            if (!probe_due(state, now)) {
+                return state.host;
+            }
+            state.probe_in_flight = true;
+            state.probe_claimed_until = now + PROBE_TIMEOUT;
+        }
+
+        next_index_ = (index + 1) % hosts_.size();
+        return state.host;
+    } // end select_host
+
+    auto endpoint_balancer::current_host() const -> std::string
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (hosts_.empty()) {
+            return {};
+        }
+
+        return hosts_[choose_host(clock_type::now(), false)].host;
+    } // end current_host
+
+    void endpoint_balancer::request_started(const std::string& _host)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto* state = find_host(_host);
+        if (!state) {
+            return;
+        }
+
+        ++state->in_flight;
+    } // end request_started
+
+    void endpoint_balancer::request_abandoned(const std::string& _host)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto* state = find_host(_host);
+        if (!state) {
+            return;
+        }
+
+        if (state->in_flight > 0) {
+            --state->in_flight;
+        }
+
+        // let another request probe the host
+        if (state->ejected) {
+            state->probe_in_flight = false;
+        }
+    } // end request_abandoned
+
+    void endpoint_balancer::request_cancelled(const std::string& _host, std::chrono::microseconds _elapsed)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto* state = find_host(_host);
+        if (!state) {
+            return;
+        }
+
+        if (state->in_flight > 0) {
+            --state->in_flight;
+        }
+
+        if (state->ejected) {
+            state->probe_in_flight = false;
+            return;
+        }
+
+        // only a lower bound, it may only make the host look slower
+        const auto elapsed_us = static_cast<double>(_elapsed.count());
+        if (elapsed_us > state->ewma_latency_us) {
+            state->ewma_latency_us = state->ewma_latency_us == 0.0
+                                   ? elapsed_us
+                                   : (1.0 - EWMA_WEIGHT) * state->ewma_latency_us + EWMA_WEIGHT * elapsed_us;
+        }
+    } // end request_cancelled
+
+    void endpoint_balancer::request_finished(const std::string& _host,
+                                             bool _success,
+                                             std::chrono::microseconds _elapsed,
+                                             std::int64_t _bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto* state = find_host(_host);
+        if (!state) {
+            return;
+        }
+
+        if (state->in_flight > 0) {
+            --state->in_flight;
+        }
+        ++state->requests;
+
+        state->ewma_failure_rate = (1.0 - EWMA_WEIGHT) * state->ewma_failure_rate + EWMA_WEIGHT * (_success ? 0.0 : 1.0);
+
+        if (_success) {
+            // the time taken per LATENCY_REFERENCE_BYTES of a large transfer
+            auto elapsed_us = static_cast<double>(_elapsed.count());
+            if (_bytes > LATENCY_REFERENCE_BYTES) {
+                elapsed_us *= static_cast<double>(LATENCY_REFERENCE_BYTES) / static_cast<double>(_bytes);
+            }
+            state->ewma_latency_us = state->ewma_latency_us == 0.0
+                                   ? elapsed_us
+                                   : (1.0 - EWMA_WEIGHT) * state->ewma_latency_us + EWMA_WEIGHT * elapsed_us;
+
+            if (state->ejected) {
+                logger::info("{}:{} ({}) host [{}] is back in rotation after a successful probe",
+                        __FILE__, __LINE__, __func__, state->host);
+            }
+
+            state->consecutive_failures = 0;
+            state->ejected = false;
+            state->probe_in_flight = false;
+            state->ejection_time = INITIAL_EJECTION_TIME;
+            return;
+        }
+
+        ++state->failures;
+        ++state->consecutive_failures;
+
+        if (state->ejected) {
+            // the probe failed, wait longer before the next one
+            state->ejection_time = std::min(state->ejection_time * 2, MAXIMUM_EJECTION_TIME);
+            state->ejected_until = clock_type::now() + state->ejection_time;
+            state->probe_in_flight = false;
+        } else if (state->consecutive_failures >= EJECT_AFTER_CONSECUTIVE_FAILURES && hosts_.size() > 1) {
+            state->ejected = true;
+            ++state->ejections;
+            state->ejected_until = clock_type::now() + state->ejection_time;
+            logger::warn("{}:{} ({}) host [{}] ejected for {} ms after {} consecutive failures",
+                    __FILE__, __LINE__, __func__, state->host, state->ejection_time.count(),
+                    state->consecutive_failures);
+        }
+    } // end request_finished
+
+    auto endpoint_balancer::statistics() const -> std::vector<host_statistics>
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        const auto now = clock_type::now();
+
+        std::vector<host_statistics> statistics;
+        statistics.reserve(hosts_.size());
+        for (const auto& state : hosts_) {
+            host_statistics host;
+            host.host = state.host;
+            host.ewma_latency_us = state.ewma_latency_us;
+            host.ewma_failure_rate = state.ewma_failure_rate;
+            host.in_flight = state.in_flight;
+            host.requests = state.requests;
+            host.failures = state.failures;
+            host.ejections = state.ejections;
+            host.consecutive_failures = state.consecutive_failures;
+            host.ejected = state.ejected;
+            host.ejected_for_ms = state.ejected && state.ejected_until > now
+                ? std::chrono::duration_cast<std::chrono::milliseconds>(state.ejected_until - now).count()
+                : 0;
+            statistics.push_back(std::move(host));
+        }
+
+        return statistics;
+    } // end statistics
+
+    bool endpoint_balancer::degraded() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        return std::any_of(hosts_.begin(), hosts_.end(),
+                [](const host_state& _state) { return _state.failures > 0 || _state.ejections > 0; });
+    } // end degraded
+
+    auto endpoint_balancer::to_json() const -> nlohmann::json
+    {
+        auto hosts = nlohmann::json::array();
+        for (const auto& host : statistics()) {
+            hosts.push_back({
+                {"host", host.host},
+                {"ewma_latency_us", host.ewma_latency_us},
+                {"ewma_failure_rate", host.ewma_failure_rate},
+                {"in_flight", host.in_flight},
+                {"requests", host.requests},
+                {"failures", host.failures},
+                {"ejections", host.ejections},
+                {"consecutive_failures", host.consecutive_failures},
+                {"ejected", host.ejected},
+                {"ejected_for_ms", host.ejected_for_ms}
+            });
+        }
+
+        return hosts;
+    } // end to_json
+
+    auto endpoint_balancer::find_host(const std::string& _host) -> host_state*
+    {
+        auto iter = std::find_if(hosts_.begin(), hosts_.end(),
+                [&_host](const host_state& _state) { return _state.host == _host; });
+        return iter == hosts_.end() ? nullptr : &*iter;
+    } // end find_host
+
+    namespace
+    {
+        // Waits for the request rate limits before taking an admission slot so that
+        // a request held back by the rate limit does not occupy a slot on the host.
+        bool acquire_request_slot(const std::string& _resource_name,
+                                  const std::string& _host,
+                                  const std::string& _user_name)
+        {
+            rate_limiter::for_resource(_resource_name).acquire_request(_user_name);
+            return admission_controller::for_resource(_resource_name).acquire(_host);
+        }
+    }
+
+    endpoint_request::endpoint_request(const std::string& _resource_name,
+                                       const std::string& _host,
+                                       const std::string& _user_name)
+        : endpoint_request{_resource_name, _host, _user_name,
+                           acquire_request_slot(_resource_name, _host, _user_name)}
+    {
+    }
+
+    endpoint_request::endpoint_request(const std::string& _resource_name,
+                                       const std::string& _host,
+                                       const std::string& _user_name,
+                                       bool _admission_acquired)
+        : resource_name_{_resource_name}
+        , balancer_{endpoint_balancer::for_resource(_resource_name)}
+        , host_{_host}
+        , user_name_{_user_name}
+        , admission_acquired_{_admission_acquired}
+        , start_{std::chrono::steady_clock::now()}
+        , finished_{false}
+    {
+        balancer_.request_started(host_);
+    }
+
+    auto endpoint_request::try_start(const std::string& _resource_name,
+                                     const std::string& _host,
+                                     const std::string& _user_name) -> std::unique_ptr<endpoint_request>
+    {
+        auto& admission = admission_controller::for_resource(_resource_name);
+
+        const auto admission_acquired = admission.try_acquire(_host);
+        if (!admission_acquired) {
+            return nullptr;
+        }
+
+        if (!rate_limiter::for_resource(_resource_name).try_acquire_request(_user_name)) {
+            if (*admission_acquired) {
+                // neither a success nor throttling, the limit of the host is left alone
+                admission.release(_host, S3StatusInterrupted);
+            }
+            return nullptr;
+        }
+
+        return std::unique_ptr<endpoint_request>{
+            new endpoint_request{_resource_name, _host, _user_name, *admission_acquired}};
+    } // end try_start
+
+    endpoint_request::~endpoint_request()
+    {
+        // Not finished (e.g. an exception was thrown).  Release the in flight
+        // count without recording a failure or a success against the host.
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        balancer_.request_abandoned(host_);
+
+        // neither a success nor throttling, the limit of the host is left alone
+        if (admission_acquired_) {
+            admission_controller::for_resource(resource_name_).release(host_, S3StatusInterrupted);
+        }
+    }
+
+    void endpoint_request::finish(S3Status _status, std::int64_t _bytes)
+    {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_);
+        balancer_.request_finished(host_, !is_endpoint_failure(_status), elapsed, _bytes);
+
+        if (admission_acquired_) {
+            admission_controller::for_resource(resource_name_).release(host_, _status);
+        }
+
+        if (_status == S3StatusOK) {
+            retry_budget::for_resource(resource_name_).record_success();
+        }
+    }
+
+    void endpoint_request::cancel()
+    {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start_);
+        balancer_.request_cancelled(host_, elapsed);
+
+        // neither a success nor throttling, the limit of the host is left alone
+        if (admission_acquired_) {
+            admission_controller::for_resource(resource_name_).release(host_, S3StatusInterrupted);
+        }
+    }
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,545 @@
+// local includes
+#include "irods/private/s3_transport/hedged_get.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/library_lifecycle.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// boost includes
+#include <boost/interprocess/exceptions.hpp>
+
+// stdlib includes
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <vector>
+
+// system includes
+#include <sys/select.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        constexpr std::size_t HEDGE_SHMEM_SIZE{100*sizeof(void*) + sizeof(shared_data::hedge_table) + 4096};
+    }
+
+    auto hedge_controller::for_resource(const std::string& _resource_name) -> hedge_controller&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<hedge_controller>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& controller = registry[_resource_name];
+        if (!controller) {
+            controller = std::make_unique<hedge_controller>(_resource_name);
+        }
+        return *controller;
+    } // end for_resource
+
+    hedge_controller::hedge_controller(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , local_statistics_{std::make_unique<shared_data::hedge_statistics>()}
+    {
+    }
+
+    template <typename Function>
+    auto hedge_controller::with_statistics(Function _function) const
+    {
+        if (auto* table = shared_table_.get(); table) {
+            shared_data::robust_lock table_lock(table->mutex);
+            shared_table_.attach_if_forked();
+            return _function(table->statistics);
+        }
+        return _function(*local_statistics_);
+    } // end with_statistics
+
+    void hedge_controller::configure(bool _enabled, double _percentile, double _maximum_hedge_ratio)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        enabled_ = _enabled;
+        percentile_ = std::clamp(_percentile, 1.0, 100.0);
+        maximum_hedge_ratio_ = std::clamp(_maximum_hedge_ratio, 0.0, 1.0);
+
+        if (enabled_ && !shared_table_.get()) {
+            const std::string shmem_key = SHARED_MEMORY_KEY_PREFIX +
+                std::to_string(std::hash<std::string>{}(resource_name_));
+            try {
+                shared_table_.open(shmem_key, HEDGE_SHMEM_SIZE);
+            } catch (const boost::interprocess::interprocess_exception& e) {
+                logger::warn("{}:{} ({}) [resource_name={}] failed to map hedged read shared memory, "
+                        "the hedge delay and cap apply to each agent separately.  {}", __FILE__, __LINE__, __func__,
+                        resource_name_, e.what());
+            }
+        }
+
+        with_statistics([this](shared_data::hedge_statistics& _statistics) { recalculate_delay(_statistics); });
+    } // end configure
+
+    bool hedge_controller::enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return enabled_;
+    } // end enabled
+
+    auto hedge_controller::hedge_delay() const -> std::optional<std::chrono::microseconds>
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_) {
+            return std::nullopt;
+        }
+        return with_statistics([](shared_data::hedge_statistics& _statistics) -> std::optional<std::chrono::microseconds> {
+            if (!_statistics.has_delay) {
+                return std::nullopt;
+            }
+            return std::chrono::microseconds{_statistics.delay_us};
+        });
+    } // end hedge_delay
+
+    void hedge_controller::record_request()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        with_statistics([this](shared_data::hedge_statistics& _statistics) {
+            ++_statistics.requests;
+            _statistics.tokens = std::min(MAXIMUM_BURST, _statistics.tokens + maximum_hedge_ratio_);
+        });
+    } // end record_request
+
+    void hedge_controller::record_first_byte(std::chrono::microseconds _elapsed)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        with_statistics([this, _elapsed](shared_data::hedge_statistics& _statistics) {
+            _statistics.samples[_statistics.next_sample] = _elapsed.count();
+            _statistics.next_sample = (_statistics.next_sample + 1) % SAMPLE_COUNT;
+            _statistics.sample_count = std::min(SAMPLE_COUNT, _statistics.sample_count + 1);
+
+            if (++_statistics.samples_since_recalculation >= SAMPLES_PER_RECALCULATION || !_statistics.has_delay) {
+                recalculate_delay(_statistics);
+            }
+        });
+    } // end record_first_byte
+
+    bool hedge_controller::try_start_hedge()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return with_statistics([](shared_data::hedge_statistics& _statistics) {
+            if (_statistics.tokens < 1.0) {
+                return false;
+            }
+            _statistics.tokens -= 1.0;
+            ++_statistics.hedges;
+            return true;
+        });
+    } // end try_start_hedge
+
+    void hedge_controller::cancel_hedge()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        with_statistics([](shared_data::hedge_statistics& _statistics) {
+            _statistics.tokens = std::min(MAXIMUM_BURST, _statistics.tokens + 1.0);
+            if (_statistics.hedges > 0) {
+                --_statistics.hedges;
+            }
+        });
+    } // end cancel_hedge
+
+    void hedge_controller::record_hedge_won()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        with_statistics([](shared_data::hedge_statistics& _statistics) { ++_statistics.hedges_won; });
+    } // end record_hedge_won
+
+    void hedge_controller::detach()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shared_table_.detach();
+    } // end detach
+
+    auto hedge_controller::to_json() const -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return with_statistics([this](shared_data::hedge_statistics& _statistics) -> nlohmann::json {
+            return {
+                {"enabled", enabled_},
+                {"hedge_delay_us", _statistics.has_delay ? _statistics.delay_us : 0},
+                {"requests", _statistics.requests},
+                {"hedges", _statistics.hedges},
+                {"hedges_won", _statistics.hedges_won},
+                {"shared", shared_table_.get() != nullptr}
+            };
+        });
+    } // end to_json
+
+    // mutex_ and the lock of the statistics must be held
+    void hedge_controller::recalculate_delay(shared_data::hedge_statistics& _statistics) const
+    {
+        _statistics.samples_since_recalculation = 0;
+
+        if (_statistics.sample_count < MINIMUM_SAMPLES) {
+            _statistics.has_delay = false;
+            return;
+        }
+
+        std::vector<std::int64_t> sorted(_statistics.samples, _statistics.samples + _statistics.sample_count);
+        const auto index = std::min(sorted.size() - 1,
+                static_cast<std::size_t>(percentile_ / 100.0 * static_cast<double>(sorted.size())));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        _statistics.delay_us = sorted[index];
+        _statistics.has_delay = true;
+    } // end recalculate_delay
+
+    namespace
+    {
+        using clock_type = std::chrono::steady_clock;
+
+        struct hedged_get_state;
+
+        // One of the (at most two) requests sent for a hedged GET.  Index 0 is the
+        // original request and index 1 the hedge.
+        struct hedge_arm
+        {
+            hedged_get_state*         state{nullptr};
+            int                       index{0};
+            std::string               host;
+            S3BucketContext           bucket_context{};
+            S3RequestContext*         request_context{nullptr};
+            clock_type::time_point    start{};
+            std::chrono::microseconds elapsed{0};
+            bool                      started{false};
+            bool                      done{false};
+            bool                      cancelled{false};
+            S3Status                  status{S3StatusOK};
+
+            bool pending() const { return started && !done && request_context; }
+        };
+
+        struct hedged_get_state
+        {
+            std::string               resource_name;
+            const S3GetObjectHandler* handler{nullptr};
+            void*                     callback_data{nullptr};
+            hedge_controller*         controller{nullptr};
+            int                       winner{-1};
+            bool                      properties_forwarded{false};
+            bool                      completion_forwarded{false};
+            hedge_arm                 arms[2];
+        };
+
+        S3Status on_response_properties(const S3ResponseProperties* _properties, void* _callback_data)
+        {
+            auto* arm = static_cast<hedge_arm*>(_callback_data);
+            auto& state = *arm->state;
+
+            if (state.winner != -1 && state.winner != arm->index) {
+                return S3StatusAbortedByCallback;
+            }
+
+            // Both requests are for the same range so only the first set of properties is passed on.
+            if (state.properties_forwarded || !state.handler->responseHandler.propertiesCallback) {
+                return S3StatusOK;
+            }
+            state.properties_forwarded = true;
+            return state.handler->responseHandler.propertiesCallback(_properties, state.callback_data);
+        }
+
+        S3Status on_data(int _buffer_size, const char* _buffer, void* _callback_data)
+        {
+            auto* arm = static_cast<hedge_arm*>(_callback_data);
+            auto& state = *arm->state;
+
+            // The first request to receive data wins
+            if (state.winner == -1) {
+                state.winner = arm->index;
+                state.controller->record_first_byte(
+                        std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - arm->start));
+                if (arm->index == 1) {
+                    state.controller->record_hedge_won();
+                }
+            }
+
+            if (state.winner != arm->index) {
+                return S3StatusAbortedByCallback;
+            }
+
+            return state.handler->getObjectDataCallback(_buffer_size, _buffer, state.callback_data);
+        }
+
+        void on_response_completion(S3Status _status, const S3ErrorDetails* _error, void* _callback_data)
+        {
+            auto* arm = static_cast<hedge_arm*>(_callback_data);
+            auto& state = *arm->state;
+
+            arm->done = true;
+            arm->status = _status;
+            arm->elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - arm->start);
+
+            if (state.completion_forwarded) {
+                return;
+            }
+
+            const auto& other = state.arms[1 - arm->index];
+
+            // Pass on the completion of the winner.  If there is no winner yet, a failure
+            // is only passed on if the other request can no longer succeed.
+            const bool forward = state.winner == arm->index ||
+                (state.winner == -1 && (_status == S3StatusOK || !other.pending()));
+
+            if (!forward) {
+                logger::debug("{}:{} ({}) [resource_name={}] {} request to host [{}] finished with [{}], "
+                        "waiting for the other request", __FILE__, __LINE__, __func__, state.resource_name,
+                        arm->index == 0 ? "original" : "hedged", arm->host, S3_get_status_name(_status));
+                return;
+            }
+
+            if (state.winner == -1) {
+                state.winner = arm->index;
+            }
+            state.completion_forwarded = true;
+            state.handler->responseHandler.completeCallback(_status, _error, state.callback_data);
+        }
+
+        bool start_arm(hedge_arm& _arm,
+                       const std::string& _key,
+                       std::uint64_t _offset,
+                       std::uint64_t _length,
+                       S3GetObjectHandler& _arm_handler)
+        {
+            if (S3_create_request_context(&_arm.request_context) != S3StatusOK) {
+                _arm.request_context = nullptr;
+                return false;
+            }
+
+            _arm.bucket_context.hostName = _arm.host.c_str();
+            _arm.start = clock_type::now();
+            _arm.started = true;
+
+            S3_get_object(&_arm.bucket_context, _key.c_str(), nullptr, _offset, _length,
+                    _arm.request_context, 0, &_arm_handler, &_arm);
+            return true;
+        }
+
+        // Passes the callbacks of an unhedged GET on, keeping its status.
+        struct unhedged_get
+        {
+            const S3GetObjectHandler* handler{nullptr};
+            void*                     callback_data{nullptr};
+            S3Status                  status{S3StatusOK};
+        };
+
+        S3Status on_unhedged_properties(const S3ResponseProperties* _properties, void* _callback_data)
+        {
+            auto* get = static_cast<unhedged_get*>(_callback_data);
+            if (!get->handler->responseHandler.propertiesCallback) {
+                return S3StatusOK;
+            }
+            return get->handler->responseHandler.propertiesCallback(_properties, get->callback_data);
+        }
+
+        S3Status on_unhedged_data(int _buffer_size, const char* _buffer, void* _callback_data)
+        {
+            auto* get = static_cast<unhedged_get*>(_callback_data);
+            return get->handler->getObjectDataCallback(_buffer_size, _buffer, get->callback_data);
+        }
+
+        void on_unhedged_completion(S3Status _status, const S3ErrorDetails* _error, void* _callback_data)
+        {
+            auto* get = static_cast<unhedged_get*>(_callback_data);
+            get->status = _status;
+            get->handler->responseHandler.completeCallback(_status, _error, get->callback_data);
+        }
+
+        void get_object_unhedged(endpoint_request&         _endpoint,
+                                 const S3BucketContext&    _bucket_context,
+                                 const std::string&        _key,
+                                 std::uint64_t             _offset,
+                                 std::uint64_t             _length,
+                                 const S3GetObjectHandler& _handler,
+                                 void*                     _callback_data)
+        {
+            unhedged_get get{&_handler, _callback_data};
+            S3GetObjectHandler handler = { { on_unhedged_properties, on_unhedged_completion }, on_unhedged_data };
+
+            S3_get_object(&_bucket_context, _key.c_str(), nullptr, _offset, _length, nullptr, 0, &handler, &get);
+            _endpoint.finish(get.status, static_cast<std::int64_t>(_length));
+        }
+    } // end anonymous namespace
+
+    void hedged_get_object(const std::string&         _resource_name,
+                           endpoint_request&          _endpoint,
+                           const S3BucketContext&     _bucket_context,
+                           const std::string&         _key,
+                           std::uint64_t              _offset,
+                           std::uint64_t              _length,
+                           const S3GetObjectHandler&  _handler,
+                           void*                      _callback_data)
+    {
+        // the request contexts of both requests are destroyed before the library may be
+        const library_lifecycle::usage usage;
+
+        auto& controller = hedge_controller::for_resource(_resource_name);
+
+        if (!controller.enabled()) {
+            get_object_unhedged(_endpoint, _bucket_context, _key, _offset, _length, _handler, _callback_data);
+            return;
+        }
+
+        controller.record_request();
+        const auto delay = controller.hedge_delay();
+
+        hedged_get_state state;
+        state.resource_name = _resource_name;
+        state.handler = &_handler;
+        state.callback_data = _callback_data;
+        state.controller = &controller;
+
+        for (int i = 0; i < 2; ++i) {
+            state.arms[i].state = &state;
+            state.arms[i].index = i;
+            state.arms[i].bucket_context = _bucket_context;
+        }
+
+        auto& original = state.arms[0];
+        auto& hedge = state.arms[1];
+
+        S3GetObjectHandler arm_handler = { { on_response_properties, on_response_completion }, on_data };
+
+        original.host = _bucket_context.hostName ? _bucket_context.hostName : "";
+        if (!start_arm(original, _key, _offset, _length, arm_handler)) {
+            get_object_unhedged(_endpoint, _bucket_context, _key, _offset, _length, _handler, _callback_data);
+            return;
+        }
+
+        // Without a delay (not enough samples yet) the request is not hedged
+        bool hedge_considered = !delay;
+
+        // tracks the hedge against its host once it is sent
+        std::unique_ptr<endpoint_request> hedge_endpoint;
+
+        while (original.pending() || hedge.pending()) {
+
+            const auto now = clock_type::now();
+
+            if (!hedge_considered && now - original.start >= *delay) {
+                hedge_considered = true;
+
+                if (state.winner == -1 && !original.done && controller.try_start_hedge()) {
+                    // a hedge is never a probe of an ejected host
+                    hedge.host = endpoint_balancer::for_resource(_resource_name).current_host();
+                    if (hedge.host.empty()) {
+                        hedge.host = original.host;
+                    }
+
+                    // The hedge is subject to the same rate limits and admission slots as any
+                    // other request, but it is only worth sending if it can go right away.
+                    hedge_endpoint = endpoint_request::try_start(_resource_name, hedge.host, _endpoint.user_name());
+                    if (!hedge_endpoint) {
+                        controller.cancel_hedge();
+                        logger::debug("{}:{} ({}) [resource_name={}] no data from host [{}] for [{}] after {} us, "
+                                "not hedging as no request to host [{}] may be sent now", __FILE__, __LINE__, __func__,
+                                _resource_name, original.host, _key, delay->count(), hedge.host);
+                    } else {
+                        logger::debug("{}:{} ({}) [resource_name={}] no data from host [{}] for [{}] after {} us, "
+                                "sending hedged request to host [{}]", __FILE__, __LINE__, __func__, _resource_name,
+                                original.host, _key, delay->count(), hedge.host);
+
+                        if (!start_arm(hedge, _key, _offset, _length, arm_handler)) {
+                            hedge_endpoint.reset();
+                        }
+                    }
+                }
+            }
+
+            fd_set read_fds;
+            fd_set write_fds;
+            fd_set except_fds;
+            FD_ZERO(&read_fds);
+            FD_ZERO(&write_fds);
+            FD_ZERO(&except_fds);
+
+            int max_fd = -1;
+            std::int64_t timeout_ms = 100;
+
+            for (auto& arm : state.arms) {
+                if (!arm.pending()) {
+                    continue;
+                }
+                int arm_max_fd = -1;
+                S3_get_request_context_fdsets(arm.request_context, &read_fds, &write_fds, &except_fds, &arm_max_fd);
+                max_fd = std::max(max_fd, arm_max_fd);
+
+                const auto arm_timeout_ms = S3_get_request_context_timeout(arm.request_context);
+                if (arm_timeout_ms >= 0) {
+                    timeout_ms = std::min(timeout_ms, arm_timeout_ms);
+                }
+            }
+
+            if (!hedge_considered) {
+                const auto until_hedge = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        original.start + *delay - now).count();
+                timeout_ms = std::min<std::int64_t>(timeout_ms, std::max<std::int64_t>(until_hedge, 0));
+            }
+
+            // Before curl has opened any sockets there is nothing to wait on.  Sleep
+            // briefly rather than spinning.
+            if (max_fd == -1) {
+                timeout_ms = std::min<std::int64_t>(timeout_ms, 1);
+            }
+
+            struct timeval tv = { static_cast<time_t>(timeout_ms / 1000),
+                                  static_cast<suseconds_t>((timeout_ms % 1000) * 1000) };
+            select(max_fd + 1, &read_fds, &write_fds, &except_fds, &tv);
+
+            for (auto& arm : state.arms) {
+                if (!arm.pending()) {
+                    continue;
+                }
+                int requests_remaining = 0;
+                if (S3_runonce_request_context(arm.request_context, &requests_remaining) != S3StatusOK) {
+                    // aborts the request, calling the completion callback with S3StatusInterrupted
+                    S3_destroy_request_context(arm.request_context);
+                    arm.request_context = nullptr;
+                }
+            }
+
+            // cancel the loser
+            if (state.winner != -1) {
+                auto& loser = state.arms[1 - state.winner];
+                if (loser.pending()) {
+                    loser.cancelled = true;
+                    S3_destroy_request_context(loser.request_context);
+                    loser.request_context = nullptr;
+                }
+            }
+        }
+
+        for (auto& arm : state.arms) {
+            if (arm.request_context) {
+                S3_destroy_request_context(arm.request_context);
+                arm.request_context = nullptr;
+            }
+        }
+
+        // Each request is credited to the host it was sent to with its own result.
+        // The loser did not fail, it was only slower.
+        if (original.cancelled) {
+            _endpoint.cancel();
+        } else {
+            _endpoint.finish(original.status, static_cast<std::int64_t>(_length));
+        }
+
+        if (hedge_endpoint) {
+            if (hedge.cancelled) {
+                hedge_endpoint->cancel();
+            } else {
+                hedge_endpoint->finish(hedge.status, static_cast<std::int64_t>(_length));
+            }
+        }
+    } // end hedged_get_object
+
+} // irods::experimental::io::s3_transport
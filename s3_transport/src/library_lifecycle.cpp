@@ -0,0 +1,183 @@
+// local includes
+#include "irods/private/s3_transport/library_lifecycle.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// stdlib includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        struct library_state
+        {
+            std::mutex        mutex;
+            std::atomic<bool> initialized{false};
+            std::size_t       references{0};
+
+            // requires mutex
+            std::uint64_t                                  next_hook_id{0};
+            std::map<std::uint64_t, std::function<void()>> stop_hooks;
+
+            // Usages have a mutex of their own, the threads joined by the stop
+            // hooks end their usages while mutex is held.
+            std::mutex              usage_mutex;
+            std::condition_variable usage_cv;
+            std::size_t             usages{0};
+
+            // statistics
+            std::uint64_t     initializations{0};
+            std::uint64_t     failed_initializations{0};
+
+            // deinitializes the library at process exit if a resource did not stop
+            ~library_state()
+            {
+                if (initialized) {
+                    S3_deinitialize();
+                }
+            }
+        };
+
+        auto state() -> library_state&
+        {
+            static library_state instance;
+            return instance;
+        }
+
+        // Requires the mutex of _state.
+        auto initialize_locked(library_state& _state, const std::string& _default_hostname) -> S3Status
+        {
+            if (_state.initialized) {
+                return S3StatusOK;
+            }
+
+            const S3Status status = S3_initialize("s3", S3_INIT_ALL,
+                    _default_hostname.empty() ? nullptr : _default_hostname.c_str());
+            if (status != S3StatusOK) {
+                ++_state.failed_initializations;
+                logger::error("{}:{} ({}) failed to initialize the S3 library - {}",
+                        __FILE__, __LINE__, __func__, S3_get_status_name(status));
+                return status;
+            }
+
+            ++_state.initializations;
+            _state.initialized = true;
+            logger::debug("{}:{} ({}) initialized the S3 library", __FILE__, __LINE__, __func__);
+            return status;
+        } // end initialize_locked
+    } // end anonymous namespace
+
+    library_lifecycle::usage::usage()
+    {
+        library_state& s = state();
+        std::lock_guard<std::mutex> lock(s.usage_mutex);
+        ++s.usages;
+    }
+
+    library_lifecycle::usage::~usage()
+    {
+        library_state& s = state();
+        {
+            std::lock_guard<std::mutex> lock(s.usage_mutex);
+            --s.usages;
+        }
+        s.usage_cv.notify_all();
+    }
+
+    auto library_lifecycle::acquire(const std::string& _resource_name, const std::string& _default_hostname) -> S3Status
+    {
+        library_state& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        const S3Status status = initialize_locked(s, _default_hostname);
+        if (status == S3StatusOK) {
+            ++s.references;
+        }
+        return status;
+    } // end acquire
+
+    void library_lifecycle::release(const std::string& _resource_name)
+    {
+        library_state& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        // a resource whose start failed has no hold to release
+        if (s.references == 0) {
+            return;
+        }
+
+        if (--s.references > 0 || !s.initialized) {
+            return;
+        }
+
+        logger::debug("{}:{} ({}) [resource_name={}] stopping {} workers before deinitializing the S3 library",
+                __FILE__, __LINE__, __func__, _resource_name, s.stop_hooks.size());
+        for (auto& [id, stop] : s.stop_hooks) {
+            stop();
+        }
+
+        {
+            std::unique_lock<std::mutex> usage_lock(s.usage_mutex);
+            s.usage_cv.wait(usage_lock, [&s] { return s.usages == 0; });
+        }
+
+        s.initialized = false;
+        S3_deinitialize();
+        logger::debug("{}:{} ({}) deinitialized the S3 library", __FILE__, __LINE__, __func__);
+    } // end release
+
+    auto library_lifecycle::add_stop_hook(std::function<void()> _stop) -> std::uint64_t
+    {
+        library_state& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        const std::uint64_t id = s.next_hook_id++;
+        s.stop_hooks.emplace(id, std::move(_stop));
+        return id;
+    } // end add_stop_hook
+
+    void library_lifecycle::remove_stop_hook(std::uint64_t _id)
+    {
+        library_state& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.stop_hooks.erase(_id);
+    } // end remove_stop_hook
+
+    auto library_lifecycle::initialize(const std::string& _default_hostname) -> S3Status
+    {
+        library_state& s = state();
+        if (s.initialized) {
+            return S3StatusOK;
+        }
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return initialize_locked(s, _default_hostname);
+    } // end initialize
+
+    bool library_lifecycle::initialized()
+    {
+        return state().initialized;
+    } // end initialized
+
+    auto library_lifecycle::to_json() -> nlohmann::json
+    {
+        library_state& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        return {
+            {"initialized", s.initialized.load()},
+            {"references", s.references},
+            {"stop_hooks", s.stop_hooks.size()},
+            {"initializations", s.initializations},
+            {"failed_initializations", s.failed_initializations}
+        };
+    } // end to_json
+
+} // irods::experimental::io::s3_transport
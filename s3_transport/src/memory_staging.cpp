@@ -0,0 +1,225 @@
+// local includes
+#include "irods/private/s3_transport/memory_staging.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <cerrno>
+#include <cstring>
+
+// boost includes
+#include <boost/filesystem.hpp>
+
+// system includes
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport::memory_staging
+{
+    namespace log  = irods::experimental::log;
+    namespace bf   = boost::filesystem;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        const std::string LOCK_FILE{".lock"};
+
+        auto directory_of(const std::string& _directory, const std::string& _resource_name) -> bf::path
+        {
+            return bf::path{_directory} / DIRECTORY_NAME / _resource_name;
+        }
+
+        // Holds an exclusive lock on the lock file of a staging directory, which
+        // serializes the reservations of all threads and agents of a resource.
+        class directory_lock
+        {
+          public:
+            explicit directory_lock(const bf::path& _directory)
+                : fd_{::open((_directory / LOCK_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)}
+                , locked_{false}
+            {
+                if (fd_ >= 0) {
+                    int result = 0;
+                    do {
+                        result = ::flock(fd_, LOCK_EX);
+                    } while (result == -1 && errno == EINTR);
+                    locked_ = result == 0;
+                }
+            }
+
+            ~directory_lock()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+
+            directory_lock(const directory_lock&) = delete;
+            auto operator=(const directory_lock&) -> directory_lock& = delete;
+
+            bool locked() const { return locked_; }
+
+          private:
+            int  fd_;
+            bool locked_;
+
+        }; // directory_lock
+
+        bool lock(int _fd, int _lock_operation)
+        {
+            int result = 0;
+            do {
+                result = ::flock(_fd, _lock_operation);
+            } while (result == -1 && errno == EINTR);
+            return result == 0;
+        }
+
+        // True if no open of a staged object holds the file at _path.
+        bool unheld(const bf::path& _path)
+        {
+            const int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return false;
+            }
+            const bool result = lock(fd, LOCK_EX | LOCK_NB);
+            ::close(fd);
+            return result;
+        }
+
+    } // namespace
+
+    file_lock::file_lock(const std::string& _path)
+        : fd_{::open(_path.c_str(), O_RDONLY | O_CLOEXEC)}
+    {
+        if (fd_ >= 0 && !lock(fd_, LOCK_SH)) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    file_lock::~file_lock()
+    {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    file_lock::file_lock(file_lock&& _other) noexcept
+        : fd_{_other.fd_}
+    {
+        _other.fd_ = -1;
+    }
+
+    auto file_lock::operator=(file_lock&& _other) noexcept -> file_lock&
+    {
+        if (this != &_other) {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+            fd_ = _other.fd_;
+            _other.fd_ = -1;
+        }
+        return *this;
+    }
+
+    auto path(const std::string& _directory,
+              const std::string& _resource_name,
+              const std::string& _name) -> std::string
+    {
+        return (directory_of(_directory, _resource_name) / _name).string();
+    } // end path
+
+    auto reserve(const std::string& _directory,
+                 const std::string& _resource_name,
+                 const std::string& _name,
+                 std::int64_t       _size,
+                 std::int64_t       _budget) -> file_lock
+    {
+        if (_size <= 0 || _size > _budget) {
+            return {};
+        }
+
+        const bf::path directory = directory_of(_directory, _resource_name);
+
+        boost::system::error_code ec;
+        bf::create_directories(directory, ec);
+        if (ec) {
+            logger::warn("{}:{} ({}) [resource_name={}] could not create the staging directory {}, "
+                    "staging in the cache directory - {}", __FILE__, __LINE__, __func__,
+                    _resource_name, directory.string(), ec.message());
+            return {};
+        }
+
+        const directory_lock lock{directory};
+        if (!lock.locked()) {
+            logger::warn("{}:{} ({}) [resource_name={}] could not lock the staging directory {}, "
+                    "staging in the cache directory - {}", __FILE__, __LINE__, __func__,
+                    _resource_name, directory.string(), std::strerror(errno));
+            return {};
+        }
+
+        const bf::path file = directory / _name;
+        const auto oldest = std::chrono::system_clock::now() - STALE_AGE;
+
+        std::int64_t reserved = 0;
+        for (bf::directory_iterator iter{directory, ec}, end; !ec && iter != end; iter.increment(ec)) {
+
+            const bf::path& entry = iter->path();
+            if (entry.filename() == LOCK_FILE || entry == file) {
+                continue;
+            }
+
+            struct stat st{};
+            if (::stat(entry.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+
+            // a long flush does not write the file, so a file that an open holds is not stale however old
+            if (std::chrono::system_clock::from_time_t(st.st_mtime) < oldest && unheld(entry)) {
+                logger::info("{}:{} ({}) [resource_name={}] removing the stale staging file {}",
+                        __FILE__, __LINE__, __func__, _resource_name, entry.string());
+                ::unlink(entry.c_str());
+                continue;
+            }
+
+            reserved += st.st_size;
+        }
+
+        if (reserved + _size > _budget) {
+            logger::debug("{}:{} ({}) [resource_name={}] {} bytes do not fit in the staging budget "
+                    "[reserved={}][budget={}]", __FILE__, __LINE__, __func__, _resource_name, _size, reserved, _budget);
+            return {};
+        }
+
+        // The file is sized now so that the space counts against the budget
+        // before it is written.  It is sparse until the parts are written.
+        const int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0 || ::ftruncate(fd, _size) != 0) {
+            logger::warn("{}:{} ({}) [resource_name={}] could not create the staging file {}, "
+                    "staging in the cache directory - {}", __FILE__, __LINE__, __func__,
+                    _resource_name, file.string(), std::strerror(errno));
+            if (fd >= 0) {
+                ::close(fd);
+                ::unlink(file.c_str());
+            }
+            return {};
+        }
+        ::close(fd);
+
+        // locked before the directory lock is released so that it is never seen unheld
+        file_lock staging_lock{file.string()};
+        if (!staging_lock.held()) {
+            logger::warn("{}:{} ({}) [resource_name={}] could not lock the staging file {}, "
+                    "staging in the cache directory - {}", __FILE__, __LINE__, __func__,
+                    _resource_name, file.string(), std::strerror(errno));
+            ::unlink(file.c_str());
+        }
+
+        return staging_lock;
+    } // end reserve
+
+} // irods::experimental::io::s3_transport::memory_staging
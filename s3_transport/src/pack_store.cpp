@@ -0,0 +1,1160 @@
+// local includes
+#include "irods/private/s3_transport/pack_store.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/hedged_get.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// boost includes
+#include <boost/filesystem.hpp>
+
+// system includes
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    namespace bf   = boost::filesystem;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        constexpr std::int64_t MAXIMUM_NUMBER_OF_PARTS{10000};
+
+        const std::string INDEX_EXTENSION{".index"};
+        const std::string SEALED_EXTENSION{".sealed"};
+        const std::string DATA_EXTENSION{".data"};
+        const std::string CURRENT_FILE{"current"};
+        const std::string PACK_LOCK_FILE{"pack.lock"};
+        const std::string COMPACTION_FILE{"compaction"};
+
+        const std::string RESERVE_RECORD{"reserve"};
+        const std::string WRITTEN_RECORD{"written"};
+        const std::string DELETED_RECORD{"deleted"};
+
+        // S3_abort_multipart_upload and S3_delete_object do not take callback data
+        thread_local S3Status request_status{S3StatusOK};
+
+        // Closes a file descriptor when it goes out of scope.
+        class scoped_fd
+        {
+          public:
+            explicit scoped_fd(int _fd)
+                : fd_{_fd}
+            {
+            }
+
+            ~scoped_fd()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+
+            scoped_fd(const scoped_fd&) = delete;
+            auto operator=(const scoped_fd&) -> scoped_fd& = delete;
+
+            int get() const { return fd_; }
+
+          private:
+            int fd_;
+
+        }; // scoped_fd
+
+        struct member_state
+        {
+            std::int64_t length{0};
+            std::int64_t reserved{0};
+            bool         written{false};
+            bool         deleted{false};
+        };
+
+        struct pack_state
+        {
+            std::string                            bucket_name;
+            std::int64_t                           created{0};
+            std::map<std::int64_t, member_state>   members;
+        };
+
+        auto now_seconds() -> std::int64_t
+        {
+            return std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        auto make_pack_id() -> std::string
+        {
+            static thread_local std::mt19937_64 generator{std::random_device{}()};
+            const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            return fmt::format("{:016x}{:016x}", static_cast<std::uint64_t>(nanoseconds), generator());
+        }
+
+        bool lock(int _fd, int _lock_operation)
+        {
+            int result = 0;
+            do {
+                result = ::flock(_fd, _lock_operation);
+            } while (result == -1 && errno == EINTR);
+            return result == 0;
+        }
+
+        bool write_line(int _fd, const nlohmann::json& _record)
+        {
+            // one write per line so concurrent appends do not interleave
+            const std::string line = _record.dump() + "\n";
+            const ssize_t written = ::write(_fd, line.data(), line.size());
+            return written == static_cast<ssize_t>(line.size()) && ::fdatasync(_fd) == 0;
+        }
+
+        auto read_file(int _fd) -> std::string
+        {
+            std::string contents;
+            char buffer[65536];
+            off_t offset = 0;
+            for (ssize_t count; (count = ::pread(_fd, buffer, sizeof(buffer), offset)) > 0; offset += count) {
+                contents.append(buffer, count);
+            }
+            return contents;
+        }
+
+        // Returns the state recorded in the index, or nothing if it has no header.
+        auto load_pack(int _fd) -> std::optional<pack_state>
+        {
+            std::istringstream lines{read_file(_fd)};
+
+            std::optional<pack_state> state;
+            for (std::string line; std::getline(lines, line);) {
+                // a line cut short by a crash is discarded
+                const auto record = nlohmann::json::parse(line, nullptr, false);
+                if (record.is_discarded() || !record.is_object()) {
+                    continue;
+                }
+
+                if (!state) {
+                    state = pack_state{record.value("bucket", ""), record.value("created", std::int64_t{0}), {}};
+                    continue;
+                }
+
+                const std::string op = record.value("op", "");
+                const auto offset = record.value("offset", std::int64_t{-1});
+                if (op == RESERVE_RECORD) {
+                    state->members[offset] = {record.value("length", std::int64_t{0}),
+                        record.value("time", std::int64_t{0}), false, false};
+                } else if (op == WRITTEN_RECORD && state->members.count(offset) > 0) {
+                    state->members[offset].written = true;
+                } else if (op == DELETED_RECORD && state->members.count(offset) > 0) {
+                    state->members[offset].deleted = true;
+                }
+            }
+            return state;
+        }
+
+        bool is_live(const member_state& _member)
+        {
+            return _member.written && !_member.deleted;
+        }
+
+        struct transfer_data
+        {
+            char*        buffer{nullptr};
+            int          fd{-1};
+            std::int64_t file_offset{0};
+            std::int64_t length{0};
+            std::int64_t offset{0};
+            S3Status     status{S3StatusOK};
+            std::string  etag;
+            std::string  upload_id;
+        };
+
+        S3Status on_response_properties(const S3ResponseProperties* _properties, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            if (_properties && _properties->eTag) {
+                data->etag = _properties->eTag;
+            }
+            return S3StatusOK;
+        }
+
+        void on_response_completion(S3Status _status, const S3ErrorDetails* _error, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            data->status = _status;
+            if (_status != S3StatusOK && _error && _error->message) {
+                logger::debug("{}:{} ({}) S3 error message: {}", __FILE__, __LINE__, __func__, _error->message);
+            }
+        }
+
+        S3Status on_get_data(int _size, const char* _buffer, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            if (data->offset + _size > data->length) {
+                return S3StatusAbortedByCallback;
+            }
+            std::memcpy(data->buffer + data->offset, _buffer, _size);
+            data->offset += _size;
+            return S3StatusOK;
+        }
+
+        // Sends the bytes of the buffer, or of the file if there is no buffer.
+        int on_put_data(int _size, char* _buffer, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            const auto count = static_cast<int>(std::min<std::int64_t>(_size, data->length - data->offset));
+            if (count <= 0) {
+                return 0;
+            }
+
+            if (data->buffer) {
+                std::memcpy(_buffer, data->buffer + data->offset, count);
+            } else {
+                const ssize_t read = ::pread(data->fd, _buffer, count, data->file_offset + data->offset);
+                if (read <= 0) {
+                    return -1;
+                }
+                data->offset += read;
+                return static_cast<int>(read);
+            }
+            data->offset += count;
+            return count;
+        }
+
+        S3Status on_upload_id(const char* _upload_id, void* _callback_data)
+        {
+            static_cast<transfer_data*>(_callback_data)->upload_id = _upload_id;
+            return S3StatusOK;
+        }
+
+        S3Status on_commit_response(const char*, const char*, void*)
+        {
+            return S3StatusOK;
+        }
+
+        void on_request_completion(S3Status _status, const S3ErrorDetails*, void*)
+        {
+            request_status = _status;
+        }
+
+        // Sends the request made by _send to a host selected by the endpoint
+        // balancer until it succeeds or the retry policy gives up.  _send is given
+        // the endpoint_request tracking the host, which is finished with the
+        // status of the transfer unless _send finishes it itself.
+        template <typename Function>
+        auto send_with_retry(const std::string&     _resource_name,
+                             const S3BucketContext& _bucket_context,
+                             const retry_policy&    _retry_policy,
+                             transfer_data&         _data,
+                             Function               _send) -> S3Status
+        {
+            auto retry = _retry_policy;
+            do {
+                _data.offset = 0;
+                _data.status = S3StatusOK;
+
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.hostName = hostname.c_str();
+
+                endpoint_request endpoint{_resource_name, hostname};
+                _send(bucket_context, endpoint);
+                endpoint.finish(_data.status, _data.offset);
+
+                // a short transfer is an error even if the request succeeded
+                if (_data.status == S3StatusOK && (_data.buffer || _data.fd >= 0) && _data.offset != _data.length) {
+                    _data.status = S3StatusErrorIncompleteBody;
+                }
+            } while (retry.should_retry(_data.status));
+
+            return _data.status;
+        } // end send_with_retry
+
+        // Uploads the _size bytes of the file _fd to _key, with a multipart upload
+        // if the file is larger than a part.
+        auto upload_file(const std::string&                    _resource_name,
+                         const pack_store::transfer_settings& _settings,
+                         const S3BucketContext&                _bucket_context,
+                         const std::string&                    _key,
+                         int                                   _fd,
+                         std::int64_t                          _size) -> S3Status
+        {
+            const std::int64_t part_size = std::max({_settings.part_size, std::int64_t{1},
+                    (_size + MAXIMUM_NUMBER_OF_PARTS - 1) / MAXIMUM_NUMBER_OF_PARTS});
+
+            S3PutProperties put_properties = _settings.put_properties;
+
+            if (_size <= part_size) {
+                S3PutObjectHandler handler = { { on_response_properties, on_response_completion }, on_put_data };
+
+                rate_limiter::for_resource(_resource_name).acquire_bytes(_size);
+
+                transfer_data data;
+                data.fd = _fd;
+                data.length = _size;
+
+                return send_with_retry(_resource_name, _bucket_context, _settings.retry, data,
+                        [&](S3BucketContext& _ctx, endpoint_request&) {
+                            S3_put_object(&_ctx, _key.c_str(), _size, &put_properties, nullptr, 0, &handler, &data);
+                        });
+            }
+
+            // start the multipart upload
+            transfer_data initiate_data;
+            {
+                S3MultipartInitialHandler handler = { { on_response_properties, on_response_completion }, on_upload_id };
+                const S3Status status = send_with_retry(_resource_name, _bucket_context, _settings.retry,
+                        initiate_data, [&](S3BucketContext& _ctx, endpoint_request&) {
+                            S3_initiate_multipart(&_ctx, _key.c_str(), &put_properties, &handler,
+                                    nullptr, _settings.timeout_ms, &initiate_data);
+                        });
+                if (status != S3StatusOK || initiate_data.upload_id.empty()) {
+                    return status != S3StatusOK ? status : S3StatusInternalError;
+                }
+            }
+            const std::string& upload_id = initiate_data.upload_id;
+
+            const std::int64_t number_of_parts = (_size + part_size - 1) / part_size;
+            std::vector<std::string> etags(number_of_parts);
+
+            std::atomic<std::int64_t> next_part{0};
+            std::mutex                error_mutex;
+            S3Status                  first_error{S3StatusOK};
+            std::atomic<bool>         failed{false};
+
+            auto upload_parts = [&] {
+                for (std::int64_t part = next_part++; part < number_of_parts && !failed; part = next_part++) {
+                    const std::int64_t offset = part * part_size;
+                    const std::int64_t length = std::min(part_size, _size - offset);
+
+                    S3PutObjectHandler handler = { { on_response_properties, on_response_completion }, on_put_data };
+
+                    rate_limiter::for_resource(_resource_name).acquire_bytes(length);
+
+                    transfer_data data;
+                    data.fd = _fd;
+                    data.file_offset = offset;
+                    data.length = length;
+
+                    const S3Status status = send_with_retry(_resource_name, _bucket_context, _settings.retry, data,
+                            [&](S3BucketContext& _ctx, endpoint_request&) {
+                                S3PutProperties part_properties = {};
+                                part_properties.expires = -1;
+                                S3_upload_part(&_ctx, _key.c_str(), &part_properties, &handler,
+                                        static_cast<int>(part + 1), upload_id.c_str(), length, nullptr,
+                                        0, &data);
+                            });
+                    etags[part] = std::move(data.etag);
+
+                    if (status != S3StatusOK) {
+                        logger::error("{}:{} ({}) [resource_name={}] failed to upload part {} of {} - {}",
+                                __FILE__, __LINE__, __func__, _resource_name, part + 1, _key,
+                                S3_get_status_name(status));
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        first_error = first_error == S3StatusOK ? status : first_error;
+                        failed = true;
+                        return;
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            const auto number_of_threads = std::min<std::int64_t>(std::max(_settings.number_of_threads, 1u), number_of_parts);
+            for (std::int64_t i = 1; i < number_of_threads; ++i) {
+                try {
+                    threads.emplace_back(upload_parts);
+                } catch (const std::system_error&) {
+                    // the remaining parts are uploaded by the threads already running
+                    break;
+                }
+            }
+            upload_parts();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            S3Status status = first_error;
+
+            if (status == S3StatusOK) {
+                std::string xml = "<CompleteMultipartUpload>\n";
+                for (std::int64_t i = 0; i < number_of_parts; ++i) {
+                    xml += fmt::format("<Part><PartNumber>{}</PartNumber><ETag>{}</ETag></Part>\n", i + 1, etags[i]);
+                }
+                xml += "</CompleteMultipartUpload>\n";
+
+                S3MultipartCommitHandler handler = { { on_response_properties, on_response_completion },
+                    on_put_data, on_commit_response };
+
+                transfer_data data;
+                data.buffer = xml.data();
+                data.length = static_cast<std::int64_t>(xml.size());
+
+                status = send_with_retry(_resource_name, _bucket_context, _settings.retry, data,
+                        [&](S3BucketContext& _ctx, endpoint_request&) {
+                            S3_complete_multipart_upload(&_ctx, _key.c_str(), &handler, upload_id.c_str(),
+                                    static_cast<int>(xml.size()), nullptr, nullptr, _settings.timeout_ms, &data);
+                        });
+            }
+
+            if (status != S3StatusOK) {
+                S3AbortMultipartUploadHandler abort_handler = { { nullptr, on_request_completion } };
+
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).current_host();
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.hostName = hostname.c_str();
+
+                request_status = S3StatusOK;
+                S3_abort_multipart_upload(&bucket_context, _key.c_str(), upload_id.c_str(),
+                        _settings.timeout_ms, &abort_handler);
+                if (request_status != S3StatusOK) {
+                    logger::warn("{}:{} ({}) [resource_name={}] failed to abort the multipart upload of {} [upload_id={}] - {}",
+                            __FILE__, __LINE__, __func__, _resource_name, _key, upload_id,
+                            S3_get_status_name(request_status));
+                }
+            }
+
+            return status;
+        } // end upload_file
+
+        auto get_range(const std::string&     _resource_name,
+                       const S3BucketContext& _bucket_context,
+                       const std::string&     _key,
+                       std::int64_t           _offset,
+                       char*                  _buffer,
+                       std::int64_t           _length,
+                       const retry_policy&    _retry_policy) -> S3Status
+        {
+            S3GetObjectHandler handler = { { on_response_properties, on_response_completion }, on_get_data };
+
+            rate_limiter::for_resource(_resource_name).acquire_bytes(_length);
+
+            transfer_data data;
+            data.buffer = _buffer;
+            data.length = _length;
+
+            return send_with_retry(_resource_name, _bucket_context, _retry_policy, data,
+                    [&](S3BucketContext& _ctx, endpoint_request& _endpoint) {
+                        // sends a second request if the first one is slow to respond and hedging is enabled
+                        hedged_get_object(_resource_name, _endpoint, _ctx, _key, _offset, _length, handler, &data);
+                    });
+        } // end get_range
+
+        auto delete_object(const std::string&     _resource_name,
+                           const S3BucketContext& _bucket_context,
+                           const std::string&     _key,
+                           const retry_policy&    _retry_policy,
+                           int                    _timeout_ms) -> S3Status
+        {
+            S3ResponseHandler handler = { nullptr, on_request_completion };
+
+            auto retry = _retry_policy;
+            do {
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.hostName = hostname.c_str();
+
+                request_status = S3StatusOK;
+                endpoint_request endpoint{_resource_name, hostname};
+                S3_delete_object(&bucket_context, _key.c_str(), nullptr, _timeout_ms, &handler, nullptr);
+                endpoint.finish(request_status);
+            } while (retry.should_retry(request_status));
+
+            // the pack may have been deleted by an earlier attempt
+            if (request_status == S3StatusHttpErrorNotFound || request_status == S3StatusErrorNoSuchKey) {
+                return S3StatusOK;
+            }
+            return request_status;
+        } // end delete_object
+    } // end anonymous namespace
+
+    auto pack_store::key(const member& _member) -> std::string
+    {
+        return fmt::format("{}:{}:{}", pack_key(_member.pack_id), _member.offset, _member.length);
+    } // end key
+
+    auto pack_store::pack_key(const std::string& _pack_id) -> std::string
+    {
+        return KEY_PREFIX + _pack_id;
+    } // end pack_key
+
+    auto pack_store::parse_key(const std::string& _key) -> std::optional<member>
+    {
+        if (_key.compare(0, KEY_PREFIX.size(), KEY_PREFIX) != 0) {
+            return std::nullopt;
+        }
+
+        const std::string name = _key.substr(KEY_PREFIX.size());
+        const auto length_separator = name.rfind(':');
+        if (length_separator == std::string::npos || length_separator == 0) {
+            return std::nullopt;
+        }
+        const auto offset_separator = name.rfind(':', length_separator - 1);
+        if (offset_separator == std::string::npos) {
+            return std::nullopt;
+        }
+
+        const std::string pack_id = name.substr(0, offset_separator);
+        const std::string offset = name.substr(offset_separator + 1, length_separator - offset_separator - 1);
+        const std::string length = name.substr(length_separator + 1);
+
+        const auto is_number = [](const std::string& _s) {
+            return !_s.empty() && _s.size() <= 18 && _s.find_first_not_of("0123456789") == std::string::npos;
+        };
+        if (pack_id.empty() || pack_id.find_first_not_of("0123456789abcdef") != std::string::npos ||
+                !is_number(offset) || !is_number(length)) {
+            return std::nullopt;
+        }
+
+        return member{pack_id, std::stoll(offset), std::stoll(length)};
+    } // end parse_key
+
+    auto pack_store::for_resource(const std::string& _resource_name) -> pack_store&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<pack_store>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& store = registry[_resource_name];
+        if (!store) {
+            store = std::make_unique<pack_store>(_resource_name);
+        }
+        return *store;
+    } // end for_resource
+
+    pack_store::pack_store(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , enabled_{false}
+        , member_maximum_size_{DEFAULT_MEMBER_MAXIMUM_SIZE}
+        , pack_size_{DEFAULT_PACK_SIZE}
+        , maximum_age_{DEFAULT_MAXIMUM_AGE}
+        , compaction_percent_{DEFAULT_COMPACTION_PERCENT}
+        , full_pack_pending_{false}
+        , members_reserved_{0}
+        , members_completed_{0}
+        , members_deleted_{0}
+        , members_moved_{0}
+        , packs_uploaded_{0}
+        , packs_discarded_{0}
+        , packs_compacted_{0}
+    {
+    }
+
+    void pack_store::configure(bool                 _enabled,
+                               const std::string&   _cache_directory,
+                               std::int64_t         _member_maximum_size,
+                               std::int64_t         _pack_size,
+                               std::chrono::seconds _maximum_age,
+                               unsigned int         _compaction_percent)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        enabled_ = _enabled;
+        directory_ = (bf::path{_cache_directory} / DIRECTORY_NAME).string();
+        member_maximum_size_ = std::clamp<std::int64_t>(_member_maximum_size, 1, MEMBER_MAXIMUM_SIZE_LIMIT);
+        pack_size_ = std::max(_pack_size, member_maximum_size_);
+        maximum_age_ = std::max(_maximum_age, std::chrono::seconds{1});
+        compaction_percent_ = std::clamp(_compaction_percent, 1u, 100u);
+
+        if (enabled_) {
+            try {
+                bf::create_directories(directory_);
+            } catch (const bf::filesystem_error& e) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to create the pack directory {}, "
+                        "small objects are not packed.  {}", __FILE__, __LINE__, __func__,
+                        resource_name_, directory_, e.what());
+                enabled_ = false;
+            }
+        }
+    } // end configure
+
+    bool pack_store::enabled() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return enabled_;
+    } // end enabled
+
+    bool pack_store::accepts(std::int64_t _size) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return enabled_ && _size > 0 && _size <= member_maximum_size_;
+    } // end accepts
+
+    auto pack_store::path(const std::string& _file_name) const -> std::string
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return (bf::path{directory_} / _file_name).string();
+    } // end path
+
+    auto pack_store::reserve(const std::string& _bucket_name, std::int64_t _length) -> std::optional<member>
+    {
+        std::int64_t pack_size = 0;
+        std::int64_t maximum_age = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pack_size = pack_size_;
+            maximum_age = maximum_age_.count();
+        }
+
+        // serializes the reservations of all agents
+        const scoped_fd pack_lock{::open(path(PACK_LOCK_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+        if (pack_lock.get() < 0 || !lock(pack_lock.get(), LOCK_EX)) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to lock {}.  {}", __FILE__, __LINE__, __func__,
+                    resource_name_, path(PACK_LOCK_FILE), std::strerror(errno));
+            return std::nullopt;
+        }
+
+        const scoped_fd current{::open(path(CURRENT_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+        if (current.get() < 0) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to open {}.  {}", __FILE__, __LINE__, __func__,
+                    resource_name_, path(CURRENT_FILE), std::strerror(errno));
+            return std::nullopt;
+        }
+
+        const std::int64_t now = now_seconds();
+
+        // use the open pack if the member fits in it
+        std::string pack_id = read_file(current.get());
+        std::int64_t offset = 0;
+        bool new_pack = pack_id.empty();
+        if (!new_pack) {
+            const scoped_fd index{::open(path(pack_id + INDEX_EXTENSION).c_str(), O_RDONLY | O_CLOEXEC)};
+            struct stat st{};
+            const auto state = index.get() < 0 ? std::nullopt : load_pack(index.get());
+            new_pack = !state || state->bucket_name != _bucket_name || state->created + maximum_age <= now ||
+                ::stat(path(pack_id + DATA_EXTENSION).c_str(), &st) != 0 ||
+                (st.st_size > 0 && st.st_size + _length > pack_size);
+            offset = st.st_size;
+        }
+
+        if (new_pack) {
+            pack_id = make_pack_id();
+            offset = 0;
+
+            const scoped_fd data{::open(path(pack_id + DATA_EXTENSION).c_str(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600)};
+            const scoped_fd index{::open(path(pack_id + INDEX_EXTENSION).c_str(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0600)};
+            if (data.get() < 0 || index.get() < 0 ||
+                    !write_line(index.get(), {{"resource", resource_name_}, {"bucket", _bucket_name}, {"created", now}}) ||
+                    ::ftruncate(current.get(), 0) != 0 ||
+                    ::pwrite(current.get(), pack_id.data(), pack_id.size(), 0) != static_cast<ssize_t>(pack_id.size()) ||
+                    ::fdatasync(current.get()) != 0) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to start the pack {}.  {}", __FILE__, __LINE__,
+                        __func__, resource_name_, pack_id, std::strerror(errno));
+                ::unlink(path(pack_id + DATA_EXTENSION).c_str());
+                ::unlink(path(pack_id + INDEX_EXTENSION).c_str());
+                return std::nullopt;
+            }
+
+            logger::debug("{}:{} ({}) [resource_name={}] started the pack {}", __FILE__, __LINE__, __func__,
+                    resource_name_, pack_id);
+        }
+
+        // the size of the file is the end of the last reservation
+        const scoped_fd data{::open(path(pack_id + DATA_EXTENSION).c_str(), O_WRONLY | O_CLOEXEC)};
+        const scoped_fd index{::open(path(pack_id + INDEX_EXTENSION).c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)};
+        if (data.get() < 0 || index.get() < 0 || ::ftruncate(data.get(), offset + _length) != 0 ||
+                !write_line(index.get(), {{"op", RESERVE_RECORD}, {"offset", offset}, {"length", _length}, {"time", now}})) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to reserve {} bytes in the pack {}.  {}",
+                    __FILE__, __LINE__, __func__, resource_name_, _length, pack_id, std::strerror(errno));
+            return std::nullopt;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++members_reserved_;
+        }
+
+        return member{pack_id, offset, _length};
+    } // end reserve
+
+    bool pack_store::write(const member& _member, std::int64_t _offset, const char* _buffer, std::int64_t _length)
+    {
+        if (_offset < 0 || _length < 0 || _offset + _length > _member.length) {
+            return false;
+        }
+
+        const scoped_fd data{::open(path(_member.pack_id + DATA_EXTENSION).c_str(), O_WRONLY | O_CLOEXEC)};
+        if (data.get() < 0) {
+            return false;
+        }
+
+        for (std::int64_t written = 0; written < _length;) {
+            const ssize_t count = ::pwrite(data.get(), _buffer + written, _length - written,
+                    _member.offset + _offset + written);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to write to the pack {}.  {}", __FILE__, __LINE__,
+                        __func__, resource_name_, _member.pack_id, std::strerror(errno));
+                return false;
+            }
+            written += count;
+        }
+
+        return true;
+    } // end write
+
+    bool pack_store::complete(const member& _member)
+    {
+        const std::string index_path = path(_member.pack_id + INDEX_EXTENSION);
+        const scoped_fd index{::open(index_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)};
+        const scoped_fd data{::open(path(_member.pack_id + DATA_EXTENSION).c_str(), O_RDONLY | O_CLOEXEC)};
+        if (index.get() < 0 || data.get() < 0 || !lock(index.get(), LOCK_SH)) {
+            return false;
+        }
+
+        // the index is renamed when the pack is uploaded
+        struct stat index_st{};
+        struct stat path_st{};
+        if (::fstat(index.get(), &index_st) != 0 || ::stat(index_path.c_str(), &path_st) != 0 ||
+                index_st.st_ino != path_st.st_ino) {
+            return false;
+        }
+
+        struct stat data_st{};
+        if (::fdatasync(data.get()) != 0 || ::fstat(data.get(), &data_st) != 0 ||
+                !write_line(index.get(), {{"op", WRITTEN_RECORD}, {"offset", _member.offset}})) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to record a member of the pack {}.  {}", __FILE__,
+                    __LINE__, __func__, resource_name_, _member.pack_id, std::strerror(errno));
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++members_completed_;
+        if (data_st.st_size >= pack_size_) {
+            full_pack_pending_ = true;
+        }
+        return true;
+    } // end complete
+
+    bool pack_store::wrote_members() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return members_completed_ > 0;
+    } // end wrote_members
+
+    auto pack_store::read(const transfer_settings& _settings,
+                          const std::string&       _bucket_name,
+                          const member&            _member,
+                          std::int64_t             _offset,
+                          char*                    _buffer,
+                          std::int64_t             _length,
+                          std::int64_t&            _bytes_read) -> S3Status
+    {
+        _bytes_read = 0;
+        const std::int64_t length = std::clamp<std::int64_t>(_member.length - _offset, 0, _length);
+        if (length == 0) {
+            return S3StatusOK;
+        }
+
+        // the file stays readable while it is open even if the pack is uploaded meanwhile
+        if (const scoped_fd data{::open(path(_member.pack_id + DATA_EXTENSION).c_str(), O_RDONLY | O_CLOEXEC)};
+                data.get() >= 0) {
+            while (_bytes_read < length) {
+                const ssize_t count = ::pread(data.get(), _buffer + _bytes_read, length - _bytes_read,
+                        _member.offset + _offset + _bytes_read);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count <= 0) {
+                    return S3StatusErrorIncompleteBody;
+                }
+                _bytes_read += count;
+            }
+            return S3StatusOK;
+        }
+
+        S3BucketContext bucket_context = _settings.bucket_context;
+        bucket_context.bucketName = _bucket_name.c_str();
+
+        const S3Status status = get_range(resource_name_, bucket_context, pack_key(_member.pack_id),
+                _member.offset + _offset, _buffer, length, _settings.retry);
+        if (status == S3StatusOK) {
+            _bytes_read = length;
+        }
+        return status;
+    } // end read
+
+    bool pack_store::remove(const member& _member)
+    {
+        bool sealed = false;
+        int fd = ::open(path(_member.pack_id + INDEX_EXTENSION).c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            fd = ::open(path(_member.pack_id + SEALED_EXTENSION).c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+            sealed = true;
+        }
+        const scoped_fd index{fd};
+
+        if (index.get() < 0 || !write_line(index.get(), {{"op", DELETED_RECORD}, {"offset", _member.offset}})) {
+            logger::warn("{}:{} ({}) [resource_name={}] failed to record the deletion of {}.  {}", __FILE__, __LINE__,
+                    __func__, resource_name_, key(_member), std::strerror(errno));
+            return false;
+        }
+
+        unsigned int compaction_percent = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++members_deleted_;
+            compaction_percent = compaction_percent_;
+        }
+
+        // packs that are not uploaded yet are discarded when all their members are deleted
+        if (!sealed) {
+            return false;
+        }
+
+        const auto state = load_pack(index.get());
+        if (!state) {
+            return false;
+        }
+
+        std::int64_t total = 0;
+        std::int64_t deleted = 0;
+        for (const auto& entry : state->members) {
+            total += entry.second.length;
+            if (!is_live(entry.second)) {
+                deleted += entry.second.length;
+            }
+        }
+
+        // the pack is compacted by an agent writing members rather than by the one deleting
+        return total > 0 && deleted * 100 >= total * static_cast<std::int64_t>(compaction_percent) &&
+            queue_compaction(_member.pack_id);
+    } // end remove
+
+    void pack_store::seal_ready_packs(const transfer_settings& _settings, bool _force)
+    {
+        std::int64_t pack_size = 0;
+        std::int64_t maximum_age = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            const auto now = std::chrono::steady_clock::now();
+            if (!_force && !full_pack_pending_ && now - last_seal_check_ < SEAL_CHECK_INTERVAL) {
+                return;
+            }
+            last_seal_check_ = now;
+            full_pack_pending_ = false;
+            pack_size = pack_size_;
+            maximum_age = maximum_age_.count();
+        }
+
+        boost::system::error_code ec;
+        if (!bf::is_directory(path(""), ec)) {
+            return;
+        }
+
+        std::vector<std::string> ready;
+        {
+            // no reservation is made in a pack while it is being checked
+            const scoped_fd pack_lock{::open(path(PACK_LOCK_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+            if (pack_lock.get() < 0 || !lock(pack_lock.get(), LOCK_EX)) {
+                return;
+            }
+
+            const scoped_fd current{::open(path(CURRENT_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+            const std::string current_pack_id = current.get() < 0 ? "" : read_file(current.get());
+
+            const std::int64_t now = now_seconds();
+
+            for (bf::directory_iterator iter{path(""), ec}, end; !ec && iter != end; iter.increment(ec)) {
+
+                const bf::path& index_path = iter->path();
+                if (index_path.extension().string() != INDEX_EXTENSION) {
+                    continue;
+                }
+
+                const std::string pack_id = index_path.stem().string();
+                const scoped_fd index{::open(index_path.c_str(), O_RDONLY | O_CLOEXEC)};
+                const auto state = index.get() < 0 ? std::nullopt : load_pack(index.get());
+                if (!state) {
+                    continue;
+                }
+
+                struct stat st{};
+                const bool full = ::stat(path(pack_id + DATA_EXTENSION).c_str(), &st) == 0 && st.st_size >= pack_size;
+                const bool old = state->created + maximum_age <= now;
+
+                // a member that was not written in time is left out
+                const bool written = std::all_of(state->members.begin(), state->members.end(), [now](const auto& _entry) {
+                    const auto& member = _entry.second;
+                    return member.written || member.deleted || member.reserved + RESERVATION_TIMEOUT.count() <= now;
+                });
+
+                if ((full || old) && written) {
+                    ready.push_back(pack_id);
+                    if (pack_id == current_pack_id) {
+                        ::ftruncate(current.get(), 0);
+                    }
+                }
+            }
+        }
+
+        for (const auto& pack_id : ready) {
+            upload_pack(_settings, pack_id);
+        }
+    } // end seal_ready_packs
+
+    bool pack_store::upload_pack(const transfer_settings& _settings, const std::string& _pack_id)
+    {
+        const std::string index_path = path(_pack_id + INDEX_EXTENSION);
+        const std::string data_path = path(_pack_id + DATA_EXTENSION);
+
+        const scoped_fd index{::open(index_path.c_str(), O_RDWR | O_CLOEXEC)};
+        if (index.get() < 0) {
+            return false;
+        }
+
+        // skip packs being uploaded by another agent and those already uploaded
+        struct stat index_st{};
+        struct stat path_st{};
+        if (!lock(index.get(), LOCK_EX | LOCK_NB) || ::fstat(index.get(), &index_st) != 0 ||
+                ::stat(index_path.c_str(), &path_st) != 0 || index_st.st_ino != path_st.st_ino) {
+            return false;
+        }
+
+        const auto state = load_pack(index.get());
+        if (!state) {
+            return false;
+        }
+
+        const bool live = std::any_of(state->members.begin(), state->members.end(),
+                [](const auto& _entry) { return is_live(_entry.second); });
+
+        // nothing of the pack was written to S3
+        if (!live) {
+            ::unlink(index_path.c_str());
+            ::unlink(data_path.c_str());
+
+            logger::debug("{}:{} ({}) [resource_name={}] discarded the pack {}, all its members were deleted",
+                    __FILE__, __LINE__, __func__, resource_name_, _pack_id);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++packs_discarded_;
+            return true;
+        }
+
+        const scoped_fd data{::open(data_path.c_str(), O_RDONLY | O_CLOEXEC)};
+        struct stat data_st{};
+        if (data.get() < 0 || ::fstat(data.get(), &data_st) != 0) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to open the pack {}.  {}", __FILE__, __LINE__,
+                    __func__, resource_name_, data_path, std::strerror(errno));
+            return false;
+        }
+
+        S3BucketContext bucket_context = _settings.bucket_context;
+        bucket_context.bucketName = state->bucket_name.c_str();
+
+        const S3Status status = upload_file(resource_name_, _settings, bucket_context, pack_key(_pack_id),
+                data.get(), data_st.st_size);
+        if (status != S3StatusOK) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to upload the pack {}, trying again later - {}",
+                    __FILE__, __LINE__, __func__, resource_name_, pack_key(_pack_id), S3_get_status_name(status));
+            return false;
+        }
+
+        // members are read from S3 from now on
+        const std::string sealed_path = path(_pack_id + SEALED_EXTENSION);
+        if (::rename(index_path.c_str(), sealed_path.c_str()) != 0) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to rename {} to {}.  {}", __FILE__, __LINE__,
+                    __func__, resource_name_, index_path, sealed_path, std::strerror(errno));
+            return false;
+        }
+        ::unlink(data_path.c_str());
+
+        logger::debug("{}:{} ({}) [resource_name={}] uploaded the pack {} [size={}][members={}]", __FILE__, __LINE__,
+                __func__, resource_name_, pack_key(_pack_id), data_st.st_size, state->members.size());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++packs_uploaded_;
+        return true;
+    } // end upload_pack
+
+    bool pack_store::queue_compaction(const std::string& _pack_id)
+    {
+        const scoped_fd queue{::open(path(COMPACTION_FILE).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)};
+        if (queue.get() < 0 || !write_line(queue.get(), {{"pack", _pack_id}})) {
+            logger::warn("{}:{} ({}) [resource_name={}] failed to queue the compaction of {}.  {}", __FILE__, __LINE__,
+                    __func__, resource_name_, pack_key(_pack_id), std::strerror(errno));
+            return false;
+        }
+        return true;
+    } // end queue_compaction
+
+    void pack_store::compact_ready_packs(const transfer_settings& _settings, const relocate_function& _relocate)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            const auto now = std::chrono::steady_clock::now();
+            if (now - last_compaction_check_ < SEAL_CHECK_INTERVAL) {
+                return;
+            }
+            last_compaction_check_ = now;
+        }
+
+        std::vector<std::string> queued;
+        {
+            // the queue is taken whole so that each pack is compacted by one agent
+            const scoped_fd pack_lock{::open(path(PACK_LOCK_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+            if (pack_lock.get() < 0 || !lock(pack_lock.get(), LOCK_EX)) {
+                return;
+            }
+
+            const scoped_fd queue{::open(path(COMPACTION_FILE).c_str(), O_RDWR | O_CLOEXEC)};
+            if (queue.get() < 0) {
+                return;
+            }
+
+            std::istringstream lines{read_file(queue.get())};
+            for (std::string line; std::getline(lines, line);) {
+                // a line cut short by a crash is discarded
+                const auto record = nlohmann::json::parse(line, nullptr, false);
+                if (record.is_discarded() || !record.is_object()) {
+                    continue;
+                }
+                const std::string pack_id = record.value("pack", "");
+                if (!pack_id.empty() && std::find(queued.begin(), queued.end(), pack_id) == queued.end()) {
+                    queued.push_back(pack_id);
+                }
+            }
+            if (::ftruncate(queue.get(), 0) != 0) {
+                return;
+            }
+        }
+
+        for (const auto& pack_id : queued) {
+            // a pack that is gone was compacted meanwhile
+            boost::system::error_code ec;
+            if (!compact(_settings, pack_id, _relocate) && bf::exists(path(pack_id + SEALED_EXTENSION), ec)) {
+                queue_compaction(pack_id);
+            }
+        }
+    } // end compact_ready_packs
+
+    bool pack_store::compact(const transfer_settings& _settings,
+                             const std::string&       _pack_id,
+                             const relocate_function& _relocate)
+    {
+        const std::string sealed_path = path(_pack_id + SEALED_EXTENSION);
+        const scoped_fd index{::open(sealed_path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC)};
+
+        // skip packs being compacted by another agent and those already removed
+        struct stat st{};
+        if (index.get() < 0 || !lock(index.get(), LOCK_EX | LOCK_NB) || ::fstat(index.get(), &st) != 0 ||
+                st.st_nlink == 0) {
+            return false;
+        }
+
+        const auto state = load_pack(index.get());
+        if (!state) {
+            return false;
+        }
+
+        S3BucketContext bucket_context = _settings.bucket_context;
+        bucket_context.bucketName = state->bucket_name.c_str();
+
+        std::uint64_t moved = 0;
+        for (const auto& [offset, entry] : state->members) {
+            if (!is_live(entry)) {
+                continue;
+            }
+
+            const member from{_pack_id, offset, entry.length};
+
+            std::vector<char> buffer(static_cast<std::size_t>(from.length));
+            S3Status status = get_range(resource_name_, bucket_context, pack_key(_pack_id), offset,
+                    buffer.data(), from.length, _settings.retry);
+            if (status != S3StatusOK) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to read {} to compact its pack - {}", __FILE__,
+                        __LINE__, __func__, resource_name_, key(from), S3_get_status_name(status));
+                return false;
+            }
+
+            // the member is staged in the open pack and uploaded with it
+            const auto to = reserve(state->bucket_name, from.length);
+            if (!to || !write(*to, 0, buffer.data(), from.length) || !complete(*to)) {
+                if (to) {
+                    remove(*to);
+                }
+                return false;
+            }
+
+            switch (_relocate(state->bucket_name, from, *to)) {
+                case relocation::moved:
+                    ++moved;
+                    break;
+
+                case relocation::orphaned:
+                    remove(*to);
+                    break;
+
+                case relocation::failed:
+                    remove(*to);
+                    logger::error("{}:{} ({}) [resource_name={}] failed to move the replicas of {} to {}, "
+                            "keeping the pack", __FILE__, __LINE__, __func__, resource_name_, key(from), key(*to));
+                    return false;
+            }
+
+            // the pack is kept if the move is not recorded, the member is then found orphaned next time
+            if (!write_line(index.get(), {{"op", DELETED_RECORD}, {"offset", offset}})) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to record that {} was moved, keeping the pack.  {}",
+                        __FILE__, __LINE__, __func__, resource_name_, key(from), std::strerror(errno));
+                return false;
+            }
+        }
+
+        // members unlinked while the pack was compacted were recorded in the index
+        const S3Status status = delete_object(resource_name_, bucket_context, pack_key(_pack_id),
+                _settings.retry, _settings.timeout_ms);
+        if (status != S3StatusOK) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to delete the compacted pack {} - {}", __FILE__,
+                    __LINE__, __func__, resource_name_, pack_key(_pack_id), S3_get_status_name(status));
+            return false;
+        }
+        ::unlink(sealed_path.c_str());
+
+        logger::info("{}:{} ({}) [resource_name={}] compacted the pack {}, moved {} of {} members", __FILE__,
+                __LINE__, __func__, resource_name_, pack_key(_pack_id), moved, state->members.size());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        members_moved_ += moved;
+        ++packs_compacted_;
+        return true;
+    } // end compact
+
+    auto pack_store::to_json() const -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {
+            {"enabled", enabled_},
+            {"members_reserved", members_reserved_},
+            {"members_completed", members_completed_},
+            {"members_deleted", members_deleted_},
+            {"members_moved", members_moved_},
+            {"packs_uploaded", packs_uploaded_},
+            {"packs_discarded", packs_discarded_},
+            {"packs_compacted", packs_compacted_}
+        };
+    } // end to_json
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,270 @@
+// local includes
+#include "irods/private/s3_transport/rate_limiter.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+
+// boost includes
+#include <boost/interprocess/exceptions.hpp>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    namespace bi   = boost::interprocess;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        // steady_clock is CLOCK_MONOTONIC on Linux which is the same for all processes
+        auto now_in_microseconds() -> std::int64_t
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        constexpr std::size_t RATE_LIMIT_SHMEM_SIZE{100*sizeof(void*) + sizeof(shared_data::rate_limit_table) + 4096};
+
+        // Adds the tokens accumulated since the last refill.  The bucket holds at most
+        // one second worth of tokens.
+        void refill(shared_data::rate_bucket& _bucket, double _rate, std::int64_t _now)
+        {
+            const double elapsed_seconds = static_cast<double>(_now - _bucket.last_refill_us) / 1000000.0;
+            _bucket.tokens = std::min(_rate, _bucket.tokens + _rate * elapsed_seconds);
+            _bucket.last_refill_us = _now;
+        }
+
+        // Returns true if _amount tokens can be taken from the bucket without waiting.
+        bool available(shared_data::rate_bucket& _bucket, double _rate, double _amount, std::int64_t _now)
+        {
+            if (_rate <= 0.0) {
+                return true;
+            }
+
+            refill(_bucket, _rate, _now);
+            return _bucket.tokens >= _amount;
+        }
+
+        // Takes _amount tokens from the bucket and returns how long, in microseconds,
+        // the caller has to wait for the bucket to be out of debt.
+        auto reserve(shared_data::rate_bucket& _bucket, double _rate, double _amount, std::int64_t _now) -> std::int64_t
+        {
+            if (_rate <= 0.0) {
+                return 0;
+            }
+
+            refill(_bucket, _rate, _now);
+            _bucket.tokens -= _amount;
+
+            return _bucket.tokens < 0.0
+                ? static_cast<std::int64_t>(-_bucket.tokens / _rate * 1000000.0)
+                : 0;
+        }
+
+        // the table mutex must be held
+        auto find_or_add_user(shared_data::rate_limit_table& _table, const std::string& _user, std::int64_t _now)
+            -> shared_data::rate_limit_user_entry*
+        {
+            if (_user.empty() || _user.size() >= shared_data::rate_limit_user_entry::MAXIMUM_USER_LENGTH) {
+                return nullptr;
+            }
+
+            for (std::size_t i = 0; i < _table.number_of_users; ++i) {
+                if (_user == _table.users[i].user) {
+                    _table.users[i].last_used_us = _now;
+                    return &_table.users[i];
+                }
+            }
+
+            shared_data::rate_limit_user_entry* entry = nullptr;
+            if (_table.number_of_users < shared_data::rate_limit_table::MAXIMUM_USERS) {
+                entry = &_table.users[_table.number_of_users++];
+            } else {
+                // reuse the entry of the user that has been idle the longest
+                entry = std::min_element(std::begin(_table.users), std::end(_table.users),
+                        [](const auto& _a, const auto& _b) { return _a.last_used_us < _b.last_used_us; });
+            }
+
+            *entry = shared_data::rate_limit_user_entry{};
+            std::strncpy(entry->user, _user.c_str(), shared_data::rate_limit_user_entry::MAXIMUM_USER_LENGTH - 1);
+            entry->last_used_us = _now;
+            return entry;
+        }
+    }
+
+    auto rate_limiter::for_resource(const std::string& _resource_name) -> rate_limiter&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<rate_limiter>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& limiter = registry[_resource_name];
+        if (!limiter) {
+            limiter = std::make_unique<rate_limiter>(_resource_name);
+        }
+        return *limiter;
+    } // end for_resource
+
+    rate_limiter::rate_limiter(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+        , limits_{}
+        , limited_{false}
+    {
+    }
+
+    void rate_limiter::configure(std::uint64_t _bytes_per_second,
+                                 std::uint64_t _requests_per_second,
+                                 std::uint64_t _bytes_per_second_per_user,
+                                 std::uint64_t _requests_per_second_per_user)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        limits_.bytes_per_second = static_cast<double>(_bytes_per_second);
+        limits_.requests_per_second = static_cast<double>(_requests_per_second);
+        limits_.bytes_per_second_per_user = static_cast<double>(_bytes_per_second_per_user);
+        limits_.requests_per_second_per_user = static_cast<double>(_requests_per_second_per_user);
+
+        const bool any_limit = _bytes_per_second > 0 || _requests_per_second > 0 ||
+            _bytes_per_second_per_user > 0 || _requests_per_second_per_user > 0;
+
+        if (any_limit && !shared_table_.get()) {
+            const std::string shmem_key = SHARED_MEMORY_KEY_PREFIX +
+                std::to_string(std::hash<std::string>{}(resource_name_));
+            try {
+                shared_table_.open(shmem_key, RATE_LIMIT_SHMEM_SIZE);
+            } catch (const bi::interprocess_exception& e) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to map rate limit shared memory, "
+                        "rate limits are disabled.  {}", __FILE__, __LINE__, __func__, resource_name_, e.what());
+                limits_ = limits{};
+            }
+        }
+
+        limited_ = any_limit && shared_table_.get();
+    } // end configure
+
+    void rate_limiter::acquire_bytes(std::int64_t _bytes, const std::string& _user)
+    {
+        if (_bytes > 0) {
+            acquire(true, static_cast<double>(_bytes), _user, -1);
+        }
+    } // end acquire_bytes
+
+    void rate_limiter::acquire_transfer_bytes(std::int64_t _bytes, const std::string& _user)
+    {
+        if (_bytes > 0) {
+            const auto maximum_wait_us = static_cast<std::int64_t>(
+                    static_cast<double>(_bytes) / MINIMUM_TRANSFER_BYTES_PER_SECOND * 1000000.0);
+            acquire(true, static_cast<double>(_bytes), _user, maximum_wait_us);
+        }
+    } // end acquire_transfer_bytes
+
+    void rate_limiter::acquire_request(const std::string& _user)
+    {
+        acquire(false, 1.0, _user, -1);
+    } // end acquire_request
+
+    bool rate_limiter::try_acquire_request(const std::string& _user)
+    {
+        if (!limited_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+
+        // held until the buckets are updated so that the table is not detached meanwhile
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto* table = shared_table_.get();
+        const double rate = limits_.requests_per_second;
+        const double rate_per_user = limits_.requests_per_second_per_user;
+
+        if (!table || (rate <= 0.0 && (rate_per_user <= 0.0 || _user.empty()))) {
+            return true;
+        }
+
+        shared_data::robust_lock table_lock(table->mutex);
+        shared_table_.attach_if_forked();
+
+        const auto now = now_in_microseconds();
+
+        auto* entry = rate_per_user > 0.0 ? find_or_add_user(*table, _user, now) : nullptr;
+
+        if (!available(table->requests, rate, 1.0, now) ||
+                (entry && !available(entry->requests, rate_per_user, 1.0, now))) {
+            return false;
+        }
+
+        reserve(table->requests, rate, 1.0, now);
+        if (entry) {
+            reserve(entry->requests, rate_per_user, 1.0, now);
+        }
+        return true;
+    } // end try_acquire_request
+
+    void rate_limiter::detach()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limited_ = false;
+        shared_table_.detach();
+    } // end detach
+
+    void rate_limiter::acquire(bool _bytes, double _amount, const std::string& _user, std::int64_t _maximum_wait_us)
+    {
+        if (!limited_.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        std::int64_t wait_us = 0;
+        {
+            // held until the buckets are updated so that the table is not detached meanwhile
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            auto* table = shared_table_.get();
+            const double rate = _bytes ? limits_.bytes_per_second : limits_.requests_per_second;
+            const double rate_per_user = _bytes ? limits_.bytes_per_second_per_user : limits_.requests_per_second_per_user;
+
+            if (!table || (rate <= 0.0 && (rate_per_user <= 0.0 || _user.empty()))) {
+                return;
+            }
+
+            shared_data::robust_lock table_lock(table->mutex);
+            shared_table_.attach_if_forked();
+
+            const auto now = now_in_microseconds();
+
+            wait_us = reserve(_bytes ? table->bytes : table->requests, rate, _amount, now);
+
+            if (rate_per_user > 0.0) {
+                if (auto* entry = find_or_add_user(*table, _user, now); entry) {
+                    wait_us = std::max(wait_us,
+                            reserve(_bytes ? entry->bytes : entry->requests, rate_per_user, _amount, now));
+                }
+            }
+        }
+
+        if (_maximum_wait_us >= 0) {
+            wait_us = std::min(wait_us, _maximum_wait_us);
+        }
+
+        if (wait_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds{wait_us});
+        }
+    } // end acquire
+
+    auto rate_limiter::to_json() const -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {
+            {"bytes_per_second", limits_.bytes_per_second},
+            {"requests_per_second", limits_.requests_per_second},
+            {"bytes_per_second_per_user", limits_.bytes_per_second_per_user},
+            {"requests_per_second_per_user", limits_.requests_per_second_per_user}
+        };
+    } // end to_json
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,218 @@
+// local includes
+#include "irods/private/s3_transport/retry_policy.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// boost includes
+#include <boost/interprocess/exceptions.hpp>
+
+// stdlib includes
+#include <algorithm>
+#include <map>
+#include <random>
+#include <thread>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        constexpr std::size_t RETRY_BUDGET_SHMEM_SIZE{100*sizeof(void*) + sizeof(shared_data::retry_budget_table) + 4096};
+
+        // the refunds add up to just under a whole token in floating point
+        constexpr double TOKEN_TOLERANCE{1e-9};
+
+        // Takes the tokens for one retry from a bucket.  The counters are updated.
+        bool take_retry_tokens(double _maximum_tokens, double& _tokens, std::uint64_t& _retries, std::uint64_t& _retries_shed)
+        {
+            // budget disabled
+            if (_maximum_tokens == 0.0) {
+                ++_retries;
+                return true;
+            }
+
+            if (_tokens + TOKEN_TOLERANCE < retry_budget::RETRY_COST) {
+                ++_retries_shed;
+                return false;
+            }
+
+            _tokens = std::max(0.0, _tokens - retry_budget::RETRY_COST);
+            ++_retries;
+            return true;
+        }
+    }
+
+    auto retry_budget::for_resource(const std::string& _resource_name) -> retry_budget&
+    {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::unique_ptr<retry_budget>> registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto& budget = registry[_resource_name];
+        if (!budget) {
+            budget = std::make_unique<retry_budget>(_resource_name);
+        }
+        return *budget;
+    } // end for_resource
+
+    retry_budget::retry_budget(const std::string& _resource_name)
+        : resource_name_{_resource_name}
+    {
+    }
+
+    void retry_budget::configure(unsigned int _maximum_tokens)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        maximum_tokens_ = static_cast<double>(_maximum_tokens);
+        tokens_ = std::min(tokens_, maximum_tokens_);
+
+        if (maximum_tokens_ == 0.0) {
+            return;
+        }
+
+        if (!shared_table_.get()) {
+            const std::string shmem_key = SHARED_MEMORY_KEY_PREFIX +
+                std::to_string(std::hash<std::string>{}(resource_name_));
+            try {
+                shared_table_.open(shmem_key, RETRY_BUDGET_SHMEM_SIZE);
+            } catch (const boost::interprocess::interprocess_exception& e) {
+                logger::warn("{}:{} ({}) [resource_name={}] failed to map retry budget shared memory, "
+                        "the retry budget applies to each agent separately.  {}", __FILE__, __LINE__, __func__,
+                        resource_name_, e.what());
+                return;
+            }
+        }
+
+        auto* table = shared_table_.get();
+        shared_data::robust_lock table_lock(table->mutex);
+        if (!table->initialized) {
+            table->tokens = maximum_tokens_;
+            table->initialized = true;
+        }
+        table->tokens = std::min(table->tokens, maximum_tokens_);
+    } // end configure
+
+    auto retry_budget::shared_bucket() const -> shared_data::retry_budget_table*
+    {
+        return maximum_tokens_ == 0.0 ? nullptr : shared_table_.get();
+    } // end shared_bucket
+
+    bool retry_budget::try_acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (auto* table = shared_bucket(); table) {
+            shared_data::robust_lock table_lock(table->mutex);
+            shared_table_.attach_if_forked();
+            return take_retry_tokens(maximum_tokens_, table->tokens, table->retries, table->retries_shed);
+        }
+
+        return take_retry_tokens(maximum_tokens_, tokens_, retries_, retries_shed_);
+    } // end try_acquire
+
+    void retry_budget::record_success()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (auto* table = shared_bucket(); table) {
+            shared_data::robust_lock table_lock(table->mutex);
+            table->tokens = std::min(maximum_tokens_, table->tokens + SUCCESS_REFUND);
+            return;
+        }
+
+        tokens_ = std::min(maximum_tokens_, tokens_ + SUCCESS_REFUND);
+    } // end record_success
+
+    void retry_budget::detach()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shared_table_.detach();
+    } // end detach
+
+    auto retry_budget::to_json() const -> nlohmann::json
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (auto* table = shared_bucket(); table) {
+            shared_data::robust_lock table_lock(table->mutex);
+            return {
+                {"maximum_tokens", maximum_tokens_},
+                {"tokens", table->tokens},
+                {"retries", table->retries},
+                {"retries_shed", table->retries_shed},
+                {"shared", true}
+            };
+        }
+
+        return {
+            {"maximum_tokens", maximum_tokens_},
+            {"tokens", tokens_},
+            {"retries", retries_},
+            {"retries_shed", retries_shed_},
+            {"shared", false}
+        };
+    } // end to_json
+
+    retry_policy::retry_policy(const std::string& _resource_name,
+                               std::size_t _retry_count_limit,
+                               std::chrono::milliseconds _base_wait,
+                               std::chrono::milliseconds _max_wait,
+                               retryable_predicate _is_retryable)
+        : resource_name_{_resource_name}
+        , retry_count_limit_{_retry_count_limit}
+        , base_wait_{std::min(_base_wait, _max_wait)}
+        , max_wait_{_max_wait}
+        , previous_delay_{base_wait_}
+        , is_retryable_{_is_retryable}
+        , retries_{0}
+    {
+    }
+
+    bool retry_policy::should_retry(S3Status _status)
+    {
+        if (_status == S3StatusOK || !is_retryable_(_status) || retries_ >= retry_count_limit_) {
+            return false;
+        }
+
+        if (!retry_budget::for_resource(resource_name_).try_acquire()) {
+            logger::warn("{}:{} ({}) [resource_name={}] retry budget exhausted, not retrying request that failed with [{}]",
+                    __FILE__, __LINE__, __func__, resource_name_, S3_get_status_name(_status));
+            return false;
+        }
+
+        ++retries_;
+
+        const auto delay = next_delay();
+        logger::debug("{}:{} ({}) [resource_name={}] request failed with [{}], retry {} of {} in {} ms",
+                __FILE__, __LINE__, __func__, resource_name_, S3_get_status_name(_status),
+                retries_, retry_count_limit_, delay.count());
+
+        if (delay.count() > 0) {
+            std::this_thread::sleep_for(delay);
+        }
+
+        return true;
+    } // end should_retry
+
+    auto retry_policy::next_delay() -> std::chrono::milliseconds
+    {
+        if (max_wait_.count() == 0) {
+            return std::chrono::milliseconds{0};
+        }
+
+        thread_local std::default_random_engine engine{std::random_device{}()};
+
+        const auto lower = base_wait_.count();
+        const auto upper = std::max(lower, previous_delay_.count() * 3);
+        std::uniform_int_distribution<std::chrono::milliseconds::rep> distribution(lower, upper);
+
+        previous_delay_ = std::min(max_wait_, std::chrono::milliseconds{distribution(engine)});
+        return previous_delay_;
+    } // end next_delay
+
+} // irods::experimental::io::s3_transport
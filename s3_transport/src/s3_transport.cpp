@@ -50,6 +50,8 @@ namespace irods::experimental::io::s3_transport
     const std::string  S3_STORAGE_CLASS_GLACIER_IR{"GLACIER_IR"};
     const std::string  S3_DEFAULT_STORAGE_CLASS{S3_STORAGE_CLASS_STANDARD};
 
+    const std::int64_t S3_DEFAULT_STALE_UPLOAD_AGE_SECONDS = 86400;
+
     namespace log  = irods::experimental::log;
     using logger = log::logger<s3_transport_logging_category>;
 
@@ -57,7 +59,9 @@ namespace irods::experimental::io::s3_transport
             libs3_types::bucket_context& bucket_context,
             std::int64_t& object_size,
             object_s3_status& object_status,
-            std::string& storage_class) {
+            std::string& storage_class,
+            std::map<std::string, std::string>* meta_data,
+            std::string* etag) {
 
         data_for_head_callback data(bucket_context);
 
@@ -73,6 +77,14 @@ namespace irods::experimental::io::s3_transport
 
         object_size = data.content_length;
 
+        if (meta_data) {
+            *meta_data = std::move(data.meta_data);
+        }
+
+        if (etag) {
+            *etag = std::move(data.etag);
+        }
+
         // Note that GLACIER_IR does not need or accept restoration
         if (boost::iequals(data.x_amz_storage_class, S3_STORAGE_CLASS_GLACIER) ||
                 boost::iequals(data.x_amz_storage_class, S3_STORAGE_CLASS_DEEP_ARCHIVE)) {
@@ -354,6 +366,10 @@ namespace irods::experimental::io::s3_transport
             data_for_head_callback *data = (data_for_head_callback*)callback_data;
             data->content_length = properties->contentLength;
 
+            if (properties->eTag) {
+                data->etag = properties->eTag;
+            }
+
             // read the headers used by GLACIER
             if (properties->xAmzStorageClass) {
                 data->x_amz_storage_class = properties->xAmzStorageClass;
@@ -362,6 +378,13 @@ namespace irods::experimental::io::s3_transport
                data->x_amz_restore = properties->xAmzRestore;
             }
 
+            // user metadata, e.g. describing the compression of the object
+            for (int i = 0; i < properties->metaDataCount; ++i) {
+                if (properties->metaData[i].name && properties->metaData[i].value) {
+                    data->meta_data[properties->metaData[i].name] = properties->metaData[i].value;
+                }
+            }
+
             return libs3_types::status_ok;
         }
 
@@ -619,7 +642,25 @@ namespace irods::experimental::io::s3_transport
 
         } // end namespace cancel_callback
 
+        namespace copy_part_callback
+        {
+            libs3_types::status on_response_properties (const libs3_types::response_properties *properties,
+                                          void *callback_data)
+            {
+                // the etag of the part is returned by S3_copy_object_range()
+                return libs3_types::status_ok;
+            } // end response_properties
+
+            void on_response_completion (libs3_types::status status,
+                                      const libs3_types::error_details *error,
+                                      void *callback_data)
+            {
+                data *copy_data = static_cast<data*>(callback_data);
+                store_and_log_status( status, error, "copy_part_callback::on_response_completion",
+                        copy_data->saved_bucket_context, copy_data->status );
+            } // end response_completion
 
+        } // end namespace copy_part_callback
 
     } // end namespace s3_multipart_upload
 
@@ -0,0 +1,460 @@
+// local includes
+#include "irods/private/s3_transport/streaming_copy.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/hedged_get.hpp"
+#include "irods/private/s3_transport/rate_limiter.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+
+// stdlib includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        constexpr std::int64_t MAXIMUM_NUMBER_OF_PARTS{10000};
+
+        // S3_abort_multipart_upload does not take callback data
+        thread_local S3Status abort_status{S3StatusOK};
+
+        struct transfer_data
+        {
+            char*        buffer{nullptr};
+            std::int64_t length{0};
+            std::int64_t offset{0};
+            S3Status     status{S3StatusOK};
+            std::string  etag;
+            std::string  upload_id;
+        };
+
+        S3Status on_response_properties(const S3ResponseProperties* _properties, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            if (_properties && _properties->eTag) {
+                data->etag = _properties->eTag;
+            }
+            return S3StatusOK;
+        }
+
+        void on_response_completion(S3Status _status, const S3ErrorDetails* _error, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            data->status = _status;
+            if (_status != S3StatusOK && _error && _error->message) {
+                logger::debug("{}:{} ({}) S3 error message: {}", __FILE__, __LINE__, __func__, _error->message);
+            }
+        }
+
+        S3Status on_get_data(int _size, const char* _buffer, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            if (data->offset + _size > data->length) {
+                return S3StatusAbortedByCallback;
+            }
+            std::memcpy(data->buffer + data->offset, _buffer, _size);
+            data->offset += _size;
+            return S3StatusOK;
+        }
+
+        int on_put_data(int _size, char* _buffer, void* _callback_data)
+        {
+            auto* data = static_cast<transfer_data*>(_callback_data);
+            const auto count = static_cast<int>(std::min<std::int64_t>(_size, data->length - data->offset));
+            std::memcpy(_buffer, data->buffer + data->offset, count);
+            data->offset += count;
+            return count;
+        }
+
+        S3Status on_upload_id(const char* _upload_id, void* _callback_data)
+        {
+            static_cast<transfer_data*>(_callback_data)->upload_id = _upload_id;
+            return S3StatusOK;
+        }
+
+        S3Status on_commit_response(const char*, const char*, void*)
+        {
+            return S3StatusOK;
+        }
+
+        void on_abort_completion(S3Status _status, const S3ErrorDetails*, void*)
+        {
+            abort_status = _status;
+        }
+
+        // Sends the request made by _send to a host selected by the endpoint
+        // balancer until it succeeds or the retry policy gives up.  _send is given
+        // the endpoint_request tracking the host, which is finished with the
+        // status of the transfer unless _send finishes it itself.
+        template <typename Function>
+        auto send_with_retry(const std::string&     _resource_name,
+                             const S3BucketContext& _bucket_context,
+                             const retry_policy&    _retry_policy,
+                             transfer_data&         _data,
+                             Function               _send) -> S3Status
+        {
+            auto retry = _retry_policy;
+            do {
+                _data.offset = 0;
+                _data.status = S3StatusOK;
+
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.hostName = hostname.c_str();
+
+                endpoint_request endpoint{_resource_name, hostname};
+                _send(bucket_context, endpoint);
+                endpoint.finish(_data.status, _data.offset);
+
+                // a short read is an error even if the request succeeded
+                if (_data.status == S3StatusOK && _data.buffer && _data.offset != _data.length) {
+                    _data.status = S3StatusErrorIncompleteBody;
+                }
+            } while (retry.should_retry(_data.status));
+
+            return _data.status;
+        } // end send_with_retry
+
+        auto get_range(const std::string&     _resource_name,
+                       const S3BucketContext& _bucket_context,
+                       const std::string&     _key,
+                       std::int64_t           _offset,
+                       char*                  _buffer,
+                       std::int64_t           _length,
+                       const retry_policy&    _retry_policy) -> S3Status
+        {
+            S3GetObjectHandler handler = { { on_response_properties, on_response_completion }, on_get_data };
+
+            rate_limiter::for_resource(_resource_name).acquire_bytes(_length);
+
+            transfer_data data;
+            data.buffer = _buffer;
+            data.length = _length;
+
+            return send_with_retry(_resource_name, _bucket_context, _retry_policy, data,
+                    [&](S3BucketContext& _ctx, endpoint_request& _endpoint) {
+                        // sends a second request if the first one is slow to respond and hedging is enabled
+                        hedged_get_object(_resource_name, _endpoint, _ctx, _key, _offset, _length, handler, &data);
+                    });
+        } // end get_range
+
+        // The state of an object copied with a single PUT.  A download thread
+        // fills two part buffers in turn while the PUT sends them.
+        struct streamed_put : transfer_data
+        {
+            std::string             resource_name;
+            std::int64_t            part_size{0};
+            std::mutex              mutex;
+            std::condition_variable cv;
+            std::vector<char>       buffers[2];
+            std::int64_t            filled[2]{0, 0};
+            std::int64_t            next_download{0};
+            std::int64_t            next_upload{0};
+            std::int64_t            upload_offset{0};
+            S3Status                download_status{S3StatusOK};
+            bool                    cancelled{false};
+        };
+
+        int on_streamed_put_data(int _size, char* _buffer, void* _callback_data)
+        {
+            auto& put = static_cast<streamed_put&>(*static_cast<transfer_data*>(_callback_data));
+
+            std::unique_lock<std::mutex> lock(put.mutex);
+
+            const int index = static_cast<int>(put.next_upload % 2);
+            put.cv.wait(lock, [&put, index] { return put.filled[index] > 0 || put.download_status != S3StatusOK; });
+            if (put.filled[index] == 0) {
+                return -1;
+            }
+
+            const auto count = static_cast<int>(std::min<std::int64_t>(_size, put.filled[index] - put.upload_offset));
+            std::memcpy(_buffer, put.buffers[index].data() + put.upload_offset, count);
+            put.upload_offset += count;
+            put.offset += count;
+
+            if (put.upload_offset == put.filled[index]) {
+                put.filled[index] = 0;
+                put.upload_offset = 0;
+                ++put.next_upload;
+                put.cv.notify_all();
+            }
+
+            lock.unlock();
+            rate_limiter::for_resource(put.resource_name).acquire_transfer_bytes(count);
+            return count;
+        }
+
+        // Copies the object with one PUT, for when multipart uploads are disabled.
+        // At most two parts are held in memory.
+        auto streamed_single_put(const std::string&     _resource_name,
+                                 const S3BucketContext& _source_bucket_context,
+                                 const std::string&     _source_key,
+                                 const S3BucketContext& _destination_bucket_context,
+                                 const std::string&     _destination_key,
+                                 std::int64_t           _object_size,
+                                 std::int64_t           _part_size,
+                                 const S3PutProperties& _put_properties,
+                                 const retry_policy&    _retry_policy) -> S3Status
+        {
+            S3PutObjectHandler handler = { { on_response_properties, on_response_completion }, on_streamed_put_data };
+
+            transfer_data data;
+            data.length = _object_size;
+
+            // every attempt downloads the object again from its start
+            return send_with_retry(_resource_name, _destination_bucket_context, _retry_policy, data,
+                    [&](S3BucketContext& _ctx, endpoint_request&) {
+                        streamed_put put;
+                        put.resource_name = _resource_name;
+                        put.part_size = _part_size;
+                        put.length = _object_size;
+                        for (auto& buffer : put.buffers) {
+                            buffer.resize(static_cast<std::size_t>(_part_size));
+                        }
+
+                        std::thread downloader([&] {
+                            const std::int64_t number_of_parts = (_object_size + _part_size - 1) / _part_size;
+                            for (std::int64_t part = 0; part < number_of_parts; ++part) {
+                                const int index = static_cast<int>(part % 2);
+                                {
+                                    std::unique_lock<std::mutex> lock(put.mutex);
+                                    put.cv.wait(lock, [&put, index] { return put.filled[index] == 0 || put.cancelled; });
+                                    if (put.cancelled) {
+                                        return;
+                                    }
+                                }
+
+                                const std::int64_t offset = part * _part_size;
+                                const std::int64_t length = std::min(_part_size, _object_size - offset);
+                                const S3Status status = get_range(_resource_name, _source_bucket_context, _source_key,
+                                        offset, put.buffers[index].data(), length, _retry_policy);
+
+                                std::lock_guard<std::mutex> lock(put.mutex);
+                                if (status != S3StatusOK) {
+                                    put.download_status = status;
+                                } else {
+                                    put.filled[index] = length;
+                                }
+                                put.cv.notify_all();
+                                if (status != S3StatusOK) {
+                                    return;
+                                }
+                            }
+                        });
+
+                        S3_put_object(&_ctx, _destination_key.c_str(), _object_size, &_put_properties,
+                                nullptr, 0, &handler, static_cast<transfer_data*>(&put));
+
+                        {
+                            std::lock_guard<std::mutex> lock(put.mutex);
+                            put.cancelled = true;
+                        }
+                        put.cv.notify_all();
+                        downloader.join();
+
+                        // a failed download is reported rather than the aborted upload
+                        data.status = put.download_status != S3StatusOK ? put.download_status : put.status;
+                        data.offset = put.offset;
+                        data.etag = put.etag;
+                        if (data.status == S3StatusOK && data.offset != data.length) {
+                            data.status = S3StatusErrorIncompleteBody;
+                        }
+                    });
+        } // end streamed_single_put
+    } // end anonymous namespace
+
+    auto streaming_copy(const std::string&     _resource_name,
+                        const S3BucketContext& _source_bucket_context,
+                        const std::string&     _source_key,
+                        const S3BucketContext& _destination_bucket_context,
+                        const std::string&     _destination_key,
+                        std::int64_t           _object_size,
+                        std::int64_t           _part_size,
+                        unsigned int           _number_of_threads,
+                        bool                   _multipart_upload,
+                        const S3PutProperties& _put_properties,
+                        const retry_policy&    _retry_policy,
+                        int                    _timeout_ms) -> S3Status
+    {
+        const std::int64_t part_size = std::max({_part_size, std::int64_t{1},
+                (_object_size + MAXIMUM_NUMBER_OF_PARTS - 1) / MAXIMUM_NUMBER_OF_PARTS});
+
+        S3PutProperties put_properties = _put_properties;
+
+        if (!_multipart_upload && _object_size > part_size) {
+            return streamed_single_put(_resource_name, _source_bucket_context, _source_key,
+                    _destination_bucket_context, _destination_key, _object_size, part_size,
+                    put_properties, _retry_policy);
+        }
+
+        // small objects are copied with one GET and one PUT
+        if (_object_size <= part_size) {
+            std::vector<char> buffer(static_cast<std::size_t>(std::max<std::int64_t>(_object_size, 1)));
+
+            if (_object_size > 0) {
+                const S3Status status = get_range(_resource_name, _source_bucket_context, _source_key,
+                        0, buffer.data(), _object_size, _retry_policy);
+                if (status != S3StatusOK) {
+                    return status;
+                }
+            }
+
+            S3PutObjectHandler handler = { { on_response_properties, on_response_completion }, on_put_data };
+
+            rate_limiter::for_resource(_resource_name).acquire_bytes(_object_size);
+
+            transfer_data data;
+            data.buffer = buffer.data();
+            data.length = _object_size;
+
+            return send_with_retry(_resource_name, _destination_bucket_context, _retry_policy, data,
+                    [&](S3BucketContext& _ctx, endpoint_request&) {
+                        S3_put_object(&_ctx, _destination_key.c_str(), _object_size, &put_properties,
+                                nullptr, 0, &handler, &data);
+                    });
+        }
+
+        // start the multipart upload
+        transfer_data initiate_data;
+        {
+            S3MultipartInitialHandler handler = { { on_response_properties, on_response_completion }, on_upload_id };
+            const S3Status status = send_with_retry(_resource_name, _destination_bucket_context, _retry_policy,
+                    initiate_data, [&](S3BucketContext& _ctx, endpoint_request&) {
+                        S3_initiate_multipart(&_ctx, _destination_key.c_str(), &put_properties, &handler,
+                                nullptr, _timeout_ms, &initiate_data);
+                    });
+            if (status != S3StatusOK || initiate_data.upload_id.empty()) {
+                return status != S3StatusOK ? status : S3StatusInternalError;
+            }
+        }
+        const std::string& upload_id = initiate_data.upload_id;
+
+        const std::int64_t number_of_parts = (_object_size + part_size - 1) / part_size;
+        std::vector<std::string> etags(number_of_parts);
+
+        std::atomic<std::int64_t> next_part{0};
+        std::mutex                error_mutex;
+        S3Status                  first_error{S3StatusOK};
+        std::atomic<bool>         failed{false};
+
+        auto copy_parts = [&] {
+            std::vector<char> buffer;
+            try {
+                buffer.resize(static_cast<std::size_t>(part_size));
+            } catch (const std::bad_alloc&) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                first_error = first_error == S3StatusOK ? S3StatusOutOfMemory : first_error;
+                failed = true;
+                return;
+            }
+
+            for (std::int64_t part = next_part++; part < number_of_parts && !failed; part = next_part++) {
+                const std::int64_t offset = part * part_size;
+                const std::int64_t length = std::min(part_size, _object_size - offset);
+
+                S3Status status = get_range(_resource_name, _source_bucket_context, _source_key,
+                        offset, buffer.data(), length, _retry_policy);
+
+                if (status == S3StatusOK) {
+                    S3PutObjectHandler handler = { { on_response_properties, on_response_completion }, on_put_data };
+
+                    rate_limiter::for_resource(_resource_name).acquire_bytes(length);
+
+                    transfer_data data;
+                    data.buffer = buffer.data();
+                    data.length = length;
+
+                    status = send_with_retry(_resource_name, _destination_bucket_context, _retry_policy, data,
+                            [&](S3BucketContext& _ctx, endpoint_request&) {
+                                S3PutProperties part_properties = {};
+                                part_properties.expires = -1;
+                                S3_upload_part(&_ctx, _destination_key.c_str(), &part_properties, &handler,
+                                        static_cast<int>(part + 1), upload_id.c_str(), length, nullptr,
+                                        0, &data);
+                            });
+                    etags[part] = std::move(data.etag);
+                }
+
+                if (status != S3StatusOK) {
+                    logger::error("{}:{} ({}) [resource_name={}] failed to copy part {} of {} to {} - {}",
+                            __FILE__, __LINE__, __func__, _resource_name, part + 1, _source_key,
+                            _destination_key, S3_get_status_name(status));
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    first_error = first_error == S3StatusOK ? status : first_error;
+                    failed = true;
+                    return;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        const auto number_of_threads = std::min<std::int64_t>(std::max(_number_of_threads, 1u), number_of_parts);
+        for (std::int64_t i = 1; i < number_of_threads; ++i) {
+            try {
+                threads.emplace_back(copy_parts);
+            } catch (const std::system_error&) {
+                // the remaining parts are copied by the threads already running
+                break;
+            }
+        }
+        copy_parts();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        S3Status status = first_error;
+
+        if (status == S3StatusOK) {
+            std::string xml = "<CompleteMultipartUpload>\n";
+            for (std::int64_t i = 0; i < number_of_parts; ++i) {
+                xml += fmt::format("<Part><PartNumber>{}</PartNumber><ETag>{}</ETag></Part>\n", i + 1, etags[i]);
+            }
+            xml += "</CompleteMultipartUpload>\n";
+
+            S3MultipartCommitHandler handler = { { on_response_properties, on_response_completion },
+                on_put_data, on_commit_response };
+
+            transfer_data data;
+            data.buffer = xml.data();
+            data.length = static_cast<std::int64_t>(xml.size());
+
+            status = send_with_retry(_resource_name, _destination_bucket_context, _retry_policy, data,
+                    [&](S3BucketContext& _ctx, endpoint_request&) {
+                        S3_complete_multipart_upload(&_ctx, _destination_key.c_str(), &handler, upload_id.c_str(),
+                                static_cast<int>(xml.size()), nullptr, nullptr, _timeout_ms, &data);
+                    });
+        }
+
+        if (status != S3StatusOK) {
+            S3AbortMultipartUploadHandler abort_handler = { { nullptr, on_abort_completion } };
+
+            const std::string hostname = endpoint_balancer::for_resource(_resource_name).current_host();
+            S3BucketContext bucket_context = _destination_bucket_context;
+            bucket_context.hostName = hostname.c_str();
+
+            abort_status = S3StatusOK;
+            S3_abort_multipart_upload(&bucket_context, _destination_key.c_str(), upload_id.c_str(),
+                    _timeout_ms, &abort_handler);
+            if (abort_status != S3StatusOK) {
+                logger::warn("{}:{} ({}) [resource_name={}] failed to abort the multipart upload of {} [upload_id={}] - {}",
+                        __FILE__, __LINE__, __func__, _resource_name, _destination_key, upload_id,
+                        S3_get_status_name(abort_status));
+            }
+        }
+
+        return status;
+    } // end streaming_copy
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,552 @@
+// local includes
+#include "irods/private/s3_transport/upload_journal.hpp"
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+#include "irods/private/s3_transport/logging_category.hpp"
+
+// misc includes
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+
+// stdlib includes
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+// boost includes
+#include <boost/filesystem.hpp>
+
+// system includes
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace irods::experimental::io::s3_transport
+{
+    namespace log  = irods::experimental::log;
+    namespace bf   = boost::filesystem;
+    using logger = log::logger<s3_transport_logging_category>;
+
+    namespace
+    {
+        const std::string JOURNAL_EXTENSION{".journal"};
+        const std::string SWEEPER_LOCK_FILE{"sweeper.lock"};
+        const std::string LAST_SWEEP_FILE{"last_sweep"};
+
+        // Closes a file descriptor when it goes out of scope.
+        class scoped_fd
+        {
+          public:
+            explicit scoped_fd(int _fd)
+                : fd_{_fd}
+            {
+            }
+
+            ~scoped_fd()
+            {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+
+            scoped_fd(const scoped_fd&) = delete;
+            auto operator=(const scoped_fd&) -> scoped_fd& = delete;
+
+            int get() const { return fd_; }
+
+          private:
+            int fd_;
+
+        }; // scoped_fd
+
+        // S3_abort_multipart_upload does not take callback data
+        thread_local S3Status abort_status{S3StatusOK};
+
+        // A stable name for the journal of an object, the path of the object may
+        // be too long for a file name.
+        auto journal_file_name(const std::string& _resource_name,
+                               const std::string& _bucket_name,
+                               const std::string& _key) -> std::string
+        {
+            std::uint64_t hash = 14695981039346656037ULL;
+            for (const std::string* s : {&_resource_name, &_bucket_name, &_key}) {
+                for (const unsigned char c : *s) {
+                    hash = (hash ^ c) * 1099511628211ULL;
+                }
+                hash = (hash ^ '/') * 1099511628211ULL;
+            }
+            return fmt::format("{:016x}{}", hash, JOURNAL_EXTENSION);
+        }
+
+        bool lock(int _fd, int _lock_operation)
+        {
+            int result = 0;
+            do {
+                result = ::flock(_fd, _lock_operation);
+            } while (result == -1 && errno == EINTR);
+            return result == 0;
+        }
+
+        bool write_line(int _fd, const nlohmann::json& _record)
+        {
+            // one write per line so concurrent appends do not interleave
+            const std::string line = _record.dump() + "\n";
+            const ssize_t written = ::write(_fd, line.data(), line.size());
+            return written == static_cast<ssize_t>(line.size()) && ::fdatasync(_fd) == 0;
+        }
+
+        auto read_lines(int _fd) -> std::vector<nlohmann::json>
+        {
+            std::string contents;
+            char buffer[65536];
+            off_t offset = 0;
+            for (ssize_t count; (count = ::pread(_fd, buffer, sizeof(buffer), offset)) > 0; offset += count) {
+                contents.append(buffer, count);
+            }
+
+            std::vector<nlohmann::json> records;
+            std::istringstream lines{contents};
+            for (std::string line; std::getline(lines, line);) {
+                // a line cut short by a crash is discarded
+                auto record = nlohmann::json::parse(line, nullptr, false);
+                if (!record.is_discarded() && record.is_object()) {
+                    records.push_back(std::move(record));
+                }
+            }
+            return records;
+        }
+
+        void on_abort_completion(S3Status _status, const S3ErrorDetails*, void*)
+        {
+            abort_status = _status;
+        }
+
+        struct list_parts_data
+        {
+            S3Status                                      status{S3StatusOK};
+            bool                                          truncated{false};
+            std::string                                   next_marker;
+            std::map<std::int64_t, upload_journal::part>* parts{nullptr};
+        };
+
+        S3Status on_list_parts(int _is_truncated, const char* _next_part_number_marker,
+                const char*, const char*, const char*, const char*, const char*,
+                int _parts_count, int, const S3ListPart* _parts, void* _callback_data)
+        {
+            auto* data = static_cast<list_parts_data*>(_callback_data);
+            data->truncated = _is_truncated != 0;
+            data->next_marker = _next_part_number_marker == nullptr ? "" : _next_part_number_marker;
+            for (int i = 0; i < _parts_count; ++i) {
+                const auto number = static_cast<std::int64_t>(_parts[i].partNumber);
+                (*data->parts)[number] = {number, 0, static_cast<std::int64_t>(_parts[i].size),
+                    _parts[i].eTag == nullptr ? "" : _parts[i].eTag, 0};
+            }
+            return S3StatusOK;
+        }
+    }
+
+    upload_journal::upload_journal(const std::string& _cache_directory,
+                                   const std::string& _resource_name,
+                                   const std::string& _bucket_name,
+                                   const std::string& _key)
+        : resource_name_{_resource_name}
+        , bucket_name_{_bucket_name}
+        , key_{_key}
+        , fd_{-1}
+    {
+        const bf::path directory = bf::path{_cache_directory} / DIRECTORY_NAME;
+        path_ = (directory / journal_file_name(_resource_name, _bucket_name, _key)).string();
+
+        try {
+            bf::create_directories(directory);
+        } catch (const bf::filesystem_error& e) {
+            logger::error("{}:{} ({}) [resource_name={}] failed to create the upload journal directory {}.  {}",
+                    __FILE__, __LINE__, __func__, resource_name_, directory.string(), e.what());
+            return;
+        }
+
+        // The sweeper may remove the file between the open and the lock, in which
+        // case the file is opened again.
+        while (true) {
+            fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+            if (fd_ < 0) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to open the upload journal {}.  {}",
+                        __FILE__, __LINE__, __func__, resource_name_, path_, std::strerror(errno));
+                return;
+            }
+
+            struct stat st{};
+            if (!lock(fd_, LOCK_EX) || ::fstat(fd_, &st) != 0) {
+                logger::error("{}:{} ({}) [resource_name={}] failed to lock the upload journal {}.  {}",
+                        __FILE__, __LINE__, __func__, resource_name_, path_, std::strerror(errno));
+                ::close(fd_);
+                fd_ = -1;
+                return;
+            }
+
+            if (st.st_nlink > 0) {
+                return;
+            }
+
+            ::close(fd_);
+        }
+    }
+
+    upload_journal::~upload_journal()
+    {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    bool upload_journal::valid() const
+    {
+        return fd_ >= 0;
+    } // end valid
+
+    auto upload_journal::load() const -> std::optional<upload>
+    {
+        if (fd_ < 0) {
+            return std::nullopt;
+        }
+
+        const auto records = read_lines(fd_);
+        if (records.empty()) {
+            return std::nullopt;
+        }
+
+        try {
+            const auto& header = records.front();
+
+            // the name of the file is a hash, make sure the journal is for this object
+            if (header.at("resource").get<std::string>() != resource_name_ ||
+                    header.at("bucket").get<std::string>() != bucket_name_ ||
+                    header.at("key").get<std::string>() != key_) {
+                return std::nullopt;
+            }
+
+            upload result{header.at("upload_id").get<std::string>(),
+                header.at("object_size").get<std::int64_t>(),
+                header.at("part_size").get<std::int64_t>(),
+                header.at("number_of_parts").get<std::int64_t>(),
+                {}};
+
+            for (auto iter = std::next(records.begin()); iter != records.end(); ++iter) {
+                result.parts.push_back({iter->at("part").get<std::int64_t>(),
+                    iter->at("offset").get<std::int64_t>(),
+                    iter->at("size").get<std::int64_t>(),
+                    iter->at("etag").get<std::string>(),
+                    iter->at("checksum").get<std::uint64_t>()});
+            }
+
+            return result;
+        } catch (const nlohmann::json::exception& e) {
+            logger::warn("{}:{} ({}) [resource_name={}] ignoring the invalid upload journal {}.  {}",
+                    __FILE__, __LINE__, __func__, resource_name_, path_, e.what());
+            return std::nullopt;
+        }
+    } // end load
+
+    bool upload_journal::start(const std::string& _upload_id,
+                               std::int64_t       _object_size,
+                               std::int64_t       _part_size,
+                               std::int64_t       _number_of_parts)
+    {
+        if (fd_ < 0 || ::ftruncate(fd_, 0) != 0) {
+            return false;
+        }
+
+        return write_line(fd_, {
+            {"resource", resource_name_},
+            {"bucket", bucket_name_},
+            {"key", key_},
+            {"upload_id", _upload_id},
+            {"object_size", _object_size},
+            {"part_size", _part_size},
+            {"number_of_parts", _number_of_parts}
+        });
+    } // end start
+
+    bool upload_journal::add_part(const part& _part)
+    {
+        if (fd_ < 0) {
+            return false;
+        }
+
+        return write_line(fd_, {
+            {"part", _part.number},
+            {"offset", _part.offset},
+            {"size", _part.size},
+            {"etag", _part.etag},
+            {"checksum", _part.checksum}
+        });
+    } // end add_part
+
+    void upload_journal::remove()
+    {
+        if (fd_ >= 0) {
+            ::unlink(path_.c_str());
+        }
+    } // end remove
+
+    void upload_journal::touch(const std::string& _cache_directory,
+                               const std::string& _resource_name,
+                               const std::string& _bucket_name,
+                               const std::string& _key)
+    {
+        const bf::path path = bf::path{_cache_directory} / DIRECTORY_NAME /
+            journal_file_name(_resource_name, _bucket_name, _key);
+
+        const scoped_fd journal{::open(path.c_str(), O_WRONLY | O_CLOEXEC)};
+        if (journal.get() >= 0) {
+            ::futimens(journal.get(), nullptr);
+        }
+    } // end touch
+
+    void upload_journal::discard(const std::string& _cache_directory,
+                                 const std::string& _resource_name,
+                                 const std::string& _bucket_name,
+                                 const std::string& _key)
+    {
+        const bf::path path = bf::path{_cache_directory} / DIRECTORY_NAME /
+            journal_file_name(_resource_name, _bucket_name, _key);
+
+        // the lock waits for a flush or a sweep using the journal
+        const scoped_fd journal{::open(path.c_str(), O_RDWR | O_CLOEXEC)};
+        if (journal.get() >= 0 && lock(journal.get(), LOCK_EX)) {
+            ::unlink(path.c_str());
+        }
+    } // end discard
+
+    void upload_journal::sweep(const std::string&     _cache_directory,
+                               const std::string&     _resource_name,
+                               const S3BucketContext& _bucket_context,
+                               std::chrono::seconds   _maximum_age,
+                               int                    _timeout_ms)
+    {
+        const bf::path directory = bf::path{_cache_directory} / DIRECTORY_NAME;
+
+        {
+            static std::mutex last_sweep_mutex;
+            static std::map<std::string, std::chrono::steady_clock::time_point> last_sweep;
+
+            const auto now = std::chrono::steady_clock::now();
+            const auto sweep_key = fmt::format("{}/{}", _resource_name, directory.string());
+
+            std::lock_guard<std::mutex> guard(last_sweep_mutex);
+            const auto iter = last_sweep.find(sweep_key);
+            if (iter != last_sweep.end() && now - iter->second < SWEEP_INTERVAL) {
+                return;
+            }
+            last_sweep[sweep_key] = now;
+        }
+
+        boost::system::error_code ec;
+        if (!bf::is_directory(directory, ec)) {
+            return;
+        }
+
+        const std::string sweeper_lock_path = (directory / SWEEPER_LOCK_FILE).string();
+        const scoped_fd sweeper_lock{::open(sweeper_lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+        if (sweeper_lock.get() < 0 || !lock(sweeper_lock.get(), LOCK_EX | LOCK_NB)) {
+            // another agent is sweeping or the lock file could not be opened
+            return;
+        }
+
+        // The agents are short lived, so the time of the last sweep by any of
+        // them is kept in the modification time of a file.
+        const std::string last_sweep_path = (directory / LAST_SWEEP_FILE).string();
+        {
+            struct stat st{};
+            if (::stat(last_sweep_path.c_str(), &st) == 0 &&
+                    std::chrono::system_clock::from_time_t(st.st_mtime) > std::chrono::system_clock::now() - SWEEP_INTERVAL) {
+                return;
+            }
+
+            const scoped_fd last_sweep{::open(last_sweep_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600)};
+            if (last_sweep.get() >= 0) {
+                ::futimens(last_sweep.get(), nullptr);
+            }
+        }
+
+        const auto oldest = std::chrono::system_clock::now() - _maximum_age;
+
+        for (bf::directory_iterator iter{directory, ec}, end; !ec && iter != end; iter.increment(ec)) {
+
+            const bf::path& path = iter->path();
+            if (path.extension().string() != JOURNAL_EXTENSION) {
+                continue;
+            }
+
+            const scoped_fd journal{::open(path.c_str(), O_RDWR | O_CLOEXEC)};
+            const int fd = journal.get();
+            if (fd < 0) {
+                continue;
+            }
+
+            // skip journals in use and those removed after the directory was read
+            struct stat st{};
+            if (!lock(fd, LOCK_EX | LOCK_NB) || ::fstat(fd, &st) != 0 || st.st_nlink == 0 ||
+                    std::chrono::system_clock::from_time_t(st.st_mtime) > oldest) {
+                continue;
+            }
+
+            const auto records = read_lines(fd);
+            if (records.empty()) {
+                ::unlink(path.c_str());
+                continue;
+            }
+
+            const auto& header = records.front();
+            if (header.value("resource", "") != _resource_name) {
+                continue;
+            }
+
+            const std::string bucket_name = header.value("bucket", "");
+            const std::string key = header.value("key", "");
+            const std::string upload_id = header.value("upload_id", "");
+
+            if (!bucket_name.empty() && !key.empty() && !upload_id.empty()) {
+                S3AbortMultipartUploadHandler abort_handler = { { nullptr, on_abort_completion } };
+
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).current_host();
+                S3BucketContext bucket_context = _bucket_context;
+                bucket_context.bucketName = bucket_name.c_str();
+                if (!hostname.empty()) {
+                    bucket_context.hostName = hostname.c_str();
+                }
+
+                abort_status = S3StatusOK;
+                S3_abort_multipart_upload(&bucket_context, key.c_str(), upload_id.c_str(), _timeout_ms, &abort_handler);
+
+                // the upload may have been completed or aborted by someone else
+                if (abort_status != S3StatusOK && abort_status != S3StatusErrorNoSuchUpload) {
+                    logger::warn("{}:{} ({}) [resource_name={}] failed to abort the stale multipart upload of {} "
+                            "[upload_id={}], trying again on the next sweep - {}", __FILE__, __LINE__, __func__,
+                            _resource_name, key, upload_id, S3_get_status_name(abort_status));
+                    continue;
+                }
+
+                logger::info("{}:{} ({}) [resource_name={}] aborted the stale multipart upload of {} [upload_id={}]",
+                        __FILE__, __LINE__, __func__, _resource_name, key, upload_id);
+            }
+
+            ::unlink(path.c_str());
+        }
+    } // end sweep
+
+    auto list_parts(const std::string&                            _resource_name,
+                    const S3BucketContext&                        _bucket_context,
+                    const std::string&                            _key,
+                    const std::string&                            _upload_id,
+                    const retry_policy&                           _retry_policy,
+                    int                                           _timeout_ms,
+                    std::map<std::int64_t, upload_journal::part>& _parts) -> S3Status
+    {
+        S3ListPartsHandler handler = {
+            {
+                [] (const S3ResponseProperties*, void*) -> S3Status {
+                    return S3StatusOK;
+                },
+                [] (S3Status _status, const S3ErrorDetails* _error, void* _callback_data) -> void {
+                    static_cast<list_parts_data*>(_callback_data)->status = _status;
+                    if (_status != S3StatusOK && _error && _error->message) {
+                        logger::debug("{}:{} ({}) S3 list parts error message: {}", __FILE__, __LINE__, __func__, _error->message);
+                    }
+                }
+            },
+            on_list_parts
+        };
+
+        std::string marker;
+        do {
+            list_parts_data data;
+            data.parts = &_parts;
+
+            auto retry = _retry_policy;
+            do {
+                data.status = S3StatusOK;
+                data.truncated = false;
+
+                const std::string hostname = endpoint_balancer::for_resource(_resource_name).select_host();
+                S3BucketContext bucket_context = _bucket_context;
+                if (!hostname.empty()) {
+                    bucket_context.hostName = hostname.c_str();
+                }
+
+                endpoint_request endpoint{_resource_name, hostname};
+                S3_list_parts(&bucket_context, _key.c_str(), marker.empty() ? nullptr : marker.c_str(),
+                        _upload_id.c_str(), nullptr, 0, nullptr, _timeout_ms, &handler, &data);
+                endpoint.finish(data.status);
+            } while (retry.should_retry(data.status));
+
+            if (data.status != S3StatusOK) {
+                return data.status;
+            }
+
+            // stop if the marker does not move to avoid looping forever on a bad response
+            if (!data.truncated || data.next_marker.empty() || data.next_marker == marker) {
+                break;
+            }
+            marker = data.next_marker;
+        } while (true);
+
+        return S3StatusOK;
+    } // end list_parts
+
+    bool etag_matches_file_range(const std::string& _etag,
+                                 const std::string& _path,
+                                 std::int64_t       _offset,
+                                 std::int64_t       _length)
+    {
+        std::string etag = _etag;
+        etag.erase(std::remove(etag.begin(), etag.end(), '"'), etag.end());
+        std::transform(etag.begin(), etag.end(), etag.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (etag.size() != 32 || etag.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            return false;
+        }
+
+        const scoped_fd file{::open(_path.c_str(), O_RDONLY | O_CLOEXEC)};
+        const int fd = file.get();
+        if (fd < 0) {
+            return false;
+        }
+
+        std::unique_ptr<EVP_MD_CTX, void(*)(EVP_MD_CTX*)> context{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+        if (!context || EVP_DigestInit_ex(context.get(), EVP_md5(), nullptr) != 1) {
+            return false;
+        }
+
+        std::vector<char> buffer(1024 * 1024);
+        for (std::int64_t remaining = _length; remaining > 0;) {
+            const auto count = ::pread(fd, buffer.data(),
+                    static_cast<std::size_t>(std::min<std::int64_t>(remaining, buffer.size())),
+                    _offset + (_length - remaining));
+            if (count <= 0 || EVP_DigestUpdate(context.get(), buffer.data(), count) != 1) {
+                return false;
+            }
+            remaining -= count;
+        }
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        if (EVP_DigestFinal_ex(context.get(), digest, &digest_length) != 1) {
+            return false;
+        }
+
+        std::string hex;
+        for (unsigned int i = 0; i < digest_length; ++i) {
+            hex += fmt::format("{:02x}", digest[i]);
+        }
+        return hex == etag;
+    } // end etag_matches_file_range
+
+} // irods::experimental::io::s3_transport
@@ -0,0 +1,5 @@
+set(IRODS_TEST_TARGET irods_delete_objects)
+
+set(IRODS_TEST_SOURCE_FILES "${CMAKE_CURRENT_SOURCE_DIR}/src/test_delete_objects.cpp")
+
+set(IRODS_TEST_LINK_OBJLIBRARIES libs3_obj)
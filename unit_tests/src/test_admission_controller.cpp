@@ -0,0 +1,191 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/admission_controller.hpp"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+namespace s3_transport = irods::experimental::io::s3_transport;
+
+using admission_controller = s3_transport::admission_controller;
+
+namespace
+{
+    // A controller with shared memory of its own, removed at the end of the test.
+    class test_controller
+    {
+      public:
+        explicit test_controller(const std::string& _name, unsigned int _maximum_in_flight)
+            : controller_{fmt::format("admission_test_{}_{}", _name, ::getpid())}
+        {
+            controller_.configure(true, _maximum_in_flight);
+        }
+
+        ~test_controller()
+        {
+            controller_.detach();
+        }
+
+        test_controller(const test_controller&) = delete;
+        auto operator=(const test_controller&) -> test_controller& = delete;
+
+        auto operator->() -> admission_controller* { return &controller_; }
+
+        // The limit and in-flight count of the first host used.
+        auto limit() const -> double { return controller_.to_json().at(0).at("limit").get<double>(); }
+        auto in_flight() const -> std::int64_t { return controller_.to_json().at(0).at("in_flight").get<std::int64_t>(); }
+
+      private:
+        admission_controller controller_;
+
+    }; // test_controller
+} // anonymous namespace
+
+TEST_CASE("throttling statuses", "[admission_controller]")
+{
+    CHECK(s3_transport::is_throttling_status(S3StatusErrorSlowDown));
+    CHECK(s3_transport::is_throttling_status(S3StatusErrorServiceUnavailable));
+    CHECK_FALSE(s3_transport::is_throttling_status(S3StatusOK));
+    CHECK_FALSE(s3_transport::is_throttling_status(S3StatusErrorInternalError));
+    CHECK_FALSE(s3_transport::is_throttling_status(S3StatusConnectionFailed));
+}
+
+TEST_CASE("requests are admitted without a slot until enabled", "[admission_controller]")
+{
+    admission_controller controller{fmt::format("admission_test_disabled_{}", ::getpid())};
+    CHECK_FALSE(controller.acquire("host"));
+    CHECK(controller.to_json().empty());
+
+    controller.configure(false, 10);
+    CHECK_FALSE(controller.acquire("host"));
+}
+
+TEST_CASE("slots are counted per host up to the limit", "[admission_controller]")
+{
+    test_controller controller{"slots", 3};
+
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(controller->acquire("host1"));
+    }
+    CHECK(controller.in_flight() == 3);
+    CHECK(controller.limit() == 3.0);
+
+    // another host has a limit of its own
+    CHECK(controller->acquire("host2"));
+    controller->release("host2", S3StatusOK);
+
+    // hosts that cannot be recorded are not limited
+    CHECK_FALSE(controller->acquire(""));
+    CHECK_FALSE(controller->acquire(std::string(300, 'h')));
+
+    for (int i = 0; i < 3; ++i) {
+        controller->release("host1", S3StatusOK);
+    }
+    CHECK(controller.in_flight() == 0);
+
+    // successes do not raise the limit past the maximum
+    CHECK(controller.limit() == 3.0);
+
+    // releasing a slot that was not taken leaves the count alone
+    controller->release("host1", S3StatusOK);
+    CHECK(controller.in_flight() == 0);
+}
+
+TEST_CASE("a request waits for a slot to be released", "[admission_controller]")
+{
+    test_controller controller{"wait", 1};
+
+    REQUIRE(controller->acquire("host"));
+
+    std::atomic<bool> admitted{false};
+    std::thread waiter{[&controller, &admitted] {
+        if (controller->acquire("host")) {
+            admitted = true;
+            controller->release("host", S3StatusOK);
+        }
+    }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    CHECK_FALSE(admitted);
+
+    controller->release("host", S3StatusOK);
+    waiter.join();
+    CHECK(admitted);
+    CHECK(controller.in_flight() == 0);
+}
+
+TEST_CASE("an optional request does not wait for a slot", "[admission_controller]")
+{
+    admission_controller disabled{fmt::format("admission_test_try_disabled_{}", ::getpid())};
+    CHECK(disabled.try_acquire("host") == std::optional<bool>{false});
+
+    test_controller controller{"try", 1};
+
+    CHECK(controller->try_acquire("host") == std::optional<bool>{true});
+    CHECK(controller.in_flight() == 1);
+
+    CHECK_FALSE(controller->try_acquire("host"));
+    CHECK(controller.in_flight() == 1);
+
+    controller->release("host", S3StatusOK);
+    CHECK(controller->try_acquire("host") == std::optional<bool>{true});
+    controller->release("host", S3StatusOK);
+    CHECK(controller.in_flight() == 0);
+}
+
+TEST_CASE("the limit is halved once per interval when throttled and raised additively", "[admission_controller]")
+{
+    test_controller controller{"aimd", 8};
+
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(controller->acquire("host"));
+    }
+
+    controller->release("host", S3StatusErrorSlowDown);
+    CHECK(controller.limit() == 8.0 * admission_controller::DECREASE_FACTOR);
+
+    // the other responses to requests sent before the limit was lowered do not lower it again
+    controller->release("host", S3StatusErrorServiceUnavailable);
+    CHECK(controller.limit() == 4.0);
+
+    // errors that are not throttling leave the limit alone
+    controller->release("host", S3StatusErrorInternalError);
+    CHECK(controller.limit() == 4.0);
+
+    // each success raises the limit by its reciprocal
+    REQUIRE(controller->acquire("host"));
+    controller->release("host", S3StatusOK);
+    CHECK(controller.limit() == 4.25);
+
+    REQUIRE(controller->acquire("host"));
+    controller->release("host", S3StatusOK);
+    CHECK(controller.limit() == 4.25 + 1.0 / 4.25);
+}
+
+TEST_CASE("a lowered maximum applies to the limit of a host", "[admission_controller]")
+{
+    test_controller controller{"maximum", 8};
+
+    REQUIRE(controller->acquire("host"));
+    controller->release("host", S3StatusOK);
+    CHECK(controller.limit() == 8.0);
+
+    controller->configure(true, 2);
+    REQUIRE(controller->acquire("host"));
+    CHECK(controller.limit() == 2.0);
+    controller->release("host", S3StatusOK);
+    CHECK(controller.limit() == 2.0);
+
+    // a maximum of zero still lets one request through
+    controller->configure(true, 0);
+    REQUIRE(controller->acquire("host"));
+    CHECK(controller.limit() == admission_controller::MINIMUM_LIMIT);
+    controller->release("host", S3StatusOK);
+}
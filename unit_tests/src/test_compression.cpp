@@ -0,0 +1,211 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/compression.hpp"
+
+#include <zstd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace s3_transport = irods::experimental::io::s3_transport;
+
+namespace
+{
+    constexpr std::uint32_t SKIPPABLE_FRAME_MAGIC = 0x184D2A5E;
+    constexpr std::uint32_t SEEKABLE_MAGIC        = 0x8F92EAB1;
+
+    // An unlinked temporary file.
+    class temporary_file
+    {
+      public:
+        temporary_file()
+        {
+            char name[] = "/tmp/irods_s3_compression_XXXXXX";
+            fd_ = ::mkstemp(name);
+            REQUIRE(fd_ >= 0);
+            ::unlink(name);
+        }
+
+        ~temporary_file()
+        {
+            ::close(fd_);
+        }
+
+        temporary_file(const temporary_file&) = delete;
+        auto operator=(const temporary_file&) -> temporary_file& = delete;
+
+        int fd() const { return fd_; }
+
+        void write(const std::string& _contents)
+        {
+            REQUIRE(static_cast<ssize_t>(_contents.size()) == ::pwrite(fd_, _contents.data(), _contents.size(), 0));
+        }
+
+        auto read() const -> std::string
+        {
+            std::string contents;
+            char buffer[65536];
+            off_t offset = 0;
+            for (ssize_t count; (count = ::pread(fd_, buffer, sizeof(buffer), offset)) > 0; offset += count) {
+                contents.append(buffer, count);
+            }
+            return contents;
+        }
+
+      private:
+        int fd_;
+
+    }; // temporary_file
+
+    auto get_u32(const std::string& _buffer, std::size_t _offset) -> std::uint32_t
+    {
+        std::uint32_t value = 0;
+        for (int i = 3; i >= 0; --i) {
+            value = (value << 8) | static_cast<unsigned char>(_buffer[_offset + i]);
+        }
+        return value;
+    }
+
+    // Compressible contents that are not a single repeated byte.
+    auto contents_of_size(std::size_t _size) -> std::string
+    {
+        std::string contents(_size, '\0');
+        for (std::size_t i = 0; i < _size; ++i) {
+            contents[i] = static_cast<char>('a' + (i * 7 + i / 1000) % 26);
+        }
+        return contents;
+    }
+
+    auto compress(const std::string& _contents) -> std::pair<s3_transport::compressed_object, std::string>
+    {
+        temporary_file input;
+        temporary_file output;
+        input.write(_contents);
+
+        const auto object = s3_transport::compress_file(input.fd(), output.fd(), s3_transport::DEFAULT_COMPRESSION_LEVEL);
+        REQUIRE(object);
+        return {*object, output.read()};
+    }
+
+    // The (compressed size, decompressed size) of each frame in the seek table
+    // at the end of _compressed.
+    auto seek_table_entries(const std::string& _compressed, std::int64_t _seek_table_size)
+        -> std::vector<std::pair<std::uint32_t, std::uint32_t>>
+    {
+        REQUIRE(_seek_table_size >= 17);
+        REQUIRE(static_cast<std::int64_t>(_compressed.size()) >= _seek_table_size);
+
+        const std::string table = _compressed.substr(_compressed.size() - _seek_table_size);
+        REQUIRE(get_u32(table, 0) == SKIPPABLE_FRAME_MAGIC);
+        REQUIRE(get_u32(table, 4) == table.size() - 8);
+        REQUIRE(get_u32(table, table.size() - 4) == SEEKABLE_MAGIC);
+
+        const std::uint32_t number_of_frames = get_u32(table, table.size() - 9);
+        const auto descriptor = static_cast<unsigned char>(table[table.size() - 5]);
+        const std::size_t entry_size = (descriptor & 0x80) ? 12 : 8;
+        REQUIRE(table.size() == 8 + number_of_frames * entry_size + 9);
+
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> entries;
+        for (std::uint32_t i = 0; i < number_of_frames; ++i) {
+            entries.emplace_back(get_u32(table, 8 + i * entry_size), get_u32(table, 8 + i * entry_size + 4));
+        }
+        return entries;
+    }
+
+    auto decompress(const std::string& _compressed, std::size_t _size) -> std::string
+    {
+        std::string contents(_size, '\0');
+        const std::size_t size = ZSTD_decompress(contents.data(), contents.size(), _compressed.data(), _compressed.size());
+        REQUIRE_FALSE(ZSTD_isError(size));
+        contents.resize(size);
+        return contents;
+    }
+} // anonymous namespace
+
+TEST_CASE("compressed files have a frame per frame size of contents", "[compression]")
+{
+    const auto frame_size = static_cast<std::size_t>(s3_transport::COMPRESSION_FRAME_SIZE);
+
+    for (const std::size_t size : {std::size_t{0}, std::size_t{1}, std::size_t{4096}, frame_size, frame_size + 1,
+                                   frame_size * 5 / 2}) {
+        CAPTURE(size);
+
+        const std::string contents = contents_of_size(size);
+        const auto [object, compressed] = compress(contents);
+
+        CHECK(object.logical_size == static_cast<std::int64_t>(size));
+        CHECK(object.compressed_size == static_cast<std::int64_t>(compressed.size()));
+
+        const auto entries = seek_table_entries(compressed, object.seek_table_size);
+        CHECK(entries.size() == (size + frame_size - 1) / frame_size);
+
+        // every frame decodes on its own to its range of the contents
+        std::int64_t compressed_offset = 0;
+        std::size_t logical_offset = 0;
+        for (const auto& [frame_compressed_size, frame_logical_size] : entries) {
+            CHECK(frame_logical_size <= frame_size);
+            const std::string frame = compressed.substr(compressed_offset, frame_compressed_size);
+            CHECK(decompress(frame, frame_logical_size) == contents.substr(logical_offset, frame_logical_size));
+            compressed_offset += frame_compressed_size;
+            logical_offset += frame_logical_size;
+        }
+        CHECK(logical_offset == size);
+        CHECK(compressed_offset + object.seek_table_size == object.compressed_size);
+
+        // the seek table is skipped by a plain zstd decoder
+        CHECK(decompress(compressed, size + 1) == contents);
+    }
+}
+
+TEST_CASE("compressed object metadata round trips", "[compression]")
+{
+    const auto [object, compressed] = compress(contents_of_size(100000));
+
+    const auto meta_data = object.meta_data();
+    CHECK(meta_data.at(s3_transport::COMPRESSION_CODEC_META_DATA) == s3_transport::COMPRESSION_CODEC);
+
+    const auto parsed = s3_transport::compressed_object_from_meta_data(meta_data);
+    REQUIRE(parsed);
+    CHECK(parsed->logical_size == object.logical_size);
+    CHECK(parsed->compressed_size == object.compressed_size);
+    CHECK(parsed->seek_table_size == object.seek_table_size);
+}
+
+TEST_CASE("compressed object metadata is rejected if missing or invalid", "[compression]")
+{
+    const s3_transport::compressed_object object{1000, 500, 33};
+
+    // objects that are not compressed carry no codec
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data({}));
+
+    auto meta_data = object.meta_data();
+    meta_data[s3_transport::COMPRESSION_CODEC_META_DATA] = "gzip";
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data(meta_data));
+
+    meta_data = object.meta_data();
+    meta_data.erase(s3_transport::SEEK_TABLE_SIZE_META_DATA);
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data(meta_data));
+
+    meta_data = object.meta_data();
+    meta_data[s3_transport::LOGICAL_SIZE_META_DATA] = "ten";
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data(meta_data));
+
+    meta_data = object.meta_data();
+    meta_data[s3_transport::LOGICAL_SIZE_META_DATA] = "-1";
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data(meta_data));
+
+    // the seek table lies within the object
+    meta_data = object.meta_data();
+    meta_data[s3_transport::SEEK_TABLE_SIZE_META_DATA] = "501";
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data(meta_data));
+
+    meta_data = object.meta_data();
+    meta_data[s3_transport::SEEK_TABLE_SIZE_META_DATA] = "0";
+    CHECK_FALSE(s3_transport::compressed_object_from_meta_data(meta_data));
+}
@@ -0,0 +1,201 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/content_address.hpp"
+#include "irods/private/s3_transport/content_release_queue.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace s3_transport    = irods::experimental::io::s3_transport;
+namespace content_address = s3_transport::content_address;
+namespace bf              = boost::filesystem;
+
+using content_release_queue = s3_transport::content_release_queue;
+
+namespace
+{
+    // A directory removed with its contents at the end of the test.
+    class temporary_directory
+    {
+      public:
+        temporary_directory()
+        {
+            char name[] = "/tmp/irods_s3_content_address_XXXXXX";
+            REQUIRE(::mkdtemp(name));
+            path_ = name;
+        }
+
+        ~temporary_directory()
+        {
+            boost::system::error_code ec;
+            bf::remove_all(path_, ec);
+        }
+
+        temporary_directory(const temporary_directory&) = delete;
+        auto operator=(const temporary_directory&) -> temporary_directory& = delete;
+
+        auto path() const -> const std::string& { return path_; }
+
+      private:
+        std::string path_;
+
+    }; // temporary_directory
+
+    // Writes _contents to a file of the directory and returns the key of the file.
+    auto key_of_contents(const temporary_directory& _directory, const std::string& _contents)
+        -> std::optional<std::string>
+    {
+        const std::string path = (bf::path{_directory.path()} / "file").string();
+        std::ofstream{path, std::ios::binary | std::ios::trunc} << _contents;
+
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        const auto key = content_address::key_of_file(fd);
+        ::close(fd);
+        return key;
+    }
+
+    const std::string ABC_DIGEST{"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"};
+} // anonymous namespace
+
+TEST_CASE("keys named by contents", "[content_address]")
+{
+    CHECK(content_address::is_key(content_address::KEY_PREFIX + ABC_DIGEST));
+    CHECK(content_address::is_key(content_address::KEY_PREFIX));
+    CHECK_FALSE(content_address::is_key("irods_s3_content/sha1/" + ABC_DIGEST));
+    CHECK_FALSE(content_address::is_key("home/rods/file"));
+    CHECK_FALSE(content_address::is_key(""));
+
+    CHECK(content_address::digest_of_key(content_address::KEY_PREFIX + ABC_DIGEST) == ABC_DIGEST);
+    CHECK(content_address::digest_of_key("home/rods/" + ABC_DIGEST).empty());
+}
+
+TEST_CASE("a file is named by the SHA-256 of its contents", "[content_address]")
+{
+    temporary_directory directory;
+
+    CHECK(key_of_contents(directory, "abc") == content_address::KEY_PREFIX + ABC_DIGEST);
+    CHECK(key_of_contents(directory, "") ==
+          content_address::KEY_PREFIX + "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    // contents larger than the read buffer
+    std::string contents(3 * 1024 * 1024 + 7, '\0');
+    for (std::size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<char>(i % 251);
+    }
+    CHECK(key_of_contents(directory, contents) ==
+          content_address::KEY_PREFIX + "f578a61853ca2f4272dba551bd868420e22302fbb6d6dfc0cc80da1d2c7b779f");
+}
+
+TEST_CASE("a file that cannot be read has no key", "[content_address]")
+{
+    temporary_directory directory;
+
+    const int fd = ::open(directory.path().c_str(), O_RDONLY | O_DIRECTORY);
+    REQUIRE(fd >= 0);
+    const auto key = content_address::key_of_file(fd);
+    const int error = errno;
+    ::close(fd);
+
+    CHECK_FALSE(key);
+    CHECK(error == EISDIR);
+
+    CHECK_FALSE(content_address::key_of_file(-1));
+    CHECK(errno == EBADF);
+}
+
+TEST_CASE("an object is shared only if it holds the contents named by its key", "[content_address]")
+{
+    const std::string key = content_address::KEY_PREFIX + ABC_DIGEST;
+    const std::map<std::string, std::string> meta_data{{content_address::DIGEST_META_DATA, ABC_DIGEST}};
+
+    CHECK(content_address::holds_contents(key, 3, 3, meta_data));
+
+    // an object of another size
+    CHECK_FALSE(content_address::holds_contents(key, 3, 4, meta_data));
+
+    // an object written under the key by other means
+    CHECK_FALSE(content_address::holds_contents(key, 3, 3, {}));
+    CHECK_FALSE(content_address::holds_contents(key, 3, 3, {{content_address::DIGEST_META_DATA, "0123"}}));
+    CHECK_FALSE(content_address::holds_contents(key, 3, 3, {{"irods-sha1", ABC_DIGEST}}));
+
+    // a key that is not named by contents
+    CHECK_FALSE(content_address::holds_contents("home/rods/" + ABC_DIGEST, 3, 3, meta_data));
+}
+
+TEST_CASE("releases are not recorded until the queue is configured", "[content_release_queue]")
+{
+    content_release_queue queue{"resource"};
+    CHECK_FALSE(queue.add("bucket", "key"));
+    CHECK(queue.take_due().empty());
+}
+
+TEST_CASE("released objects are due once the grace period has passed", "[content_release_queue]")
+{
+    temporary_directory directory;
+
+    content_release_queue queue{"resource"};
+    queue.configure(directory.path(), std::chrono::seconds{0});
+    REQUIRE(queue.add("bucket", content_address::KEY_PREFIX + ABC_DIGEST));
+    REQUIRE(queue.add("other_bucket", "key"));
+
+    const auto due = queue.take_due();
+    REQUIRE(due.size() == 2);
+    CHECK(due[0].bucket_name == "bucket");
+    CHECK(due[0].key == content_address::KEY_PREFIX + ABC_DIGEST);
+    CHECK(due[1].bucket_name == "other_bucket");
+    CHECK(due[1].key == "key");
+
+    // the due entries are taken once
+    CHECK(queue.take_due().empty());
+}
+
+TEST_CASE("released objects are kept during the grace period", "[content_release_queue]")
+{
+    temporary_directory directory;
+
+    content_release_queue queue{"resource"};
+    queue.configure(directory.path());
+    REQUIRE(queue.add("bucket", "key"));
+    CHECK(queue.take_due().empty());
+
+    // the agents of the resource share the file
+    content_release_queue other{"resource"};
+    other.configure(directory.path(), std::chrono::seconds{0});
+    const auto due = other.take_due();
+    REQUIRE(due.size() == 1);
+    CHECK(due[0].key == "key");
+    CHECK(queue.take_due().empty());
+}
+
+TEST_CASE("records cut short or without an object are skipped", "[content_release_queue]")
+{
+    temporary_directory directory;
+
+    content_release_queue queue{"resource"};
+    queue.configure(directory.path(), std::chrono::seconds{0});
+    REQUIRE(queue.add("bucket", "first"));
+    {
+        std::ofstream file{(bf::path{directory.path()} / content_release_queue::FILE_NAME).string(), std::ios::app};
+        file << "{\"bucket\": \"bucket\", \"key\": \"\", \"time\": 0}\n";
+        file << "[1, 2]\n";
+        file << "{\"bucket\": \"bucket\", \"ke";
+        file << "\n";
+    }
+    REQUIRE(queue.add("bucket", "second"));
+
+    const auto due = queue.take_due();
+    REQUIRE(due.size() == 2);
+    CHECK(due[0].key == "first");
+    CHECK(due[1].key == "second");
+}
@@ -0,0 +1,112 @@
+#include <catch2/catch_all.hpp>
+
+#include "libs3/libs3.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    auto document(const std::vector<const char*>& _keys, int _quiet = 1) -> std::string
+    {
+        const int length = S3_generate_delete_objects_document(static_cast<int>(_keys.size()), _keys.data(), _quiet, nullptr, 0);
+        REQUIRE(length >= 0);
+
+        std::string buffer(static_cast<std::size_t>(length) + 1, '\0');
+        REQUIRE(length == S3_generate_delete_objects_document(static_cast<int>(_keys.size()), _keys.data(), _quiet,
+                    buffer.data(), static_cast<int>(buffer.size())));
+        buffer.resize(static_cast<std::size_t>(length));
+        return buffer;
+    }
+
+    struct completion
+    {
+        bool     called{false};
+        S3Status status{S3StatusOK};
+    };
+
+    void on_complete(S3Status _status, const S3ErrorDetails*, void* _callback_data)
+    {
+        auto* data = static_cast<completion*>(_callback_data);
+        data->called = true;
+        data->status = _status;
+    }
+
+    // completes without sending anything if the keys are rejected
+    auto delete_objects(const std::vector<const char*>& _keys) -> completion
+    {
+        S3BucketContext bucket_context{};
+        bucket_context.hostName = "localhost";
+        bucket_context.bucketName = "bucket";
+
+        S3DeleteObjectsHandler handler{};
+        handler.responseHandler.completeCallback = on_complete;
+
+        completion data;
+        S3_delete_objects(&bucket_context, static_cast<int>(_keys.size()), _keys.data(), 1, nullptr, 0, &handler, &data);
+        return data;
+    }
+} // anonymous namespace
+
+TEST_CASE("delete objects document lists every key", "[delete_objects]")
+{
+    CHECK(document({"a", "dir/b"}) ==
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Delete><Quiet>true</Quiet>"
+            "<Object><Key>a</Key></Object>"
+            "<Object><Key>dir/b</Key></Object>"
+            "</Delete>");
+
+    CHECK(document({"a"}, 0) ==
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Delete><Quiet>false</Quiet>"
+            "<Object><Key>a</Key></Object>"
+            "</Delete>");
+}
+
+TEST_CASE("delete objects document escapes keys", "[delete_objects]")
+{
+    CHECK(document({"a&b<c>d\"e'f"}).find("<Key>a&amp;b&lt;c&gt;d&quot;e&apos;f</Key>") != std::string::npos);
+
+    // whitespace the XML parser would normalize is sent as character references
+    CHECK(document({"a\tb\nc\rd"}).find("<Key>a&#9;b&#10;c&#13;d</Key>") != std::string::npos);
+
+    // bytes of multibyte characters are sent as they are
+    CHECK(document({"caf\xc3\xa9"}).find("<Key>caf\xc3\xa9</Key>") != std::string::npos);
+}
+
+TEST_CASE("delete objects document is cut short to the buffer", "[delete_objects]")
+{
+    const std::vector<const char*> keys{"key"};
+    const std::string whole = document(keys);
+
+    char buffer[16];
+    CHECK(static_cast<int>(whole.size()) ==
+            S3_generate_delete_objects_document(1, keys.data(), 1, buffer, sizeof(buffer)));
+    CHECK(std::string{buffer} == whole.substr(0, sizeof(buffer) - 1));
+}
+
+TEST_CASE("delete objects rejects keys XML cannot carry", "[delete_objects]")
+{
+    CHECK(S3_is_valid_delete_objects_key("a/b c"));
+    CHECK(S3_is_valid_delete_objects_key("tab\tline\nreturn\r"));
+    CHECK_FALSE(S3_is_valid_delete_objects_key("bell\x07"));
+    CHECK_FALSE(S3_is_valid_delete_objects_key("escape\x1b"));
+    CHECK_FALSE(S3_is_valid_delete_objects_key(std::string(S3_MAX_KEY_SIZE + 1, 'k').c_str()));
+
+    const std::vector<const char*> keys{"good", "bad\x01"};
+    CHECK(-1 == S3_generate_delete_objects_document(2, keys.data(), 1, nullptr, 0));
+
+    const auto result = delete_objects(keys);
+    CHECK(result.called);
+    CHECK(result.status == S3StatusNotSupported);
+}
+
+TEST_CASE("delete objects rejects a request with too many or no keys", "[delete_objects]")
+{
+    CHECK(delete_objects({}).status == S3StatusInternalError);
+
+    const std::vector<const char*> keys(S3_MAX_DELETE_OBJECTS_COUNT + 1, "key");
+    CHECK(delete_objects(keys).status == S3StatusInternalError);
+
+    const std::string long_key(S3_MAX_KEY_SIZE + 1, 'k');
+    CHECK(delete_objects({long_key.c_str()}).status == S3StatusKeyTooLong);
+}
@@ -0,0 +1,110 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/endpoint_balancer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+namespace s3_transport = irods::experimental::io::s3_transport;
+
+using endpoint_balancer = s3_transport::endpoint_balancer;
+
+namespace
+{
+    auto find_statistics(const endpoint_balancer& _balancer, const std::string& _host)
+        -> endpoint_balancer::host_statistics
+    {
+        const auto statistics = _balancer.statistics();
+        const auto iter = std::find_if(statistics.begin(), statistics.end(),
+                [&_host](const auto& _statistics) { return _statistics.host == _host; });
+        REQUIRE(iter != statistics.end());
+        return *iter;
+    }
+
+    void fail_requests(endpoint_balancer& _balancer, const std::string& _host, unsigned int _count)
+    {
+        for (unsigned int i = 0; i < _count; ++i) {
+            _balancer.request_started(_host);
+            _balancer.request_finished(_host, false, std::chrono::microseconds{1000});
+        }
+    }
+} // anonymous namespace
+
+TEST_CASE("without hosts no host is chosen", "[endpoint_balancer]")
+{
+    endpoint_balancer balancer;
+    CHECK(balancer.select_host().empty());
+    CHECK(balancer.current_host().empty());
+    CHECK(balancer.statistics().empty());
+}
+
+TEST_CASE("the current host does not move the round robin on", "[endpoint_balancer]")
+{
+    endpoint_balancer balancer;
+    balancer.set_hosts({"a", "b"});
+
+    CHECK(balancer.current_host() == "a");
+    CHECK(balancer.current_host() == "a");
+
+    CHECK(balancer.select_host() == "a");
+    CHECK(balancer.current_host() == "b");
+    CHECK(balancer.select_host() == "b");
+    CHECK(balancer.select_host() == "a");
+}
+
+TEST_CASE("the latency of a large transfer is counted per reference size", "[endpoint_balancer]")
+{
+    endpoint_balancer balancer;
+    balancer.set_hosts({"a", "b"});
+
+    // 100 ms for 100 reference sizes is 1 ms per reference size
+    balancer.request_started("a");
+    balancer.request_finished("a", true, std::chrono::microseconds{100000},
+            100 * endpoint_balancer::LATENCY_REFERENCE_BYTES);
+    CHECK(std::abs(find_statistics(balancer, "a").ewma_latency_us - 1000.0) < 0.001);
+
+    // a small request is counted as it is
+    balancer.request_started("b");
+    balancer.request_finished("b", true, std::chrono::microseconds{10000}, 1024);
+    CHECK(std::abs(find_statistics(balancer, "b").ewma_latency_us - 10000.0) < 0.001);
+
+    CHECK(balancer.select_host() == "a");
+    CHECK(balancer.select_host() == "a");
+}
+
+TEST_CASE("an ejected host is not handed out before its probe is due", "[endpoint_balancer]")
+{
+    endpoint_balancer balancer;
+    balancer.set_hosts({"a", "b"});
+    CHECK_FALSE(balancer.degraded());
+
+    fail_requests(balancer, "a", endpoint_balancer::EJECT_AFTER_CONSECUTIVE_FAILURES);
+
+    const auto statistics = find_statistics(balancer, "a");
+    CHECK(statistics.ejected);
+    CHECK(statistics.ejections == 1);
+    CHECK(statistics.failures == endpoint_balancer::EJECT_AFTER_CONSECUTIVE_FAILURES);
+    CHECK(statistics.ejected_for_ms > 0);
+    CHECK(balancer.degraded());
+
+    for (int i = 0; i < 4; ++i) {
+        CHECK(balancer.current_host() == "b");
+        CHECK(balancer.select_host() == "b");
+    }
+}
+
+TEST_CASE("the only host is never ejected", "[endpoint_balancer]")
+{
+    endpoint_balancer balancer;
+    balancer.set_hosts({"a"});
+
+    fail_requests(balancer, "a", 2 * endpoint_balancer::EJECT_AFTER_CONSECUTIVE_FAILURES);
+
+    const auto statistics = find_statistics(balancer, "a");
+    CHECK_FALSE(statistics.ejected);
+    CHECK(statistics.ejections == 0);
+    CHECK(balancer.current_host() == "a");
+    CHECK(balancer.select_host() == "a");
+}
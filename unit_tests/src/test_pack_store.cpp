@@ -0,0 +1,242 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/pack_store.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace s3_transport = irods::experimental::io::s3_transport;
+namespace bf           = boost::filesystem;
+
+using pack_store = s3_transport::pack_store;
+
+namespace
+{
+    // A cache directory removed with its contents at the end of the test.
+    class temporary_directory
+    {
+      public:
+        temporary_directory()
+        {
+            char name[] = "/tmp/irods_s3_pack_store_XXXXXX";
+            REQUIRE(::mkdtemp(name));
+            path_ = name;
+        }
+
+        ~temporary_directory()
+        {
+            boost::system::error_code ec;
+            bf::remove_all(path_, ec);
+        }
+
+        temporary_directory(const temporary_directory&) = delete;
+        auto operator=(const temporary_directory&) -> temporary_directory& = delete;
+
+        auto path() const -> const std::string& { return path_; }
+
+      private:
+        std::string path_;
+
+    }; // temporary_directory
+
+    // Members written to the file of their pack are read without a request.
+    auto transfer_settings() -> pack_store::transfer_settings
+    {
+        return {S3BucketContext{}, S3PutProperties{},
+                s3_transport::retry_policy{"resource", 0, std::chrono::milliseconds{1}, std::chrono::milliseconds{1}},
+                1000, 5 * 1024 * 1024, 1};
+    }
+
+    auto read_member(pack_store& _store, const pack_store::member& _member, std::int64_t _offset, std::int64_t _length)
+        -> std::string
+    {
+        std::string buffer(_length, '\0');
+        std::int64_t bytes_read = 0;
+        REQUIRE(S3StatusOK == _store.read(transfer_settings(), "bucket", _member, _offset, buffer.data(), _length,
+                    bytes_read));
+        buffer.resize(bytes_read);
+        return buffer;
+    }
+
+    auto store_member(pack_store& _store, const std::string& _bucket_name, const std::string& _contents)
+        -> pack_store::member
+    {
+        const auto member = _store.reserve(_bucket_name, _contents.size());
+        REQUIRE(member);
+        REQUIRE(_store.write(*member, 0, _contents.data(), _contents.size()));
+        REQUIRE(_store.complete(*member));
+        return *member;
+    }
+
+    // Moves the index of a pack aside as it is once the pack is in S3.
+    void mark_uploaded(const std::string& _cache_directory, const std::string& _pack_id)
+    {
+        const bf::path directory = bf::path{_cache_directory} / pack_store::DIRECTORY_NAME;
+        bf::rename(directory / (_pack_id + ".index"), directory / (_pack_id + ".sealed"));
+        bf::remove(directory / (_pack_id + ".data"));
+    }
+} // anonymous namespace
+
+TEST_CASE("pack member keys round trip", "[pack_store]")
+{
+    const pack_store::member member{"0123456789abcdef", 4096, 100};
+
+    const std::string key = pack_store::key(member);
+    CHECK(key == "irods_s3_packs/0123456789abcdef:4096:100");
+    CHECK(pack_store::pack_key(member.pack_id) == "irods_s3_packs/0123456789abcdef");
+
+    const auto parsed = pack_store::parse_key(key);
+    REQUIRE(parsed);
+    CHECK(parsed->pack_id == member.pack_id);
+    CHECK(parsed->offset == member.offset);
+    CHECK(parsed->length == member.length);
+}
+
+TEST_CASE("keys that do not name a pack member are rejected", "[pack_store]")
+{
+    // not under the prefix
+    CHECK_FALSE(pack_store::parse_key("home/user/file"));
+    CHECK_FALSE(pack_store::parse_key("other/abc:0:10"));
+
+    // a pack itself
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc"));
+
+    // missing fields
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc:10"));
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/:0:10"));
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc::10"));
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc:0:"));
+
+    // pack ids are lowercase hexadecimal
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/ABC:0:10"));
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/ab/c:0:10"));
+
+    // offsets and lengths are unsigned numbers that fit
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc:-1:10"));
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc:0:1x"));
+    CHECK_FALSE(pack_store::parse_key("irods_s3_packs/abc:0:" + std::string(19, '9')));
+}
+
+TEST_CASE("only small objects are packed when enabled", "[pack_store]")
+{
+    const temporary_directory cache;
+    pack_store store{"resource"};
+
+    CHECK_FALSE(store.accepts(10));
+
+    store.configure(true, cache.path(), 1000, 10000, std::chrono::seconds{300}, 50);
+    CHECK(store.enabled());
+    CHECK(store.accepts(1));
+    CHECK(store.accepts(1000));
+    CHECK_FALSE(store.accepts(0));
+    CHECK_FALSE(store.accepts(1001));
+}
+
+TEST_CASE("members are packed one after another and read from the pack file", "[pack_store]")
+{
+    const temporary_directory cache;
+    pack_store store{"resource"};
+    store.configure(true, cache.path(), 1000, 2500, std::chrono::seconds{300}, 50);
+
+    const auto first = store_member(store, "bucket", std::string(1000, 'a'));
+    const auto second = store_member(store, "bucket", std::string(1000, 'b'));
+    CHECK(first.offset == 0);
+    CHECK(second.pack_id == first.pack_id);
+    CHECK(second.offset == 1000);
+
+    // a member that does not fit starts a new pack
+    const auto third = store_member(store, "bucket", std::string(1000, 'c'));
+    CHECK(third.pack_id != first.pack_id);
+    CHECK(third.offset == 0);
+
+    // as does a member of another bucket
+    const auto other = store_member(store, "other_bucket", "d");
+    CHECK(other.pack_id != third.pack_id);
+
+    CHECK(read_member(store, first, 0, 1000) == std::string(1000, 'a'));
+    CHECK(read_member(store, second, 10, 20) == std::string(20, 'b'));
+
+    // reads are cut short at the end of the member
+    CHECK(read_member(store, second, 990, 100) == std::string(10, 'b'));
+    CHECK(read_member(store, second, 1000, 100).empty());
+
+    // writes past the end of the member are refused
+    CHECK_FALSE(store.write(first, 999, "xy", 2));
+    CHECK_FALSE(store.write(first, -1, "x", 1));
+
+    CHECK(store.to_json().at("members_reserved") == 4);
+    CHECK(store.to_json().at("members_completed") == 4);
+    CHECK(store.wrote_members());
+}
+
+TEST_CASE("packs whose members were all deleted are discarded", "[pack_store]")
+{
+    const temporary_directory cache;
+    pack_store store{"resource"};
+    store.configure(true, cache.path(), 1000, 1000, std::chrono::seconds{300}, 50);
+
+    // never completed, so nothing of the pack is written to S3
+    const auto member = store.reserve("bucket", 1000);
+    REQUIRE(member);
+    CHECK_FALSE(store.remove(*member));
+
+    store.seal_ready_packs(transfer_settings(), true);
+
+    const auto stats = store.to_json();
+    CHECK(stats.at("packs_discarded") == 1);
+    CHECK(stats.at("packs_uploaded") == 0);
+    CHECK(stats.at("members_deleted") == 1);
+
+    CHECK_FALSE(bf::exists(bf::path{cache.path()} / pack_store::DIRECTORY_NAME / (member->pack_id + ".data")));
+}
+
+TEST_CASE("uploaded packs are compacted once enough of their bytes are deleted", "[pack_store]")
+{
+    const temporary_directory cache;
+    pack_store store{"resource"};
+    store.configure(true, cache.path(), 1000, 10000, std::chrono::seconds{300}, 50);
+
+    const auto first = store_member(store, "bucket", std::string(100, 'a'));
+    const auto second = store_member(store, "bucket", std::string(100, 'b'));
+    const auto third = store_member(store, "bucket", std::string(200, 'c'));
+    REQUIRE(first.pack_id == third.pack_id);
+
+    // deletions from a pack that is not uploaded never call for compaction
+    const auto pending = store_member(store, "other_bucket", std::string(100, 'd'));
+    CHECK_FALSE(store.remove(pending));
+
+    mark_uploaded(cache.path(), first.pack_id);
+
+    // 100 of 400 bytes deleted
+    CHECK_FALSE(store.remove(first));
+
+    // 200 of 400 bytes deleted reaches 50 percent and queues the pack
+    CHECK(store.remove(second));
+    CHECK(store.remove(third));
+
+    std::ifstream queue{(bf::path{cache.path()} / pack_store::DIRECTORY_NAME / "compaction").string()};
+    std::string line;
+    REQUIRE(std::getline(queue, line));
+    CHECK(line == "{\"pack\":\"" + first.pack_id + "\"}");
+}
+
+TEST_CASE("members that were never written count as deleted for compaction", "[pack_store]")
+{
+    const temporary_directory cache;
+    pack_store store{"resource"};
+    store.configure(true, cache.path(), 1000, 10000, std::chrono::seconds{300}, 75);
+
+    const auto written = store_member(store, "bucket", std::string(100, 'a'));
+    const auto abandoned = store.reserve("bucket", 200);
+    store_member(store, "bucket", std::string(100, 'b'));
+    REQUIRE(abandoned);
+
+    mark_uploaded(cache.path(), written.pack_id);
+
+    // 300 of 400 bytes are not live
+    CHECK(store.remove(written));
+}
@@ -0,0 +1,209 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/retry_policy.hpp"
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <string>
+
+#include <unistd.h>
+
+namespace s3_transport = irods::experimental::io::s3_transport;
+
+using retry_budget = s3_transport::retry_budget;
+using retry_policy = s3_transport::retry_policy;
+
+namespace
+{
+    // A resource name of the test, so that its budget has shared memory of its own.
+    auto resource_name(const std::string& _name) -> std::string
+    {
+        return fmt::format("retry_test_{}_{}", _name, ::getpid());
+    }
+
+    // Detaches the budget of a resource at the end of the test.
+    class budget_detacher
+    {
+      public:
+        explicit budget_detacher(retry_budget& _budget)
+            : budget_{_budget}
+        {
+        }
+
+        ~budget_detacher()
+        {
+            budget_.detach();
+        }
+
+        budget_detacher(const budget_detacher&) = delete;
+        auto operator=(const budget_detacher&) -> budget_detacher& = delete;
+
+      private:
+        retry_budget& budget_;
+
+    }; // budget_detacher
+
+    auto tokens(const retry_budget& _budget) -> double
+    {
+        return _budget.to_json().at("tokens").get<double>();
+    }
+
+    int always_retryable(S3Status)
+    {
+        return 1;
+    }
+} // anonymous namespace
+
+TEST_CASE("a budget of zero tokens never sheds retries", "[retry_budget]")
+{
+    retry_budget budget{resource_name("disabled")};
+    const budget_detacher detacher{budget};
+    budget.configure(0);
+
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(budget.try_acquire());
+    }
+
+    const auto stats = budget.to_json();
+    CHECK(stats.at("retries") == 1000);
+    CHECK(stats.at("retries_shed") == 0);
+    CHECK(stats.at("shared") == false);
+}
+
+TEST_CASE("retries are shed once the tokens run out", "[retry_budget]")
+{
+    retry_budget budget{resource_name("shed")};
+    const budget_detacher detacher{budget};
+    budget.configure(3);
+    CHECK(budget.to_json().at("shared") == true);
+
+    CHECK(budget.try_acquire());
+    CHECK(budget.try_acquire());
+    CHECK(budget.try_acquire());
+    CHECK_FALSE(budget.try_acquire());
+
+    const auto stats = budget.to_json();
+    CHECK(stats.at("retries") == 3);
+    CHECK(stats.at("retries_shed") == 1);
+    CHECK(tokens(budget) == 0.0);
+}
+
+TEST_CASE("ten successes pay for a retry", "[retry_budget]")
+{
+    retry_budget budget{resource_name("refund")};
+    const budget_detacher detacher{budget};
+    budget.configure(1);
+
+    REQUIRE(budget.try_acquire());
+    REQUIRE_FALSE(budget.try_acquire());
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 9; ++i) {
+            budget.record_success();
+        }
+        CHECK_FALSE(budget.try_acquire());
+
+        budget.record_success();
+        CHECK(budget.try_acquire());
+        CHECK(tokens(budget) >= 0.0);
+    }
+}
+
+TEST_CASE("the tokens are capped at the maximum", "[retry_budget]")
+{
+    retry_budget budget{resource_name("cap")};
+    const budget_detacher detacher{budget};
+    budget.configure(5);
+
+    for (int i = 0; i < 100; ++i) {
+        budget.record_success();
+    }
+    CHECK(tokens(budget) == 5.0);
+
+    // lowering the maximum drops the tokens above it
+    budget.configure(2);
+    CHECK(tokens(budget) == 2.0);
+    CHECK(budget.try_acquire());
+    CHECK(budget.try_acquire());
+    CHECK_FALSE(budget.try_acquire());
+}
+
+TEST_CASE("the agents of a resource share one bucket", "[retry_budget]")
+{
+    const std::string name = resource_name("shared");
+
+    retry_budget first{name};
+    const budget_detacher first_detacher{first};
+    first.configure(3);
+
+    // the second agent finds the bucket already filled
+    retry_budget second{name};
+    const budget_detacher second_detacher{second};
+    second.configure(3);
+
+    CHECK(first.try_acquire());
+    CHECK(first.try_acquire());
+    CHECK(tokens(second) == 1.0);
+
+    CHECK(second.try_acquire());
+    CHECK_FALSE(first.try_acquire());
+    CHECK(second.to_json().at("retries") == 3);
+    CHECK(second.to_json().at("retries_shed") == 1);
+}
+
+TEST_CASE("requests are retried only after retryable errors up to the limit", "[retry_policy]")
+{
+    const std::string name = resource_name("policy");
+    auto& budget = retry_budget::for_resource(name);
+    const budget_detacher detacher{budget};
+    budget.configure(0);
+
+    retry_policy retry{name, 2, std::chrono::milliseconds{0}, std::chrono::milliseconds{0}};
+    CHECK_FALSE(retry.should_retry(S3StatusOK));
+    CHECK_FALSE(retry.should_retry(S3StatusErrorNoSuchKey));
+    CHECK(retry.retries() == 0);
+
+    CHECK(retry.should_retry(S3StatusConnectionFailed));
+    CHECK(retry.should_retry(S3StatusErrorSlowDown));
+    CHECK_FALSE(retry.should_retry(S3StatusErrorSlowDown));
+    CHECK(retry.retries() == 2);
+
+    // the caller may decide what is retryable
+    retry_policy any{name, 1, std::chrono::milliseconds{0}, std::chrono::milliseconds{0}, always_retryable};
+    CHECK(any.should_retry(S3StatusErrorNoSuchKey));
+}
+
+TEST_CASE("retries stop when the budget of the resource is exhausted", "[retry_policy]")
+{
+    const std::string name = resource_name("exhausted");
+    auto& budget = retry_budget::for_resource(name);
+    const budget_detacher detacher{budget};
+    budget.configure(1);
+
+    retry_policy retry{name, 10, std::chrono::milliseconds{0}, std::chrono::milliseconds{0}};
+    CHECK(retry.should_retry(S3StatusErrorInternalError));
+    CHECK_FALSE(retry.should_retry(S3StatusErrorInternalError));
+    CHECK(retry.retries() == 1);
+}
+
+TEST_CASE("retries wait between the base and the maximum wait", "[retry_policy]")
+{
+    const std::string name = resource_name("wait");
+    auto& budget = retry_budget::for_resource(name);
+    const budget_detacher detacher{budget};
+    budget.configure(0);
+
+    retry_policy retry{name, 3, std::chrono::milliseconds{20}, std::chrono::milliseconds{30}};
+    for (int i = 0; i < 3; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(retry.should_retry(S3StatusConnectionFailed));
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{20});
+    }
+
+    // a base wait above the maximum is lowered to it
+    retry_policy capped{name, 1, std::chrono::seconds{60}, std::chrono::milliseconds{1}};
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(capped.should_retry(S3StatusConnectionFailed));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds{10});
+}
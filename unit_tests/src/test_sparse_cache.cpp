@@ -0,0 +1,228 @@
+#include <catch2/catch_all.hpp>
+
+#include "irods/private/s3_transport/sparse_cache.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace sparse_cache = irods::experimental::io::s3_transport::sparse_cache;
+
+namespace
+{
+    // The members of the multipart shared data the bookkeeping uses.
+    struct sparse_data
+    {
+        sparse_data(std::int64_t _object_size, std::int64_t _part_size)
+            : existing_object_size{_object_size}
+            , sparse_part_size{_part_size}
+            , filled_parts(sparse_cache::number_of_words(_object_size, _part_size), 0)
+            , dirty_parts(filled_parts.size(), 0)
+            , filling_parts(filled_parts.size(), 0)
+        {
+        }
+
+        std::int64_t               existing_object_size;
+        std::int64_t               sparse_part_size;
+        std::vector<std::uint64_t> filled_parts;
+        std::vector<std::uint64_t> dirty_parts;
+        std::vector<std::uint64_t> filling_parts;
+    };
+
+    using parts = std::vector<sparse_cache::part_to_read>;
+
+    auto claim(sparse_data& _data, std::int64_t _offset, std::int64_t _length, bool _overwrite,
+               bool _take_over = false) -> std::pair<parts, bool>
+    {
+        parts parts_to_read;
+        const bool waiting = sparse_cache::claim_parts(_data, _offset, _length, _overwrite, _take_over, parts_to_read);
+        return {parts_to_read, waiting};
+    }
+
+    void release(sparse_data& _data, const parts& _parts, bool _read, bool _overwrite)
+    {
+        sparse_cache::release_parts(_data, _parts, std::vector<bool>(_parts.size(), _read), _overwrite);
+    }
+
+    bool layouts_equal(const std::vector<sparse_cache::file_part>& _a, const std::vector<sparse_cache::file_part>& _b)
+    {
+        if (_a.size() != _b.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < _a.size(); ++i) {
+            if (_a[i].offset != _b[i].offset || _a[i].size != _b[i].size || _a[i].copy != _b[i].copy ||
+                    _a[i].unread != _b[i].unread) {
+                return false;
+            }
+        }
+        return true;
+    }
+} // anonymous namespace
+
+TEST_CASE("sparse part size", "[sparse_cache]")
+{
+    // an object smaller than a part is downloaded
+    CHECK(sparse_cache::part_size(100, 1000, 10000) == 0);
+
+    CHECK(sparse_cache::part_size(1000, 1000, 10000) == 1000);
+    CHECK(sparse_cache::part_size(5000000, 1000, 10000) == 1000);
+
+    // parts grow to stay within the maximum number of parts
+    CHECK(sparse_cache::part_size(20000001, 1000, 10000) == 2001);
+
+    // a bit for every part, including a short last one
+    CHECK(sparse_cache::number_of_words(63 * 10, 10) == 1);
+    CHECK(sparse_cache::number_of_words(63 * 10 + 1, 10) == 2);
+}
+
+TEST_CASE("bitmap bits span words", "[sparse_cache]")
+{
+    std::vector<std::uint64_t> bitmap(2, 0);
+
+    sparse_cache::set(bitmap, 0);
+    sparse_cache::set(bitmap, 63);
+    sparse_cache::set(bitmap, 64);
+    CHECK(bitmap[0] == ((std::uint64_t{1} << 63) | 1));
+    CHECK(bitmap[1] == 1);
+
+    sparse_cache::clear(bitmap, 63);
+    CHECK_FALSE(sparse_cache::is_set(bitmap, 63));
+    CHECK(sparse_cache::is_set(bitmap, 64));
+
+    // parts past the bitmap are not set
+    CHECK_FALSE(sparse_cache::is_set(bitmap, 1000));
+}
+
+TEST_CASE("parts read from S3 are claimed once and marked filled", "[sparse_cache]")
+{
+    sparse_data data{1000, 100};
+
+    // bytes 150 to 349 are in parts 1 to 3
+    const auto [first, first_waiting] = claim(data, 150, 200, false);
+    CHECK(first == parts{{1, 100}, {2, 100}, {3, 100}});
+    CHECK_FALSE(first_waiting);
+    CHECK(sparse_cache::is_set(data.filling_parts, 2));
+
+    // another reader claims part 4 and waits for part 3
+    const auto [second, second_waiting] = claim(data, 350, 100, false);
+    CHECK(second == parts{{4, 100}});
+    CHECK(second_waiting);
+    const auto [third, third_waiting] = claim(data, 300, 100, false);
+    CHECK(third.empty());
+    CHECK(third_waiting);
+
+    release(data, first, true, false);
+    CHECK_FALSE(sparse_cache::is_set(data.filling_parts, 2));
+    CHECK(sparse_cache::is_set(data.filled_parts, 2));
+    CHECK_FALSE(sparse_cache::is_set(data.dirty_parts, 2));
+
+    // filled parts are not read again
+    const auto [again, again_waiting] = claim(data, 100, 300, false);
+    CHECK(again.empty());
+    CHECK_FALSE(again_waiting);
+}
+
+TEST_CASE("parts of a reader that takes too long are taken over", "[sparse_cache]")
+{
+    sparse_data data{1000, 100};
+
+    const auto [first, first_waiting] = claim(data, 0, 100, false);
+    CHECK(first == parts{{0, 100}});
+
+    const auto [second, second_waiting] = claim(data, 0, 100, false, true);
+    CHECK(second == parts{{0, 100}});
+    CHECK_FALSE(second_waiting);
+}
+
+TEST_CASE("parts that failed to be read are released unfilled", "[sparse_cache]")
+{
+    sparse_data data{1000, 100};
+
+    const auto [first, first_waiting] = claim(data, 0, 200, false);
+    release(data, first, false, false);
+    CHECK_FALSE(sparse_cache::is_set(data.filling_parts, 0));
+    CHECK_FALSE(sparse_cache::is_set(data.filled_parts, 0));
+
+    const auto [second, second_waiting] = claim(data, 0, 200, false);
+    CHECK(second == parts{{0, 100}, {1, 100}});
+}
+
+TEST_CASE("overwritten parts are marked dirty and read only if partly written", "[sparse_cache]")
+{
+    sparse_data data{1000, 100};
+
+    // part 1 is written whole, parts 0 and 2 only in part
+    const auto [written, written_waiting] = claim(data, 50, 200, true);
+    CHECK(written == parts{{0, 100}, {2, 100}});
+    CHECK(sparse_cache::is_set(data.filled_parts, 1));
+    CHECK(sparse_cache::is_set(data.dirty_parts, 1));
+    CHECK_FALSE(sparse_cache::is_set(data.dirty_parts, 0));
+
+    release(data, written, true, true);
+    CHECK(sparse_cache::is_set(data.dirty_parts, 0));
+    CHECK(sparse_cache::is_set(data.dirty_parts, 2));
+
+    // a part read before it is overwritten becomes dirty
+    const auto [read, read_waiting] = claim(data, 500, 10, false);
+    release(data, read, true, false);
+    CHECK_FALSE(sparse_cache::is_set(data.dirty_parts, 5));
+
+    const auto [overwritten, overwritten_waiting] = claim(data, 505, 1, true);
+    CHECK(overwritten.empty());
+    CHECK(sparse_cache::is_set(data.dirty_parts, 5));
+}
+
+TEST_CASE("bytes past the end of the object are not read", "[sparse_cache]")
+{
+    sparse_data data{250, 100};
+
+    // the last part of the object is short
+    const auto [end, end_waiting] = claim(data, 200, 100, false);
+    CHECK(end == parts{{2, 50}});
+
+    // appended bytes are not in S3
+    const auto [appended, appended_waiting] = claim(data, 250, 1000, true);
+    CHECK(appended.empty());
+
+    // writing past the end of the short part covers all of it
+    sparse_data other{250, 100};
+    const auto [covered, covered_waiting] = claim(other, 200, 100, true);
+    CHECK(covered.empty());
+    CHECK(sparse_cache::is_set(other.dirty_parts, 2));
+}
+
+TEST_CASE("unwritten parts of the object are copied", "[sparse_cache]")
+{
+    sparse_data data{250, 100};
+
+    // the end of the object joins the last copied part
+    CHECK(layouts_equal(sparse_cache::make_layout(data, 250), {{0, 100, true, 100}, {100, 150, true, 100}}));
+
+    // appended bytes are uploaded in parts of the tracked size
+    CHECK(layouts_equal(sparse_cache::make_layout(data, 500),
+                {{0, 100, true, 100}, {100, 150, true, 100}, {250, 100, false, 0}, {350, 100, false, 0},
+                 {450, 50, false, 0}}));
+
+    // a file cut shorter than the object is uploaded whole
+    CHECK(sparse_cache::make_layout(data, 200).empty());
+}
+
+TEST_CASE("written parts of the object are uploaded", "[sparse_cache]")
+{
+    sparse_data data{250, 100};
+
+    // part 0 was read and written, the short part 2 was written without being read
+    const auto [read, read_waiting] = claim(data, 10, 10, true);
+    release(data, read, true, true);
+    sparse_cache::set(data.dirty_parts, 2);
+
+    // the short part is uploaded with the appended bytes and still has bytes of the object to read
+    CHECK(layouts_equal(sparse_cache::make_layout(data, 320),
+                {{0, 100, false, 0}, {100, 100, true, 100}, {200, 100, false, 50}, {300, 20, false, 0}}));
+
+    // a written whole part is not read
+    sparse_data overwritten{250, 100};
+    const auto [covered, covered_waiting] = claim(overwritten, 100, 100, true);
+    CHECK(covered.empty());
+    CHECK(layouts_equal(sparse_cache::make_layout(overwritten, 250),
+                {{0, 100, true, 100}, {100, 100, false, 0}, {200, 50, false, 50}}));
+}